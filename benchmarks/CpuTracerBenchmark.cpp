@@ -0,0 +1,161 @@
+// CPU ray tracer benchmark: BVH build time and quality for the demo scene,
+// then frames traced with packet and single-ray primary traversal. Rays per
+// second count primary, reflection and shadow rays. Optionally writes the
+// last frame, tone mapped, as a PPM for comparison with the GPU backends.
+// Usage: CpuTracerBenchmark [width height] [frames] [out.ppm]
+#include "Camera.h"
+#include "CpuTracer.h"
+#include "JobSystem.h"
+#include "Material.h"
+#include "Scene.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr uint32_t DEFAULT_WIDTH = 640;
+constexpr uint32_t DEFAULT_HEIGHT = 360;
+constexpr uint32_t DEFAULT_FRAMES = 8;
+constexpr float FRAME_TIME = 1.0f / 60.0f;
+
+double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Same rig as SimpleRenderer::makeLightingConstants
+void setupLights(CpuTraceFrame& frame, float time) {
+    frame.lightCount = 4;
+    frame.ambientLight = glm::vec3(0.02f, 0.02f, 0.05f);
+    frame.lightPositions[0] = glm::vec4(0.0f, 50.0f, -30.0f, 1.0f);
+    frame.lightColors[0] = glm::vec4(1.0f, 0.3f, 0.8f, 2.0f);
+    frame.lightPositions[1] = glm::vec4(-20.0f, 30.0f, -20.0f, 1.0f);
+    frame.lightColors[1] = glm::vec4(0.2f, 0.8f, 1.0f, 1.5f);
+    frame.lightPositions[2] = glm::vec4(10.0f, 5.0f, -25.0f, 1.0f);
+    frame.lightColors[2] = glm::vec4(1.0f, 0.6f, 0.2f, 1.0f);
+    frame.lightPositions[3] = glm::vec4(15.0f, 40.0f, -35.0f + std::sin(time * 0.5f) * 10.0f, 1.0f);
+    frame.lightColors[3] = glm::vec4(0.8f, 0.2f, 1.0f, 1.2f + std::sin(time * 2.0f) * 0.3f);
+}
+
+struct RunStats {
+    double frameMs = 0.0;
+    double mrays = 0.0;
+};
+
+// The camera turns slowly so frames are not identical
+RunStats renderFrames(CpuTracer& tracer, Camera& camera, JobSystem& jobs, uint32_t width, uint32_t height, uint32_t frames) {
+    RunStats result;
+    glm::mat4 prevViewProjection = camera.getProjectionMatrix() * camera.getViewMatrix();
+    float yaw = camera.getYaw();
+    for (uint32_t i = 0; i < frames; ++i) {
+        float time = i * FRAME_TIME;
+        camera.setOrientation(yaw + i * 0.5f, camera.getPitch());
+
+        CpuTraceFrame frame;
+        glm::mat4 view = camera.getViewMatrix();
+        glm::mat4 proj = camera.getProjectionMatrix();
+        frame.viewInverse = glm::inverse(view);
+        frame.projInverse = glm::inverse(proj);
+        frame.viewProjection = proj * view;
+        frame.prevViewProjection = prevViewProjection;
+        frame.cameraPos = camera.getPosition();
+        frame.time = time;
+        setupLights(frame, time);
+        prevViewProjection = frame.viewProjection;
+
+        tracer.render(frame, width, height, &jobs);
+        const CpuTracerStats& stats = tracer.getStats();
+        result.frameMs += stats.renderMs;
+        result.mrays += (stats.primaryRays + stats.secondaryRays + stats.shadowRays) / (stats.renderMs * 1000.0);
+    }
+    result.frameMs /= frames;
+    result.mrays /= frames;
+    camera.setOrientation(yaw, camera.getPitch());
+    return result;
+}
+
+// ACES fit of the post composite; no exposure, grading or bloom
+void writePpm(const char* path, const CpuTracer& tracer) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Failed to open " << path << std::endl;
+        return;
+    }
+    file << "P6\n" << tracer.getWidth() << " " << tracer.getHeight() << "\n255\n";
+    for (const glm::vec4& color : tracer.getColor()) {
+        for (int c = 0; c < 3; ++c) {
+            float x = color[c];
+            float mapped = std::clamp((x * (2.51f * x + 0.03f)) / (x * (2.43f * x + 0.59f) + 0.14f), 0.0f, 1.0f);
+            file.put(static_cast<char>(std::lround(std::pow(mapped, 1.0f / 2.2f) * 255.0f)));
+        }
+    }
+    std::cout << "Wrote " << path << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    uint32_t width = DEFAULT_WIDTH;
+    uint32_t height = DEFAULT_HEIGHT;
+    uint32_t frames = DEFAULT_FRAMES;
+    const char* outputPath = nullptr;
+    if (argc > 2) {
+        width = std::max(1L, std::strtol(argv[1], nullptr, 10));
+        height = std::max(1L, std::strtol(argv[2], nullptr, 10));
+    }
+    if (argc > 3) {
+        frames = std::max(1L, std::strtol(argv[3], nullptr, 10));
+    }
+    if (argc > 4) {
+        outputPath = argv[4];
+    }
+
+    JobSystem jobs;
+    Scene scene(&jobs);
+    scene.init();
+
+    const std::vector<GLTFMesh>& sceneMeshes = scene.getMeshes();
+    const std::vector<SceneMeshRange>& ranges = scene.getMeshRanges();
+    SceneTransforms transforms;
+    scene.captureTransforms(transforms);
+    std::vector<CpuTracerMesh> meshes;
+    for (uint32_t i = 0; i < sceneMeshes.size(); ++i) {
+        if (ranges[i].indexCount >= 3) {
+            meshes.push_back({ranges[i].indexCount, makeMaterialRecord(sceneMeshes[i], ranges[i].firstIndex), i, transforms.meshWorlds[i]});
+        }
+    }
+
+    CpuTracer tracer;
+    auto buildStart = Clock::now();
+    tracer.build(scene.getVertices(), scene.getIndices(), std::move(meshes), &jobs);
+    double buildMs = elapsedMs(buildStart);
+
+    const CpuBvhStats& bvh = tracer.getBvh().getStats();
+    std::cout << std::fixed << std::setprecision(2)
+              << "Workers: " << jobs.getWorkerCount() << " | SIMD lanes: " << CpuRayPacket::WIDTH << std::endl
+              << "BVH: " << bvh.triangleCount << " triangles, " << bvh.nodeCount << " nodes, " << bvh.leafCount
+              << " leaves, depth " << bvh.depth << ", SAH cost " << bvh.sahCost << ", build " << bvh.buildMs
+              << " ms (" << buildMs << " ms with copies)" << std::endl;
+
+    Camera camera(static_cast<int>(width), static_cast<int>(height));
+    std::cout << "traversal  frame ms  Mrays/s" << std::endl;
+    for (bool packets : {true, false}) {
+        tracer.setPacketsEnabled(packets);
+        RunStats run = renderFrames(tracer, camera, jobs, width, height, frames);
+        std::cout << std::setw(9) << (packets ? "packet" : "single")
+                  << std::setw(10) << run.frameMs
+                  << std::setw(9) << run.mrays << std::endl;
+    }
+
+    if (outputPath) {
+        writePpm(outputPath, tracer);
+    }
+    return 0;
+}
@@ -0,0 +1,112 @@
+// Micro-benchmarks for JobSystem: per-job spawn overhead, dependency latency
+// and parallelFor scaling from 1 to 64 workers. Worker counts above the
+// hardware thread count are still run so oversubscription shows up in the
+// report. Usage: JobSystemBenchmark [maxWorkers] [pin]
+#include "JobSystem.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr uint32_t SPAWN_JOBS = 200000;
+constexpr uint32_t CHAIN_LENGTH = 20000;
+constexpr uint32_t SCALING_ITEMS = 1u << 20;
+constexpr uint32_t SCALING_GRAIN = 1024;
+constexpr uint32_t REPEATS = 5;
+
+double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Enough arithmetic per item that scaling is not memory bound
+float work(uint32_t item) {
+    float value = static_cast<float>(item);
+    for (int i = 0; i < 64; ++i) {
+        value = std::sin(value) * 0.5f + 1.0f;
+    }
+    return value;
+}
+
+double benchmarkSpawn(JobSystem& jobs) {
+    std::atomic<uint32_t> executed{0};
+    JobCounter counter;
+    auto start = Clock::now();
+    for (uint32_t i = 0; i < SPAWN_JOBS; ++i) {
+        jobs.spawn([&executed]() { executed.fetch_add(1, std::memory_order_relaxed); }, &counter);
+    }
+    jobs.wait(counter);
+    return elapsedMs(start) * 1.0e6 / SPAWN_JOBS;
+}
+
+// Each job of the chain only becomes runnable when the previous one finished
+double benchmarkChain(JobSystem& jobs) {
+    std::vector<JobCounter> counters(CHAIN_LENGTH);
+    auto start = Clock::now();
+    jobs.spawn([]() {}, &counters[0]);
+    for (uint32_t i = 1; i < CHAIN_LENGTH; ++i) {
+        jobs.runAfter(counters[i - 1], []() {}, &counters[i]);
+    }
+    jobs.wait(counters.back());
+    // Earlier counters may still be releasing their continuation
+    for (JobCounter& counter : counters) {
+        jobs.wait(counter);
+    }
+    return elapsedMs(start) * 1.0e6 / CHAIN_LENGTH;
+}
+
+double benchmarkParallelFor(JobSystem& jobs, std::vector<float>& output) {
+    double best = 1.0e30;
+    for (uint32_t repeat = 0; repeat < REPEATS; ++repeat) {
+        auto start = Clock::now();
+        jobs.parallelFor(SCALING_ITEMS, SCALING_GRAIN, [&output](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; ++i) {
+                output[i] = work(i);
+            }
+        });
+        best = std::min(best, elapsedMs(start));
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    uint32_t maxWorkers = 64;
+    bool pin = false;
+    if (argc > 1) {
+        maxWorkers = std::max(1L, std::strtol(argv[1], nullptr, 10));
+    }
+    if (argc > 2) {
+        pin = std::strcmp(argv[2], "pin") == 0;
+    }
+
+    std::cout << "Hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "workers  spawn ns/job  chain ns/job  parallelFor ms  speedup" << std::endl;
+
+    std::vector<float> output(SCALING_ITEMS);
+    double baselineMs = 0.0;
+    for (uint32_t workers = 1; workers <= maxWorkers; workers *= 2) {
+        JobSystem jobs(workers, pin);
+        double spawnNs = benchmarkSpawn(jobs);
+        double chainNs = benchmarkChain(jobs);
+        double forMs = benchmarkParallelFor(jobs, output);
+        if (workers == 1) {
+            baselineMs = forMs;
+        }
+        std::cout << std::setw(7) << workers
+                  << std::setw(14) << spawnNs
+                  << std::setw(14) << chainNs
+                  << std::setw(16) << forMs
+                  << std::setw(9) << baselineMs / forMs << "x" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,180 @@
+// SceneRaycaster benchmark on the demo scene: queries per second for single
+// closest-hit and any-hit rays on one thread, for batches on the job system,
+// and the cost of moving every instance. Ground probes are a coherent grid of
+// downward rays (ground clamping); line-of-sight rays join random points in
+// the scene bounds and are incoherent.
+// Usage: RaycastBenchmark [rays] [workers]
+#include "JobSystem.h"
+#include "Scene.h"
+#include "SceneRaycaster.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr uint32_t DEFAULT_RAYS = 1u << 18;
+constexpr uint32_t REPEATS = 3;
+
+double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Best of REPEATS runs, in million queries per second
+template <typename Run>
+double measure(uint32_t queries, Run run) {
+    double best = 1.0e30;
+    for (uint32_t repeat = 0; repeat < REPEATS; ++repeat) {
+        auto start = Clock::now();
+        run();
+        best = std::min(best, elapsedMs(start));
+    }
+    return queries / (best * 1000.0);
+}
+
+std::vector<CpuRay> makeGroundProbes(const glm::vec3& boundsMin, const glm::vec3& boundsMax, uint32_t count) {
+    uint32_t side = static_cast<uint32_t>(std::sqrt(static_cast<double>(count)));
+    std::vector<CpuRay> rays;
+    rays.reserve(side * side);
+    glm::vec3 extent = boundsMax - boundsMin;
+    for (uint32_t z = 0; z < side; ++z) {
+        for (uint32_t x = 0; x < side; ++x) {
+            CpuRay ray;
+            ray.origin = glm::vec3(boundsMin.x + extent.x * (x + 0.5f) / side, boundsMax.y + 1.0f,
+                                   boundsMin.z + extent.z * (z + 0.5f) / side);
+            ray.direction = glm::vec3(0.0f, -1.0f, 0.0f);
+            rays.push_back(ray);
+        }
+    }
+    return rays;
+}
+
+std::vector<CpuRay> makeLineOfSight(const glm::vec3& boundsMin, const glm::vec3& boundsMax, uint32_t count) {
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    auto randomPoint = [&]() {
+        return boundsMin + (boundsMax - boundsMin) * glm::vec3(unit(rng), unit(rng), unit(rng));
+    };
+    std::vector<CpuRay> rays(count);
+    for (CpuRay& ray : rays) {
+        glm::vec3 from = randomPoint();
+        glm::vec3 to = randomPoint();
+        float distance = std::max(glm::length(to - from), 1.0e-3f);
+        ray.origin = from;
+        ray.direction = (to - from) / distance;
+        ray.tMin = 1.0e-3f;
+        ray.tMax = distance;
+    }
+    return rays;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    uint32_t rayCount = DEFAULT_RAYS;
+    uint32_t workers = 0;
+    if (argc > 1) {
+        rayCount = std::max(1L, std::strtol(argv[1], nullptr, 10));
+    }
+    if (argc > 2) {
+        workers = std::max(1L, std::strtol(argv[2], nullptr, 10));
+    }
+
+    JobSystem jobs(workers);
+    Scene scene(&jobs);
+    scene.init();
+
+    SceneRaycaster raycaster;
+    raycaster.build(scene.getVertices(), scene.getIndices(), scene.getMeshRanges(), &jobs);
+    RaycastStats stats = raycaster.getStats();
+
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+    for (const GLTFVertex& vertex : scene.getVertices()) {
+        boundsMin = glm::min(boundsMin, vertex.position);
+        boundsMax = glm::max(boundsMax, vertex.position);
+    }
+
+    std::vector<CpuRay> probes = makeGroundProbes(boundsMin, boundsMax, rayCount);
+    std::vector<CpuRay> sight = makeLineOfSight(boundsMin, boundsMax, rayCount);
+    std::vector<RaycastHit> hits(std::max(probes.size(), sight.size()));
+    std::vector<uint8_t> occluded(sight.size());
+
+    std::cout << std::fixed << std::setprecision(2)
+              << "Workers: " << jobs.getWorkerCount() << " | SIMD lanes: " << CpuRayPacket::WIDTH << std::endl
+              << "Scene: " << stats.instanceCount << " instances, " << stats.triangleCount << " triangles, build "
+              << stats.buildMs << " ms" << std::endl;
+
+    uint32_t probeCount = static_cast<uint32_t>(probes.size());
+    uint32_t sightCount = static_cast<uint32_t>(sight.size());
+    double singleProbe = measure(probeCount, [&]() {
+        for (uint32_t i = 0; i < probeCount; ++i) {
+            raycaster.castRay(probes[i], hits[i]);
+        }
+    });
+    double singleClosest = measure(sightCount, [&]() {
+        for (uint32_t i = 0; i < sightCount; ++i) {
+            raycaster.castRay(sight[i], hits[i]);
+        }
+    });
+    double singleSight = measure(sightCount, [&]() {
+        for (uint32_t i = 0; i < sightCount; ++i) {
+            occluded[i] = raycaster.isOccluded(sight[i]);
+        }
+    });
+    double batchProbe = measure(probeCount, [&]() { raycaster.castRays(probes.data(), hits.data(), probeCount, &jobs); });
+    double batchClosest = measure(sightCount, [&]() { raycaster.castRays(sight.data(), hits.data(), sightCount, &jobs); });
+    double batchSight = measure(sightCount, [&]() { raycaster.testOcclusion(sight.data(), occluded.data(), sightCount, &jobs); });
+
+    std::cout << "query                    single Mq/s  batch Mq/s" << std::endl;
+    auto report = [](const char* name, double single, double batch) {
+        std::cout << std::left << std::setw(25) << name << std::right << std::setw(11) << single << std::setw(12) << batch << std::endl;
+    };
+    report("ground probe (closest)", singleProbe, batchProbe);
+    report("line of sight (closest)", singleClosest, batchClosest);
+    report("line of sight (any)", singleSight, batchSight);
+
+    // Every instance moves each frame, e.g. a traffic system driving them
+    uint32_t instanceCount = raycaster.getInstanceCount();
+    std::vector<uint32_t> instances(instanceCount);
+    std::vector<glm::mat4> transforms(instanceCount);
+    for (uint32_t i = 0; i < instanceCount; ++i) {
+        instances[i] = i;
+        transforms[i] = glm::mat4(1.0f);
+        transforms[i][3] = glm::vec4(0.0f, 0.01f * i, 0.0f, 1.0f);
+    }
+    double refitMs = 1.0e30;
+    for (uint32_t repeat = 0; repeat < REPEATS; ++repeat) {
+        auto start = Clock::now();
+        raycaster.setInstanceTransforms(instances.data(), transforms.data(), instanceCount);
+        refitMs = std::min(refitMs, elapsedMs(start));
+    }
+    std::cout << "Moving all " << instanceCount << " instances: " << std::setprecision(3) << refitMs << " ms" << std::endl;
+
+    // The same motion as the simulation drives it: nodes set, graph updated,
+    // world matrices captured and synced into the raycaster
+    SceneGraph& graph = scene.getSceneGraph();
+    const std::vector<uint32_t>& meshNodes = scene.getMeshNodes();
+    SceneTransforms sceneTransforms;
+    double graphMs = 1.0e30;
+    for (uint32_t repeat = 0; repeat < REPEATS; ++repeat) {
+        for (uint32_t i = 0; i < meshNodes.size(); ++i) {
+            graph.setTranslation(meshNodes[i], glm::vec3(0.0f, 0.01f * i + 0.001f * (repeat + 1), 0.0f));
+        }
+        auto start = Clock::now();
+        scene.update(0.0f);
+        scene.captureTransforms(sceneTransforms);
+        raycaster.syncTransforms(sceneTransforms);
+        graphMs = std::min(graphMs, elapsedMs(start));
+    }
+    std::cout << "Moving them through the scene graph: " << graphMs << " ms" << std::endl;
+    return 0;
+}
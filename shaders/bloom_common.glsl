@@ -0,0 +1,25 @@
+// Shared by bloom_downsample.comp and bloom_upsample.comp. Both passes work
+// on 8x8 output tiles and stage the source texels they need in shared memory
+// so every source texel is fetched from memory once per workgroup.
+#ifndef BLOOM_COMMON_GLSL
+#define BLOOM_COMMON_GLSL
+
+const int BLOOM_TILE_SIZE = 8; // Matches POST_TILE_SIZE in PostProcess.h
+
+// Mirrors BloomPushConstants in PostProcess.cpp
+layout(push_constant) uniform BloomPushConstants {
+    ivec2 srcSize;
+    ivec2 dstSize;
+    float threshold;
+    float knee;
+    uint prefilter;
+} bloom;
+
+// Half float max; keeps a stray infinity from smearing across the pyramid
+const float BLOOM_MAX_VALUE = 65000.0;
+
+float bloomLuminance(vec3 color) {
+    return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+#endif // BLOOM_COMMON_GLSL
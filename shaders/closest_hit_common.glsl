@@ -0,0 +1,25 @@
+// Declarations shared by the per-material closest hit shaders. Every hit
+// group's SBT record carries its mesh's MaterialParams inline.
+#ifndef CLOSEST_HIT_COMMON_GLSL
+#define CLOSEST_HIT_COMMON_GLSL
+
+#include "ray_payload.glsl"
+#include "material.glsl"
+
+hitAttributeEXT vec2 attribs;
+layout(location = 0) rayPayloadInEXT RayPayload payload;
+
+layout(shaderRecordEXT, std430) buffer HitRecord {
+    MaterialParams material;
+} hitRecord;
+
+void writeHitPayload(MaterialSample surface) {
+    payload.color = surface.albedo;
+    payload.normal = surface.normal;
+    payload.worldPos = gl_WorldRayOriginEXT + gl_WorldRayDirectionEXT * gl_HitTEXT;
+    payload.emission = surface.emission;
+    payload.hitDistance = gl_HitTEXT;
+    payload.reflectivity = surface.reflectivity;
+}
+
+#endif // CLOSEST_HIT_COMMON_GLSL
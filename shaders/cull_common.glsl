@@ -0,0 +1,75 @@
+// Visibility tests shared by the GPU culling passes (draw_cull.comp,
+// meshlet_cull.comp and meshlet.task). Bounds are world-space AABBs, placed
+// by mesh_transform.glsl, tested against the unjittered view-projection and
+// the reverse-Z Hi-Z pyramid.
+#ifndef CULL_COMMON_GLSL
+#define CULL_COMMON_GLSL
+
+// Gribb-Hartmann planes. With reverse-Z the near plane is z <= w; the far
+// plane uses the GL z >= -w form, which is conservative for the [0, w] range.
+bool isBoxInFrustum(mat4 viewProjection, vec3 boundsMin, vec3 boundsMax) {
+    mat4 m = viewProjection;
+    vec4 row0 = vec4(m[0][0], m[1][0], m[2][0], m[3][0]);
+    vec4 row1 = vec4(m[0][1], m[1][1], m[2][1], m[3][1]);
+    vec4 row2 = vec4(m[0][2], m[1][2], m[2][2], m[3][2]);
+    vec4 row3 = vec4(m[0][3], m[1][3], m[2][3], m[3][3]);
+    vec4 planes[6] = vec4[](row3 + row0, row3 - row0, row3 + row1, row3 - row1, row3 + row2, row3 - row2);
+
+    for (int i = 0; i < 6; i++) {
+        // Corner of the box furthest along the plane normal
+        vec3 positive = mix(boundsMin, boundsMax, greaterThanEqual(planes[i].xyz, vec3(0.0)));
+        if (dot(planes[i].xyz, positive) + planes[i].w < 0.0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Projects the box to screen space and compares its nearest depth with the
+// farthest depth of the pyramid texels under it, at the level where the
+// footprint spans at most 2x2 texels.
+bool isBoxOccluded(sampler2D hizImage, mat4 viewProjection, vec3 boundsMin, vec3 boundsMax) {
+    vec2 uvMin = vec2(1.0);
+    vec2 uvMax = vec2(0.0);
+    float nearestDepth = 0.0;
+    for (int i = 0; i < 8; i++) {
+        vec3 corner = mix(boundsMin, boundsMax, bvec3((i & 1) != 0, (i & 2) != 0, (i & 4) != 0));
+        vec4 clip = viewProjection * vec4(corner, 1.0);
+        if (clip.w <= 0.0) {
+            return false; // Straddles the camera plane
+        }
+        vec3 ndc = clip.xyz / clip.w;
+        vec2 uv = ndc.xy * 0.5 + 0.5;
+        uvMin = min(uvMin, uv);
+        uvMax = max(uvMax, uv);
+        nearestDepth = max(nearestDepth, ndc.z);
+    }
+
+    // The depth was rendered with the TAAU jitter, so widen by a texel
+    ivec2 size = textureSize(hizImage, 0);
+    ivec2 first = clamp(ivec2(floor(clamp(uvMin, 0.0, 1.0) * vec2(size))) - 1, ivec2(0), size - 1);
+    ivec2 last = clamp(ivec2(floor(clamp(uvMax, 0.0, 1.0) * vec2(size))) + 1, ivec2(0), size - 1);
+
+    ivec2 footprint = last - first + 1;
+    int level = int(ceil(log2(float(max(footprint.x, footprint.y)))));
+    level = clamp(level, 0, textureQueryLevels(hizImage) - 1);
+
+    ivec2 levelMax = textureSize(hizImage, level) - 1;
+    ivec2 texelMin = min(first >> level, levelMax);
+    ivec2 texelMax = min(last >> level, levelMax);
+    float farthest = min(min(texelFetch(hizImage, texelMin, level).r,
+                             texelFetch(hizImage, ivec2(texelMax.x, texelMin.y), level).r),
+                         min(texelFetch(hizImage, ivec2(texelMin.x, texelMax.y), level).r,
+                             texelFetch(hizImage, texelMax, level).r));
+    return nearestDepth < farthest;
+}
+
+// Normal cone test (meshoptimizer's formulation with the bounding sphere
+// center): true when every triangle of the cluster faces away from the camera.
+// A cutoff of 1 can never pass, which disables the test for wide cones.
+bool isConeBackfacing(vec3 center, float radius, vec3 coneAxis, float coneCutoff, vec3 cameraPos) {
+    vec3 toCenter = center - cameraPos;
+    return dot(toCenter, coneAxis) >= coneCutoff * length(toCenter) + radius;
+}
+
+#endif // CULL_COMMON_GLSL
@@ -1,44 +1,109 @@
 #version 450
 
+// Mirrors UniformBufferObject in SimpleRenderer.h
 layout(binding = 0) uniform UniformBufferObject {
     mat4 model;
     mat4 view;
     mat4 proj;
+    mat4 viewInverse;
+    mat4 projInverse;
+    mat4 viewProjection;
+    mat4 prevViewProjection;
     vec3 cameraPos;
-    float time;
 } ubo;
 
+// Mirrors PointLight in SimpleRenderer.h
+struct PointLight {
+    vec4 positionRadius; // World position, range where the falloff reaches zero
+    vec4 colorIntensity;
+};
+
+layout(binding = 1, std430) readonly buffer Lights {
+    PointLight lights[];
+} lightBuffer;
+
+// Written each frame by cluster_lights.comp
+layout(binding = 2, std430) readonly buffer ClusterCounts {
+    uint counts[];
+} clusterCounts;
+
+layout(binding = 3, std430) readonly buffer ClusterLights {
+    uint indices[];
+} clusterLights;
+
+// Mirrors ClusterPushConstants in SimpleRenderer.h
+layout(push_constant) uniform ClusterPushConstants {
+    uint gridX;
+    uint gridY;
+    uint gridZ;
+    uint lightCount;
+    float screenWidth;
+    float screenHeight;
+    float zNear;
+    float zFar;
+    float time;
+} cluster;
+
+const uint CLUSTER_TILE_SIZE = 64u;       // Pixels, matches SimpleRenderer::CLUSTER_TILE_SIZE
+const uint MAX_LIGHTS_PER_CLUSTER = 128u; // Matches SimpleRenderer::MAX_LIGHTS_PER_CLUSTER
+
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragTexCoord;
 layout(location = 2) in vec3 fragNormal;
 layout(location = 3) in vec3 fragWorldPos;
+layout(location = 4) in vec4 fragCurrentClip;
+layout(location = 5) in vec4 fragPreviousClip;
 
 layout(location = 0) out vec4 outColor;
+layout(location = 1) out vec2 outMotion; // Current minus previous UV, read by the TAAU resolve
+
+uint findCluster() {
+    uvec2 tile = min(uvec2(gl_FragCoord.xy) / CLUSTER_TILE_SIZE, uvec2(cluster.gridX, cluster.gridY) - 1u);
+    float viewDepth = -(ubo.view * vec4(fragWorldPos, 1.0)).z;
+    float slice = log(max(viewDepth, cluster.zNear) / cluster.zNear) / log(cluster.zFar / cluster.zNear) * float(cluster.gridZ);
+    uint sliceIndex = min(uint(slice), cluster.gridZ - 1u);
+    return (sliceIndex * cluster.gridY + tile.y) * cluster.gridX + tile.x;
+}
 
 void main() {
-    // Basic lighting
-    vec3 lightDir = normalize(vec3(1.0, 1.0, 1.0));
     vec3 normal = normalize(fragNormal);
-    float diff = max(dot(normal, lightDir), 0.0);
-    
+    vec3 viewDir = normalize(ubo.cameraPos - fragWorldPos);
+
     // Ambient lighting
     vec3 ambient = vec3(0.1, 0.1, 0.2);
-    
-    // Diffuse lighting
-    vec3 diffuse = diff * vec3(0.8, 0.8, 1.0);
-    
-    // Combine lighting
-    vec3 lighting = ambient + diffuse;
-    
-    // Apply cyberpunk color grading
-    vec3 color = fragColor * lighting;
-    
+    vec3 color = fragColor * ambient;
+
+    // Point lights of this fragment's cluster, with the ray tracer's falloff
+    // windowed to reach zero at the light's range
+    uint clusterIndex = findCluster();
+    uint lightCount = min(clusterCounts.counts[clusterIndex], MAX_LIGHTS_PER_CLUSTER);
+    for (uint i = 0u; i < lightCount; i++) {
+        PointLight light = lightBuffer.lights[clusterLights.indices[clusterIndex * MAX_LIGHTS_PER_CLUSTER + i]];
+        vec3 toLight = light.positionRadius.xyz - fragWorldPos;
+        float distance = length(toLight);
+        if (distance >= light.positionRadius.w) {
+            continue;
+        }
+        vec3 lightDir = toLight / distance;
+        float NdotL = dot(normal, lightDir);
+        if (NdotL <= 0.0) {
+            continue;
+        }
+
+        float window = clamp(1.0 - pow(distance / light.positionRadius.w, 4.0), 0.0, 1.0);
+        float attenuation = window * window / (1.0 + 0.1 * distance + 0.01 * distance * distance);
+        vec3 radiance = light.colorIntensity.rgb * light.colorIntensity.w * attenuation;
+
+        float spec = pow(max(dot(viewDir, reflect(-lightDir, normal)), 0.0), 32.0);
+        color += radiance * (fragColor * NdotL + 0.5 * spec);
+    }
+
     // Add some neon glow effect for bright colors
     if (fragColor.r > 0.8 || fragColor.g > 0.8 || fragColor.b > 0.8) {
-        float glow = sin(ubo.time * 2.0) * 0.3 + 0.7;
+        float glow = sin(cluster.time * 2.0) * 0.3 + 0.7;
         color += fragColor * glow * 0.5;
     }
-    
+
     outColor = vec4(color, 1.0);
+    outMotion = (fragCurrentClip.xy / fragCurrentClip.w - fragPreviousClip.xy / fragPreviousClip.w) * 0.5;
 }
-
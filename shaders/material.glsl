@@ -0,0 +1,81 @@
+// Material models shared by the per-material closest hit shaders and
+// ray_query.comp. Each model reads only the vertex attributes it needs.
+#ifndef MATERIAL_GLSL
+#define MATERIAL_GLSL
+
+#include "vertex_fetch.glsl"
+
+// Mirrors MaterialRecord in Material.h (std430). Stored inline in the SBT hit
+// records and, for ray queries, in the mesh info buffer.
+struct MaterialParams {
+    vec4 baseColor;     // Albedo multiplier, metal F0 tint or glass tint
+    vec4 emission;      // Radiance, already scaled by strength
+    float roughness;
+    float reflectivity; // Bounce weight (rough/metal) or F0 (glass)
+    uint firstIndex;    // Mesh start in its index buffer, for the BLAS build
+    uint materialType;
+};
+
+const uint MATERIAL_ROUGH = 0u;
+const uint MATERIAL_METALLIC = 1u;
+const uint MATERIAL_EMISSIVE = 2u;
+const uint MATERIAL_GLASS = 3u;
+
+// Fraction of light the glass tint scatters back diffusely
+const float GLASS_TINT_STRENGTH = 0.2;
+
+struct MaterialSample {
+    vec3 albedo;
+    vec3 normal;
+    vec3 emission;
+    float reflectivity;
+};
+
+// Dielectric with vertex colors: full color + normal fetch
+MaterialSample sampleRoughMaterial(MaterialParams material, Triangle triangle, vec3 barycentrics) {
+    MaterialSample result;
+    result.albedo = interpolateColor(triangle, barycentrics) * material.baseColor.rgb;
+    result.normal = interpolateNormal(triangle, barycentrics);
+    result.emission = vec3(0.0);
+    result.reflectivity = material.reflectivity;
+    return result;
+}
+
+// Metals take their tint from the material, so vertex colors are skipped
+MaterialSample sampleMetallicMaterial(MaterialParams material, Triangle triangle, vec3 barycentrics) {
+    MaterialSample result;
+    result.albedo = material.baseColor.rgb;
+    result.normal = interpolateNormal(triangle, barycentrics);
+    result.emission = vec3(0.0);
+    result.reflectivity = material.reflectivity;
+    return result;
+}
+
+// Pure emitters need no vertex data and end the path
+MaterialSample sampleEmissiveMaterial(MaterialParams material, vec3 rayDirection) {
+    MaterialSample result;
+    result.albedo = vec3(0.0);
+    result.normal = -rayDirection;
+    result.emission = material.emission.rgb;
+    result.reflectivity = 0.0;
+    return result;
+}
+
+// Thin glass: Schlick Fresnel on the geometric normal decides how much is
+// reflected; the transmitted part shows up as a faint tint.
+MaterialSample sampleGlassMaterial(MaterialParams material, Triangle triangle, vec3 rayDirection) {
+    vec3 normal = faceNormal(triangle);
+    normal = faceforward(normal, rayDirection, normal);
+
+    float cosTheta = clamp(dot(-rayDirection, normal), 0.0, 1.0);
+    float fresnel = material.reflectivity + (1.0 - material.reflectivity) * pow(1.0 - cosTheta, 5.0);
+
+    MaterialSample result;
+    result.albedo = material.baseColor.rgb * GLASS_TINT_STRENGTH * (1.0 - fresnel);
+    result.normal = normal;
+    result.emission = vec3(0.0);
+    result.reflectivity = fresnel;
+    return result;
+}
+
+#endif // MATERIAL_GLSL
@@ -0,0 +1,38 @@
+// Scene graph placement of every mesh, shared by the raster vertex stages and
+// the culling passes. Vertices and cull bounds are stored in mesh space; each
+// includer declares the MeshTransforms buffer at its own binding.
+#ifndef MESH_TRANSFORM_GLSL
+#define MESH_TRANSFORM_GLSL
+
+// Mirrors MeshTransform in SimpleRenderer.h (std430)
+struct MeshTransform {
+    mat4 model;
+    mat4 previousModel; // Last frame's, for motion vectors
+};
+
+// Arvo's method: the world AABB enclosing the transformed mesh-space box
+void placeBox(mat4 model, inout vec3 boundsMin, inout vec3 boundsMax) {
+    vec3 center = (model * vec4((boundsMin + boundsMax) * 0.5, 1.0)).xyz;
+    vec3 extent = (boundsMax - boundsMin) * 0.5;
+    vec3 worldExtent = abs(model[0].xyz) * extent.x + abs(model[1].xyz) * extent.y + abs(model[2].xyz) * extent.z;
+    boundsMin = center - worldExtent;
+    boundsMax = center + worldExtent;
+}
+
+// Center moved, radius grown by the largest axis scale
+vec4 placeSphere(mat4 model, vec4 sphere) {
+    float scale = max(max(length(model[0].xyz), length(model[1].xyz)), length(model[2].xyz));
+    return vec4((model * vec4(sphere.xyz, 1.0)).xyz, sphere.w * scale);
+}
+
+// A normal cone survives rotation and uniform scale; otherwise its cutoff no
+// longer bounds the normals, and a cutoff of 1 disables the test
+vec4 placeCone(mat4 model, vec4 cone) {
+    vec3 scales = vec3(length(model[0].xyz), length(model[1].xyz), length(model[2].xyz));
+    if (max(max(scales.x, scales.y), scales.z) - min(min(scales.x, scales.y), scales.z) > 1e-3 * scales.x) {
+        return vec4(cone.xyz, 1.0);
+    }
+    return vec4(normalize(mat3(model) * cone.xyz), cone.w);
+}
+
+#endif // MESH_TRANSFORM_GLSL
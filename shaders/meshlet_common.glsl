@@ -0,0 +1,105 @@
+// Meshlet data and the per-meshlet two-phase cull shared by the mesh shader
+// path (meshlet.task / meshlet.mesh) and its compute fallback
+// (meshlet_cull.comp). Set 0 is the raster set (camera UBO, mesh transforms),
+// set 1 holds the meshlet buffers, one set per cull phase.
+#ifndef MESHLET_COMMON_GLSL
+#define MESHLET_COMMON_GLSL
+
+#include "cull_common.glsl"
+#include "mesh_transform.glsl"
+
+// Mirrors UniformBufferObject in SimpleRenderer.h
+layout(set = 0, binding = 0) uniform CameraUBO {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    mat4 viewInverse;
+    mat4 projInverse;
+    mat4 viewProjection;     // Unjittered
+    mat4 prevViewProjection;
+    vec3 cameraPos;
+} cameraUBO;
+
+layout(set = 0, binding = 4, std430) readonly buffer MeshTransforms {
+    MeshTransform transforms[];
+} meshTransforms;
+
+// Mirrors Meshlet in Meshlet.h
+struct Meshlet {
+    vec4 boundingSphere; // Mesh-space center, radius
+    vec4 cone;           // Front-facing normal cone axis, cutoff
+    uint vertexOffset;
+    uint triangleOffset;
+    uint vertexCount;
+    uint triangleCount;
+    uint meshIndex;      // Selects its MeshTransform
+    uint padding0;
+    uint padding1;
+    uint padding2;
+};
+
+layout(set = 1, binding = 0, std430) readonly buffer Meshlets {
+    Meshlet meshlets[];
+} meshletBuffer;
+
+// Shared vertex buffer index of every meshlet vertex
+layout(set = 1, binding = 1, std430) readonly buffer MeshletVertices {
+    uint indices[];
+} meshletVertices;
+
+// Three 8-bit meshlet-local vertex indices per triangle
+layout(set = 1, binding = 2, std430) readonly buffer MeshletTriangles {
+    uint triangles[];
+} meshletTriangles;
+
+// One flag per meshlet, written by the late phase
+layout(set = 1, binding = 3, std430) buffer MeshletVisibility {
+    uint visible[];
+} meshletVisibility;
+
+// Reverse-Z depth pyramid, each texel holds the farthest depth it covers
+layout(set = 1, binding = 4) uniform sampler2D hizImage;
+
+const uint CULL_PHASE_EARLY = 0u;
+const uint CULL_PHASE_LATE = 1u;
+const uint MESHLET_TASK_GROUP_SIZE = 32u; // Matches SimpleRenderer::MESHLET_TASK_GROUP_SIZE
+
+// Meshlets of one task workgroup that survived culling, one mesh workgroup each
+struct TaskPayload {
+    uint meshletIndices[MESHLET_TASK_GROUP_SIZE];
+};
+
+// Same scheme as draw_cull.comp at meshlet granularity: the early phase
+// draws the meshlets visible last frame, the late phase tests every meshlet
+// against this frame's Hi-Z, draws the newly visible ones and records
+// visibility for the next frame. Returns whether to draw in this phase.
+bool cullMeshlet(uint meshletIndex, uint phase) {
+    Meshlet meshlet = meshletBuffer.meshlets[meshletIndex];
+    bool wasVisible = meshletVisibility.visible[meshletIndex] != 0u;
+    if (phase == CULL_PHASE_EARLY && !wasVisible) {
+        return false;
+    }
+
+    mat4 model = meshTransforms.transforms[meshlet.meshIndex].model;
+    vec4 sphere = placeSphere(model, meshlet.boundingSphere);
+    vec4 cone = placeCone(model, meshlet.cone);
+    vec3 center = sphere.xyz;
+    float radius = sphere.w;
+    vec3 boundsMin = center - vec3(radius);
+    vec3 boundsMax = center + vec3(radius);
+    bool visible = isBoxInFrustum(cameraUBO.viewProjection, boundsMin, boundsMax) &&
+                   !isConeBackfacing(center, radius, cone.xyz, cone.w, cameraUBO.cameraPos);
+    if (phase == CULL_PHASE_LATE) {
+        visible = visible && !isBoxOccluded(hizImage, cameraUBO.viewProjection, boundsMin, boundsMax);
+        meshletVisibility.visible[meshletIndex] = visible ? 1u : 0u;
+        // Already drawn by the early phase
+        return visible && !wasVisible;
+    }
+    return visible;
+}
+
+uvec3 unpackMeshletTriangle(uint packedTriangle) {
+    return uvec3(packedTriangle & 0xffu, (packedTriangle >> 8) & 0xffu, (packedTriangle >> 16) & 0xffu);
+}
+
+#endif // MESHLET_COMMON_GLSL
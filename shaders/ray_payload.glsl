@@ -0,0 +1,15 @@
+// Primary/reflection ray payload (location 0) shared by ray_gen.rgen and the
+// miss and closest hit shaders.
+#ifndef RAY_PAYLOAD_GLSL
+#define RAY_PAYLOAD_GLSL
+
+struct RayPayload {
+    vec3 color;         // Surface albedo, or sky color on a miss
+    vec3 normal;
+    vec3 worldPos;
+    vec3 emission;
+    float hitDistance;  // 0 on a miss
+    float reflectivity; // Weight of the next bounce, 0 stops the path
+};
+
+#endif // RAY_PAYLOAD_GLSL
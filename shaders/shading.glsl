@@ -0,0 +1,185 @@
+// Shading model shared by ray_gen.rgen and ray_query.comp so both backends
+// produce the same image. Declares the camera (binding 2) and lighting
+// (binding 3) uniform blocks and the trace push constants. Each backend
+// implements traceShadowRay() with its own traversal API.
+#ifndef SHADING_GLSL
+#define SHADING_GLSL
+
+layout(set = 0, binding = 2) uniform CameraUBO {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    mat4 viewInverse;
+    mat4 projInverse;
+    mat4 viewProjection;     // Unjittered, for motion vectors
+    mat4 prevViewProjection; // Unjittered, previous frame
+    vec3 cameraPos;
+} cameraUBO;
+
+// Mirrors LightingUBO in SimpleRenderer.h
+layout(set = 0, binding = 3) uniform LightingUBO {
+    vec4 lightPositions[4]; // xyz used
+    vec4 lightColors[4];    // rgb color, a intensity
+    int lightCount;
+    float exposure;
+    vec3 ambientLight;
+} lighting;
+
+// Mirrors TracePushConstants in SimpleRenderer.h
+layout(push_constant) uniform TracePushConstants {
+    uint flags;
+    uint maxShadowLights;
+    float time;
+} trace;
+
+const uint TRACE_FLAG_SHADOWS = 1u;
+
+const int MAX_LIGHTS = 4;
+const int MAX_BOUNCES = 2;
+const float RAY_TMIN = 0.001;
+const float RAY_TMAX = 10000.0;
+// Paths whose remaining weight drops below this stop bouncing
+const float MIN_PATH_WEIGHT = 0.01;
+const float SHADOW_BIAS = 0.01;
+// Lights contributing less luminance than this are never shadow tested
+const float SHADOW_MIN_CONTRIBUTION = 0.002;
+
+// Returns 1.0 if nothing blocks the segment, 0.0 otherwise
+float traceShadowRay(vec3 origin, vec3 direction, float maxDistance);
+
+// Primary ray through the pixel center; proj carries the TAAU sub-pixel jitter
+void computeCameraRay(uvec2 pixel, uvec2 size, out vec3 origin, out vec3 direction) {
+    const vec2 pixelCenter = vec2(pixel) + vec2(0.5);
+    const vec2 inUV = pixelCenter / vec2(size);
+    const vec2 d = inUV * 2.0 - 1.0;
+
+    vec4 clip = vec4(d, 1.0, 1.0);
+    vec4 viewDir = cameraUBO.projInverse * clip;
+    viewDir /= viewDir.w;
+
+    origin = cameraUBO.cameraPos;
+    direction = normalize((cameraUBO.viewInverse * vec4(viewDir.xyz, 0.0)).xyz);
+}
+
+// Screen-space motion (current minus previous UV) of a world position, for
+// the temporal resolve. Uses unjittered matrices so jitter is not motion.
+vec2 computeMotionVector(vec3 worldPos) {
+    vec4 currentClip = cameraUBO.viewProjection * vec4(worldPos, 1.0);
+    vec4 previousClip = cameraUBO.prevViewProjection * vec4(worldPos, 1.0);
+    vec2 currentUV = currentClip.xy / currentClip.w * 0.5 + 0.5;
+    vec2 previousUV = previousClip.xy / previousClip.w * 0.5 + 0.5;
+    return currentUV - previousUV;
+}
+
+// Volumetric fog function
+vec3 calculateVolumetricFog(vec3 rayOrigin, vec3 rayDirection, float rayDistance) {
+    vec3 fogColor = vec3(0.1, 0.05, 0.2); // Dark purple fog
+    float fogDensity = 0.02;
+    float fogHeight = 20.0; // Height where fog starts
+
+    vec3 accumulatedFog = vec3(0.0);
+    float stepSize = 2.0;
+    int steps = int(rayDistance / stepSize);
+
+    for (int i = 0; i < steps; i++) {
+        float t = float(i) * stepSize;
+        vec3 samplePos = rayOrigin + rayDirection * t;
+
+        // Height-based fog density
+        float heightFactor = exp(-max(0.0, samplePos.y - fogHeight) * 0.1);
+        float localDensity = fogDensity * heightFactor;
+
+        // Add some noise for atmospheric variation
+        float noise = sin(samplePos.x * 0.1) * cos(samplePos.z * 0.1) * 0.5 + 0.5;
+        localDensity *= (0.8 + noise * 0.4);
+
+        // Accumulate fog
+        float fogAmount = 1.0 - exp(-localDensity * stepSize);
+        accumulatedFog += fogColor * fogAmount * (1.0 - length(accumulatedFog));
+    }
+
+    return accumulatedFog;
+}
+
+// Ambient + direct lighting + emission at a surface hit, blended with the fog in front of it
+vec3 shadeHit(vec3 rayOrigin, vec3 rayDirection, float hitDistance, vec3 hitColor, vec3 hitNormal, vec3 hitPos, vec3 emission) {
+    vec3 finalColor = emission;
+
+    // Ambient lighting
+    finalColor += hitColor * lighting.ambientLight;
+
+    // Unshadowed direct lighting from all lights
+    vec3 lightContribution[MAX_LIGHTS];
+    vec3 lightDirection[MAX_LIGHTS];
+    float lightDistance[MAX_LIGHTS];
+    float lightWeight[MAX_LIGHTS];
+
+    int lightCount = min(lighting.lightCount, MAX_LIGHTS);
+    vec3 viewDir = normalize(cameraUBO.cameraPos - hitPos);
+    for (int i = 0; i < lightCount; i++) {
+        vec3 toLight = lighting.lightPositions[i].xyz - hitPos;
+        lightDistance[i] = length(toLight);
+        lightDirection[i] = toLight / lightDistance[i];
+        float attenuation = 1.0 / (1.0 + 0.1 * lightDistance[i] + 0.01 * lightDistance[i] * lightDistance[i]);
+
+        // Lights behind the surface contribute nothing and need no shadow ray
+        float NdotL = dot(hitNormal, lightDirection[i]);
+        if (NdotL <= 0.0) {
+            lightContribution[i] = vec3(0.0);
+            lightWeight[i] = 0.0;
+            continue;
+        }
+
+        // Simple diffuse lighting
+        vec3 diffuse = hitColor * lighting.lightColors[i].rgb * lighting.lightColors[i].a * NdotL * attenuation;
+
+        // Add some specular highlights for cyberpunk feel
+        vec3 reflectDir = reflect(-lightDirection[i], hitNormal);
+        float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32.0);
+        vec3 specular = lighting.lightColors[i].rgb * lighting.lightColors[i].a * spec * attenuation * 0.5;
+
+        lightContribution[i] = diffuse + specular;
+        lightWeight[i] = dot(lightContribution[i], vec3(0.2126, 0.7152, 0.0722));
+    }
+
+    // Shadow rays go to the strongest lights only, up to maxShadowLights;
+    // the remaining lights are too dim for their occlusion to be visible.
+    uint shadowRays = (trace.flags & TRACE_FLAG_SHADOWS) != 0u ? trace.maxShadowLights : 0u;
+    vec3 shadowOrigin = hitPos + hitNormal * SHADOW_BIAS;
+    for (uint ray = 0u; ray < shadowRays; ray++) {
+        int strongest = -1;
+        float strongestWeight = SHADOW_MIN_CONTRIBUTION;
+        for (int i = 0; i < lightCount; i++) {
+            if (lightWeight[i] > strongestWeight) {
+                strongest = i;
+                strongestWeight = lightWeight[i];
+            }
+        }
+        if (strongest < 0) {
+            break;
+        }
+
+        lightContribution[strongest] *= traceShadowRay(shadowOrigin, lightDirection[strongest],
+                                                       lightDistance[strongest] - SHADOW_BIAS);
+        lightWeight[strongest] = 0.0;
+    }
+
+    for (int i = 0; i < lightCount; i++) {
+        finalColor += lightContribution[i];
+    }
+
+    // Add volumetric fog between camera and hit point
+    vec3 fog = calculateVolumetricFog(rayOrigin, rayDirection, hitDistance);
+    return mix(finalColor, fog, 0.3);
+}
+
+// Sky color with atmospheric effects for rays that leave the scene
+vec3 shadeMiss(vec3 rayOrigin, vec3 rayDirection) {
+    vec3 skyColor = vec3(0.05, 0.1, 0.2) + vec3(0.1, 0.05, 0.3) * sin(trace.time * 0.5);
+
+    // Add distant fog
+    vec3 distantFog = calculateVolumetricFog(rayOrigin, rayDirection, 1000.0);
+    return mix(skyColor, distantFog, 0.5);
+}
+
+#endif // SHADING_GLSL
@@ -1,4 +1,7 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "mesh_transform.glsl"
 
 layout(binding = 0) uniform UniformBufferObject {
     mat4 model;
@@ -6,26 +9,40 @@ layout(binding = 0) uniform UniformBufferObject {
     mat4 proj;
     mat4 viewInverse;
     mat4 projInverse;
+    mat4 viewProjection;     // Unjittered, for motion vectors
+    mat4 prevViewProjection; // Unjittered, previous frame
     vec3 cameraPos;
-    float time;
 } ubo;
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoord;
 layout(location = 3) in vec3 inNormal;
+layout(location = 4) in uint inMeshIndex; // Selects the vertex's mesh transform
+
+layout(binding = 4, std430) readonly buffer MeshTransforms {
+    MeshTransform transforms[];
+} meshTransforms;
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
 layout(location = 2) out vec3 fragNormal;
 layout(location = 3) out vec3 fragWorldPos;
+layout(location = 4) out vec4 fragCurrentClip;
+layout(location = 5) out vec4 fragPreviousClip;
+
+// The depth prepass and the shading pass must produce identical depth for the EQUAL test
+invariant gl_Position;
 
 void main() {
-    vec4 worldPos = ubo.model * vec4(inPosition, 1.0);
+    MeshTransform transform = meshTransforms.transforms[inMeshIndex];
+    vec4 worldPos = transform.model * vec4(inPosition, 1.0);
     gl_Position = ubo.proj * ubo.view * worldPos;
     
     fragColor = inColor;
     fragTexCoord = inTexCoord;
-    fragNormal = mat3(transpose(inverse(ubo.model))) * inNormal;
+    fragNormal = mat3(transpose(inverse(transform.model))) * inNormal;
     fragWorldPos = worldPos.xyz;
+    fragCurrentClip = ubo.viewProjection * worldPos;
+    fragPreviousClip = ubo.prevViewProjection * (transform.previousModel * vec4(inPosition, 1.0));
 }
@@ -0,0 +1,86 @@
+// Triangle attribute fetch shared by the closest hit shaders and ray_query.comp.
+// Declares the per-instance geometry table (set 1, binding 0), indexed by the
+// instance custom index. Its entries hold buffer device addresses, so any mesh
+// can be fetched without descriptor changes and vertices are read as typed,
+// 16-byte aligned structs. Including shaders enable GL_EXT_buffer_reference
+// and GL_EXT_shader_explicit_arithmetic_types_int64.
+#ifndef VERTEX_FETCH_GLSL
+#define VERTEX_FETCH_GLSL
+
+#include "vertex_layout.glsl"
+
+// Mirrors MeshGeometryRecord in SimpleRenderer.h
+struct MeshGeometry {
+    uint64_t vertices;  // Address of the Vertex records
+    uint64_t indices;   // Address of the mesh's first uint index
+    uint vertexStride;  // Bytes
+    uint padding;
+};
+
+layout(set = 1, binding = 0, std430) readonly buffer GeometryTable {
+    MeshGeometry meshes[];
+} geometryTable;
+
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer VertexRef {
+    Vertex vertex;
+};
+
+layout(buffer_reference, std430, buffer_reference_align = 4) readonly buffer IndexRef {
+    uint indices[];
+};
+
+// Vertex indices of a hit triangle, where its mesh's vertices live and the
+// matrix taking its mesh-space normals to world space
+struct Triangle {
+    uvec3 vertices;
+    uint64_t vertexData;
+    uint vertexStride;
+    mat3 normalMatrix;
+};
+
+VertexRef getVertex(Triangle triangle, uint index) {
+    return VertexRef(triangle.vertexData + uint64_t(index) * triangle.vertexStride);
+}
+
+// meshIndex is the instance custom index; primitiveIndex is relative to the
+// mesh; worldToObject is the hit instance's inverse transform
+Triangle fetchTriangle(uint meshIndex, uint primitiveIndex, mat4x3 worldToObject) {
+    MeshGeometry geometry = geometryTable.meshes[meshIndex];
+    IndexRef indexData = IndexRef(geometry.indices);
+    uint indexOffset = primitiveIndex * 3;
+
+    Triangle triangle;
+    triangle.vertices = uvec3(indexData.indices[indexOffset + 0],
+                              indexData.indices[indexOffset + 1],
+                              indexData.indices[indexOffset + 2]);
+    triangle.vertexData = geometry.vertices;
+    triangle.vertexStride = geometry.vertexStride;
+    triangle.normalMatrix = transpose(mat3(worldToObject));
+    return triangle;
+}
+
+vec3 toBarycentrics(vec2 attribs) {
+    return vec3(1.0 - attribs.x - attribs.y, attribs.x, attribs.y);
+}
+
+vec3 interpolateNormal(Triangle triangle, vec3 barycentrics) {
+    return normalize(triangle.normalMatrix * (getVertex(triangle, triangle.vertices.x).vertex.normal * barycentrics.x +
+                                              getVertex(triangle, triangle.vertices.y).vertex.normal * barycentrics.y +
+                                              getVertex(triangle, triangle.vertices.z).vertex.normal * barycentrics.z));
+}
+
+vec3 interpolateColor(Triangle triangle, vec3 barycentrics) {
+    return getVertex(triangle, triangle.vertices.x).vertex.color * barycentrics.x +
+           getVertex(triangle, triangle.vertices.y).vertex.color * barycentrics.y +
+           getVertex(triangle, triangle.vertices.z).vertex.color * barycentrics.z;
+}
+
+// Geometric normal from the triangle's positions; no normal attributes read
+vec3 faceNormal(Triangle triangle) {
+    vec3 v0 = getVertex(triangle, triangle.vertices.x).vertex.position;
+    vec3 v1 = getVertex(triangle, triangle.vertices.y).vertex.position;
+    vec3 v2 = getVertex(triangle, triangle.vertices.z).vertex.position;
+    return normalize(triangle.normalMatrix * cross(v1 - v0, v2 - v0));
+}
+
+#endif // VERTEX_FETCH_GLSL
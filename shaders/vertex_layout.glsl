@@ -0,0 +1,14 @@
+// Vertex as stored in the shared vertex buffer, for shaders that fetch
+// vertices themselves instead of through vertex input.
+#ifndef VERTEX_LAYOUT_GLSL
+#define VERTEX_LAYOUT_GLSL
+
+// Mirrors GLTFVertex in GLTFLoader.h (std430, 64 bytes)
+struct Vertex {
+    vec3 position;
+    vec3 normal;
+    vec2 texCoord;
+    vec3 color;
+};
+
+#endif // VERTEX_LAYOUT_GLSL
@@ -0,0 +1,107 @@
+#include "AccelerationStructureCache.h"
+#include "GLTFLoader.h"
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+std::string toHex(const uint8_t* bytes, size_t size) {
+    std::ostringstream stream;
+    stream << std::hex << std::setfill('0');
+    for (size_t i = 0; i < size; ++i) {
+        stream << std::setw(2) << static_cast<uint32_t>(bytes[i]);
+    }
+    return stream.str();
+}
+
+uint64_t readHeaderField(const std::vector<uint8_t>& data, size_t offset) {
+    uint64_t value = 0;
+    if (data.size() >= offset + sizeof(value)) {
+        std::memcpy(&value, data.data() + offset, sizeof(value));
+    }
+    return value;
+}
+
+} // namespace
+
+AccelerationStructureCache::AccelerationStructureCache(const std::filesystem::path& root, const uint8_t (&driverUUID)[VK_UUID_SIZE])
+    : m_directory(root / toHex(driverUUID, VK_UUID_SIZE)) {
+    std::error_code ec;
+    std::filesystem::create_directories(m_directory, ec);
+}
+
+bool AccelerationStructureCache::load(uint64_t key, std::vector<uint8_t>& data) const {
+    std::ifstream file(entryPath(key), std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    size_t fileSize = static_cast<size_t>(file.tellg());
+    if (fileSize < HEADER_SIZE) {
+        return false;
+    }
+    data.resize(fileSize);
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(fileSize));
+    if (!file || readSerializedSize(data) != fileSize) {
+        data.clear();
+        return false;
+    }
+    return true;
+}
+
+bool AccelerationStructureCache::store(uint64_t key, const void* data, size_t size) const {
+    std::filesystem::path path = entryPath(key);
+    std::filesystem::path temporary = path;
+    temporary += ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            return false;
+        }
+        file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        if (!file) {
+            return false;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(temporary, path, ec);
+    return !ec;
+}
+
+uint64_t AccelerationStructureCache::hashTriangles(const GLTFVertex* vertices, const uint32_t* indices, uint32_t indexCount, uint64_t seed) {
+    uint64_t hash = hashBytes(FNV_OFFSET_BASIS, &seed, sizeof(seed));
+    hash = hashBytes(hash, &indexCount, sizeof(indexCount));
+    for (uint32_t i = 0; i < indexCount; ++i) {
+        const glm::vec3& position = vertices[indices[i]].position;
+        float xyz[3] = {position.x, position.y, position.z}; // Skips the vec3 padding
+        hash = hashBytes(hash, xyz, sizeof(xyz));
+    }
+    return hash;
+}
+
+uint64_t AccelerationStructureCache::readSerializedSize(const std::vector<uint8_t>& data) {
+    return readHeaderField(data, 2 * VK_UUID_SIZE);
+}
+
+uint64_t AccelerationStructureCache::readDeserializedSize(const std::vector<uint8_t>& data) {
+    return readHeaderField(data, 2 * VK_UUID_SIZE + sizeof(uint64_t));
+}
+
+std::filesystem::path AccelerationStructureCache::entryPath(uint64_t key) const {
+    std::ostringstream name;
+    name << std::hex << std::setfill('0') << std::setw(16) << key << ".blas";
+    return m_directory / name.str();
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+struct GLTFVertex;
+
+// Serialized bottom-level acceleration structures on disk: one file per mesh,
+// named after the hash of its triangles, in a directory per driver
+// (VkPhysicalDeviceIDProperties::driverUUID). Entries are the exact blobs
+// vkCmdCopyAccelerationStructureToMemoryKHR wrote; whether the device can
+// still deserialize one is for the caller to ask the driver.
+class AccelerationStructureCache {
+public:
+    AccelerationStructureCache(const std::filesystem::path& root, const uint8_t (&driverUUID)[VK_UUID_SIZE]);
+
+    // False when there is no entry or it is truncated
+    bool load(uint64_t key, std::vector<uint8_t>& data) const;
+    // Writes through a temporary file so a concurrent start never reads a
+    // partial entry. Failing only costs the next start its warm path.
+    bool store(uint64_t key, const void* data, size_t size) const;
+
+    const std::filesystem::path& getDirectory() const { return m_directory; }
+
+    // FNV-1a over the positions of the triangles' corners in index order,
+    // which together with the build flags (seed) is all a BLAS depends on
+    static uint64_t hashTriangles(const GLTFVertex* vertices, const uint32_t* indices, uint32_t indexCount, uint64_t seed);
+
+    // Header written in front of every serialized acceleration structure:
+    // driver UUID, compatibility UUID, serialized size, deserialized size and
+    // the count of referenced handles (zero for a BLAS)
+    static constexpr size_t HEADER_SIZE = 2 * VK_UUID_SIZE + 3 * sizeof(uint64_t);
+    static uint64_t readSerializedSize(const std::vector<uint8_t>& data);
+    static uint64_t readDeserializedSize(const std::vector<uint8_t>& data);
+
+private:
+    std::filesystem::path entryPath(uint64_t key) const;
+
+    std::filesystem::path m_directory;
+};
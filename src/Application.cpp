@@ -1,16 +1,69 @@
 #include "Application.h"
 #include "SimpleRenderer.h"
 #include "Camera.h"
+#include "CpuTracer.h"
 #include "Scene.h"
+#include "FramePacer.h"
+#include "GpuProfiler.h"
+#include "JobSystem.h"
+#include "ShaderManager.h"
+#include "Simulation.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <iomanip>
 #include <iostream>
-#include <chrono>
-#include <thread>
+#include <string>
+
+namespace {
+
+std::string readEnv(const char* name) {
+    const char* value = std::getenv(name);
+    std::string result = value ? value : "";
+    std::transform(result.begin(), result.end(), result.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return result;
+}
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+const char* presentModePolicyToString(PresentModePolicy policy) {
+    switch (policy) {
+    case PresentModePolicy::Fifo: return "fifo";
+    case PresentModePolicy::Mailbox: return "mailbox";
+    case PresentModePolicy::Immediate: return "immediate";
+    }
+    return "unknown";
+}
+
+} // namespace
 
 Application::Application() 
     : m_window(nullptr)
     , m_running(false)
     , m_lastTime(0.0f)
-    , m_deltaTime(0.0f) {
+    , m_simulationRate(DEFAULT_SIMULATION_RATE)
+    , m_latencyMode(false)
+    , m_presentModePolicy(PresentModePolicy::Mailbox)
+    , m_targetFps(DEFAULT_TARGET_FPS)
+    , m_benchmarkFrames(0)
+    , m_frameIndex(0)
+    , m_lastStatsReportTime(0.0f)
+    , m_requestedBackend(RenderBackend::RayTracingPipeline)
+    , m_hasRequestedBackend(false)
+    , m_shadowsEnabled(true)
+    , m_bloomEnabled(true)
+    , m_depthPrepass(false)
+    , m_meshletPath(MeshletPath::Off)
+    , m_temporalUpscale(true)
+    , m_renderScale(SimpleRenderer::DEFAULT_RENDER_SCALE)
+    , m_jobThreads(0)
+    , m_pinJobThreads(false)
+    , m_asCacheDirectory(DEFAULT_AS_CACHE_DIRECTORY)
+    , m_meshOptimization(MeshOptimization::VertexCache)
+    , m_benchmarkPhase(0)
+    , m_phaseStartFrame(0) {
 }
 
 Application::~Application() {
@@ -18,11 +71,171 @@ Application::~Application() {
 }
 
 void Application::run() {
+    m_startTime = std::chrono::steady_clock::now();
+    loadSettings();
+    startAssetLoading();
+
+    auto windowStart = std::chrono::steady_clock::now();
     initWindow();
+    m_startupTimings.windowMs = millisecondsSince(windowStart);
+
     initVulkan();
     mainLoop();
 }
 
+// Shaders and the scene load on workers while the main thread creates the
+// window, device and pipelines; initVulkan joins them before the geometry
+// upload, the first step that needs both.
+void Application::startAssetLoading() {
+    m_startupJobs = std::make_unique<JobCounter>();
+    m_scene = std::make_unique<Scene>(m_jobSystem.get());
+    m_scene->setMeshOptimization(m_meshOptimization);
+
+    m_jobSystem->spawn([this]() {
+        auto start = std::chrono::steady_clock::now();
+        ShaderManager::preloadShaders(*m_jobSystem);
+        m_startupTimings.shadersMs = millisecondsSince(start);
+    }, m_startupJobs.get());
+
+    m_jobSystem->spawn([this]() {
+        auto start = std::chrono::steady_clock::now();
+        m_scene->init();
+        m_startupTimings.sceneMs = millisecondsSince(start);
+    }, m_startupJobs.get());
+}
+
+void Application::loadSettings() {
+    std::string benchmark = readEnv("BENCHMARK_FRAMES");
+    if (!benchmark.empty()) {
+        m_benchmarkFrames = static_cast<uint32_t>(std::max(0L, std::strtol(benchmark.c_str(), nullptr, 10)));
+    }
+
+    // Benchmarks run uncapped and unsynchronized unless explicitly overridden
+    if (isBenchmarking()) {
+        m_targetFps = 0.0;
+        m_presentModePolicy = PresentModePolicy::Immediate;
+    }
+
+    std::string targetFps = readEnv("TARGET_FPS");
+    if (targetFps == "uncapped" || targetFps == "off") {
+        m_targetFps = 0.0;
+    } else if (!targetFps.empty()) {
+        m_targetFps = std::max(0.0, std::strtod(targetFps.c_str(), nullptr));
+    }
+
+    std::string presentMode = readEnv("PRESENT_MODE");
+    if (presentMode == "fifo") {
+        m_presentModePolicy = PresentModePolicy::Fifo;
+    } else if (presentMode == "mailbox") {
+        m_presentModePolicy = PresentModePolicy::Mailbox;
+    } else if (presentMode == "immediate") {
+        m_presentModePolicy = PresentModePolicy::Immediate;
+    } else if (!presentMode.empty()) {
+        std::cerr << "Unknown PRESENT_MODE '" << presentMode << "', expected fifo, mailbox or immediate" << std::endl;
+    }
+
+    std::string backend = readEnv("RENDER_BACKEND");
+    if (backend == "rt" || backend == "rt-pipeline") {
+        m_requestedBackend = RenderBackend::RayTracingPipeline;
+        m_hasRequestedBackend = true;
+    } else if (backend == "ray-query" || backend == "rayquery" || backend == "compute") {
+        m_requestedBackend = RenderBackend::RayQueryCompute;
+        m_hasRequestedBackend = true;
+    } else if (backend == "raster") {
+        m_requestedBackend = RenderBackend::Raster;
+        m_hasRequestedBackend = true;
+    } else if (backend == "cpu") {
+        m_requestedBackend = RenderBackend::CpuReference;
+        m_hasRequestedBackend = true;
+    } else if (!backend.empty()) {
+        std::cerr << "Unknown RENDER_BACKEND '" << backend << "', expected rt, ray-query, raster or cpu" << std::endl;
+    }
+
+    std::string shadows = readEnv("SHADOWS");
+    if (shadows == "0" || shadows == "off") {
+        m_shadowsEnabled = false;
+    }
+
+    std::string bloom = readEnv("BLOOM");
+    if (bloom == "0" || bloom == "off") {
+        m_bloomEnabled = false;
+    }
+
+    std::string depthPrepass = readEnv("DEPTH_PREPASS");
+    if (depthPrepass == "1" || depthPrepass == "on") {
+        m_depthPrepass = true;
+    }
+
+    std::string meshlets = readEnv("MESHLETS");
+    if (meshlets == "1" || meshlets == "on" || meshlets == "mesh") {
+        m_meshletPath = MeshletPath::MeshShader;
+    } else if (meshlets == "compute") {
+        m_meshletPath = MeshletPath::Compute;
+    } else if (!meshlets.empty() && meshlets != "0" && meshlets != "off") {
+        std::cerr << "Unknown MESHLETS '" << meshlets << "', expected on, mesh, compute or off" << std::endl;
+    }
+
+    std::string taa = readEnv("TAA");
+    if (taa == "0" || taa == "off") {
+        m_temporalUpscale = false;
+    }
+
+    std::string renderScale = readEnv("RENDER_SCALE");
+    if (!renderScale.empty()) {
+        m_renderScale = std::clamp(static_cast<float>(std::strtod(renderScale.c_str(), nullptr)),
+                                   SimpleRenderer::MIN_RENDER_SCALE, 1.0f);
+    }
+
+    std::string jobThreads = readEnv("JOB_THREADS");
+    if (!jobThreads.empty()) {
+        m_jobThreads = static_cast<uint32_t>(std::max(0L, std::strtol(jobThreads.c_str(), nullptr, 10)));
+    }
+
+    std::string simulationRate = readEnv("SIM_RATE");
+    if (!simulationRate.empty()) {
+        m_simulationRate = std::max(MIN_SIMULATION_RATE, std::strtod(simulationRate.c_str(), nullptr));
+    }
+
+    std::string latency = readEnv("LATENCY");
+    if (latency == "1" || latency == "on") {
+        m_latencyMode = true;
+    }
+
+    std::string pinJobThreads = readEnv("JOB_PIN");
+    if (pinJobThreads == "1" || pinJobThreads == "on") {
+        m_pinJobThreads = true;
+    }
+
+    std::string asCache = readEnv("AS_CACHE");
+    if (asCache == "0" || asCache == "off") {
+        m_asCacheDirectory.clear();
+    } else if (!asCache.empty()) {
+        m_asCacheDirectory = asCache;
+    }
+
+    std::string meshOptimization = readEnv("MESH_OPT");
+    if (meshOptimization == "0" || meshOptimization == "off") {
+        m_meshOptimization = MeshOptimization::Off;
+    } else if (meshOptimization == "overdraw") {
+        m_meshOptimization = MeshOptimization::Overdraw;
+    } else if (!meshOptimization.empty() && meshOptimization != "1" && meshOptimization != "on") {
+        std::cerr << "Unknown MESH_OPT '" << meshOptimization << "', expected on, overdraw or off" << std::endl;
+    }
+
+    // The main thread becomes worker 0
+    m_jobSystem = std::make_unique<JobSystem>(m_jobThreads, m_pinJobThreads);
+    m_framePacer = std::make_unique<FramePacer>(m_targetFps);
+
+    std::cout << "[Startup] " << m_jobSystem->getWorkerCount() << " job workers"
+              << (m_jobSystem->isPinned() ? ", pinned to cores" : "") << std::endl;
+    std::cout << "Frame pacing: "
+              << (m_framePacer->isUncapped() ? std::string("uncapped") : std::to_string(m_targetFps) + " FPS target")
+              << ", present mode policy " << presentModePolicyToString(m_presentModePolicy) << std::endl;
+    if (isBenchmarking()) {
+        std::cout << "Benchmark mode: " << BENCHMARK_WARMUP_FRAMES << " warmup + " << m_benchmarkFrames << " measured frames" << std::endl;
+    }
+}
+
 void Application::initWindow() {
     glfwInit();
     
@@ -45,6 +258,35 @@ void Application::initWindow() {
         if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
             app->m_running = false;
         }
+
+        // Backend hot-switching; benchmarks drive the backend themselves
+        if (action == GLFW_PRESS && app->m_renderer && !app->isBenchmarking()) {
+            if (key == GLFW_KEY_F1) {
+                app->m_renderer->setBackend(RenderBackend::RayTracingPipeline);
+            } else if (key == GLFW_KEY_F2) {
+                app->m_renderer->setBackend(RenderBackend::RayQueryCompute);
+            } else if (key == GLFW_KEY_F3) {
+                app->m_renderer->setBackend(RenderBackend::Raster);
+            } else if (key == GLFW_KEY_F4) {
+                app->m_renderer->setShadowsEnabled(!app->m_renderer->areShadowsEnabled());
+            } else if (key == GLFW_KEY_F5) {
+                app->m_renderer->setBloomEnabled(!app->m_renderer->isBloomEnabled());
+            } else if (key == GLFW_KEY_F6) {
+                app->m_renderer->setDepthPrepassEnabled(!app->m_renderer->isDepthPrepassEnabled());
+            } else if (key == GLFW_KEY_F7) {
+                // Off -> mesh shader (when supported) -> compute -> off
+                MeshletPath path = app->m_renderer->getMeshletPath();
+                if (path == MeshletPath::Off) {
+                    app->m_renderer->setMeshletPath(MeshletPath::MeshShader);
+                } else if (path == MeshletPath::MeshShader) {
+                    app->m_renderer->setMeshletPath(MeshletPath::Compute);
+                } else {
+                    app->m_renderer->setMeshletPath(MeshletPath::Off);
+                }
+            } else if (key == GLFW_KEY_F8) {
+                app->m_renderer->setBackend(RenderBackend::CpuReference);
+            }
+        }
     });
     
     glfwSetCursorPosCallback(m_window, [](GLFWwindow* window, double xpos, double ypos) {
@@ -61,21 +303,40 @@ void Application::initWindow() {
 
 void Application::initVulkan() {
     std::cout << "Creating renderer..." << std::endl;
-    m_renderer = std::make_unique<SimpleRenderer>(m_window);
+    auto rendererStart = std::chrono::steady_clock::now();
+    m_renderer = std::make_unique<SimpleRenderer>(m_window, m_presentModePolicy, m_temporalUpscale, m_renderScale, m_jobSystem.get());
+    m_startupTimings.rendererMs = millisecondsSince(rendererStart);
     
     std::cout << "Creating camera..." << std::endl;
     m_camera = std::make_unique<Camera>(WINDOW_WIDTH, WINDOW_HEIGHT);
+    m_simulationCamera = std::make_unique<Camera>(WINDOW_WIDTH, WINDOW_HEIGHT);
     
-    std::cout << "Creating scene..." << std::endl;
-    m_scene = std::make_unique<Scene>();
-    
-    // Initialize scene with basic geometry
-    std::cout << "Initializing scene..." << std::endl;
-    m_scene->init();
+    // Join the asset loads; this thread helps with whatever is left of them
+    std::cout << "Waiting for scene..." << std::endl;
+    auto joinStart = std::chrono::steady_clock::now();
+    m_jobSystem->wait(*m_startupJobs);
+    m_startupJobs.reset();
+    m_startupTimings.joinWaitMs = millisecondsSince(joinStart);
     
     // Initialize renderer geometry with scene data
     std::cout << "Initializing renderer geometry..." << std::endl;
+    auto geometryStart = std::chrono::steady_clock::now();
+    m_renderer->setAccelerationStructureCacheDirectory(m_asCacheDirectory);
     m_renderer->initGeometry(m_scene.get());
+    m_startupTimings.geometryMs = millisecondsSince(geometryStart);
+    // The GPU buffers and BLASes hold it from here; the CPU tracer reads its
+    // copy back from them only once its backend is selected
+    size_t releasedBytes = m_scene->releaseGeometry();
+    std::cout << "[Startup] Released " << releasedBytes / (1024.0 * 1024.0) << " MB of CPU scene geometry" << std::endl;
+
+    if (m_hasRequestedBackend) {
+        m_renderer->setBackend(m_requestedBackend);
+    }
+    m_renderer->setShadowsEnabled(m_shadowsEnabled);
+    m_renderer->setBloomEnabled(m_bloomEnabled);
+    m_renderer->setDepthPrepassEnabled(m_depthPrepass);
+    m_renderer->setMeshletPath(m_meshletPath);
+    m_renderer->setLatencyMode(m_latencyMode);
     
     std::cout << "Vulkan initialization complete!" << std::endl;
 }
@@ -83,6 +344,17 @@ void Application::initVulkan() {
 void Application::mainLoop() {
     m_running = true;
     m_lastTime = static_cast<float>(glfwGetTime());
+    m_lastStatsReportTime = m_lastTime;
+    m_frameIndex = 0;
+    m_framePacer->reset();
+    if (isBenchmarking()) {
+        startBenchmark();
+    }
+
+    // Scene::update writes the meshes, so the simulation starts only after
+    // the renderer has read them in initGeometry
+    m_simulation = std::make_unique<Simulation>(*m_simulationCamera, *m_scene, m_simulationRate);
+    m_simulation->start();
     
     std::cout << "Starting main loop..." << std::endl;
     
@@ -96,65 +368,262 @@ void Application::mainLoop() {
         }
         
         float currentTime = static_cast<float>(glfwGetTime());
-        m_deltaTime = currentTime - m_lastTime;
         m_lastTime = currentTime;
         
-        update(m_deltaTime);
+        update();
         drawFrame();
-        
-        // Add a small delay to prevent excessive CPU usage
-        std::this_thread::sleep_for(std::chrono::milliseconds(16)); // ~60 FPS
+        if (m_frameIndex == 0) {
+            reportStartup();
+        }
+
+        m_framePacer->waitForNextFrame();
+        ++m_frameIndex;
+
+        if (isBenchmarking()) {
+            updateBenchmark();
+        } else if (currentTime - m_lastStatsReportTime >= STATS_REPORT_INTERVAL) {
+            reportFrameStats("Frame");
+            m_framePacer->resetStats();
+            m_renderer->getProfiler()->resetStats();
+            m_lastStatsReportTime = currentTime;
+        }
     }
     
     std::cout << "Main loop ended." << std::endl;
+    m_simulation->stop();
     vkDeviceWaitIdle(m_renderer->getDevice());
 }
 
-void Application::drawFrame() {
-    try {
-        m_renderer->beginFrame();
-        m_renderer->render(m_camera.get(), m_scene.get());
-        m_renderer->endFrame();
-    } catch (const std::exception& e) {
-        std::cerr << "Error in drawFrame: " << e.what() << std::endl;
+void Application::startBenchmark() {
+    // Measured phases must not include raster frames drawn while the RT
+    // pipelines are still compiling
+    m_renderer->waitForRayTracing();
+    m_renderer->waitForCpuTracer();
+
+    // The CPU reference is orders of magnitude slower and only runs when
+    // requested through RENDER_BACKEND
+    std::vector<RenderBackend> backends;
+    if (m_hasRequestedBackend) {
+        backends.push_back(m_requestedBackend);
+    } else {
+        for (RenderBackend backend : {RenderBackend::RayTracingPipeline, RenderBackend::RayQueryCompute, RenderBackend::Raster}) {
+            if (m_renderer->isBackendAvailable(backend)) {
+                backends.push_back(backend);
+            }
+        }
+    }
+
+    m_benchmarkPhases.clear();
+    for (RenderBackend backend : backends) {
+        m_benchmarkPhases.push_back({backend, m_shadowsEnabled, 0.0});
+        // The CPU tracer has no GPU trace scope to split the shadow cost from
+        if (backend != RenderBackend::Raster && backend != RenderBackend::CpuReference && m_shadowsEnabled) {
+            m_benchmarkPhases.push_back({backend, false, 0.0});
+        }
+    }
+
+    m_benchmarkPhase = 0;
+    m_phaseStartFrame = m_frameIndex;
+    if (m_benchmarkPhases.empty()) {
+        std::cerr << "Benchmark: no render backend available" << std::endl;
         m_running = false;
+        return;
     }
+    m_renderer->setBackend(m_benchmarkPhases[0].backend);
+    m_renderer->setShadowsEnabled(m_benchmarkPhases[0].shadows);
 }
 
-void Application::update(float deltaTime) {
-    handleInput(deltaTime);
-    m_camera->update(deltaTime);
-    m_scene->update(deltaTime);
+void Application::updateBenchmark() {
+    uint32_t phaseFrame = m_frameIndex - m_phaseStartFrame;
+    if (phaseFrame == BENCHMARK_WARMUP_FRAMES) {
+        m_framePacer->resetStats();
+        m_renderer->getProfiler()->resetStats();
+    } else if (phaseFrame >= BENCHMARK_WARMUP_FRAMES + m_benchmarkFrames) {
+        BenchmarkPhase& phase = m_benchmarkPhases[m_benchmarkPhase];
+        phase.traceGpuMs = m_renderer->getProfiler()->getAverageMs("trace");
+
+        std::string label = std::string("Benchmark ") + SimpleRenderer::getBackendName(phase.backend);
+        if (phase.backend != RenderBackend::Raster) {
+            label += phase.shadows ? " shadows" : " no-shadows";
+        }
+        reportFrameStats(label.c_str());
+
+        ++m_benchmarkPhase;
+        if (m_benchmarkPhase >= m_benchmarkPhases.size()) {
+            reportShadowCost();
+            m_running = false;
+            return;
+        }
+
+        m_renderer->setBackend(m_benchmarkPhases[m_benchmarkPhase].backend);
+        m_renderer->setShadowsEnabled(m_benchmarkPhases[m_benchmarkPhase].shadows);
+        m_phaseStartFrame = m_frameIndex;
+        m_framePacer->reset();
+    }
 }
 
-void Application::handleInput(float deltaTime) {
-    // Camera movement
-    if (glfwGetKey(m_window, GLFW_KEY_W) == GLFW_PRESS) {
-        m_camera->moveForward(deltaTime);
+void Application::reportFrameStats(const char* label) const {
+    FrameTimingStats stats = m_framePacer->getStats();
+    if (stats.frameCount == 0) {
+        return;
     }
-    if (glfwGetKey(m_window, GLFW_KEY_S) == GLFW_PRESS) {
-        m_camera->moveBackward(deltaTime);
+
+    std::cout << std::fixed << std::setprecision(2)
+              << "[" << label << "] " << stats.averageFps << " FPS over " << stats.frameCount << " frames"
+              << " | avg " << stats.averageMs << " ms"
+              << " | min " << stats.minMs << " ms"
+              << " | max " << stats.maxMs << " ms"
+              << " | p99 " << stats.p99Ms << " ms"
+              << " | jitter " << stats.jitterMs << " ms";
+    if (!m_framePacer->isUncapped()) {
+        std::cout << " (target " << 1000.0 / m_framePacer->getTargetFps() << " ms)";
     }
-    if (glfwGetKey(m_window, GLFW_KEY_A) == GLFW_PRESS) {
-        m_camera->moveLeft(deltaTime);
+    std::cout << std::endl;
+    std::cout << "[" << label << "] CPU record " << m_renderer->getRecordCpuMs() << " ms on "
+              << m_jobSystem->getWorkerCount() << " workers";
+    if (m_simulation) {
+        std::cout << " | simulation " << m_simulation->getTickCpuMs() << " ms per tick at "
+                  << m_simulation->getTickRate() << " Hz";
     }
-    if (glfwGetKey(m_window, GLFW_KEY_D) == GLFW_PRESS) {
-        m_camera->moveRight(deltaTime);
+    std::cout << std::endl;
+    const CpuTracer* cpuTracer = m_renderer->getCpuTracer();
+    if (m_renderer->getBackend() == RenderBackend::CpuReference && cpuTracer) {
+        const CpuTracerStats& traceStats = cpuTracer->getStats();
+        uint64_t rays = traceStats.primaryRays + traceStats.secondaryRays + traceStats.shadowRays;
+        std::cout << "[" << label << "] CPU trace " << traceStats.renderMs << " ms | "
+                  << rays / (traceStats.renderMs * 1000.0) << " Mrays/s (" << traceStats.primaryRays << " primary, "
+                  << traceStats.secondaryRays << " reflection, " << traceStats.shadowRays << " shadow)" << std::endl;
     }
-    if (glfwGetKey(m_window, GLFW_KEY_SPACE) == GLFW_PRESS) {
-        m_camera->moveUp(deltaTime);
+    if (m_renderer->isLatencyMode()) {
+        std::cout << "[" << label << "] Input to present " << m_renderer->getInputToPresentMs()
+                  << " ms (camera latch to GPU done, excludes scanout)" << std::endl;
     }
-    if (glfwGetKey(m_window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS) {
-        m_camera->moveDown(deltaTime);
+
+    std::vector<GpuScopeStats> gpuStats = m_renderer->getProfiler()->getStats();
+    if (!gpuStats.empty()) {
+        std::cout << "[" << label << "] GPU";
+        for (const GpuScopeStats& scope : gpuStats) {
+            std::cout << " | " << scope.name << " " << scope.averageMs << " ms";
+        }
+        std::cout << std::endl;
+    }
+    std::cout << std::defaultfloat;
+}
+
+void Application::reportStartup() const {
+    std::cout << std::fixed << std::setprecision(1)
+              << "[Startup] First frame after " << millisecondsSince(m_startTime) << " ms"
+              << " | window " << m_startupTimings.windowMs << " ms"
+              << " | renderer " << m_startupTimings.rendererMs << " ms"
+              << " | shaders " << m_startupTimings.shadersMs << " ms (workers)"
+              << " | scene " << m_startupTimings.sceneMs << " ms (workers)"
+              << " | join wait " << m_startupTimings.joinWaitMs << " ms"
+              << " | geometry " << m_startupTimings.geometryMs << " ms"
+              << std::defaultfloat << std::endl;
+
+    // Cold builds every BLAS, warm deserializes all of them from AS_CACHE
+    const AccelerationStructureStats& asStats = m_renderer->getAccelerationStructureStats();
+    if (asStats.blasCount > 0) {
+        const char* temperature = asStats.blasFromCache == asStats.blasCount ? "warm"
+                                : asStats.blasFromCache == 0 ? "cold" : "partially warm";
+        std::cout << std::fixed << std::setprecision(1)
+                  << "[Startup] Acceleration structures " << asStats.setupMs << " ms (" << temperature << ", "
+                  << asStats.blasFromCache << "/" << asStats.blasCount << " BLASes from cache)"
+                  << std::defaultfloat << std::endl;
+    }
+}
+
+// Shadow rays share the trace dispatch with primary and reflection rays, so
+// their cost is the difference between the paired shadows/no-shadows phases.
+void Application::reportShadowCost() const {
+    for (const BenchmarkPhase& withShadows : m_benchmarkPhases) {
+        if (!withShadows.shadows || withShadows.backend == RenderBackend::Raster) {
+            continue;
+        }
+        for (const BenchmarkPhase& withoutShadows : m_benchmarkPhases) {
+            if (withoutShadows.backend != withShadows.backend || withoutShadows.shadows || withoutShadows.traceGpuMs <= 0.0) {
+                continue;
+            }
+            double shadowMs = withShadows.traceGpuMs - withoutShadows.traceGpuMs;
+            std::cout << std::fixed << std::setprecision(2)
+                      << "[Benchmark " << SimpleRenderer::getBackendName(withShadows.backend) << "] shadow rays "
+                      << shadowMs << " ms GPU (" << 100.0 * shadowMs / withShadows.traceGpuMs << "% of trace "
+                      << withShadows.traceGpuMs << " ms)" << std::defaultfloat << std::endl;
+        }
+    }
+}
+
+void Application::drawFrame() {
+    try {
+        m_renderer->beginFrame();
+        // The scene is posed at the start of recording, the camera later
+        // by latchCamera(); both from the same interpolated simulation
+        auto now = std::chrono::steady_clock::now();
+        SimulationState state = m_simulation->sample(now);
+        m_renderer->render(m_camera.get(), state.sceneTime, m_simulation->sampleTransforms(now));
+        latchCamera();
+        m_renderer->endFrame(m_camera.get());
+    } catch (const std::exception& e) {
+        std::cerr << "Error in drawFrame: " << e.what() << std::endl;
+        m_running = false;
+    }
+}
+
+// The simulation ticks on its own thread; this thread only forwards input
+void Application::update() {
+    // Keep the camera still during benchmarks so runs are comparable
+    m_simulation->setInput(sampleInput(), !isBenchmarking());
+}
+
+// Poses the render camera from the newest cursor position and simulation
+// state; runs after the frame is recorded, right before its submit
+void Application::latchCamera() {
+    updateMouseLook();
+    SimulationState state = m_simulation->sample(std::chrono::steady_clock::now());
+    m_camera->setPosition(state.cameraPosition);
+}
+
+void Application::updateMouseLook() {
+    if (isBenchmarking()) {
+        return;
     }
-    
-    // Mouse look
     double xpos, ypos;
     glfwGetCursorPos(m_window, &xpos, &ypos);
     m_camera->handleMouseMovement(static_cast<float>(xpos), static_cast<float>(ypos));
 }
 
+// GLFW input can only be polled on the main thread
+SimulationInput Application::sampleInput() {
+    updateMouseLook();
+
+    SimulationInput input;
+    input.forward = glfwGetKey(m_window, GLFW_KEY_W) == GLFW_PRESS;
+    input.backward = glfwGetKey(m_window, GLFW_KEY_S) == GLFW_PRESS;
+    input.left = glfwGetKey(m_window, GLFW_KEY_A) == GLFW_PRESS;
+    input.right = glfwGetKey(m_window, GLFW_KEY_D) == GLFW_PRESS;
+    input.up = glfwGetKey(m_window, GLFW_KEY_SPACE) == GLFW_PRESS;
+    input.down = glfwGetKey(m_window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS;
+    input.yaw = m_camera->getYaw();
+    input.pitch = m_camera->getPitch();
+    return input;
+}
+
 void Application::cleanup() {
+    // Ticks the scene, which the renderer and job system outlive
+    if (m_simulation) {
+        m_simulation->stop();
+    }
+
+    // Startup jobs still use the scene if initialization failed before the join
+    if (m_startupJobs) {
+        try {
+            m_jobSystem->wait(*m_startupJobs);
+        } catch (const std::exception& e) {
+            std::cerr << "Error while loading assets: " << e.what() << std::endl;
+        }
+        m_startupJobs.reset();
+    }
+
     if (m_renderer) {
         m_renderer.reset();
     }
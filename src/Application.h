@@ -1,11 +1,23 @@
 #pragma once
 
+#include <chrono>
 #include <memory>
+#include <cstdint>
+#include <string>
+#include <vector>
 #include <GLFW/glfw3.h>
 
 class SimpleRenderer;
 class Camera;
 class Scene;
+class FramePacer;
+class Simulation;
+struct SimulationInput;
+class JobSystem;
+class JobCounter;
+enum class PresentModePolicy;
+enum class RenderBackend;
+enum class MeshOptimization;
 
 class Application {
 public:
@@ -20,17 +32,86 @@ private:
     void initVulkan();
     void mainLoop();
     void drawFrame();
-    void update(float deltaTime);
-    void handleInput(float deltaTime);
+    void update();
+    void latchCamera();
+    void updateMouseLook();
+    SimulationInput sampleInput();
+    void loadSettings();
+    void startAssetLoading();
+    void reportStartup() const;
+    void startBenchmark();
+    void updateBenchmark();
+    void reportFrameStats(const char* label) const;
+    void reportShadowCost() const;
+    bool isBenchmarking() const { return m_benchmarkFrames > 0; }
 
     GLFWwindow* m_window;
+    std::unique_ptr<JobSystem> m_jobSystem; // Declared first so it outlives its users
     std::unique_ptr<SimpleRenderer> m_renderer;
-    std::unique_ptr<Camera> m_camera;
+    std::unique_ptr<Camera> m_camera; // Render thread's, posed from the simulation snapshots
+    std::unique_ptr<Camera> m_simulationCamera;
     std::unique_ptr<Scene> m_scene;
+    std::unique_ptr<FramePacer> m_framePacer;
+    std::unique_ptr<Simulation> m_simulation; // After the scene and cameras it ticks
+
+    // Startup graph: asset loading jobs joined before the geometry upload,
+    // phase timings reported with the time to first frame
+    struct StartupTimings {
+        double windowMs = 0.0;
+        double rendererMs = 0.0; // Device, swapchain and pipelines on the main thread
+        double shadersMs = 0.0;  // SPIR-V preload on workers
+        double sceneMs = 0.0;    // Scene load on a worker
+        double joinWaitMs = 0.0; // Main thread waiting for the loads after the renderer was ready
+        double geometryMs = 0.0; // Geometry upload and acceleration structures
+    };
+    std::unique_ptr<JobCounter> m_startupJobs;
+    std::chrono::steady_clock::time_point m_startTime;
+    StartupTimings m_startupTimings;
 
     bool m_running;
     float m_lastTime;
-    float m_deltaTime;
+    double m_simulationRate; // SIM_RATE env var, fixed simulation ticks per second
+    bool m_latencyMode;      // LATENCY env var
+
+    // Frame pacing (TARGET_FPS, PRESENT_MODE, BENCHMARK_FRAMES env vars)
+    PresentModePolicy m_presentModePolicy;
+    double m_targetFps;
+    uint32_t m_benchmarkFrames;
+    uint32_t m_frameIndex;
+    float m_lastStatsReportTime;
+
+    // Backend selection (RENDER_BACKEND env var, F1-F3 at runtime)
+    RenderBackend m_requestedBackend;
+    bool m_hasRequestedBackend;
+    bool m_shadowsEnabled; // SHADOWS env var, F4 at runtime
+    bool m_bloomEnabled;   // BLOOM env var, F5 at runtime
+    bool m_depthPrepass;   // DEPTH_PREPASS env var, F6 at runtime (raster backend)
+    MeshletPath m_meshletPath; // MESHLETS env var, F7 at runtime (raster backend)
+    bool m_temporalUpscale; // TAA env var
+    float m_renderScale;    // RENDER_SCALE env var, trace resolution relative to the window
+    uint32_t m_jobThreads;  // JOB_THREADS env var, 0 uses every hardware thread
+    bool m_pinJobThreads;   // JOB_PIN env var
+    std::string m_asCacheDirectory; // AS_CACHE env var, empty disables the BLAS cache
+    MeshOptimization m_meshOptimization; // MESH_OPT env var
+
+    // Benchmarks run every available backend in turn unless one is requested;
+    // ray traced backends run once with and once without shadows so the
+    // shadow ray cost can be reported on its own.
+    struct BenchmarkPhase {
+        RenderBackend backend;
+        bool shadows;
+        double traceGpuMs;
+    };
+    std::vector<BenchmarkPhase> m_benchmarkPhases;
+    size_t m_benchmarkPhase;
+    uint32_t m_phaseStartFrame;
+
+    static constexpr double DEFAULT_TARGET_FPS = 60.0;
+    static constexpr double DEFAULT_SIMULATION_RATE = 120.0;
+    static constexpr double MIN_SIMULATION_RATE = 10.0;
+    static constexpr float STATS_REPORT_INTERVAL = 5.0f;
+    static constexpr uint32_t BENCHMARK_WARMUP_FRAMES = 60;
+    static constexpr const char* DEFAULT_AS_CACHE_DIRECTORY = "as_cache";
 
     // Window properties
     static constexpr int WINDOW_WIDTH = 1920;
@@ -1,6 +1,21 @@
 #include "Camera.h"
 #include <algorithm>
 
+namespace {
+
+float halton(uint32_t index, uint32_t base) {
+    float result = 0.0f;
+    float fraction = 1.0f;
+    while (index > 0) {
+        fraction /= static_cast<float>(base);
+        result += fraction * static_cast<float>(index % base);
+        index /= base;
+    }
+    return result;
+}
+
+} // namespace
+
 Camera::Camera(int width, int height)
     : m_position(0.0f, 60.0f, 0.0f)
     , m_worldUp(0.0f, 1.0f, 0.0f)
@@ -48,6 +63,12 @@ void Camera::handleMouseMovement(float xpos, float ypos) {
     updateCameraVectors();
 }
 
+void Camera::setOrientation(float yaw, float pitch) {
+    m_yaw = yaw;
+    m_pitch = std::clamp(pitch, -89.0f, 89.0f);
+    updateCameraVectors();
+}
+
 void Camera::moveForward(float deltaTime) {
     m_position += m_front * m_movementSpeed * deltaTime;
 }
@@ -77,9 +98,23 @@ glm::mat4 Camera::getViewMatrix() const {
 }
 
 glm::mat4 Camera::getProjectionMatrix() const {
+    // Swapping the planes maps near to 1 and far to 0 (GLM_FORCE_DEPTH_ZERO_TO_ONE),
+    // which spreads float depth precision evenly over distance
     return glm::perspective(glm::radians(m_fov), 
                            static_cast<float>(m_width) / static_cast<float>(m_height), 
-                           m_nearPlane, m_farPlane);
+                           m_farPlane, m_nearPlane);
+}
+
+glm::mat4 Camera::getJitteredProjectionMatrix(glm::vec2 jitter, uint32_t width, uint32_t height) const {
+    // Translating in NDC after projection keeps the shift constant in pixels at every depth
+    glm::vec3 ndcOffset(2.0f * jitter.x / static_cast<float>(width), 2.0f * jitter.y / static_cast<float>(height), 0.0f);
+    return glm::translate(glm::mat4(1.0f), ndcOffset) * getProjectionMatrix();
+}
+
+glm::vec2 Camera::getJitterOffset(uint32_t frameIndex, uint32_t phaseCount) {
+    // Index 0 of the sequence is the origin, so start at 1
+    uint32_t index = frameIndex % std::max(phaseCount, 1u) + 1;
+    return glm::vec2(halton(index, 2), halton(index, 3)) - 0.5f;
 }
 
 void Camera::updateCameraVectors() {
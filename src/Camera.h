@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
@@ -18,9 +19,22 @@ public:
     void moveDown(float deltaTime);
     
     glm::mat4 getViewMatrix() const;
+    // Reverse-Z: depth is 1 at the near plane and 0 at the far plane
     glm::mat4 getProjectionMatrix() const;
+    // Projection shifted by a sub-pixel offset, in pixels of a width x height
+    // render target; the sample for pixel p lands at p + 0.5 - jitter
+    glm::mat4 getJitteredProjectionMatrix(glm::vec2 jitter, uint32_t width, uint32_t height) const;
+    // Halton(2, 3) offset in [-0.5, 0.5) for the given frame, repeating every phaseCount frames
+    static glm::vec2 getJitterOffset(uint32_t frameIndex, uint32_t phaseCount);
     glm::vec3 getPosition() const { return m_position; }
+    float getNearPlane() const { return m_nearPlane; }
+    float getFarPlane() const { return m_farPlane; }
     glm::vec3 getFront() const { return m_front; }
+    float getYaw() const { return m_yaw; }
+    float getPitch() const { return m_pitch; }
+    // For cameras driven from another thread's state (simulation, mouse look)
+    void setPosition(const glm::vec3& position) { m_position = position; }
+    void setOrientation(float yaw, float pitch);
 
 private:
     void updateCameraVectors();
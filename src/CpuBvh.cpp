@@ -0,0 +1,718 @@
+#include "CpuBvh.h"
+#include "GLTFLoader.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+
+namespace {
+
+using simd::Float4;
+using simd::FloatPacket;
+
+constexpr float DIRECTION_EPSILON = 1.0e-12f;
+constexpr float DETERMINANT_EPSILON = 1.0e-12f;
+
+// Keeps the slab test finite for axis-aligned rays
+float safeInverse(float x) {
+    if (std::fabs(x) < DIRECTION_EPSILON) {
+        x = std::copysign(DIRECTION_EPSILON, x);
+    }
+    return 1.0f / x;
+}
+
+} // namespace
+
+// Triangles are partitioned as whole records rather than as indices into
+// per-triangle arrays, so binning a range reads contiguous memory
+struct CpuBvh::BuildReference {
+    Bounds bounds;
+    uint32_t triangle;
+
+    glm::vec3 centroid() const { return 0.5f * (bounds.min + bounds.max); }
+};
+
+struct CpuBvh::BuildContext {
+    std::vector<BuildReference> references; // Partitioned in place
+    std::vector<BuildNode> nodes;           // Preallocated for the worst case of 2n - 1
+    std::atomic<uint32_t> nodeCount{1};
+    std::atomic<uint32_t> depth{0};
+    JobSystem* jobs = nullptr;
+    JobCounter counter;
+};
+
+void CpuBvh::build(const std::vector<GLTFVertex>& vertices, const std::vector<uint32_t>& indices,
+                   const std::vector<uint32_t>& triangles, JobSystem* jobs) {
+    auto start = std::chrono::steady_clock::now();
+    m_nodes.clear();
+    m_triangles.clear();
+    m_primitives.clear();
+    m_stats = {};
+
+    uint32_t count = static_cast<uint32_t>(triangles.size());
+    if (count == 0) {
+        return;
+    }
+
+    BuildContext context;
+    context.jobs = jobs;
+    context.references.resize(count);
+    context.nodes.resize(2 * static_cast<size_t>(count) - 1);
+    parallelFor(jobs, count, PARALLEL_BIN_GRAIN, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            uint32_t base = triangles[i] * 3;
+            BuildReference& reference = context.references[i];
+            reference.bounds = Bounds();
+            for (uint32_t corner = 0; corner < 3; ++corner) {
+                reference.bounds.grow(vertices[indices[base + corner]].position);
+            }
+            reference.triangle = triangles[i];
+        }
+    });
+
+    buildRange(context, 0, 0, count, 1);
+    if (jobs) {
+        jobs->wait(context.counter);
+    }
+
+    // Leaves reference m_triangles directly, so store them in build order
+    m_primitives.resize(count);
+    m_triangles.resize(count);
+    parallelFor(jobs, count, PARALLEL_BIN_GRAIN, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            uint32_t triangle = context.references[i].triangle;
+            uint32_t base = triangle * 3;
+            const glm::vec3& v0 = vertices[indices[base + 0]].position;
+            glm::vec3 edge1 = vertices[indices[base + 1]].position - v0;
+            glm::vec3 edge2 = vertices[indices[base + 2]].position - v0;
+            m_primitives[i] = triangle;
+            m_triangles[i] = {{v0.x, v0.y, v0.z}, {edge1.x, edge1.y, edge1.z}, {edge2.x, edge2.y, edge2.z}, triangle};
+        }
+    });
+
+    // Expected cost of a random ray through the binary tree, relative to the root
+    float rootArea = std::max(context.nodes[0].bounds.area(), 1.0e-12f);
+    float cost = 0.0f;
+    uint32_t buildNodeCount = context.nodeCount.load();
+    for (uint32_t i = 0; i < buildNodeCount; ++i) {
+        const BuildNode& node = context.nodes[i];
+        cost += node.bounds.area() / rootArea * (node.count > 0 ? static_cast<float>(node.count) : TRAVERSAL_COST);
+    }
+
+    m_nodes.reserve(buildNodeCount / 2 + 1);
+    m_stats.depth = 0;
+    collapse(context.nodes, 0, 1);
+    m_stats.triangleCount = count;
+    m_stats.nodeCount = static_cast<uint32_t>(m_nodes.size());
+    m_stats.sahCost = cost;
+    m_stats.buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void CpuBvh::buildRange(BuildContext& context, uint32_t nodeIndex, uint32_t first, uint32_t count, uint32_t depth) {
+    uint32_t previousDepth = context.depth.load(std::memory_order_relaxed);
+    while (previousDepth < depth && !context.depth.compare_exchange_weak(previousDepth, depth, std::memory_order_relaxed)) {
+    }
+
+    JobSystem* rangeJobs = count >= PARALLEL_BIN_THRESHOLD ? context.jobs : nullptr;
+    std::mutex mergeMutex;
+
+    Bounds bounds;
+    Bounds centroidBounds;
+    parallelFor(rangeJobs, count, PARALLEL_BIN_GRAIN, [&](uint32_t begin, uint32_t end) {
+        Bounds localBounds;
+        Bounds localCentroids;
+        for (uint32_t i = first + begin; i < first + end; ++i) {
+            const BuildReference& reference = context.references[i];
+            localBounds.grow(reference.bounds);
+            localCentroids.grow(reference.centroid());
+        }
+        std::lock_guard<std::mutex> lock(mergeMutex);
+        bounds.grow(localBounds);
+        centroidBounds.grow(localCentroids);
+    });
+
+    BuildNode& node = context.nodes[nodeIndex];
+    node.bounds = bounds;
+    node.first = first;
+    node.count = count;
+    if (count <= MAX_LEAF_SIZE) {
+        return;
+    }
+
+    struct Bin {
+        Bounds bounds;
+        uint32_t count = 0;
+    };
+    using AxisBins = std::array<std::array<Bin, BIN_COUNT>, 3>;
+
+    glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+    glm::vec3 scale(0.0f);
+    for (int axis = 0; axis < 3; ++axis) {
+        if (extent[axis] > 1.0e-12f) {
+            scale[axis] = static_cast<float>(BIN_COUNT) * (1.0f - 1.0e-5f) / extent[axis];
+        }
+    }
+    const glm::vec3 binOrigin = centroidBounds.min;
+    auto binIndex = [binOrigin, scale](const glm::vec3& centroid, int axis) {
+        uint32_t bin = static_cast<uint32_t>((centroid[axis] - binOrigin[axis]) * scale[axis]);
+        return std::min(bin, BIN_COUNT - 1);
+    };
+
+    AxisBins bins{};
+    parallelFor(rangeJobs, count, PARALLEL_BIN_GRAIN, [&](uint32_t begin, uint32_t end) {
+        AxisBins localBins{};
+        for (uint32_t i = first + begin; i < first + end; ++i) {
+            const BuildReference& reference = context.references[i];
+            glm::vec3 centroid = reference.centroid();
+            for (int axis = 0; axis < 3; ++axis) {
+                Bin& bin = localBins[axis][binIndex(centroid, axis)];
+                bin.bounds.grow(reference.bounds);
+                ++bin.count;
+            }
+        }
+        std::lock_guard<std::mutex> lock(mergeMutex);
+        for (int axis = 0; axis < 3; ++axis) {
+            for (uint32_t b = 0; b < BIN_COUNT; ++b) {
+                bins[axis][b].bounds.grow(localBins[axis][b].bounds);
+                bins[axis][b].count += localBins[axis][b].count;
+            }
+        }
+    });
+
+    // Sweep each axis once from the right to get the cost of every split plane
+    float bestCost = std::numeric_limits<float>::max();
+    int bestAxis = -1;
+    uint32_t bestSplit = 0;
+    for (int axis = 0; axis < 3; ++axis) {
+        if (scale[axis] == 0.0f) {
+            continue;
+        }
+        std::array<float, BIN_COUNT> rightCost{};
+        Bounds right;
+        uint32_t rightCount = 0;
+        for (uint32_t b = BIN_COUNT - 1; b > 0; --b) {
+            right.grow(bins[axis][b].bounds);
+            rightCount += bins[axis][b].count;
+            rightCost[b] = right.area() * static_cast<float>(rightCount);
+        }
+        Bounds left;
+        uint32_t leftCount = 0;
+        for (uint32_t b = 1; b < BIN_COUNT; ++b) {
+            left.grow(bins[axis][b - 1].bounds);
+            leftCount += bins[axis][b - 1].count;
+            if (leftCount == 0 || leftCount == count) {
+                continue;
+            }
+            float cost = left.area() * static_cast<float>(leftCount) + rightCost[b];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = b;
+            }
+        }
+    }
+
+    float area = std::max(bounds.area(), 1.0e-12f);
+    float splitCost = TRAVERSAL_COST + bestCost / area;
+    uint32_t leftCount = 0;
+    if (bestAxis >= 0) {
+        if (splitCost >= static_cast<float>(count) && count <= LEAF_COUNT_MASK) {
+            return;
+        }
+        auto begin = context.references.begin() + first;
+        auto middle = std::partition(begin, begin + count, [&](const BuildReference& reference) {
+            return binIndex(reference.centroid(), bestAxis) < bestSplit;
+        });
+        leftCount = static_cast<uint32_t>(middle - begin);
+    } else {
+        // Every centroid coincides; split in the middle to keep leaves small
+        leftCount = count / 2;
+    }
+
+    uint32_t left = context.nodeCount.fetch_add(2, std::memory_order_relaxed);
+    node.left = left;
+    node.right = left + 1;
+    node.count = 0;
+
+    uint32_t rightCount = count - leftCount;
+    if (context.jobs && leftCount >= SPAWN_THRESHOLD) {
+        BuildContext* shared = &context;
+        context.jobs->spawn([this, shared, left, first, leftCount, depth]() {
+            buildRange(*shared, left, first, leftCount, depth + 1);
+        }, &context.counter);
+    } else {
+        buildRange(context, left, first, leftCount, depth + 1);
+    }
+    buildRange(context, left + 1, first + leftCount, rightCount, depth + 1);
+}
+
+// Children are collapsed after their parent, so a reverse sweep over the
+// nodes sees every child's box before the box that encloses it
+void CpuBvh::refit(const std::vector<GLTFVertex>& vertices, const std::vector<uint32_t>& indices, JobSystem* jobs) {
+    auto start = std::chrono::steady_clock::now();
+    uint32_t count = static_cast<uint32_t>(m_triangles.size());
+    parallelFor(jobs, count, PARALLEL_BIN_GRAIN, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            uint32_t base = m_triangles[i].id * 3;
+            const glm::vec3& v0 = vertices[indices[base + 0]].position;
+            glm::vec3 edge1 = vertices[indices[base + 1]].position - v0;
+            glm::vec3 edge2 = vertices[indices[base + 2]].position - v0;
+            m_triangles[i] = {{v0.x, v0.y, v0.z}, {edge1.x, edge1.y, edge1.z}, {edge2.x, edge2.y, edge2.z}, m_triangles[i].id};
+        }
+    });
+
+    std::vector<Bounds> nodeBounds(m_nodes.size());
+    for (size_t n = m_nodes.size(); n-- > 0;) {
+        Node& node = m_nodes[n];
+        for (uint32_t i = 0; i < 4; ++i) {
+            uint32_t child = node.children[i];
+            if (child == EMPTY) {
+                continue;
+            }
+            Bounds bounds;
+            if (child & LEAF_BIT) {
+                uint32_t first = (child & ~LEAF_BIT) >> LEAF_COUNT_BITS;
+                for (uint32_t t = first; t < first + (child & LEAF_COUNT_MASK); ++t) {
+                    const Triangle& triangle = m_triangles[t];
+                    glm::vec3 v0(triangle.v0[0], triangle.v0[1], triangle.v0[2]);
+                    bounds.grow(v0);
+                    bounds.grow(v0 + glm::vec3(triangle.edge1[0], triangle.edge1[1], triangle.edge1[2]));
+                    bounds.grow(v0 + glm::vec3(triangle.edge2[0], triangle.edge2[1], triangle.edge2[2]));
+                }
+            } else {
+                bounds = nodeBounds[child];
+            }
+            for (int axis = 0; axis < 3; ++axis) {
+                node.bounds[axis * 2 + 0][i] = bounds.min[axis];
+                node.bounds[axis * 2 + 1][i] = bounds.max[axis];
+            }
+            nodeBounds[n].grow(bounds);
+        }
+    }
+    m_stats.refitMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+uint32_t CpuBvh::collapse(const std::vector<BuildNode>& buildNodes, uint32_t buildIndex, uint32_t depth) {
+    m_stats.depth = std::max(m_stats.depth, depth);
+
+    // Open the largest inner child until the node has four children
+    uint32_t children[4] = {buildIndex, 0, 0, 0};
+    uint32_t childCount = 1;
+    while (childCount < 4) {
+        int largest = -1;
+        float largestArea = -1.0f;
+        for (uint32_t i = 0; i < childCount; ++i) {
+            const BuildNode& child = buildNodes[children[i]];
+            if (child.count == 0 && child.bounds.area() > largestArea) {
+                largest = static_cast<int>(i);
+                largestArea = child.bounds.area();
+            }
+        }
+        if (largest < 0) {
+            break;
+        }
+        const BuildNode& opened = buildNodes[children[largest]];
+        children[largest] = opened.left;
+        children[childCount++] = opened.right;
+    }
+
+    uint32_t nodeIndex = static_cast<uint32_t>(m_nodes.size());
+    m_nodes.emplace_back();
+    for (uint32_t i = 0; i < 4; ++i) {
+        uint32_t encoded = EMPTY;
+        Bounds bounds;
+        if (i < childCount) {
+            const BuildNode& child = buildNodes[children[i]];
+            bounds = child.bounds;
+            encoded = child.count > 0 ? makeLeaf(child) : collapse(buildNodes, children[i], depth + 1);
+        }
+        // Empty slots keep inverted bounds, which no slab test accepts
+        Node& node = m_nodes[nodeIndex];
+        for (int axis = 0; axis < 3; ++axis) {
+            node.bounds[axis * 2 + 0][i] = bounds.min[axis];
+            node.bounds[axis * 2 + 1][i] = bounds.max[axis];
+        }
+        node.children[i] = encoded;
+    }
+    return nodeIndex;
+}
+
+uint32_t CpuBvh::makeLeaf(const BuildNode& node) {
+    ++m_stats.leafCount;
+    return LEAF_BIT | (node.first << LEAF_COUNT_BITS) | node.count;
+}
+
+bool CpuBvh::intersectTriangle(const Triangle& triangle, const CpuRay& ray, float tMax, float& t, float& u, float& v) const {
+    glm::vec3 edge1(triangle.edge1[0], triangle.edge1[1], triangle.edge1[2]);
+    glm::vec3 edge2(triangle.edge2[0], triangle.edge2[1], triangle.edge2[2]);
+    glm::vec3 p = glm::cross(ray.direction, edge2);
+    float determinant = glm::dot(edge1, p);
+    if (std::fabs(determinant) < DETERMINANT_EPSILON) {
+        return false;
+    }
+    float inverseDeterminant = 1.0f / determinant;
+    glm::vec3 s = ray.origin - glm::vec3(triangle.v0[0], triangle.v0[1], triangle.v0[2]);
+    u = glm::dot(s, p) * inverseDeterminant;
+    if (u < 0.0f || u > 1.0f) {
+        return false;
+    }
+    glm::vec3 q = glm::cross(s, edge1);
+    v = glm::dot(ray.direction, q) * inverseDeterminant;
+    if (v < 0.0f || u + v > 1.0f) {
+        return false;
+    }
+    t = glm::dot(edge2, q) * inverseDeterminant;
+    return t > ray.tMin && t < tMax;
+}
+
+// Moller-Trumbore for every lane of a packet; returns the mask of lanes that
+// hit within (tMin, tMax)
+simd::FloatPacket CpuBvh::intersectTriangle(const Triangle& triangle, const FloatPacket origin[3], const FloatPacket direction[3],
+                                            FloatPacket tMin, FloatPacket tMax, FloatPacket& t, FloatPacket& u, FloatPacket& v) {
+    const FloatPacket zero = FloatPacket::broadcast(0.0f);
+    const FloatPacket one = FloatPacket::broadcast(1.0f);
+    FloatPacket edge1[3], edge2[3], s[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        edge1[axis] = FloatPacket::broadcast(triangle.edge1[axis]);
+        edge2[axis] = FloatPacket::broadcast(triangle.edge2[axis]);
+        s[axis] = origin[axis] - FloatPacket::broadcast(triangle.v0[axis]);
+    }
+    FloatPacket p[3] = {direction[1] * edge2[2] - direction[2] * edge2[1],
+                        direction[2] * edge2[0] - direction[0] * edge2[2],
+                        direction[0] * edge2[1] - direction[1] * edge2[0]};
+    FloatPacket determinant = edge1[0] * p[0] + edge1[1] * p[1] + edge1[2] * p[2];
+    FloatPacket inverseDeterminant = one / determinant;
+    u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inverseDeterminant;
+    FloatPacket q[3] = {s[1] * edge1[2] - s[2] * edge1[1],
+                        s[2] * edge1[0] - s[0] * edge1[2],
+                        s[0] * edge1[1] - s[1] * edge1[0]};
+    v = (direction[0] * q[0] + direction[1] * q[1] + direction[2] * q[2]) * inverseDeterminant;
+    t = (edge2[0] * q[0] + edge2[1] * q[1] + edge2[2] * q[2]) * inverseDeterminant;
+    return (simd::abs(determinant) >= FloatPacket::broadcast(DETERMINANT_EPSILON)) & (u >= zero) & (v >= zero) &
+           (u + v <= one) & (t > tMin) & (t < tMax);
+}
+
+bool CpuBvh::intersect(const CpuRay& ray, CpuHit& hit) const {
+    hit = {};
+    if (m_nodes.empty()) {
+        return false;
+    }
+
+    glm::vec3 inverse(safeInverse(ray.direction.x), safeInverse(ray.direction.y), safeInverse(ray.direction.z));
+    // Near planes are the minimums along axes the ray travels in positive direction
+    int nearPlane[3];
+    Float4 originScaled[3];
+    Float4 inverse4[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        nearPlane[axis] = axis * 2 + (inverse[axis] < 0.0f ? 1 : 0);
+        inverse4[axis] = Float4::broadcast(inverse[axis]);
+        originScaled[axis] = Float4::broadcast(ray.origin[axis] * inverse[axis]);
+    }
+
+    struct Entry {
+        uint32_t child;
+        float tNear;
+    };
+    Entry stack[STACK_SIZE];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = {0, ray.tMin};
+    float tMax = ray.tMax;
+
+    while (stackSize > 0) {
+        Entry entry = stack[--stackSize];
+        if (entry.tNear > tMax) {
+            continue;
+        }
+        if (entry.child & LEAF_BIT) {
+            uint32_t first = (entry.child & ~LEAF_BIT) >> LEAF_COUNT_BITS;
+            uint32_t count = entry.child & LEAF_COUNT_MASK;
+            for (uint32_t i = first; i < first + count; ++i) {
+                float t, u, v;
+                if (intersectTriangle(m_triangles[i], ray, tMax, t, u, v)) {
+                    tMax = t;
+                    hit = {t, u, v, m_triangles[i].id};
+                }
+            }
+            continue;
+        }
+
+        const Node& node = m_nodes[entry.child];
+        Float4 tNear = Float4::broadcast(ray.tMin);
+        Float4 tFar = Float4::broadcast(tMax);
+        for (int axis = 0; axis < 3; ++axis) {
+            Float4 nearT = Float4::load(node.bounds[nearPlane[axis]]) * inverse4[axis] - originScaled[axis];
+            Float4 farT = Float4::load(node.bounds[nearPlane[axis] ^ 1]) * inverse4[axis] - originScaled[axis];
+            tNear = simd::max(tNear, nearT);
+            tFar = simd::min(tFar, farT);
+        }
+        uint32_t mask = (tNear <= tFar).bits();
+        if (mask == 0) {
+            continue;
+        }
+
+        float nearValues[4];
+        tNear.store(nearValues);
+        Entry hits[4];
+        uint32_t hitCount = 0;
+        for (uint32_t i = 0; i < 4; ++i) {
+            if (mask & (1u << i)) {
+                // Insertion sort, farthest first so the nearest child is popped next
+                uint32_t slot = hitCount++;
+                while (slot > 0 && hits[slot - 1].tNear < nearValues[i]) {
+                    hits[slot] = hits[slot - 1];
+                    --slot;
+                }
+                hits[slot] = {node.children[i], nearValues[i]};
+            }
+        }
+        for (uint32_t i = 0; i < hitCount && stackSize < STACK_SIZE; ++i) {
+            stack[stackSize++] = hits[i];
+        }
+    }
+    return hit.triangle != CpuHit::NONE;
+}
+
+bool CpuBvh::occluded(const CpuRay& ray) const {
+    if (m_nodes.empty()) {
+        return false;
+    }
+
+    glm::vec3 inverse(safeInverse(ray.direction.x), safeInverse(ray.direction.y), safeInverse(ray.direction.z));
+    int nearPlane[3];
+    Float4 originScaled[3];
+    Float4 inverse4[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        nearPlane[axis] = axis * 2 + (inverse[axis] < 0.0f ? 1 : 0);
+        inverse4[axis] = Float4::broadcast(inverse[axis]);
+        originScaled[axis] = Float4::broadcast(ray.origin[axis] * inverse[axis]);
+    }
+    Float4 tMin = Float4::broadcast(ray.tMin);
+    Float4 tMax = Float4::broadcast(ray.tMax);
+
+    uint32_t stack[STACK_SIZE];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0) {
+        uint32_t child = stack[--stackSize];
+        if (child & LEAF_BIT) {
+            uint32_t first = (child & ~LEAF_BIT) >> LEAF_COUNT_BITS;
+            uint32_t count = child & LEAF_COUNT_MASK;
+            for (uint32_t i = first; i < first + count; ++i) {
+                float t, u, v;
+                if (intersectTriangle(m_triangles[i], ray, ray.tMax, t, u, v)) {
+                    return true;
+                }
+            }
+            continue;
+        }
+
+        const Node& node = m_nodes[child];
+        Float4 tNear = tMin;
+        Float4 tFar = tMax;
+        for (int axis = 0; axis < 3; ++axis) {
+            tNear = simd::max(tNear, Float4::load(node.bounds[nearPlane[axis]]) * inverse4[axis] - originScaled[axis]);
+            tFar = simd::min(tFar, Float4::load(node.bounds[nearPlane[axis] ^ 1]) * inverse4[axis] - originScaled[axis]);
+        }
+        uint32_t mask = (tNear <= tFar).bits();
+        for (uint32_t i = 0; i < 4 && stackSize < STACK_SIZE; ++i) {
+            if (mask & (1u << i)) {
+                stack[stackSize++] = node.children[i];
+            }
+        }
+    }
+    return false;
+}
+
+void CpuBvh::intersect(CpuRayPacket& packet, CpuPacketHit& hit) const {
+    constexpr uint32_t WIDTH = CpuRayPacket::WIDTH;
+    for (uint32_t lane = 0; lane < WIDTH; ++lane) {
+        hit.u[lane] = 0.0f;
+        hit.v[lane] = 0.0f;
+        hit.triangle[lane] = CpuHit::NONE;
+        // Inactive lanes get an empty interval so no box or triangle accepts them
+        if (!(packet.activeMask & (1u << lane))) {
+            packet.tMin[lane] = 0.0f;
+            packet.tMax[lane] = -1.0f;
+        }
+    }
+    if (m_nodes.empty() || packet.activeMask == 0) {
+        return;
+    }
+
+    FloatPacket origin[3] = {FloatPacket::load(packet.originX), FloatPacket::load(packet.originY), FloatPacket::load(packet.originZ)};
+    FloatPacket direction[3] = {FloatPacket::load(packet.directionX), FloatPacket::load(packet.directionY), FloatPacket::load(packet.directionZ)};
+    FloatPacket inverse[3];
+    FloatPacket originScaled[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        float values[WIDTH];
+        direction[axis].store(values);
+        for (uint32_t lane = 0; lane < WIDTH; ++lane) {
+            values[lane] = safeInverse(values[lane]);
+        }
+        inverse[axis] = FloatPacket::load(values);
+        originScaled[axis] = origin[axis] * inverse[axis];
+    }
+    FloatPacket tMin = FloatPacket::load(packet.tMin);
+    FloatPacket tMax = FloatPacket::load(packet.tMax);
+    FloatPacket hitU = FloatPacket::broadcast(0.0f);
+    FloatPacket hitV = FloatPacket::broadcast(0.0f);
+
+    uint32_t stack[STACK_SIZE];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0) {
+        uint32_t child = stack[--stackSize];
+        if (child & LEAF_BIT) {
+            uint32_t first = (child & ~LEAF_BIT) >> LEAF_COUNT_BITS;
+            uint32_t count = child & LEAF_COUNT_MASK;
+            for (uint32_t i = first; i < first + count; ++i) {
+                const Triangle& triangle = m_triangles[i];
+                FloatPacket t, u, v;
+                FloatPacket accepted = intersectTriangle(triangle, origin, direction, tMin, tMax, t, u, v);
+                uint32_t mask = accepted.bits();
+                if (mask == 0) {
+                    continue;
+                }
+                tMax = simd::select(accepted, t, tMax);
+                hitU = simd::select(accepted, u, hitU);
+                hitV = simd::select(accepted, v, hitV);
+                for (uint32_t lane = 0; lane < WIDTH; ++lane) {
+                    if (mask & (1u << lane)) {
+                        hit.triangle[lane] = triangle.id;
+                    }
+                }
+            }
+            continue;
+        }
+
+        // Lanes may point in different directions, so order each slab with min/max
+        const Node& node = m_nodes[child];
+        uint32_t visit[4];
+        float visitNear[4];
+        uint32_t visitCount = 0;
+        for (uint32_t i = 0; i < 4; ++i) {
+            if (node.children[i] == EMPTY) {
+                continue;
+            }
+            FloatPacket tNear = tMin;
+            FloatPacket tFar = tMax;
+            for (int axis = 0; axis < 3; ++axis) {
+                FloatPacket t0 = FloatPacket::broadcast(node.bounds[axis * 2 + 0][i]) * inverse[axis] - originScaled[axis];
+                FloatPacket t1 = FloatPacket::broadcast(node.bounds[axis * 2 + 1][i]) * inverse[axis] - originScaled[axis];
+                tNear = simd::max(tNear, simd::min(t0, t1));
+                tFar = simd::min(tFar, simd::max(t0, t1));
+            }
+            uint32_t mask = (tNear <= tFar).bits();
+            if (mask == 0) {
+                continue;
+            }
+            float nearValues[WIDTH];
+            tNear.store(nearValues);
+            float nearest = std::numeric_limits<float>::max();
+            for (uint32_t lane = 0; lane < WIDTH; ++lane) {
+                if (mask & (1u << lane)) {
+                    nearest = std::min(nearest, nearValues[lane]);
+                }
+            }
+            uint32_t slot = visitCount++;
+            while (slot > 0 && visitNear[slot - 1] < nearest) {
+                visit[slot] = visit[slot - 1];
+                visitNear[slot] = visitNear[slot - 1];
+                --slot;
+            }
+            visit[slot] = node.children[i];
+            visitNear[slot] = nearest;
+        }
+        for (uint32_t i = 0; i < visitCount && stackSize < STACK_SIZE; ++i) {
+            stack[stackSize++] = visit[i];
+        }
+    }
+
+    tMax.store(packet.tMax);
+    hitU.store(hit.u);
+    hitV.store(hit.v);
+}
+
+uint32_t CpuBvh::occluded(const CpuRayPacket& packet) const {
+    constexpr uint32_t WIDTH = CpuRayPacket::WIDTH;
+    if (m_nodes.empty() || packet.activeMask == 0) {
+        return 0;
+    }
+
+    float laneMin[WIDTH];
+    float laneMax[WIDTH];
+    for (uint32_t lane = 0; lane < WIDTH; ++lane) {
+        bool active = (packet.activeMask & (1u << lane)) != 0;
+        laneMin[lane] = active ? packet.tMin[lane] : 0.0f;
+        laneMax[lane] = active ? packet.tMax[lane] : -1.0f;
+    }
+
+    FloatPacket origin[3] = {FloatPacket::load(packet.originX), FloatPacket::load(packet.originY), FloatPacket::load(packet.originZ)};
+    FloatPacket direction[3] = {FloatPacket::load(packet.directionX), FloatPacket::load(packet.directionY), FloatPacket::load(packet.directionZ)};
+    FloatPacket inverse[3];
+    FloatPacket originScaled[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        float values[WIDTH];
+        direction[axis].store(values);
+        for (uint32_t lane = 0; lane < WIDTH; ++lane) {
+            values[lane] = safeInverse(values[lane]);
+        }
+        inverse[axis] = FloatPacket::load(values);
+        originScaled[axis] = origin[axis] * inverse[axis];
+    }
+    FloatPacket tMin = FloatPacket::load(laneMin);
+    FloatPacket tMax = FloatPacket::load(laneMax);
+    const FloatPacket retired = FloatPacket::broadcast(-1.0f);
+
+    uint32_t occludedMask = 0;
+    uint32_t stack[STACK_SIZE];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0) {
+        uint32_t child = stack[--stackSize];
+        if (child & LEAF_BIT) {
+            uint32_t first = (child & ~LEAF_BIT) >> LEAF_COUNT_BITS;
+            uint32_t count = child & LEAF_COUNT_MASK;
+            for (uint32_t i = first; i < first + count; ++i) {
+                FloatPacket t, u, v;
+                FloatPacket accepted = intersectTriangle(m_triangles[i], origin, direction, tMin, tMax, t, u, v);
+                uint32_t mask = accepted.bits();
+                if (mask == 0) {
+                    continue;
+                }
+                // Occluded lanes are done: an empty interval drops them from every later test
+                occludedMask |= mask;
+                if (occludedMask == packet.activeMask) {
+                    return occludedMask;
+                }
+                tMax = simd::select(accepted, retired, tMax);
+            }
+            continue;
+        }
+
+        const Node& node = m_nodes[child];
+        for (uint32_t i = 0; i < 4 && stackSize < STACK_SIZE; ++i) {
+            if (node.children[i] == EMPTY) {
+                continue;
+            }
+            FloatPacket tNear = tMin;
+            FloatPacket tFar = tMax;
+            for (int axis = 0; axis < 3; ++axis) {
+                FloatPacket t0 = FloatPacket::broadcast(node.bounds[axis * 2 + 0][i]) * inverse[axis] - originScaled[axis];
+                FloatPacket t1 = FloatPacket::broadcast(node.bounds[axis * 2 + 1][i]) * inverse[axis] - originScaled[axis];
+                tNear = simd::max(tNear, simd::min(t0, t1));
+                tFar = simd::min(tFar, simd::max(t0, t1));
+            }
+            if ((tNear <= tFar).bits() != 0) {
+                stack[stackSize++] = node.children[i];
+            }
+        }
+    }
+    return occludedMask;
+}
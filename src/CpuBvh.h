@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include <glm/glm.hpp>
+#include "CpuSimd.h"
+
+class JobSystem;
+struct GLTFVertex;
+
+struct CpuRay {
+    glm::vec3 origin;
+    glm::vec3 direction;
+    float tMin = 0.0f;
+    float tMax = std::numeric_limits<float>::max();
+};
+
+// Closest hit of a ray. u and v weight the triangle's second and third
+// vertex, like the hardware barycentrics in the hit shaders.
+struct CpuHit {
+    static constexpr uint32_t NONE = 0xFFFFFFFFu;
+
+    float t = 0.0f;
+    float u = 0.0f;
+    float v = 0.0f;
+    uint32_t triangle = NONE; // Index of the triangle's first index / 3
+};
+
+// PACKET_WIDTH coherent rays in SoA layout, traversed together. Lanes not in
+// activeMask are ignored; their hits keep triangle NONE.
+struct CpuRayPacket {
+    static constexpr uint32_t WIDTH = simd::FloatPacket::WIDTH;
+
+    float originX[WIDTH], originY[WIDTH], originZ[WIDTH];
+    float directionX[WIDTH], directionY[WIDTH], directionZ[WIDTH];
+    float tMin[WIDTH];
+    float tMax[WIDTH]; // Shrinks to the closest hit during traversal
+    uint32_t activeMask = 0;
+};
+
+struct CpuPacketHit {
+    float u[CpuRayPacket::WIDTH];
+    float v[CpuRayPacket::WIDTH];
+    uint32_t triangle[CpuRayPacket::WIDTH];
+};
+
+struct CpuBvhStats {
+    uint32_t triangleCount = 0;
+    uint32_t nodeCount = 0; // 4-wide nodes
+    uint32_t leafCount = 0;
+    uint32_t depth = 0;
+    float sahCost = 0.0f;   // Of the binary tree before collapsing
+    double buildMs = 0.0;
+    double refitMs = 0.0;   // Last refit
+};
+
+// Bounding volume hierarchy for the CPU ray tracer. Built top-down with the
+// binned surface area heuristic; large ranges are binned and split on the job
+// system. The binary tree is collapsed into 4-wide nodes whose child boxes are
+// tested against one ray in a single Float4 slab test, and coherent rays can
+// traverse it as a packet with one FloatPacket lane per ray.
+class CpuBvh {
+public:
+    // triangles lists the triangle numbers (first index / 3) to include
+    void build(const std::vector<GLTFVertex>& vertices, const std::vector<uint32_t>& indices,
+               const std::vector<uint32_t>& triangles, JobSystem* jobs);
+    // Moves the built triangles to the vertices' new positions and refits
+    // every box, keeping the tree; the indices must be the ones it was built from
+    void refit(const std::vector<GLTFVertex>& vertices, const std::vector<uint32_t>& indices, JobSystem* jobs);
+
+    bool intersect(const CpuRay& ray, CpuHit& hit) const;
+    // Any hit within the ray's interval, for shadow rays
+    bool occluded(const CpuRay& ray) const;
+    void intersect(CpuRayPacket& packet, CpuPacketHit& hit) const;
+    // Any hit per lane; returns the mask of active lanes that are blocked
+    uint32_t occluded(const CpuRayPacket& packet) const;
+
+    bool isEmpty() const { return m_nodes.empty(); }
+    const CpuBvhStats& getStats() const { return m_stats; }
+
+private:
+    struct Bounds {
+        glm::vec3 min{std::numeric_limits<float>::max()};
+        glm::vec3 max{std::numeric_limits<float>::lowest()};
+
+        void grow(const glm::vec3& point) {
+            min = glm::min(min, point);
+            max = glm::max(max, point);
+        }
+        void grow(const Bounds& other) {
+            min = glm::min(min, other.min);
+            max = glm::max(max, other.max);
+        }
+        float area() const {
+            glm::vec3 extent = glm::max(max - min, glm::vec3(0.0f));
+            return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+        }
+    };
+
+    // Binary node of the intermediate tree; leaves own primitives
+    // [first, first + count) of m_primitives
+    struct BuildNode {
+        Bounds bounds;
+        uint32_t left = 0;
+        uint32_t right = 0;
+        uint32_t first = 0;
+        uint32_t count = 0; // Zero for inner nodes
+    };
+
+    // Children of a 4-wide node as SoA boxes: bounds[axis * 2 + 0] are the
+    // minimums, bounds[axis * 2 + 1] the maximums of the four children.
+    // A child is an inner node index or LEAF_BIT | first << LEAF_COUNT_BITS |
+    // count over m_triangles; unused slots are EMPTY.
+    struct alignas(64) Node {
+        float bounds[6][4];
+        uint32_t children[4];
+    };
+
+    // Precomputed for the Moller-Trumbore test
+    struct Triangle {
+        float v0[3];
+        float edge1[3];
+        float edge2[3];
+        uint32_t id;
+    };
+
+    struct BuildReference;
+    struct BuildContext;
+    void buildRange(BuildContext& context, uint32_t nodeIndex, uint32_t first, uint32_t count, uint32_t depth);
+    uint32_t collapse(const std::vector<BuildNode>& buildNodes, uint32_t buildIndex, uint32_t depth);
+    uint32_t makeLeaf(const BuildNode& node);
+
+    bool intersectTriangle(const Triangle& triangle, const CpuRay& ray, float tMax, float& t, float& u, float& v) const;
+    static simd::FloatPacket intersectTriangle(const Triangle& triangle, const simd::FloatPacket origin[3], const simd::FloatPacket direction[3],
+                                               simd::FloatPacket tMin, simd::FloatPacket tMax,
+                                               simd::FloatPacket& t, simd::FloatPacket& u, simd::FloatPacket& v);
+
+    std::vector<Node> m_nodes;
+    std::vector<Triangle> m_triangles;
+    std::vector<uint32_t> m_primitives; // Build order of the input triangles
+    CpuBvhStats m_stats;
+
+    static constexpr uint32_t EMPTY = 0xFFFFFFFFu;
+    static constexpr uint32_t LEAF_BIT = 0x80000000u;
+    static constexpr uint32_t LEAF_COUNT_BITS = 4;
+    static constexpr uint32_t LEAF_COUNT_MASK = (1u << LEAF_COUNT_BITS) - 1;
+    static constexpr uint32_t BIN_COUNT = 16;
+    static constexpr uint32_t MAX_LEAF_SIZE = 4;
+    static constexpr uint32_t PARALLEL_BIN_THRESHOLD = 64 * 1024; // Ranges binned with parallelFor
+    static constexpr uint32_t PARALLEL_BIN_GRAIN = 16 * 1024;
+    static constexpr uint32_t SPAWN_THRESHOLD = 4096;            // Smaller subtrees stay on the calling job
+    static constexpr uint32_t STACK_SIZE = 256;
+    static constexpr float TRAVERSAL_COST = 1.0f;                 // Relative to one triangle test
+};
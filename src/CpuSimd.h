@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+// Thin SIMD wrappers for the CPU ray tracer. Float4 always has four lanes and
+// is used for the four child boxes of a BVH node; FloatPacket has one lane
+// per ray of a packet: eight with AVX2 (CPU_TRACER_AVX2), four with SSE, and
+// four emulated lanes on targets without SSE. Comparisons return lane masks
+// of the same type, all bits set where true.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CPU_SIMD_AVX2 1
+#define CPU_SIMD_SSE 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CPU_SIMD_SSE 1
+#endif
+
+namespace simd {
+
+#if defined(CPU_SIMD_SSE)
+
+struct Float4 {
+    __m128 v;
+
+    static constexpr uint32_t WIDTH = 4;
+    static Float4 load(const float* p) { return {_mm_loadu_ps(p)}; }
+    static Float4 broadcast(float x) { return {_mm_set1_ps(x)}; }
+    void store(float* p) const { _mm_storeu_ps(p, v); }
+    // Bit i set when lane i's mask is set
+    uint32_t bits() const { return static_cast<uint32_t>(_mm_movemask_ps(v)); }
+};
+
+inline Float4 operator+(Float4 a, Float4 b) { return {_mm_add_ps(a.v, b.v)}; }
+inline Float4 operator-(Float4 a, Float4 b) { return {_mm_sub_ps(a.v, b.v)}; }
+inline Float4 operator*(Float4 a, Float4 b) { return {_mm_mul_ps(a.v, b.v)}; }
+inline Float4 operator/(Float4 a, Float4 b) { return {_mm_div_ps(a.v, b.v)}; }
+inline Float4 operator&(Float4 a, Float4 b) { return {_mm_and_ps(a.v, b.v)}; }
+inline Float4 operator|(Float4 a, Float4 b) { return {_mm_or_ps(a.v, b.v)}; }
+inline Float4 operator<(Float4 a, Float4 b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+inline Float4 operator<=(Float4 a, Float4 b) { return {_mm_cmple_ps(a.v, b.v)}; }
+inline Float4 operator>(Float4 a, Float4 b) { return {_mm_cmpgt_ps(a.v, b.v)}; }
+inline Float4 operator>=(Float4 a, Float4 b) { return {_mm_cmpge_ps(a.v, b.v)}; }
+inline Float4 min(Float4 a, Float4 b) { return {_mm_min_ps(a.v, b.v)}; }
+inline Float4 max(Float4 a, Float4 b) { return {_mm_max_ps(a.v, b.v)}; }
+// mask ? a : b
+inline Float4 select(Float4 mask, Float4 a, Float4 b) {
+    return {_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v))};
+}
+
+#else
+
+namespace detail {
+
+inline float maskValue(bool set) {
+    uint32_t bits = set ? 0xFFFFFFFFu : 0u;
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+inline uint32_t maskBits(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+} // namespace detail
+
+struct Float4 {
+    float v[4];
+
+    static constexpr uint32_t WIDTH = 4;
+    static Float4 load(const float* p) { return {{p[0], p[1], p[2], p[3]}}; }
+    static Float4 broadcast(float x) { return {{x, x, x, x}}; }
+    void store(float* p) const {
+        for (uint32_t i = 0; i < WIDTH; ++i) {
+            p[i] = v[i];
+        }
+    }
+    uint32_t bits() const {
+        uint32_t result = 0;
+        for (uint32_t i = 0; i < WIDTH; ++i) {
+            result |= (detail::maskBits(v[i]) >> 31) << i;
+        }
+        return result;
+    }
+};
+
+namespace detail {
+
+template <typename Op>
+Float4 lanes(Float4 a, Float4 b, Op op) {
+    Float4 result;
+    for (uint32_t i = 0; i < Float4::WIDTH; ++i) {
+        result.v[i] = op(a.v[i], b.v[i]);
+    }
+    return result;
+}
+
+} // namespace detail
+
+inline Float4 operator+(Float4 a, Float4 b) { return detail::lanes(a, b, [](float x, float y) { return x + y; }); }
+inline Float4 operator-(Float4 a, Float4 b) { return detail::lanes(a, b, [](float x, float y) { return x - y; }); }
+inline Float4 operator*(Float4 a, Float4 b) { return detail::lanes(a, b, [](float x, float y) { return x * y; }); }
+inline Float4 operator/(Float4 a, Float4 b) { return detail::lanes(a, b, [](float x, float y) { return x / y; }); }
+inline Float4 operator&(Float4 a, Float4 b) {
+    return detail::lanes(a, b, [](float x, float y) { return detail::maskValue((detail::maskBits(x) & detail::maskBits(y)) != 0); });
+}
+inline Float4 operator|(Float4 a, Float4 b) {
+    return detail::lanes(a, b, [](float x, float y) { return detail::maskValue((detail::maskBits(x) | detail::maskBits(y)) != 0); });
+}
+inline Float4 operator<(Float4 a, Float4 b) { return detail::lanes(a, b, [](float x, float y) { return detail::maskValue(x < y); }); }
+inline Float4 operator<=(Float4 a, Float4 b) { return detail::lanes(a, b, [](float x, float y) { return detail::maskValue(x <= y); }); }
+inline Float4 operator>(Float4 a, Float4 b) { return detail::lanes(a, b, [](float x, float y) { return detail::maskValue(x > y); }); }
+inline Float4 operator>=(Float4 a, Float4 b) { return detail::lanes(a, b, [](float x, float y) { return detail::maskValue(x >= y); }); }
+inline Float4 min(Float4 a, Float4 b) { return detail::lanes(a, b, [](float x, float y) { return y < x ? y : x; }); }
+inline Float4 max(Float4 a, Float4 b) { return detail::lanes(a, b, [](float x, float y) { return y > x ? y : x; }); }
+inline Float4 select(Float4 mask, Float4 a, Float4 b) {
+    Float4 result;
+    for (uint32_t i = 0; i < Float4::WIDTH; ++i) {
+        result.v[i] = detail::maskBits(mask.v[i]) != 0 ? a.v[i] : b.v[i];
+    }
+    return result;
+}
+
+#endif
+
+#if defined(CPU_SIMD_AVX2)
+
+struct Float8 {
+    __m256 v;
+
+    static constexpr uint32_t WIDTH = 8;
+    static Float8 load(const float* p) { return {_mm256_loadu_ps(p)}; }
+    static Float8 broadcast(float x) { return {_mm256_set1_ps(x)}; }
+    void store(float* p) const { _mm256_storeu_ps(p, v); }
+    uint32_t bits() const { return static_cast<uint32_t>(_mm256_movemask_ps(v)); }
+};
+
+inline Float8 operator+(Float8 a, Float8 b) { return {_mm256_add_ps(a.v, b.v)}; }
+inline Float8 operator-(Float8 a, Float8 b) { return {_mm256_sub_ps(a.v, b.v)}; }
+inline Float8 operator*(Float8 a, Float8 b) { return {_mm256_mul_ps(a.v, b.v)}; }
+inline Float8 operator/(Float8 a, Float8 b) { return {_mm256_div_ps(a.v, b.v)}; }
+inline Float8 operator&(Float8 a, Float8 b) { return {_mm256_and_ps(a.v, b.v)}; }
+inline Float8 operator|(Float8 a, Float8 b) { return {_mm256_or_ps(a.v, b.v)}; }
+inline Float8 operator<(Float8 a, Float8 b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)}; }
+inline Float8 operator<=(Float8 a, Float8 b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)}; }
+inline Float8 operator>(Float8 a, Float8 b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)}; }
+inline Float8 operator>=(Float8 a, Float8 b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ)}; }
+inline Float8 min(Float8 a, Float8 b) { return {_mm256_min_ps(a.v, b.v)}; }
+inline Float8 max(Float8 a, Float8 b) { return {_mm256_max_ps(a.v, b.v)}; }
+inline Float8 select(Float8 mask, Float8 a, Float8 b) { return {_mm256_blendv_ps(b.v, a.v, mask.v)}; }
+
+using FloatPacket = Float8;
+
+#else
+
+using FloatPacket = Float4;
+
+#endif
+
+template <typename T>
+inline T abs(T a) { return max(a, T::broadcast(0.0f) - a); }
+
+} // namespace simd
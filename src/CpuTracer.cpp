@@ -0,0 +1,352 @@
+#include "CpuTracer.h"
+#include "JobSystem.h"
+#include "Scene.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+
+namespace {
+
+// Volumetric fog of shading.glsl, marched in the same fixed steps
+glm::vec3 calculateVolumetricFog(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, float rayDistance) {
+    const glm::vec3 fogColor(0.1f, 0.05f, 0.2f); // Dark purple fog
+    const float fogDensity = 0.02f;
+    const float fogHeight = 20.0f;
+    const float stepSize = 2.0f;
+
+    glm::vec3 accumulatedFog(0.0f);
+    int steps = static_cast<int>(rayDistance / stepSize);
+    for (int i = 0; i < steps; i++) {
+        float t = static_cast<float>(i) * stepSize;
+        glm::vec3 samplePos = rayOrigin + rayDirection * t;
+
+        float heightFactor = std::exp(-std::max(0.0f, samplePos.y - fogHeight) * 0.1f);
+        float localDensity = fogDensity * heightFactor;
+        float noise = std::sin(samplePos.x * 0.1f) * std::cos(samplePos.z * 0.1f) * 0.5f + 0.5f;
+        localDensity *= (0.8f + noise * 0.4f);
+
+        float fogAmount = 1.0f - std::exp(-localDensity * stepSize);
+        accumulatedFog += fogColor * fogAmount * (1.0f - glm::length(accumulatedFog));
+    }
+    return accumulatedFog;
+}
+
+glm::vec2 computeMotionVector(const CpuTraceFrame& frame, const glm::vec3& worldPos) {
+    glm::vec4 currentClip = frame.viewProjection * glm::vec4(worldPos, 1.0f);
+    glm::vec4 previousClip = frame.prevViewProjection * glm::vec4(worldPos, 1.0f);
+    glm::vec2 currentUV = glm::vec2(currentClip) / currentClip.w * 0.5f + 0.5f;
+    glm::vec2 previousUV = glm::vec2(previousClip) / previousClip.w * 0.5f + 0.5f;
+    return currentUV - previousUV;
+}
+
+} // namespace
+
+void CpuTracer::build(std::vector<GLTFVertex> vertices, std::vector<uint32_t> indices, std::vector<CpuTracerMesh> meshes, JobSystem* jobs) {
+    m_vertices = std::move(vertices);
+    m_indices = std::move(indices);
+    m_meshes = std::move(meshes);
+
+    m_triangleMeshes.assign(m_indices.size() / 3, CpuHit::NONE);
+    std::vector<uint32_t> triangles;
+    for (uint32_t mesh = 0; mesh < m_meshes.size(); ++mesh) {
+        uint32_t first = m_meshes[mesh].material.firstIndex / 3;
+        uint32_t count = m_meshes[mesh].indexCount / 3;
+        for (uint32_t triangle = first; triangle < first + count && triangle < m_triangleMeshes.size(); ++triangle) {
+            m_triangleMeshes[triangle] = mesh;
+            triangles.push_back(triangle);
+        }
+    }
+    updateNormalMatrices();
+    std::vector<GLTFVertex> placed = placeVertices();
+    m_bvh.build(placed.empty() ? m_vertices : placed, m_indices, triangles, jobs);
+}
+
+void CpuTracer::syncTransforms(const SceneTransforms& transforms, JobSystem* jobs) {
+    if (transforms.version == m_transformVersion) {
+        return;
+    }
+    m_transformVersion = transforms.version;
+
+    bool moved = false;
+    for (CpuTracerMesh& mesh : m_meshes) {
+        if (mesh.sceneMesh < transforms.meshWorlds.size() && mesh.transform != transforms.meshWorlds[mesh.sceneMesh]) {
+            mesh.transform = transforms.meshWorlds[mesh.sceneMesh];
+            moved = true;
+        }
+    }
+    if (moved) {
+        updateNormalMatrices();
+        std::vector<GLTFVertex> placed = placeVertices();
+        m_bvh.refit(placed.empty() ? m_vertices : placed, m_indices, jobs);
+    }
+}
+
+// Meshes own disjoint vertex ranges, so each vertex is placed by the mesh of
+// any triangle that references it
+std::vector<GLTFVertex> CpuTracer::placeVertices() const {
+    bool identity = std::all_of(m_meshes.begin(), m_meshes.end(),
+                                [](const CpuTracerMesh& mesh) { return mesh.transform == glm::mat4(1.0f); });
+    if (identity) {
+        return {};
+    }
+
+    std::vector<GLTFVertex> placed = m_vertices;
+    for (const CpuTracerMesh& mesh : m_meshes) {
+        uint32_t first = mesh.material.firstIndex;
+        uint32_t last = std::min<uint32_t>(first + mesh.indexCount, static_cast<uint32_t>(m_indices.size()));
+        for (uint32_t i = first; i < last; ++i) {
+            uint32_t vertex = m_indices[i];
+            placed[vertex].position = glm::vec3(mesh.transform * glm::vec4(m_vertices[vertex].position, 1.0f));
+        }
+    }
+    return placed;
+}
+
+void CpuTracer::updateNormalMatrices() {
+    m_normalMatrices.resize(m_meshes.size());
+    for (size_t i = 0; i < m_meshes.size(); ++i) {
+        m_normalMatrices[i] = glm::transpose(glm::inverse(glm::mat3(m_meshes[i].transform)));
+    }
+}
+
+void CpuTracer::render(const CpuTraceFrame& frame, uint32_t width, uint32_t height, JobSystem* jobs) {
+    auto start = std::chrono::steady_clock::now();
+    m_width = width;
+    m_height = height;
+    m_color.resize(static_cast<size_t>(width) * height);
+    m_motion.resize(static_cast<size_t>(width) * height);
+
+    uint32_t tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    uint32_t tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    std::atomic<uint64_t> secondaryRays{0};
+    std::atomic<uint64_t> shadowRays{0};
+    parallelFor(jobs, tilesX * tilesY, 1, [&](uint32_t begin, uint32_t end) {
+        RayCounts counts;
+        for (uint32_t tile = begin; tile < end; ++tile) {
+            renderTile(frame, tile % tilesX, tile / tilesX, counts);
+        }
+        secondaryRays.fetch_add(counts.secondary, std::memory_order_relaxed);
+        shadowRays.fetch_add(counts.shadow, std::memory_order_relaxed);
+    });
+
+    m_stats.primaryRays = static_cast<uint64_t>(width) * height;
+    m_stats.secondaryRays = secondaryRays.load();
+    m_stats.shadowRays = shadowRays.load();
+    m_stats.renderMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void CpuTracer::renderTile(const CpuTraceFrame& frame, uint32_t tileX, uint32_t tileY, RayCounts& counts) {
+    constexpr uint32_t WIDTH = CpuRayPacket::WIDTH;
+    uint32_t x0 = tileX * TILE_SIZE;
+    uint32_t y0 = tileY * TILE_SIZE;
+    uint32_t x1 = std::min(x0 + TILE_SIZE, m_width);
+    uint32_t y1 = std::min(y0 + TILE_SIZE, m_height);
+
+    for (uint32_t y = y0; y < y1; ++y) {
+        for (uint32_t x = x0; x < x1; x += WIDTH) {
+            uint32_t lanes = std::min(WIDTH, x1 - x);
+            glm::vec3 origins[WIDTH];
+            glm::vec3 directions[WIDTH];
+            CpuHit hits[WIDTH];
+            for (uint32_t lane = 0; lane < lanes; ++lane) {
+                computeCameraRay(frame, x + lane, y, origins[lane], directions[lane]);
+            }
+
+            if (m_packetsEnabled) {
+                CpuRayPacket packet;
+                for (uint32_t lane = 0; lane < lanes; ++lane) {
+                    packet.originX[lane] = origins[lane].x;
+                    packet.originY[lane] = origins[lane].y;
+                    packet.originZ[lane] = origins[lane].z;
+                    packet.directionX[lane] = directions[lane].x;
+                    packet.directionY[lane] = directions[lane].y;
+                    packet.directionZ[lane] = directions[lane].z;
+                    packet.tMin[lane] = RAY_TMIN;
+                    packet.tMax[lane] = RAY_TMAX;
+                    packet.activeMask |= 1u << lane;
+                }
+                for (uint32_t lane = lanes; lane < WIDTH; ++lane) {
+                    packet.originX[lane] = packet.originY[lane] = packet.originZ[lane] = 0.0f;
+                    packet.directionX[lane] = packet.directionY[lane] = packet.directionZ[lane] = 1.0f;
+                }
+                CpuPacketHit packetHit;
+                m_bvh.intersect(packet, packetHit);
+                for (uint32_t lane = 0; lane < lanes; ++lane) {
+                    hits[lane] = {packet.tMax[lane], packetHit.u[lane], packetHit.v[lane], packetHit.triangle[lane]};
+                }
+            } else {
+                for (uint32_t lane = 0; lane < lanes; ++lane) {
+                    m_bvh.intersect(CpuRay{origins[lane], directions[lane], RAY_TMIN, RAY_TMAX}, hits[lane]);
+                }
+            }
+
+            for (uint32_t lane = 0; lane < lanes; ++lane) {
+                glm::vec3 primaryPosition;
+                glm::vec3 color = tracePath(frame, origins[lane], directions[lane], hits[lane], primaryPosition, counts);
+                size_t pixel = static_cast<size_t>(y) * m_width + x + lane;
+                m_color[pixel] = glm::vec4(color, 1.0f);
+                m_motion[pixel] = computeMotionVector(frame, primaryPosition);
+            }
+        }
+    }
+}
+
+glm::vec3 CpuTracer::tracePath(const CpuTraceFrame& frame, glm::vec3 origin, glm::vec3 direction, CpuHit hit,
+                               glm::vec3& primaryPosition, RayCounts& counts) const {
+    glm::vec3 accumulatedColor(0.0f);
+    float accumulatedAttenuation = 1.0f;
+    primaryPosition = origin + direction * RAY_TMAX;
+
+    for (int bounce = 0; bounce < MAX_BOUNCES; bounce++) {
+        if (bounce > 0) {
+            m_bvh.intersect(CpuRay{origin, direction, RAY_TMIN, RAY_TMAX}, hit);
+            ++counts.secondary;
+        }
+        if (hit.triangle == CpuHit::NONE) {
+            accumulatedColor += shadeMiss(frame, origin, direction) * accumulatedAttenuation;
+            break;
+        }
+
+        glm::vec3 worldPos = origin + direction * hit.t;
+        if (bounce == 0) {
+            primaryPosition = worldPos;
+        }
+        Surface surface = sampleSurface(hit, direction);
+        accumulatedColor += shadeHit(frame, origin, direction, hit.t, surface, worldPos, counts) * accumulatedAttenuation;
+
+        // Reflections weighted by the material; matte and emissive surfaces end the path
+        accumulatedAttenuation *= surface.reflectivity;
+        if (accumulatedAttenuation < MIN_PATH_WEIGHT) {
+            break;
+        }
+        origin = worldPos + surface.normal * 0.001f;
+        direction = glm::reflect(direction, surface.normal);
+    }
+    return accumulatedColor;
+}
+
+CpuTracer::Surface CpuTracer::sampleSurface(const CpuHit& hit, const glm::vec3& direction) const {
+    uint32_t mesh = m_triangleMeshes[hit.triangle];
+    const MaterialRecord& material = m_meshes[mesh].material;
+    const glm::mat3& normalMatrix = m_normalMatrices[mesh];
+    const GLTFVertex& v0 = m_vertices[m_indices[hit.triangle * 3 + 0]];
+    const GLTFVertex& v1 = m_vertices[m_indices[hit.triangle * 3 + 1]];
+    const GLTFVertex& v2 = m_vertices[m_indices[hit.triangle * 3 + 2]];
+    glm::vec3 barycentrics(1.0f - hit.u - hit.v, hit.u, hit.v);
+
+    Surface surface{};
+    switch (static_cast<MaterialType>(material.materialType)) {
+    case MaterialType::Emissive:
+        surface.albedo = glm::vec3(0.0f);
+        surface.normal = -direction;
+        surface.emission = glm::vec3(material.emission);
+        surface.reflectivity = 0.0f;
+        break;
+    case MaterialType::Glass: {
+        glm::vec3 normal = glm::normalize(normalMatrix * glm::cross(v1.position - v0.position, v2.position - v0.position));
+        normal = glm::faceforward(normal, direction, normal);
+        float cosTheta = glm::clamp(glm::dot(-direction, normal), 0.0f, 1.0f);
+        float fresnel = material.reflectivity + (1.0f - material.reflectivity) * std::pow(1.0f - cosTheta, 5.0f);
+        surface.albedo = glm::vec3(material.baseColor) * GLASS_TINT_STRENGTH * (1.0f - fresnel);
+        surface.normal = normal;
+        surface.emission = glm::vec3(0.0f);
+        surface.reflectivity = fresnel;
+        break;
+    }
+    case MaterialType::Metallic:
+    case MaterialType::Rough: {
+        bool metallic = static_cast<MaterialType>(material.materialType) == MaterialType::Metallic;
+        glm::vec3 color = v0.color * barycentrics.x + v1.color * barycentrics.y + v2.color * barycentrics.z;
+        surface.albedo = metallic ? glm::vec3(material.baseColor) : color * glm::vec3(material.baseColor);
+        surface.normal = glm::normalize(normalMatrix * (v0.normal * barycentrics.x + v1.normal * barycentrics.y + v2.normal * barycentrics.z));
+        surface.emission = glm::vec3(0.0f);
+        surface.reflectivity = material.reflectivity;
+        break;
+    }
+    }
+    return surface;
+}
+
+glm::vec3 CpuTracer::shadeHit(const CpuTraceFrame& frame, const glm::vec3& rayOrigin, const glm::vec3& rayDirection, float hitDistance,
+                              const Surface& surface, const glm::vec3& hitPos, RayCounts& counts) const {
+    glm::vec3 finalColor = surface.emission + surface.albedo * frame.ambientLight;
+
+    glm::vec3 lightContribution[MAX_LIGHTS];
+    glm::vec3 lightDirection[MAX_LIGHTS];
+    float lightDistance[MAX_LIGHTS];
+    float lightWeight[MAX_LIGHTS];
+
+    int lightCount = std::min(frame.lightCount, MAX_LIGHTS);
+    glm::vec3 viewDir = glm::normalize(frame.cameraPos - hitPos);
+    for (int i = 0; i < lightCount; i++) {
+        glm::vec3 toLight = glm::vec3(frame.lightPositions[i]) - hitPos;
+        lightDistance[i] = glm::length(toLight);
+        lightDirection[i] = toLight / lightDistance[i];
+        float attenuation = 1.0f / (1.0f + 0.1f * lightDistance[i] + 0.01f * lightDistance[i] * lightDistance[i]);
+
+        float NdotL = glm::dot(surface.normal, lightDirection[i]);
+        if (NdotL <= 0.0f) {
+            lightContribution[i] = glm::vec3(0.0f);
+            lightWeight[i] = 0.0f;
+            continue;
+        }
+
+        glm::vec3 lightColor = glm::vec3(frame.lightColors[i]) * frame.lightColors[i].a;
+        glm::vec3 diffuse = surface.albedo * lightColor * NdotL * attenuation;
+        glm::vec3 reflectDir = glm::reflect(-lightDirection[i], surface.normal);
+        float spec = std::pow(std::max(glm::dot(viewDir, reflectDir), 0.0f), 32.0f);
+        glm::vec3 specular = lightColor * spec * attenuation * 0.5f;
+
+        lightContribution[i] = diffuse + specular;
+        lightWeight[i] = glm::dot(lightContribution[i], glm::vec3(0.2126f, 0.7152f, 0.0722f));
+    }
+
+    // Shadow rays to the strongest lights only, as in shading.glsl
+    uint32_t shadowRays = frame.shadows ? frame.maxShadowLights : 0u;
+    glm::vec3 shadowOrigin = hitPos + surface.normal * SHADOW_BIAS;
+    for (uint32_t ray = 0; ray < shadowRays; ray++) {
+        int strongest = -1;
+        float strongestWeight = SHADOW_MIN_CONTRIBUTION;
+        for (int i = 0; i < lightCount; i++) {
+            if (lightWeight[i] > strongestWeight) {
+                strongest = i;
+                strongestWeight = lightWeight[i];
+            }
+        }
+        if (strongest < 0) {
+            break;
+        }
+
+        ++counts.shadow;
+        if (m_bvh.occluded(CpuRay{shadowOrigin, lightDirection[strongest], RAY_TMIN, lightDistance[strongest] - SHADOW_BIAS})) {
+            lightContribution[strongest] = glm::vec3(0.0f);
+        }
+        lightWeight[strongest] = 0.0f;
+    }
+
+    for (int i = 0; i < lightCount; i++) {
+        finalColor += lightContribution[i];
+    }
+
+    glm::vec3 fog = calculateVolumetricFog(rayOrigin, rayDirection, hitDistance);
+    return glm::mix(finalColor, fog, 0.3f);
+}
+
+glm::vec3 CpuTracer::shadeMiss(const CpuTraceFrame& frame, const glm::vec3& rayOrigin, const glm::vec3& rayDirection) const {
+    glm::vec3 skyColor = glm::vec3(0.05f, 0.1f, 0.2f) + glm::vec3(0.1f, 0.05f, 0.3f) * std::sin(frame.time * 0.5f);
+    glm::vec3 distantFog = calculateVolumetricFog(rayOrigin, rayDirection, 1000.0f);
+    return glm::mix(skyColor, distantFog, 0.5f);
+}
+
+void CpuTracer::computeCameraRay(const CpuTraceFrame& frame, uint32_t x, uint32_t y, glm::vec3& origin, glm::vec3& direction) const {
+    glm::vec2 pixelCenter = glm::vec2(static_cast<float>(x), static_cast<float>(y)) + glm::vec2(0.5f);
+    glm::vec2 uv = pixelCenter / glm::vec2(static_cast<float>(m_width), static_cast<float>(m_height));
+    glm::vec2 d = uv * 2.0f - 1.0f;
+
+    glm::vec4 viewDir = frame.projInverse * glm::vec4(d, 1.0f, 1.0f);
+    viewDir /= viewDir.w;
+
+    origin = frame.cameraPos;
+    direction = glm::normalize(glm::vec3(frame.viewInverse * glm::vec4(glm::vec3(viewDir), 0.0f)));
+}
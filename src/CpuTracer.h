@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "CpuBvh.h"
+#include "GLTFLoader.h"
+#include "Material.h"
+
+class JobSystem;
+struct SceneTransforms;
+
+// A scene mesh as seen by the CPU tracer; material.firstIndex locates it in
+// the index buffer, like RayTracedMesh. Its vertices are in mesh space and
+// placed by transform, the sceneMesh entry of SceneTransforms::meshWorlds.
+struct CpuTracerMesh {
+    uint32_t indexCount = 0;
+    MaterialRecord material{};
+    uint32_t sceneMesh = 0;
+    glm::mat4 transform{1.0f};
+};
+
+// Everything the shaders read from the camera and lighting UBOs and the trace
+// push constants
+struct CpuTraceFrame {
+    glm::mat4 viewInverse{1.0f};
+    glm::mat4 projInverse{1.0f};
+    glm::mat4 viewProjection{1.0f};     // Unjittered, for motion vectors
+    glm::mat4 prevViewProjection{1.0f}; // Unjittered, previous frame
+    glm::vec3 cameraPos{0.0f};
+    glm::vec4 lightPositions[4] = {};   // xyz used
+    glm::vec4 lightColors[4] = {};      // rgb color, a intensity
+    int lightCount = 0;
+    glm::vec3 ambientLight{0.0f};
+    bool shadows = true;
+    uint32_t maxShadowLights = 2;
+    float time = 0.0f;
+};
+
+struct CpuTracerStats {
+    uint64_t primaryRays = 0;
+    uint64_t secondaryRays = 0; // Reflections
+    uint64_t shadowRays = 0;
+    double renderMs = 0.0;
+};
+
+// Software implementation of the ray traced backends: shades exactly like
+// ray_gen.rgen and the closest hit shaders, with CpuBvh standing in for the
+// acceleration structures. The frame is split into tiles rendered in
+// parallel; primary rays of a tile row are traced as packets, reflection and
+// shadow rays one at a time. Serves as a GPU-free renderer, a reference image
+// for the Vulkan backends and a ray throughput benchmark.
+class CpuTracer {
+public:
+    // Takes copies so the build can run in the background while the caller's
+    // geometry changes or is released
+    void build(std::vector<GLTFVertex> vertices, std::vector<uint32_t> indices, std::vector<CpuTracerMesh> meshes, JobSystem* jobs);
+    // Follows the scene graph: when a mesh's world matrix changed, the BVH is
+    // refitted around the moved triangles. Returns at once for a version that
+    // was already applied.
+    void syncTransforms(const SceneTransforms& transforms, JobSystem* jobs);
+    // Writes linear radiance and motion (current minus previous UV) for every
+    // pixel, rows top to bottom like the HDR and motion images
+    void render(const CpuTraceFrame& frame, uint32_t width, uint32_t height, JobSystem* jobs);
+
+    // Traces primary rays one at a time instead of in packets; same image
+    void setPacketsEnabled(bool enabled) { m_packetsEnabled = enabled; }
+    bool arePacketsEnabled() const { return m_packetsEnabled; }
+
+    const std::vector<glm::vec4>& getColor() const { return m_color; }
+    const std::vector<glm::vec2>& getMotion() const { return m_motion; }
+    uint32_t getWidth() const { return m_width; }
+    uint32_t getHeight() const { return m_height; }
+    const CpuBvh& getBvh() const { return m_bvh; }
+    const CpuTracerStats& getStats() const { return m_stats; }
+
+    static constexpr uint32_t TILE_SIZE = 16;
+
+private:
+    struct Surface {
+        glm::vec3 albedo;
+        glm::vec3 normal;
+        glm::vec3 emission;
+        float reflectivity;
+    };
+
+    struct RayCounts {
+        uint64_t secondary = 0;
+        uint64_t shadow = 0;
+    };
+
+    void renderTile(const CpuTraceFrame& frame, uint32_t tileX, uint32_t tileY, RayCounts& counts);
+    // The traceRay loop of ray_gen.rgen, starting from an already traced primary hit
+    glm::vec3 tracePath(const CpuTraceFrame& frame, glm::vec3 origin, glm::vec3 direction, CpuHit hit,
+                        glm::vec3& primaryPosition, RayCounts& counts) const;
+    Surface sampleSurface(const CpuHit& hit, const glm::vec3& direction) const;
+    glm::vec3 shadeHit(const CpuTraceFrame& frame, const glm::vec3& rayOrigin, const glm::vec3& rayDirection, float hitDistance,
+                       const Surface& surface, const glm::vec3& hitPos, RayCounts& counts) const;
+    glm::vec3 shadeMiss(const CpuTraceFrame& frame, const glm::vec3& rayOrigin, const glm::vec3& rayDirection) const;
+    void computeCameraRay(const CpuTraceFrame& frame, uint32_t x, uint32_t y, glm::vec3& origin, glm::vec3& direction) const;
+    // World-space copy of m_vertices' positions for building or refitting the
+    // BVH; empty when every mesh transform is identity
+    std::vector<GLTFVertex> placeVertices() const;
+    void updateNormalMatrices();
+
+    std::vector<GLTFVertex> m_vertices; // Mesh space
+    std::vector<uint32_t> m_indices;
+    std::vector<CpuTracerMesh> m_meshes;
+    std::vector<glm::mat3> m_normalMatrices; // Mesh to world space normals, per mesh
+    std::vector<uint32_t> m_triangleMeshes; // Mesh of every triangle of m_indices
+    uint64_t m_transformVersion = 0;
+    CpuBvh m_bvh;
+
+    std::vector<glm::vec4> m_color;
+    std::vector<glm::vec2> m_motion;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    bool m_packetsEnabled = true;
+    CpuTracerStats m_stats;
+
+    // Mirrors the constants in shaders/shading.glsl and material.glsl
+    static constexpr int MAX_LIGHTS = 4;
+    static constexpr int MAX_BOUNCES = 2;
+    static constexpr float RAY_TMIN = 0.001f;
+    static constexpr float RAY_TMAX = 10000.0f;
+    static constexpr float MIN_PATH_WEIGHT = 0.01f;
+    static constexpr float SHADOW_BIAS = 0.01f;
+    static constexpr float SHADOW_MIN_CONTRIBUTION = 0.002f;
+    static constexpr float GLASS_TINT_STRENGTH = 0.2f;
+};
@@ -0,0 +1,99 @@
+#include "FramePacer.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <thread>
+
+FramePacer::FramePacer(double targetFps)
+    : m_targetFps(0.0)
+    , m_targetFrameTime(Clock::duration::zero())
+    , m_hasLastFrame(false) {
+    m_frameTimesMs.reserve(MAX_SAMPLES);
+    setTargetFps(targetFps);
+}
+
+void FramePacer::setTargetFps(double targetFps) {
+    m_targetFps = targetFps > 0.0 ? targetFps : 0.0;
+    if (isUncapped()) {
+        m_targetFrameTime = Clock::duration::zero();
+    } else {
+        m_targetFrameTime = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / m_targetFps));
+    }
+    reset();
+}
+
+void FramePacer::reset() {
+    m_nextDeadline = Clock::now() + m_targetFrameTime;
+    m_hasLastFrame = false;
+    resetStats();
+}
+
+void FramePacer::waitForNextFrame() {
+    if (!isUncapped()) {
+        auto now = Clock::now();
+
+        // Sleep away the bulk of the remaining time; the OS may overshoot by
+        // a scheduler quantum, so stop short and spin for the remainder.
+        if (m_nextDeadline - now > SPIN_THRESHOLD) {
+            std::this_thread::sleep_for(m_nextDeadline - now - SPIN_THRESHOLD);
+        }
+        while (Clock::now() < m_nextDeadline) {
+            std::this_thread::yield();
+        }
+
+        // Advance by whole frames so small overshoots are absorbed by the next
+        // frame instead of accumulating; resync if we fell more than a frame behind.
+        m_nextDeadline += m_targetFrameTime;
+        now = Clock::now();
+        if (now > m_nextDeadline) {
+            m_nextDeadline = now + m_targetFrameTime;
+        }
+    }
+
+    recordFrame(Clock::now());
+}
+
+void FramePacer::recordFrame(Clock::time_point now) {
+    if (m_hasLastFrame) {
+        double frameMs = std::chrono::duration<double, std::milli>(now - m_lastFrameEnd).count();
+        if (m_frameTimesMs.size() < MAX_SAMPLES) {
+            m_frameTimesMs.push_back(frameMs);
+        }
+    }
+    m_lastFrameEnd = now;
+    m_hasLastFrame = true;
+}
+
+FrameTimingStats FramePacer::getStats() const {
+    FrameTimingStats stats{};
+    if (m_frameTimesMs.empty()) {
+        return stats;
+    }
+
+    stats.frameCount = static_cast<uint32_t>(m_frameTimesMs.size());
+    double total = std::accumulate(m_frameTimesMs.begin(), m_frameTimesMs.end(), 0.0);
+    stats.averageMs = total / stats.frameCount;
+    stats.averageFps = stats.averageMs > 0.0 ? 1000.0 / stats.averageMs : 0.0;
+
+    auto [minIt, maxIt] = std::minmax_element(m_frameTimesMs.begin(), m_frameTimesMs.end());
+    stats.minMs = *minIt;
+    stats.maxMs = *maxIt;
+
+    double variance = 0.0;
+    for (double frameMs : m_frameTimesMs) {
+        double delta = frameMs - stats.averageMs;
+        variance += delta * delta;
+    }
+    stats.jitterMs = std::sqrt(variance / stats.frameCount);
+
+    std::vector<double> sorted = m_frameTimesMs;
+    size_t p99Index = std::min(sorted.size() - 1, static_cast<size_t>(std::ceil(sorted.size() * 0.99)) - 1);
+    std::nth_element(sorted.begin(), sorted.begin() + p99Index, sorted.end());
+    stats.p99Ms = sorted[p99Index];
+
+    return stats;
+}
+
+void FramePacer::resetStats() {
+    m_frameTimesMs.clear();
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+struct FrameTimingStats {
+    uint32_t frameCount = 0;
+    double averageMs = 0.0;
+    double minMs = 0.0;
+    double maxMs = 0.0;
+    double p99Ms = 0.0;
+    double jitterMs = 0.0; // Standard deviation of the frame-to-frame interval
+    double averageFps = 0.0;
+};
+
+// Paces the main loop toward a target frame time. Coarse waiting is done with
+// sleep_for, the last SPIN_THRESHOLD of every frame is spun so the deadline is
+// hit with sub-millisecond precision regardless of the OS timer resolution.
+class FramePacer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit FramePacer(double targetFps = 60.0);
+
+    // A target of zero (or less) disables the limiter entirely.
+    void setTargetFps(double targetFps);
+    double getTargetFps() const { return m_targetFps; }
+    bool isUncapped() const { return m_targetFps <= 0.0; }
+
+    // Call once per frame after presenting. Blocks until the next frame
+    // deadline (unless uncapped) and records the achieved frame interval.
+    void waitForNextFrame();
+
+    // Drops the current deadline and sample window, e.g. after a long stall
+    // such as loading or switching benchmark phases.
+    void reset();
+
+    FrameTimingStats getStats() const;
+    void resetStats();
+
+private:
+    void recordFrame(Clock::time_point now);
+
+    double m_targetFps;
+    Clock::duration m_targetFrameTime;
+    Clock::time_point m_nextDeadline;
+    Clock::time_point m_lastFrameEnd;
+    bool m_hasLastFrame;
+
+    std::vector<double> m_frameTimesMs;
+
+    static constexpr auto SPIN_THRESHOLD = std::chrono::microseconds(2000);
+    static constexpr size_t MAX_SAMPLES = 16384;
+};
@@ -1,12 +1,15 @@
 #include "GLTFLoader.h"
+#include "JobSystem.h"
+#include <algorithm>
 #include <iostream>
+#include <limits>
 #include <fstream>
 #include <cstring>
 
 // Simple glTF loader implementation
 // This is a simplified version that handles basic geometry and materials
 
-bool GLTFLoader::loadModel(const std::string& filepath, GLTFModel& model) {
+bool GLTFLoader::loadModel(const std::string& filepath, GLTFModel& model, JobSystem* jobs) {
     std::ifstream file(filepath, std::ios::binary);
     if (!file.is_open()) {
         std::cerr << "Failed to open glTF file: " << filepath << std::endl;
@@ -17,41 +20,75 @@ bool GLTFLoader::loadModel(const std::string& filepath, GLTFModel& model) {
     // In a full implementation, you would parse the glTF binary format
     std::cout << "Loading glTF model: " << filepath << std::endl;
     
-    // Create a simple test mesh representing the city
-    GLTFMesh cityMesh;
-    cityMesh.name = "CyberpunkCity";
-    cityMesh.baseColor = glm::vec3(0.1f, 0.1f, 0.2f);
-    cityMesh.metallic = 0.2f;
-    cityMesh.roughness = 0.8f;
-    cityMesh.hasEmission = false;
-    cityMesh.transform = glm::mat4(1.0f);
-    
     // Create a simple city representation
     // This is a placeholder - in a real implementation, you would parse the actual glTF data
-    createSimpleCityMesh(cityMesh);
+    createSimpleCityMeshes(model);
     
-    model.meshes.push_back(cityMesh);
     model.name = "CyberpunkCity";
-    model.minBounds = glm::vec3(-50.0f, -1.0f, -50.0f);
-    model.maxBounds = glm::vec3(50.0f, 30.0f, 50.0f);
+    computeBounds(model, jobs);
     
     std::cout << "Loaded " << model.meshes.size() << " meshes from " << filepath << std::endl;
     return true;
 }
 
-void GLTFLoader::createSimpleCityMesh(GLTFMesh& mesh) {
+void GLTFLoader::computeBounds(GLTFModel& model, JobSystem* jobs) {
+    // One job per mesh, reduced serially so the result does not depend on scheduling
+    std::vector<glm::vec3> meshMin(model.meshes.size(), glm::vec3(std::numeric_limits<float>::max()));
+    std::vector<glm::vec3> meshMax(model.meshes.size(), glm::vec3(std::numeric_limits<float>::lowest()));
+    parallelFor(jobs, static_cast<uint32_t>(model.meshes.size()), 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            for (const GLTFVertex& vertex : model.meshes[i].vertices) {
+                glm::vec3 position = glm::vec3(model.meshes[i].transform * glm::vec4(vertex.position, 1.0f));
+                meshMin[i] = glm::min(meshMin[i], position);
+                meshMax[i] = glm::max(meshMax[i], position);
+            }
+        }
+    });
+
+    model.minBounds = glm::vec3(std::numeric_limits<float>::max());
+    model.maxBounds = glm::vec3(std::numeric_limits<float>::lowest());
+    for (size_t i = 0; i < model.meshes.size(); ++i) {
+        model.minBounds = glm::min(model.minBounds, meshMin[i]);
+        model.maxBounds = glm::max(model.maxBounds, meshMax[i]);
+    }
+}
+
+void GLTFLoader::createSimpleCityMeshes(GLTFModel& model) {
     // Create a simple city representation
-    // This is a placeholder for the actual glTF parsing
+    // This is a placeholder for the actual glTF parsing. One mesh per
+    // material, so every material gets its own ray tracing hit group.
     
-    // Ground plane - make it more visible
-    mesh.vertices.push_back({{-50.0f, -1.0f, -50.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}, {0.3f, 0.3f, 0.5f}});
-    mesh.vertices.push_back({{ 50.0f, -1.0f, -50.0f}, {0.0f, 1.0f, 0.0f}, {1.0f, 0.0f}, {0.3f, 0.3f, 0.5f}});
-    mesh.vertices.push_back({{ 50.0f, -1.0f,  50.0f}, {0.0f, 1.0f, 0.0f}, {1.0f, 1.0f}, {0.3f, 0.3f, 0.5f}});
-    mesh.vertices.push_back({{-50.0f, -1.0f,  50.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 1.0f}, {0.3f, 0.3f, 0.5f}});
+    // Ground plane - wet, reflective asphalt
+    GLTFMesh ground;
+    ground.name = "Ground";
+    ground.baseColor = glm::vec3(0.3f, 0.3f, 0.5f);
+    ground.metallic = 0.8f;
+    ground.roughness = 0.3f;
+    ground.hasEmission = false;
+    
+    ground.vertices.push_back({{-50.0f, 0.0f, -50.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}, {0.3f, 0.3f, 0.5f}});
+    ground.vertices.push_back({{ 50.0f, 0.0f, -50.0f}, {0.0f, 1.0f, 0.0f}, {1.0f, 0.0f}, {0.3f, 0.3f, 0.5f}});
+    ground.vertices.push_back({{ 50.0f, 0.0f,  50.0f}, {0.0f, 1.0f, 0.0f}, {1.0f, 1.0f}, {0.3f, 0.3f, 0.5f}});
+    ground.vertices.push_back({{-50.0f, 0.0f,  50.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 1.0f}, {0.3f, 0.3f, 0.5f}});
     
     // Ground indices
-    mesh.indices.push_back(0); mesh.indices.push_back(1); mesh.indices.push_back(2);
-    mesh.indices.push_back(2); mesh.indices.push_back(3); mesh.indices.push_back(0);
+    ground.indices.push_back(0); ground.indices.push_back(1); ground.indices.push_back(2);
+    ground.indices.push_back(2); ground.indices.push_back(3); ground.indices.push_back(0);
+    
+    GLTFMesh buildings;
+    buildings.name = "Buildings";
+    buildings.baseColor = glm::vec3(1.0f);
+    buildings.metallic = 0.0f;
+    buildings.roughness = 0.8f;
+    buildings.hasEmission = false;
+    
+    GLTFMesh glassTowers;
+    glassTowers.name = "GlassTowers";
+    glassTowers.baseColor = glm::vec3(0.2f, 0.6f, 0.9f);
+    glassTowers.metallic = 0.0f;
+    glassTowers.roughness = 0.05f;
+    glassTowers.transmission = 1.0f;
+    glassTowers.hasEmission = false;
     
     // Create some simple buildings - make them larger and more visible
     for (int i = 0; i < 20; ++i) {
@@ -59,19 +96,44 @@ void GLTFLoader::createSimpleCityMesh(GLTFMesh& mesh) {
         float z = (i / 5 - 2) * 15.0f;
         float height = 10.0f + (i % 3) * 15.0f; // Make buildings taller
         
-        createBuilding(mesh, glm::vec3(x, 0.0f, z), glm::vec3(8.0f, height, 8.0f), // Make buildings wider
+        // Every fourth tower is glass
+        createBuilding(i % 4 == 3 ? glassTowers : buildings,
+                      glm::vec3(x, 0.0f, z), glm::vec3(8.0f, height, 8.0f), // Make buildings wider
                       glm::vec3(0.8f, 0.2f, 0.8f)); // Make them bright magenta for visibility
     }
     
     // Add some neon elements
+    GLTFMesh neon;
+    neon.name = "NeonStrips";
+    neon.baseColor = glm::vec3(1.0f, 0.2f, 0.8f);
+    neon.metallic = 0.0f;
+    neon.roughness = 0.5f;
+    neon.hasEmission = true;
+    neon.emissionColor = glm::vec3(1.0f, 0.2f, 0.8f);
+    neon.emissionStrength = 4.0f;
+    
     for (int i = 0; i < 10; ++i) {
         float x = (i % 5 - 2) * 15.0f;
         float z = (i / 5 - 2) * 15.0f;
         float height = 8.0f + (i % 3) * 5.0f;
         
-        createNeonStrip(mesh, glm::vec3(x, height, z), glm::vec3(6.0f, 0.2f, 0.2f),
+        createNeonStrip(neon, glm::vec3(x, height, z), glm::vec3(6.0f, 0.2f, 0.2f),
                        glm::vec3(1.0f, 0.2f, 0.8f));
     }
+    
+    // Laid out as a glTF scene would be: a root node with one child per
+    // mesh. The ground is authored at the origin and placed by its node.
+    std::vector<GLTFMesh> meshes = {ground, buildings, glassTowers, neon};
+    std::vector<GLTFNode> nodes(meshes.size() + 1);
+    nodes[0].name = "City";
+    for (uint32_t i = 0; i < meshes.size(); ++i) {
+        nodes[0].children.push_back(i + 1);
+        nodes[i + 1].name = meshes[i].name;
+        nodes[i + 1].mesh = static_cast<int>(i);
+    }
+    nodes[1].translation = glm::vec3(0.0f, -1.0f, 0.0f);
+    
+    processNode(nodes[0], nodes, meshes, glm::mat4(1.0f), model);
 }
 
 void GLTFLoader::createBuilding(GLTFMesh& mesh, const glm::vec3& position, const glm::vec3& size, const glm::vec3& color) {
@@ -170,11 +232,20 @@ void GLTFLoader::createNeonStrip(GLTFMesh& mesh, const glm::vec3& position, cons
     }
 }
 
-// Placeholder implementations for the interface methods
-void GLTFLoader::processNode(const void* node, const void* scene, GLTFModel& model) {
-    // Placeholder - would parse actual glTF node data
+void GLTFLoader::processNode(const GLTFNode& node, const std::vector<GLTFNode>& nodes, const std::vector<GLTFMesh>& meshes,
+                             const glm::mat4& parentTransform, GLTFModel& model) {
+    glm::mat4 world = parentTransform * getNodeTransform(node);
+    if (node.mesh >= 0) {
+        GLTFMesh mesh = meshes.at(static_cast<size_t>(node.mesh));
+        mesh.transform = world;
+        model.meshes.push_back(std::move(mesh));
+    }
+    for (uint32_t child : node.children) {
+        processNode(nodes.at(child), nodes, meshes, world, model);
+    }
 }
 
+// Placeholder implementations for the interface methods
 GLTFMesh GLTFLoader::processMesh(const void* mesh, const void* scene) {
     GLTFMesh result;
     // Placeholder - would parse actual glTF mesh data
@@ -187,8 +258,17 @@ GLTFVertex GLTFLoader::processVertex(const void* vertex, const void* accessor) {
     return result;
 }
 
-glm::mat4 GLTFLoader::getNodeTransform(const void* node) {
-    return glm::mat4(1.0f);
+// A node carries either a full matrix or TRS components, applied as T * R * S
+glm::mat4 GLTFLoader::getNodeTransform(const GLTFNode& node) {
+    if (node.hasMatrix) {
+        return node.matrix;
+    }
+    glm::mat4 transform = glm::mat4_cast(glm::normalize(node.rotation));
+    transform[0] *= node.scale.x;
+    transform[1] *= node.scale.y;
+    transform[2] *= node.scale.z;
+    transform[3] = glm::vec4(node.translation, 1.0f);
+    return transform;
 }
 
 glm::vec3 GLTFLoader::getVec3FromAccessor(const void* accessor, size_t index) {
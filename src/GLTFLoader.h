@@ -1,10 +1,14 @@
 #pragma once
 
+#include <cstddef>
 #include <vector>
 #include <string>
 #include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include <vulkan/vulkan.h>
 
+class JobSystem;
+
 struct GLTFVertex {
     glm::vec3 position;
     glm::vec3 normal;
@@ -15,19 +19,38 @@ struct GLTFVertex {
     static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
 };
 
+// Shaders that fetch vertices themselves read them as the std430 Vertex in
+// shaders/vertex_layout.glsl; GLM's aligned vec3 gives GLTFVertex that layout
+static_assert(sizeof(GLTFVertex) == 64, "GLTFVertex must match Vertex in vertex_layout.glsl");
+static_assert(offsetof(GLTFVertex, normal) == 16 && offsetof(GLTFVertex, texCoord) == 32 && offsetof(GLTFVertex, color) == 48,
+              "GLTFVertex must match Vertex in vertex_layout.glsl");
+
 struct GLTFMesh {
     std::vector<GLTFVertex> vertices;
     std::vector<uint32_t> indices;
-    glm::mat4 transform;
+    glm::mat4 transform{1.0f}; // Mesh space to world, seeds the mesh's scene graph node
     std::string name;
     glm::vec3 baseColor;
     float metallic;
     float roughness;
+    float transmission = 0.0f; // > 0 selects the glass material
     bool hasEmission;
     glm::vec3 emissionColor;
     float emissionStrength;
 };
 
+// A glTF node: either a matrix or translation/rotation/scale, as in the spec
+struct GLTFNode {
+    std::string name;
+    bool hasMatrix = false;
+    glm::mat4 matrix{1.0f};
+    glm::vec3 translation{0.0f};
+    glm::quat rotation{1.0f, 0.0f, 0.0f, 0.0f};
+    glm::vec3 scale{1.0f};
+    int mesh = -1; // Index into the mesh table, -1 for pure transform nodes
+    std::vector<uint32_t> children;
+};
+
 struct GLTFModel {
     std::vector<GLTFMesh> meshes;
     glm::vec3 minBounds;
@@ -37,18 +60,23 @@ struct GLTFModel {
 
 class GLTFLoader {
 public:
-    static bool loadModel(const std::string& filepath, GLTFModel& model);
+    // Per-mesh post-processing runs on jobs when given
+    static bool loadModel(const std::string& filepath, GLTFModel& model, JobSystem* jobs = nullptr);
     
 private:
-    static void processNode(const void* node, const void* scene, GLTFModel& model);
+    // Composes the node's local transform onto its parent's and emits a
+    // copy of its mesh with the resulting world matrix, then recurses
+    static void processNode(const GLTFNode& node, const std::vector<GLTFNode>& nodes, const std::vector<GLTFMesh>& meshes,
+                            const glm::mat4& parentTransform, GLTFModel& model);
     static GLTFMesh processMesh(const void* mesh, const void* scene);
     static GLTFVertex processVertex(const void* vertex, const void* accessor);
-    static glm::mat4 getNodeTransform(const void* node);
+    static glm::mat4 getNodeTransform(const GLTFNode& node);
     static glm::vec3 getVec3FromAccessor(const void* accessor, size_t index);
     static glm::vec2 getVec2FromAccessor(const void* accessor, size_t index);
     
     // Helper functions for creating simple geometry
-    static void createSimpleCityMesh(GLTFMesh& mesh);
+    static void computeBounds(GLTFModel& model, JobSystem* jobs);
+    static void createSimpleCityMeshes(GLTFModel& model);
     static void createBuilding(GLTFMesh& mesh, const glm::vec3& position, const glm::vec3& size, const glm::vec3& color);
     static void createNeonStrip(GLTFMesh& mesh, const glm::vec3& position, const glm::vec3& size, const glm::vec3& color);
 };
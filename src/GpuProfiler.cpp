@@ -0,0 +1,157 @@
+#include "GpuProfiler.h"
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+GpuProfiler::GpuProfiler(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamilyIndex, uint32_t framesInFlight)
+    : m_device(device)
+    , m_queryPool(VK_NULL_HANDLE)
+    , m_timestampPeriodNs(0.0)
+    , m_timestampMask(0)
+    , m_frameSlot(0)
+    , m_nextQuery(0)
+    , m_frameScopes(framesInFlight) {
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+    uint32_t validBits = queueFamilyIndex < queueFamilyCount ? queueFamilies[queueFamilyIndex].timestampValidBits : 0;
+    if (validBits == 0 || properties.limits.timestampPeriod <= 0.0f) {
+        std::cout << "[Profiler] Timestamp queries unsupported on this queue, GPU timings disabled" << std::endl;
+        return;
+    }
+
+    m_timestampPeriodNs = properties.limits.timestampPeriod;
+    m_timestampMask = validBits >= 64 ? ~0ull : ((1ull << validBits) - 1);
+
+    VkQueryPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = QUERIES_PER_FRAME * framesInFlight;
+
+    if (vkCreateQueryPool(m_device, &poolInfo, nullptr, &m_queryPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create timestamp query pool!");
+    }
+}
+
+GpuProfiler::~GpuProfiler() {
+    if (m_queryPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(m_device, m_queryPool, nullptr);
+    }
+}
+
+void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t frameSlot) {
+    if (!isSupported()) {
+        return;
+    }
+
+    collect(frameSlot);
+
+    m_frameSlot = frameSlot;
+    m_nextQuery = 0;
+    m_openScopes.clear();
+    vkCmdResetQueryPool(commandBuffer, m_queryPool, frameSlot * QUERIES_PER_FRAME, QUERIES_PER_FRAME);
+}
+
+void GpuProfiler::beginScope(VkCommandBuffer commandBuffer, const char* name) {
+    if (!isSupported()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_scopeMutex);
+    if (m_nextQuery + 2 > QUERIES_PER_FRAME) {
+        return;
+    }
+    uint32_t base = m_frameSlot * QUERIES_PER_FRAME;
+    auto& scopes = m_frameScopes[m_frameSlot];
+    scopes.push_back({name, base + m_nextQuery, base + m_nextQuery + 1});
+    m_openScopes.push_back({commandBuffer, scopes.size() - 1});
+    m_nextQuery += 2;
+
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_queryPool, scopes.back().beginQuery);
+}
+
+void GpuProfiler::endScope(VkCommandBuffer commandBuffer) {
+    if (!isSupported()) {
+        return;
+    }
+
+    // Closes the innermost scope opened on this command buffer
+    std::lock_guard<std::mutex> lock(m_scopeMutex);
+    auto open = std::find_if(m_openScopes.rbegin(), m_openScopes.rend(), [commandBuffer](const auto& entry) {
+        return entry.first == commandBuffer;
+    });
+    if (open == m_openScopes.rend()) {
+        return;
+    }
+    const Scope& scope = m_frameScopes[m_frameSlot][open->second];
+    m_openScopes.erase(std::next(open).base());
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_queryPool, scope.endQuery);
+}
+
+void GpuProfiler::collect(uint32_t frameSlot) {
+    auto& scopes = m_frameScopes[frameSlot];
+    if (scopes.empty()) {
+        return;
+    }
+
+    // The slot's fence has signalled, so every query written by it is
+    // available. Queries are handed out in pairs, so only read the used prefix.
+    uint32_t queryCount = static_cast<uint32_t>(scopes.size()) * 2;
+    std::vector<uint64_t> timestamps(queryCount);
+    VkResult result = vkGetQueryPoolResults(m_device, m_queryPool,
+                                            frameSlot * QUERIES_PER_FRAME, queryCount,
+                                            timestamps.size() * sizeof(uint64_t), timestamps.data(),
+                                            sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (result == VK_SUCCESS) {
+        uint32_t base = frameSlot * QUERIES_PER_FRAME;
+        for (const Scope& scope : scopes) {
+            uint64_t begin = timestamps[scope.beginQuery - base] & m_timestampMask;
+            uint64_t end = timestamps[scope.endQuery - base] & m_timestampMask;
+            double ms = static_cast<double>((end - begin) & m_timestampMask) * m_timestampPeriodNs * 1e-6;
+
+            auto it = std::find_if(m_accumulators.begin(), m_accumulators.end(), [&](const Accumulator& acc) {
+                return acc.name == scope.name;
+            });
+            if (it == m_accumulators.end()) {
+                m_accumulators.push_back({scope.name, ms, 1});
+            } else {
+                it->totalMs += ms;
+                ++it->count;
+            }
+        }
+    }
+
+    scopes.clear();
+}
+
+std::vector<GpuScopeStats> GpuProfiler::getStats() const {
+    std::vector<GpuScopeStats> stats;
+    for (const Accumulator& acc : m_accumulators) {
+        if (acc.count > 0) {
+            stats.push_back({acc.name, acc.totalMs / acc.count, acc.count});
+        }
+    }
+    return stats;
+}
+
+double GpuProfiler::getAverageMs(const std::string& name) const {
+    for (const Accumulator& acc : m_accumulators) {
+        if (acc.name == name && acc.count > 0) {
+            return acc.totalMs / acc.count;
+        }
+    }
+    return 0.0;
+}
+
+void GpuProfiler::resetStats() {
+    for (Accumulator& acc : m_accumulators) {
+        acc.totalMs = 0.0;
+        acc.count = 0;
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+struct GpuScopeStats {
+    std::string name;
+    double averageMs = 0.0;
+    uint32_t sampleCount = 0;
+};
+
+// Timestamp-query profiler for named GPU scopes. Each frame in flight owns a
+// slice of the query pool; results are read back when that frame slot comes
+// around again, after its fence has been waited on, so reading never stalls.
+class GpuProfiler {
+public:
+    GpuProfiler(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamilyIndex, uint32_t framesInFlight);
+    ~GpuProfiler();
+
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    bool isSupported() const { return m_queryPool != VK_NULL_HANDLE; }
+
+    // Must be recorded outside a render pass, before any scope of the frame.
+    void beginFrame(VkCommandBuffer commandBuffer, uint32_t frameSlot);
+
+    // Scopes may nest within a command buffer; the name must outlive the
+    // frame (string literals). Command buffers of the frame may record
+    // scopes from several threads at once.
+    void beginScope(VkCommandBuffer commandBuffer, const char* name);
+    void endScope(VkCommandBuffer commandBuffer);
+
+    // Averages since the last resetStats(), in first-seen order.
+    std::vector<GpuScopeStats> getStats() const;
+    double getAverageMs(const std::string& name) const;
+    void resetStats();
+
+private:
+    struct Scope {
+        const char* name;
+        uint32_t beginQuery;
+        uint32_t endQuery;
+    };
+
+    struct Accumulator {
+        std::string name;
+        double totalMs;
+        uint32_t count;
+    };
+
+    void collect(uint32_t frameSlot);
+
+    VkDevice m_device;
+    VkQueryPool m_queryPool;
+    double m_timestampPeriodNs;
+    uint64_t m_timestampMask;
+
+    uint32_t m_frameSlot;
+    uint32_t m_nextQuery;
+    std::vector<std::vector<Scope>> m_frameScopes;
+    std::vector<std::pair<VkCommandBuffer, size_t>> m_openScopes; // Command buffer, index into the frame's scopes
+    std::mutex m_scopeMutex;
+    std::vector<Accumulator> m_accumulators;
+
+    static constexpr uint32_t MAX_SCOPES_PER_FRAME = 16;
+    static constexpr uint32_t QUERIES_PER_FRAME = MAX_SCOPES_PER_FRAME * 2;
+};
@@ -0,0 +1,449 @@
+#include "JobSystem.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+struct Job {
+    std::function<void()> function;
+    JobCounter* counter = nullptr;
+};
+
+namespace {
+
+// Worker index of the current thread within t_owner, -1 outside any job system
+thread_local const JobSystem* t_owner = nullptr;
+thread_local int32_t t_workerIndex = -1;
+// Job system whose background threads include the current thread
+thread_local const JobSystem* t_backgroundOwner = nullptr;
+
+// Per-thread xorshift state for picking steal victims
+thread_local uint32_t t_randomState = 0x9e3779b9u;
+
+uint32_t nextRandom() {
+    uint32_t x = t_randomState;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    t_randomState = x;
+    return x;
+}
+
+} // namespace
+
+bool JobCounter::isDone() const {
+    return m_pending.load(std::memory_order_acquire) == 0 && m_finishing.load(std::memory_order_acquire) == 0;
+}
+
+WorkStealingDeque::WorkStealingDeque() {
+    for (auto& slot : m_jobs) {
+        slot.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+bool WorkStealingDeque::push(Job* job) {
+    int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+    int64_t top = m_top.load(std::memory_order_acquire);
+    if (bottom - top >= CAPACITY) {
+        return false;
+    }
+    m_jobs[bottom & (CAPACITY - 1)].store(job, std::memory_order_relaxed);
+    m_bottom.store(bottom + 1, std::memory_order_release);
+    return true;
+}
+
+Job* WorkStealingDeque::pop() {
+    int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+    m_bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = m_top.load(std::memory_order_relaxed);
+
+    if (top > bottom) {
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    Job* job = m_jobs[bottom & (CAPACITY - 1)].load(std::memory_order_relaxed);
+    if (top == bottom) {
+        // Last job, race the thieves for it
+        if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            job = nullptr;
+        }
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+Job* WorkStealingDeque::steal() {
+    int64_t top = m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t bottom = m_bottom.load(std::memory_order_acquire);
+    if (top >= bottom) {
+        return nullptr;
+    }
+    Job* job = m_jobs[top & (CAPACITY - 1)].load(std::memory_order_relaxed);
+    if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    return job;
+}
+
+JobSystem::JobSystem(uint32_t workerCount, bool pinThreads)
+    : m_pinThreads(pinThreads) {
+    if (workerCount == 0) {
+        workerCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    m_deques.reserve(workerCount);
+    for (uint32_t i = 0; i < workerCount; ++i) {
+        m_deques.push_back(std::make_unique<WorkStealingDeque>());
+    }
+
+    t_owner = this;
+    t_workerIndex = 0;
+    if (m_pinThreads) {
+        pinCurrentThread(0);
+    }
+
+    m_threads.reserve(workerCount - 1);
+    for (uint32_t i = 1; i < workerCount; ++i) {
+        m_threads.emplace_back([this, i]() { workerLoop(i); });
+    }
+
+    // As many as the other workers, so a deferred compile can spread as
+    // wide as before; they sleep on the condition while there is no work
+    uint32_t backgroundCount = std::max(1u, workerCount - 1);
+    m_backgroundThreads.reserve(backgroundCount);
+    for (uint32_t i = 0; i < backgroundCount; ++i) {
+        m_backgroundThreads.emplace_back([this]() { backgroundLoop(); });
+    }
+}
+
+JobSystem::~JobSystem() {
+    // Background jobs may still need the workers, so they finish first. The
+    // queue is drained because a running job may be waiting on queued ones.
+    {
+        std::lock_guard<std::mutex> lock(m_backgroundMutex);
+        m_backgroundRunning = false;
+    }
+    m_backgroundCondition.notify_all();
+    for (std::thread& thread : m_backgroundThreads) {
+        thread.join();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_running.store(false, std::memory_order_release);
+    }
+    m_wakeCondition.notify_all();
+    for (std::thread& thread : m_threads) {
+        thread.join();
+    }
+
+    // Jobs nobody waited on are dropped
+    for (auto& deque : m_deques) {
+        while (Job* job = deque->pop()) {
+            delete job;
+        }
+    }
+    for (Job* job : m_sharedQueue) {
+        delete job;
+    }
+
+    if (t_owner == this) {
+        t_owner = nullptr;
+        t_workerIndex = -1;
+    }
+}
+
+void JobSystem::spawn(std::function<void()> function, JobCounter* counter) {
+    if (counter) {
+        counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+    }
+    enqueue(new Job{std::move(function), counter});
+}
+
+void JobSystem::spawnBackground(std::function<void()> function, JobCounter* counter) {
+    if (counter) {
+        counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_backgroundMutex);
+        m_backgroundQueue.push_back(new Job{std::move(function), counter});
+    }
+    m_backgroundCondition.notify_one();
+}
+
+void JobSystem::runAfter(JobCounter& dependency, std::function<void()> function, JobCounter* counter) {
+    if (counter) {
+        counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+    }
+    Job* job = new Job{std::move(function), counter};
+    {
+        // finish() drops the count to zero under the same lock, so the
+        // continuation is either queued before that or spawned right here
+        std::lock_guard<std::mutex> lock(dependency.m_mutex);
+        if (dependency.m_pending.load(std::memory_order_acquire) != 0) {
+            dependency.m_continuations.push_back(job);
+            return;
+        }
+    }
+    enqueue(job);
+}
+
+void JobSystem::wait(JobCounter& counter) {
+    int32_t workerIndex = getCurrentWorkerIndex();
+    uint32_t idleSpins = 0;
+    while (!counter.isDone()) {
+        // Other threads only help with the jobs they could have spawned
+        // themselves, never with a worker's deque. Background threads also
+        // take background jobs, so one can wait on others without every
+        // background thread ending up blocked.
+        Job* job = nullptr;
+        if (workerIndex >= 0) {
+            job = findJob(static_cast<uint32_t>(workerIndex));
+        } else {
+            job = takeSharedJob();
+            if (!job && t_backgroundOwner == this) {
+                job = takeBackgroundJob();
+            }
+        }
+        if (job) {
+            execute(job);
+            idleSpins = 0;
+        } else if (++idleSpins > IDLE_SPINS) {
+            std::this_thread::yield();
+        }
+    }
+
+    std::exception_ptr exception;
+    {
+        std::lock_guard<std::mutex> lock(counter.m_mutex);
+        exception.swap(counter.m_exception);
+    }
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+}
+
+void JobSystem::parallelFor(uint32_t count, uint32_t grain, const std::function<void(uint32_t, uint32_t)>& body) {
+    if (count == 0) {
+        return;
+    }
+    grain = std::max(1u, grain);
+    if (count <= grain || getWorkerCount() == 1) {
+        body(0, count);
+        return;
+    }
+
+    // The calling thread takes the first range itself
+    JobCounter counter;
+    for (uint32_t begin = grain; begin < count; begin += grain) {
+        uint32_t end = std::min(count, begin + grain);
+        spawn([&body, begin, end]() { body(begin, end); }, &counter);
+    }
+    try {
+        body(0, grain);
+    } catch (...) {
+        // The spawned ranges still reference body and counter
+        try {
+            wait(counter);
+        } catch (...) {
+        }
+        throw;
+    }
+    wait(counter);
+}
+
+void JobSystem::workerLoop(uint32_t workerIndex) {
+    t_owner = this;
+    t_workerIndex = static_cast<int32_t>(workerIndex);
+    t_randomState ^= workerIndex * 0x85ebca6bu;
+    if (m_pinThreads) {
+        pinCurrentThread(workerIndex);
+    }
+
+    uint32_t idleSpins = 0;
+    while (m_running.load(std::memory_order_acquire)) {
+        if (Job* job = findJob(workerIndex)) {
+            execute(job);
+            idleSpins = 0;
+            continue;
+        }
+        if (++idleSpins < IDLE_SPINS) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // The timeout covers a push that races past the sleeper count check
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_sleepingWorkers.fetch_add(1, std::memory_order_seq_cst);
+        if (m_running.load(std::memory_order_acquire)) {
+            m_wakeCondition.wait_for(lock, std::chrono::milliseconds(SLEEP_TIMEOUT_MS));
+        }
+        m_sleepingWorkers.fetch_sub(1, std::memory_order_relaxed);
+        idleSpins = 0;
+    }
+}
+
+// Background threads are not workers: jobs they spawn go to the shared
+// queue and their waits only take jobs from there
+void JobSystem::backgroundLoop() {
+    t_backgroundOwner = this;
+    for (;;) {
+        Job* job = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(m_backgroundMutex);
+            m_backgroundCondition.wait(lock, [this]() { return !m_backgroundQueue.empty() || !m_backgroundRunning; });
+            if (m_backgroundQueue.empty()) {
+                return;
+            }
+            job = m_backgroundQueue.front();
+            m_backgroundQueue.pop_front();
+        }
+        execute(job);
+    }
+}
+
+void JobSystem::enqueue(Job* job) {
+    int32_t workerIndex = getCurrentWorkerIndex();
+    if (workerIndex >= 0) {
+        if (!m_deques[workerIndex]->push(job)) {
+            // Deque full, running inline keeps the owner making progress
+            execute(job);
+            return;
+        }
+    } else {
+        std::lock_guard<std::mutex> lock(m_sharedMutex);
+        m_sharedQueue.push_back(job);
+    }
+
+    if (m_sleepingWorkers.load(std::memory_order_seq_cst) > 0) {
+        m_wakeCondition.notify_one();
+    }
+}
+
+Job* JobSystem::findJob(uint32_t workerIndex) {
+    const uint32_t workerCount = getWorkerCount();
+    if (Job* job = m_deques[workerIndex]->pop()) {
+        return job;
+    }
+    if (Job* job = takeSharedJob()) {
+        return job;
+    }
+
+    // One pass over the other workers starting at a random victim
+    uint32_t start = nextRandom() % workerCount;
+    for (uint32_t i = 0; i < workerCount; ++i) {
+        uint32_t victim = (start + i) % workerCount;
+        if (victim == workerIndex) {
+            continue;
+        }
+        if (Job* job = m_deques[victim]->steal()) {
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+Job* JobSystem::takeSharedJob() {
+    std::lock_guard<std::mutex> lock(m_sharedMutex);
+    if (m_sharedQueue.empty()) {
+        return nullptr;
+    }
+    Job* job = m_sharedQueue.front();
+    m_sharedQueue.pop_front();
+    return job;
+}
+
+Job* JobSystem::takeBackgroundJob() {
+    std::lock_guard<std::mutex> lock(m_backgroundMutex);
+    if (m_backgroundQueue.empty()) {
+        return nullptr;
+    }
+    Job* job = m_backgroundQueue.front();
+    m_backgroundQueue.pop_front();
+    return job;
+}
+
+void JobSystem::execute(Job* job) {
+    JobCounter* counter = job->counter;
+    try {
+        job->function();
+    } catch (const std::exception& e) {
+        recordException(counter, e.what());
+    } catch (...) {
+        recordException(counter, "unknown exception");
+    }
+    delete job;
+    if (counter) {
+        finish(counter);
+    }
+}
+
+// Must be called from inside a catch block
+void JobSystem::recordException(JobCounter* counter, const char* what) {
+    // Without a counter nobody can observe the failure, and rethrowing would
+    // take down the worker
+    if (!counter) {
+        std::cerr << "[Jobs] Job without a counter failed: " << what << std::endl;
+        return;
+    }
+    std::lock_guard<std::mutex> lock(counter->m_mutex);
+    if (!counter->m_exception) {
+        counter->m_exception = std::current_exception();
+    }
+}
+
+void JobSystem::finish(JobCounter* counter) {
+    // Keeps wait() from returning, and the owner from destroying the counter,
+    // until the continuations have been taken
+    counter->m_finishing.fetch_add(1, std::memory_order_seq_cst);
+    std::vector<Job*> continuations;
+    {
+        std::lock_guard<std::mutex> lock(counter->m_mutex);
+        if (counter->m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            continuations.swap(counter->m_continuations);
+        }
+    }
+    counter->m_finishing.fetch_sub(1, std::memory_order_release);
+
+    for (Job* continuation : continuations) {
+        enqueue(continuation);
+    }
+}
+
+int32_t JobSystem::getCurrentWorkerIndex() const {
+    return t_owner == this ? t_workerIndex : -1;
+}
+
+void JobSystem::pinCurrentThread(uint32_t core) {
+    uint32_t coreCount = std::max(1u, std::thread::hardware_concurrency());
+    core %= coreCount;
+#if defined(_WIN32)
+    if (core < 64) {
+        SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << core);
+    }
+#elif defined(__linux__)
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(core, &cpuSet);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+#else
+    (void)core;
+#endif
+}
+
+void parallelFor(JobSystem* jobs, uint32_t count, uint32_t grain, const std::function<void(uint32_t, uint32_t)>& body) {
+    if (jobs) {
+        jobs->parallelFor(count, grain, body);
+    } else if (count > 0) {
+        body(0, count);
+    }
+}
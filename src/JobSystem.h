@@ -0,0 +1,137 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem;
+struct Job;
+
+// Number of spawned jobs that have not finished yet. Jobs spawned against a
+// counter can be waited on as a group and jobs queued with runAfter start once
+// it drops to zero. Must outlive the jobs it tracks and any wait on it. The
+// first exception thrown by one of its jobs is kept and rethrown by wait().
+class JobCounter {
+public:
+    JobCounter() = default;
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    bool isDone() const;
+
+private:
+    friend class JobSystem;
+
+    std::atomic<uint32_t> m_pending{0};
+    std::atomic<uint32_t> m_finishing{0}; // Workers still touching the counter after their decrement
+    std::mutex m_mutex;
+    std::vector<Job*> m_continuations;
+    std::exception_ptr m_exception;
+};
+
+// Fixed-capacity Chase-Lev deque: the owning worker pushes and pops at the
+// bottom without locking, other workers steal from the top with one CAS.
+class WorkStealingDeque {
+public:
+    static constexpr int64_t CAPACITY = 4096; // Power of two
+
+    WorkStealingDeque();
+
+    bool push(Job* job); // Owner only, false when full
+    Job* pop();          // Owner only
+    Job* steal();        // Any thread
+
+private:
+    alignas(64) std::atomic<int64_t> m_top{0};
+    alignas(64) std::atomic<int64_t> m_bottom{0};
+    std::array<std::atomic<Job*>, CAPACITY> m_jobs;
+};
+
+// Work-stealing job system shared by the loader, scene and renderer. The
+// thread that creates it becomes worker 0 and only executes jobs while it
+// waits; the other workers run jobs from their own deque, then the shared
+// queue of jobs spawned by non-worker threads, then steal from a random
+// worker, and sleep when everything is empty.
+// Long jobs go to separate background threads instead, so no worker, and no
+// frame waiting on its own jobs, ever picks one up.
+class JobSystem {
+public:
+    // workerCount includes the creating thread, 0 uses every hardware thread.
+    // With pinThreads each worker is bound to one core, the creating thread
+    // to core 0.
+    explicit JobSystem(uint32_t workerCount = 0, bool pinThreads = false);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    void spawn(std::function<void()> function, JobCounter* counter = nullptr);
+    // Runs function on a background thread. For jobs that take longer than
+    // a frame, such as pipeline compiles and BVH builds: they make progress
+    // with any number of workers and wait() never runs them inline. Poll the
+    // counter with isDone() to avoid blocking on it.
+    void spawnBackground(std::function<void()> function, JobCounter* counter = nullptr);
+    // Spawns function once dependency has no pending jobs left
+    void runAfter(JobCounter& dependency, std::function<void()> function, JobCounter* counter = nullptr);
+    // Executes other jobs until counter is done, then rethrows the first
+    // exception its jobs threw. Threads that are not workers only take jobs
+    // from the shared queue, and background jobs when they are background
+    // threads. A job spawned without a counter that throws is logged and
+    // dropped.
+    void wait(JobCounter& counter);
+
+    // Splits [0, count) into ranges of at most grain items, runs
+    // body(begin, end) on each and returns when all of them are done
+    void parallelFor(uint32_t count, uint32_t grain, const std::function<void(uint32_t, uint32_t)>& body);
+
+    uint32_t getWorkerCount() const { return static_cast<uint32_t>(m_deques.size()); }
+    uint32_t getBackgroundThreadCount() const { return static_cast<uint32_t>(m_backgroundThreads.size()); }
+    // Index of the calling thread among the workers, -1 for other threads.
+    // Lets callers keep per-worker state such as command pools.
+    int32_t getCurrentWorkerIndex() const;
+    bool isPinned() const { return m_pinThreads; }
+
+private:
+    void workerLoop(uint32_t workerIndex);
+    void backgroundLoop();
+    void enqueue(Job* job);
+    Job* findJob(uint32_t workerIndex);
+    Job* takeSharedJob();
+    Job* takeBackgroundJob();
+    void execute(Job* job);
+    void recordException(JobCounter* counter, const char* what);
+    void finish(JobCounter* counter);
+    static void pinCurrentThread(uint32_t core);
+
+    std::vector<std::unique_ptr<WorkStealingDeque>> m_deques; // One per worker, index 0 is the creating thread
+    std::vector<std::thread> m_threads;                      // Workers 1..n-1
+
+    std::mutex m_sharedMutex;
+    std::deque<Job*> m_sharedQueue; // Jobs spawned by non-worker threads
+
+    std::vector<std::thread> m_backgroundThreads;
+    std::mutex m_backgroundMutex;
+    std::condition_variable m_backgroundCondition;
+    std::deque<Job*> m_backgroundQueue;
+    bool m_backgroundRunning = true; // Guarded by m_backgroundMutex
+
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wakeCondition;
+    std::atomic<uint32_t> m_sleepingWorkers{0};
+    std::atomic<bool> m_running{true};
+    bool m_pinThreads;
+
+    static constexpr uint32_t IDLE_SPINS = 64;      // Failed searches before a worker sleeps
+    static constexpr uint32_t SLEEP_TIMEOUT_MS = 1; // Sleepers also wake on this interval
+};
+
+// Runs body serially when jobs is null so callers can keep the job system optional
+void parallelFor(JobSystem* jobs, uint32_t count, uint32_t grain, const std::function<void(uint32_t, uint32_t)>& body);
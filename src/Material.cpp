@@ -0,0 +1,60 @@
+#include "Material.h"
+#include <algorithm>
+
+namespace {
+
+// Reflectance of common dielectrics at normal incidence
+constexpr float DIELECTRIC_F0 = 0.04f;
+
+} // namespace
+
+MaterialType classifyMaterial(const GLTFMesh& mesh) {
+    if (mesh.hasEmission) {
+        return MaterialType::Emissive;
+    }
+    if (mesh.transmission > 0.0f) {
+        return MaterialType::Glass;
+    }
+    if (mesh.metallic >= 0.5f) {
+        return MaterialType::Metallic;
+    }
+    return MaterialType::Rough;
+}
+
+MaterialRecord makeMaterialRecord(const GLTFMesh& mesh, uint32_t firstIndex) {
+    MaterialType type = classifyMaterial(mesh);
+
+    MaterialRecord record{};
+    record.baseColor = glm::vec4(mesh.baseColor, 1.0f);
+    record.emission = mesh.hasEmission ? glm::vec4(mesh.emissionColor * mesh.emissionStrength, 1.0f) : glm::vec4(0.0f);
+    record.roughness = mesh.roughness;
+    record.firstIndex = firstIndex;
+    record.materialType = static_cast<uint32_t>(type);
+
+    // Glass evaluates Fresnel per hit and only needs F0; the other types get
+    // a fixed bounce weight that fades out as the surface gets rougher.
+    float smoothness = 1.0f - std::clamp(mesh.roughness, 0.0f, 1.0f);
+    switch (type) {
+    case MaterialType::Glass:
+        record.reflectivity = DIELECTRIC_F0;
+        break;
+    case MaterialType::Emissive:
+        record.reflectivity = 0.0f;
+        break;
+    default:
+        record.reflectivity = (DIELECTRIC_F0 + (1.0f - DIELECTRIC_F0) * mesh.metallic) * smoothness * smoothness;
+        break;
+    }
+
+    return record;
+}
+
+const char* materialTypeToString(MaterialType type) {
+    switch (type) {
+    case MaterialType::Rough: return "rough";
+    case MaterialType::Metallic: return "metallic";
+    case MaterialType::Emissive: return "emissive";
+    case MaterialType::Glass: return "glass";
+    }
+    return "unknown";
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "GLTFLoader.h"
+
+// Each material type has its own closest hit shader and SBT hit group, so the
+// hit shaders never branch on material. Values index the hit groups.
+enum class MaterialType : uint32_t {
+    Rough = 0,    // Dielectric with vertex colors (closest_hit.rchit)
+    Metallic = 1, // closest_hit_metallic.rchit
+    Emissive = 2, // closest_hit_emissive.rchit
+    Glass = 3     // closest_hit_glass.rchit
+};
+
+constexpr uint32_t MATERIAL_TYPE_COUNT = 4;
+
+// Inline data of an SBT hit record and entry of the ray query mesh info
+// buffer. Mirrors MaterialParams in shaders/material.glsl (std430).
+struct MaterialRecord {
+    glm::vec4 baseColor;
+    glm::vec4 emission;
+    float roughness;
+    float reflectivity;
+    uint32_t firstIndex;
+    uint32_t materialType;
+};
+
+static_assert(sizeof(MaterialRecord) == 48, "MaterialRecord must match the std430 layout of MaterialParams");
+
+MaterialType classifyMaterial(const GLTFMesh& mesh);
+MaterialRecord makeMaterialRecord(const GLTFMesh& mesh, uint32_t firstIndex);
+const char* materialTypeToString(MaterialType type);
@@ -0,0 +1,292 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+
+namespace {
+
+constexpr uint32_t NONE = ~0u;
+
+// Bits of a float with both zeros equal, so hashing agrees with ==
+uint32_t hashBits(float value) {
+    if (value == 0.0f) {
+        return 0;
+    }
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// GLTFVertex has padding after each vec3, so attributes are hashed and
+// compared one by one rather than as raw bytes
+struct VertexHash {
+    size_t operator()(const GLTFVertex& v) const {
+        const float values[] = {v.position.x, v.position.y, v.position.z, v.normal.x, v.normal.y, v.normal.z,
+                                v.texCoord.x, v.texCoord.y, v.color.x, v.color.y, v.color.z};
+        uint64_t hash = 14695981039346656037ull;
+        for (float value : values) {
+            hash = (hash ^ hashBits(value)) * 1099511628211ull;
+        }
+        return static_cast<size_t>(hash ^ (hash >> 32));
+    }
+};
+
+struct VertexEqual {
+    bool operator()(const GLTFVertex& a, const GLTFVertex& b) const {
+        return a.position == b.position && a.normal == b.normal && a.texCoord == b.texCoord && a.color == b.color;
+    }
+};
+
+// Points every index at the first vertex with the same attributes and
+// drops triangles that collapse. The vertex array itself is compacted
+// later by the fetch reordering.
+void weldVertices(const std::vector<GLTFVertex>& vertices, std::vector<uint32_t>& indices) {
+    std::unordered_map<GLTFVertex, uint32_t, VertexHash, VertexEqual> unique;
+    unique.reserve(vertices.size());
+    std::vector<uint32_t> remap(vertices.size());
+    for (uint32_t v = 0; v < vertices.size(); ++v) {
+        remap[v] = unique.emplace(vertices[v], v).first->second;
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        uint32_t a = remap[indices[i]];
+        uint32_t b = remap[indices[i + 1]];
+        uint32_t c = remap[indices[i + 2]];
+        if (a != b && b != c && c != a) {
+            indices[kept++] = a;
+            indices[kept++] = b;
+            indices[kept++] = c;
+        }
+    }
+    indices.resize(kept);
+}
+
+// Tipsify (Sander, Nehab and Barczak 2007): fans around one vertex at a
+// time, emitting all of its remaining triangles, then continues from the
+// vertex just emitted that will stay in the cache longest. When none of the
+// candidates has triangles left it restarts from the dead-end stack or the
+// next live vertex; clusterStarts records those restarts, in triangles.
+std::vector<uint32_t> orderForVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount,
+                                          std::vector<uint32_t>& clusterStarts) {
+    const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+    // Triangles around every vertex, as offsets into one array
+    std::vector<uint32_t> liveTriangles(vertexCount, 0);
+    for (uint32_t index : indices) {
+        ++liveTriangles[index];
+    }
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    std::partial_sum(liveTriangles.begin(), liveTriangles.end(), adjacencyOffsets.begin() + 1);
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (uint32_t t = 0; t < triangleCount; ++t) {
+        for (uint32_t k = 0; k < 3; ++k) {
+            adjacency[fill[indices[t * 3 + k]]++] = t;
+        }
+    }
+
+    std::vector<uint32_t> cacheTime(vertexCount, 0);
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    std::vector<uint32_t> deadEnd;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    deadEnd.reserve(indices.size());
+    clusterStarts.assign(1, 0);
+
+    uint32_t time = MESH_OPT_CACHE_SIZE + 1;
+    uint32_t cursor = 0;
+    uint32_t fan = vertexCount > 0 ? 0 : NONE;
+    while (fan != NONE) {
+        candidates.clear();
+        for (uint32_t a = adjacencyOffsets[fan]; a < adjacencyOffsets[fan + 1]; ++a) {
+            uint32_t t = adjacency[a];
+            if (emitted[t]) {
+                continue;
+            }
+            emitted[t] = 1;
+            for (uint32_t k = 0; k < 3; ++k) {
+                uint32_t v = indices[t * 3 + k];
+                output.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                --liveTriangles[v];
+                if (time - cacheTime[v] > MESH_OPT_CACHE_SIZE) {
+                    cacheTime[v] = time++;
+                }
+            }
+        }
+
+        // Prefer the candidate that entered the cache earliest but will
+        // still be in it after its remaining triangles are emitted
+        uint32_t next = NONE;
+        int bestPriority = -1;
+        for (uint32_t v : candidates) {
+            if (liveTriangles[v] == 0) {
+                continue;
+            }
+            int priority = 0;
+            if (time - cacheTime[v] + 2 * liveTriangles[v] <= MESH_OPT_CACHE_SIZE) {
+                priority = static_cast<int>(time - cacheTime[v]);
+            }
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                next = v;
+            }
+        }
+
+        if (next == NONE) {
+            while (!deadEnd.empty() && next == NONE) {
+                uint32_t v = deadEnd.back();
+                deadEnd.pop_back();
+                if (liveTriangles[v] > 0) {
+                    next = v;
+                }
+            }
+            while (next == NONE && cursor < vertexCount) {
+                if (liveTriangles[cursor] > 0) {
+                    next = cursor;
+                }
+                ++cursor;
+            }
+            if (next != NONE) {
+                clusterStarts.push_back(static_cast<uint32_t>(output.size() / 3));
+            }
+        }
+        fan = next;
+    }
+    return output;
+}
+
+// Sorts the clusters by how far they face away from the mesh centre, so the
+// outer surfaces, which hide the rest, are drawn first. A simplified form of
+// the linear-speed overdraw ordering that accompanies Tipsify.
+void orderForOverdraw(std::vector<uint32_t>& indices, const std::vector<GLTFVertex>& vertices,
+                      const std::vector<uint32_t>& clusterStarts) {
+    const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+    const uint32_t clusterCount = static_cast<uint32_t>(clusterStarts.size());
+    if (clusterCount < 2) {
+        return;
+    }
+
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    std::vector<glm::vec3> centroids(clusterCount, glm::vec3(0.0f));
+    std::vector<glm::vec3> normals(clusterCount, glm::vec3(0.0f));
+    std::vector<float> areas(clusterCount, 0.0f);
+    for (uint32_t c = 0; c < clusterCount; ++c) {
+        uint32_t end = c + 1 < clusterCount ? clusterStarts[c + 1] : triangleCount;
+        for (uint32_t t = clusterStarts[c]; t < end; ++t) {
+            const glm::vec3& p0 = vertices[indices[t * 3]].position;
+            const glm::vec3& p1 = vertices[indices[t * 3 + 1]].position;
+            const glm::vec3& p2 = vertices[indices[t * 3 + 2]].position;
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0); // Length is twice the area
+            float area = glm::length(normal) * 0.5f;
+            glm::vec3 centre = (p0 + p1 + p2) / 3.0f;
+            centroids[c] += centre * area;
+            normals[c] += normal;
+            areas[c] += area;
+        }
+        meshCentroid += centroids[c];
+        meshArea += areas[c];
+    }
+    if (meshArea <= 0.0f) {
+        return;
+    }
+    meshCentroid /= meshArea;
+
+    std::vector<float> outwardness(clusterCount, 0.0f);
+    for (uint32_t c = 0; c < clusterCount; ++c) {
+        float normalLength = glm::length(normals[c]);
+        if (areas[c] > 0.0f && normalLength > 0.0f) {
+            outwardness[c] = glm::dot(centroids[c] / areas[c] - meshCentroid, normals[c] / normalLength);
+        }
+    }
+
+    std::vector<uint32_t> order(clusterCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return outwardness[a] > outwardness[b]; });
+
+    std::vector<uint32_t> sorted;
+    sorted.reserve(indices.size());
+    for (uint32_t c : order) {
+        uint32_t end = c + 1 < clusterCount ? clusterStarts[c + 1] : triangleCount;
+        sorted.insert(sorted.end(), indices.begin() + clusterStarts[c] * 3, indices.begin() + end * 3);
+    }
+    indices.swap(sorted);
+}
+
+// Renumbers vertices in order of first use and drops unreferenced ones
+void orderForVertexFetch(std::vector<GLTFVertex>& vertices, std::vector<uint32_t>& indices) {
+    std::vector<uint32_t> remap(vertices.size(), NONE);
+    std::vector<GLTFVertex> ordered;
+    ordered.reserve(vertices.size());
+    for (uint32_t& index : indices) {
+        if (remap[index] == NONE) {
+            remap[index] = static_cast<uint32_t>(ordered.size());
+            ordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(ordered);
+}
+
+} // namespace
+
+const char* meshOptimizationToString(MeshOptimization mode) {
+    switch (mode) {
+        case MeshOptimization::Off: return "off";
+        case MeshOptimization::VertexCache: return "vertex cache";
+        case MeshOptimization::Overdraw: return "vertex cache + overdraw";
+    }
+    return "unknown";
+}
+
+void MeshOptimizationStats::add(const MeshOptimizationStats& other) {
+    verticesBefore += other.verticesBefore;
+    verticesAfter += other.verticesAfter;
+    trianglesBefore += other.trianglesBefore;
+    trianglesAfter += other.trianglesAfter;
+    cacheMissesBefore += other.cacheMissesBefore;
+    cacheMissesAfter += other.cacheMissesAfter;
+}
+
+uint64_t countCacheMisses(const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize) {
+    // A vertex is cached while fewer than cacheSize misses followed its own
+    std::vector<uint64_t> insertedAt(vertexCount, 0);
+    uint64_t misses = 0;
+    for (uint32_t i = 0; i < indexCount; ++i) {
+        uint64_t& stamp = insertedAt[indices[i]];
+        if (stamp == 0 || misses - stamp >= cacheSize) {
+            ++misses;
+            stamp = misses;
+        }
+    }
+    return misses;
+}
+
+MeshOptimizationStats optimizeMesh(std::vector<GLTFVertex>& vertices, std::vector<uint32_t>& indices, MeshOptimization mode) {
+    indices.resize(indices.size() / 3 * 3);
+    const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+
+    MeshOptimizationStats stats;
+    stats.verticesBefore = vertexCount;
+    stats.trianglesBefore = static_cast<uint32_t>(indices.size() / 3);
+    stats.cacheMissesBefore = countCacheMisses(indices.data(), static_cast<uint32_t>(indices.size()), vertexCount, MESH_OPT_CACHE_SIZE);
+    if (mode != MeshOptimization::Off && !indices.empty()) {
+        weldVertices(vertices, indices);
+        std::vector<uint32_t> clusterStarts;
+        indices = orderForVertexCache(indices, vertexCount, clusterStarts);
+        if (mode == MeshOptimization::Overdraw) {
+            orderForOverdraw(indices, vertices, clusterStarts);
+        }
+        orderForVertexFetch(vertices, indices);
+    }
+    stats.verticesAfter = static_cast<uint32_t>(vertices.size());
+    stats.trianglesAfter = static_cast<uint32_t>(indices.size() / 3);
+    stats.cacheMissesAfter = countCacheMisses(indices.data(), static_cast<uint32_t>(indices.size()),
+                                              stats.verticesAfter, MESH_OPT_CACHE_SIZE);
+    return stats;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "GLTFLoader.h"
+
+// Load-time mesh optimization (MESH_OPT env var). Every mode above Off welds
+// duplicate vertices, orders triangles for the post-transform vertex cache
+// and renumbers vertices in first-use order so fetches walk the vertex
+// buffer forwards; Overdraw also sorts the triangle clusters outside-in.
+enum class MeshOptimization {
+    Off,
+    VertexCache,
+    Overdraw
+};
+
+const char* meshOptimizationToString(MeshOptimization mode);
+
+// Size of the simulated FIFO cache used for ordering and for ACMR. Small
+// enough to hold on every GPU's post-transform cache.
+constexpr uint32_t MESH_OPT_CACHE_SIZE = 16;
+
+// Counts accumulate over meshes; ACMR is cache misses per triangle, 3 at
+// worst and about 0.5 for a large regular grid
+struct MeshOptimizationStats {
+    uint32_t verticesBefore = 0;
+    uint32_t verticesAfter = 0;
+    uint32_t trianglesBefore = 0;
+    uint32_t trianglesAfter = 0; // Degenerate triangles left by welding are dropped
+    uint64_t cacheMissesBefore = 0;
+    uint64_t cacheMissesAfter = 0;
+
+    float getAcmrBefore() const { return trianglesBefore ? static_cast<float>(cacheMissesBefore) / trianglesBefore : 0.0f; }
+    float getAcmrAfter() const { return trianglesAfter ? static_cast<float>(cacheMissesAfter) / trianglesAfter : 0.0f; }
+    void add(const MeshOptimizationStats& other);
+};
+
+// Vertex cache misses of a triangle list on a FIFO cache of cacheSize entries
+uint64_t countCacheMisses(const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize);
+
+// Rewrites one mesh in place. Indices address the mesh's own vertices.
+MeshOptimizationStats optimizeMesh(std::vector<GLTFVertex>& vertices, std::vector<uint32_t>& indices, MeshOptimization mode);
@@ -0,0 +1,128 @@
+#include "Meshlet.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+constexpr uint32_t NO_SLOT = std::numeric_limits<uint32_t>::max();
+
+// Normal of the side the raster pipeline keeps. Front faces are counter-
+// clockwise in framebuffer space and the projection has no Y flip, so that is
+// the side (b - a) x (c - a) points away from.
+glm::vec3 frontFaceNormal(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+    return glm::cross(c - a, b - a);
+}
+
+void computeMeshletBounds(const std::vector<GLTFVertex>& vertices, const MeshletData& data, Meshlet& meshlet) {
+    auto position = [&](uint32_t localIndex) {
+        return vertices[data.vertices[meshlet.vertexOffset + localIndex]].position;
+    };
+
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+    for (uint32_t v = 0; v < meshlet.vertexCount; ++v) {
+        boundsMin = glm::min(boundsMin, position(v));
+        boundsMax = glm::max(boundsMax, position(v));
+    }
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    float radius = 0.0f;
+    for (uint32_t v = 0; v < meshlet.vertexCount; ++v) {
+        radius = std::max(radius, glm::length(position(v) - center));
+    }
+    meshlet.boundingSphere = glm::vec4(center, radius);
+
+    // Cone around the average face normal; degenerate triangles are skipped
+    std::vector<glm::vec3> normals;
+    normals.reserve(meshlet.triangleCount);
+    glm::vec3 axis(0.0f);
+    for (uint32_t t = 0; t < meshlet.triangleCount; ++t) {
+        uint32_t packed = data.triangles[meshlet.triangleOffset + t];
+        glm::vec3 normal = frontFaceNormal(position(packed & 0xff), position((packed >> 8) & 0xff), position((packed >> 16) & 0xff));
+        float length = glm::length(normal);
+        if (length > 0.0f) {
+            normals.push_back(normal / length);
+            axis += normals.back();
+        }
+    }
+
+    meshlet.cone = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    float axisLength = glm::length(axis);
+    if (normals.empty() || axisLength < 1e-6f) {
+        return;
+    }
+    axis /= axisLength;
+    float minDot = 1.0f;
+    for (const glm::vec3& normal : normals) {
+        minDot = std::min(minDot, glm::dot(normal, axis));
+    }
+    // A cone wider than a hemisphere always has a triangle facing the camera
+    if (minDot > 0.0f) {
+        meshlet.cone = glm::vec4(axis, std::sqrt(1.0f - minDot * minDot));
+    }
+}
+
+} // namespace
+
+void buildMeshlets(const std::vector<GLTFVertex>& vertices, const uint32_t* indices, uint32_t indexCount, MeshletData& out) {
+    if (indexCount < 3) {
+        return;
+    }
+
+    // Meshlet-local slot of each vertex of the range, reset when a meshlet closes
+    auto [minIt, maxIt] = std::minmax_element(indices, indices + indexCount);
+    const uint32_t firstVertex = *minIt;
+    std::vector<uint32_t> localSlots(*maxIt - firstVertex + 1, NO_SLOT);
+
+    Meshlet current{};
+    current.vertexOffset = static_cast<uint32_t>(out.vertices.size());
+    current.triangleOffset = static_cast<uint32_t>(out.triangles.size());
+    auto closeMeshlet = [&]() {
+        if (current.triangleCount == 0) {
+            return;
+        }
+        for (uint32_t v = 0; v < current.vertexCount; ++v) {
+            localSlots[out.vertices[current.vertexOffset + v] - firstVertex] = NO_SLOT;
+        }
+        computeMeshletBounds(vertices, out, current);
+        out.meshlets.push_back(current);
+        current = Meshlet{};
+        current.vertexOffset = static_cast<uint32_t>(out.vertices.size());
+        current.triangleOffset = static_cast<uint32_t>(out.triangles.size());
+    };
+
+    for (uint32_t i = 0; i + 2 < indexCount; i += 3) {
+        uint32_t newVertices = 0;
+        for (uint32_t k = 0; k < 3; ++k) {
+            newVertices += localSlots[indices[i + k] - firstVertex] == NO_SLOT ? 1 : 0;
+        }
+        if (current.vertexCount + newVertices > MESHLET_MAX_VERTICES || current.triangleCount == MESHLET_MAX_TRIANGLES) {
+            closeMeshlet();
+        }
+
+        uint32_t packed = 0;
+        for (uint32_t k = 0; k < 3; ++k) {
+            uint32_t& slot = localSlots[indices[i + k] - firstVertex];
+            if (slot == NO_SLOT) {
+                slot = current.vertexCount++;
+                out.vertices.push_back(indices[i + k]);
+            }
+            packed |= slot << (8 * k);
+        }
+        out.triangles.push_back(packed);
+        current.triangleCount++;
+    }
+    closeMeshlet();
+}
+
+void appendMeshlets(MeshletData& out, const MeshletData& source) {
+    const uint32_t vertexBase = static_cast<uint32_t>(out.vertices.size());
+    const uint32_t triangleBase = static_cast<uint32_t>(out.triangles.size());
+    out.vertices.insert(out.vertices.end(), source.vertices.begin(), source.vertices.end());
+    out.triangles.insert(out.triangles.end(), source.triangles.begin(), source.triangles.end());
+    for (Meshlet meshlet : source.meshlets) {
+        meshlet.vertexOffset += vertexBase;
+        meshlet.triangleOffset += triangleBase;
+        out.meshlets.push_back(meshlet);
+    }
+}
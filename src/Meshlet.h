@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "GLTFLoader.h"
+
+// Meshlet limits: 64 vertices keep the per-meshlet vertex indices in 8 bits
+// and 124 triangles fit the common mesh shader output budget.
+constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+// Cluster of up to MESHLET_MAX_TRIANGLES triangles culled as a unit on the
+// GPU. Mirrors Meshlet in shaders/meshlet_common.glsl (std430).
+struct Meshlet {
+    glm::vec4 boundingSphere; // Mesh-space center, radius
+    glm::vec4 cone;           // Front-facing normal cone axis, cutoff (1 disables the test)
+    uint32_t vertexOffset;    // Into MeshletData::vertices
+    uint32_t triangleOffset;  // Into MeshletData::triangles
+    uint32_t vertexCount;
+    uint32_t triangleCount;
+    uint32_t meshIndex;       // Scene mesh, selects its MeshTransform; set by the caller
+    uint32_t padding[3];
+};
+
+static_assert(sizeof(Meshlet) == 64, "Meshlet must match the std430 layout in meshlet_common.glsl");
+
+struct MeshletData {
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> vertices;  // Shared vertex buffer index of every meshlet vertex
+    std::vector<uint32_t> triangles; // Three 8-bit meshlet-local vertex indices per triangle
+};
+
+// Greedily splits a triangle list into meshlets in index order and appends
+// them to out. Indices address the shared vertex buffer, as in Scene.
+void buildMeshlets(const std::vector<GLTFVertex>& vertices, const uint32_t* indices, uint32_t indexCount, MeshletData& out);
+
+// Appends source to out, rebasing its meshlets' offsets. Lets meshes be split
+// independently and merged in a fixed order.
+void appendMeshlets(MeshletData& out, const MeshletData& source);
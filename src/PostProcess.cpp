@@ -0,0 +1,634 @@
+#include "PostProcess.h"
+#include "GpuProfiler.h"
+#include "ShaderManager.h"
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+// Mirrors TaaPushConstants in shaders/taa_resolve.comp
+struct TaaPushConstants {
+    float jitter[2];
+    int32_t inputSize[2];
+    int32_t outputSize[2];
+    float blendFactor;
+    uint32_t historyValid;
+};
+
+// Mirrors BloomPushConstants in shaders/bloom_common.glsl
+struct BloomPushConstants {
+    int32_t srcSize[2];
+    int32_t dstSize[2];
+    float threshold;
+    float knee;
+    uint32_t prefilter;
+};
+
+// Mirrors CompositePushConstants in shaders/post_composite.comp
+struct CompositePushConstants {
+    float exposure;
+    float bloomStrength;
+    float saturation;
+    float contrast;
+    uint32_t flags;
+    uint32_t frameIndex;
+};
+
+constexpr uint32_t POST_FLAG_BLOOM = 1u << 0;
+constexpr uint32_t POST_FLAG_ENCODE_SRGB = 1u << 1;
+
+bool isSrgbFormat(VkFormat format) {
+    switch (format) {
+    case VK_FORMAT_B8G8R8A8_SRGB:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_A8B8G8R8_SRGB_PACK32:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void computeBarrier(VkCommandBuffer commandBuffer) {
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0,
+                         1, &barrier,
+                         0, nullptr,
+                         0, nullptr);
+}
+
+void imageBarrier(VkCommandBuffer commandBuffer, VkImage image, uint32_t mipLevels,
+                  VkImageLayout oldLayout, VkImageLayout newLayout,
+                  VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage,
+                  VkAccessFlags srcAccess, VkAccessFlags dstAccess) {
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = mipLevels;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+uint32_t groupCount(uint32_t size, uint32_t tileSize) {
+    return (size + tileSize - 1) / tileSize;
+}
+
+} // namespace
+
+PostProcess::PostProcess(VkDevice device,
+                         VkPhysicalDevice physicalDevice,
+                         VkImageView hdrView,
+                         VkImageView motionView,
+                         VkExtent2D renderExtent,
+                         VkExtent2D extent,
+                         bool temporalResolve,
+                         const std::vector<VkImage>& swapchainImages,
+                         const std::vector<VkImageView>& swapchainViews,
+                         VkFormat swapchainFormat,
+                         bool storageSwapchain)
+    : m_device(device)
+    , m_physicalDevice(physicalDevice)
+    , m_renderExtent(renderExtent)
+    , m_extent(extent)
+    , m_temporalResolve(temporalResolve)
+    , m_swapchainImages(swapchainImages)
+    , m_swapchainFormat(swapchainFormat)
+    , m_storageSwapchain(storageSwapchain)
+    , m_historyImages{VK_NULL_HANDLE, VK_NULL_HANDLE}
+    , m_historyMemory{VK_NULL_HANDLE, VK_NULL_HANDLE}
+    , m_historyViews{VK_NULL_HANDLE, VK_NULL_HANDLE}
+    , m_historySampler(VK_NULL_HANDLE)
+    , m_historyIndex(0)
+    , m_historyInitialized(false)
+    , m_historyValid(false)
+    , m_bloomImage(VK_NULL_HANDLE)
+    , m_bloomMemory(VK_NULL_HANDLE)
+    , m_bloomMipCount(0)
+    , m_outputImage(VK_NULL_HANDLE)
+    , m_outputMemory(VK_NULL_HANDLE)
+    , m_outputView(VK_NULL_HANDLE)
+    , m_taaSetLayout(VK_NULL_HANDLE)
+    , m_bloomSetLayout(VK_NULL_HANDLE)
+    , m_compositeSetLayout(VK_NULL_HANDLE)
+    , m_descriptorPool(VK_NULL_HANDLE)
+    , m_variantCount(temporalResolve ? 2 : 1)
+    , m_compositeSetCount(0)
+    , m_taaPipelineLayout(VK_NULL_HANDLE)
+    , m_bloomPipelineLayout(VK_NULL_HANDLE)
+    , m_compositePipelineLayout(VK_NULL_HANDLE)
+    , m_taaPipeline(VK_NULL_HANDLE)
+    , m_downsamplePipeline(VK_NULL_HANDLE)
+    , m_upsamplePipeline(VK_NULL_HANDLE)
+    , m_compositePipeline(VK_NULL_HANDLE) {
+    createImages();
+    createDescriptors(hdrView, motionView, swapchainViews);
+    createPipelines();
+
+    std::cout << "[Post] HDR post chain ready: " << m_bloomMipCount << " bloom mips, output "
+              << (m_storageSwapchain ? "written directly to the swapchain" : "blitted to the swapchain") << std::endl;
+    if (m_temporalResolve) {
+        std::cout << "[Post] TAAU " << m_renderExtent.width << "x" << m_renderExtent.height
+                  << " -> " << m_extent.width << "x" << m_extent.height << std::endl;
+    }
+}
+
+PostProcess::~PostProcess() {
+    vkDestroyPipeline(m_device, m_compositePipeline, nullptr);
+    vkDestroyPipeline(m_device, m_upsamplePipeline, nullptr);
+    vkDestroyPipeline(m_device, m_downsamplePipeline, nullptr);
+    vkDestroyPipeline(m_device, m_taaPipeline, nullptr);
+    vkDestroyPipelineLayout(m_device, m_compositePipelineLayout, nullptr);
+    vkDestroyPipelineLayout(m_device, m_bloomPipelineLayout, nullptr);
+    vkDestroyPipelineLayout(m_device, m_taaPipelineLayout, nullptr);
+    vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, m_compositeSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, m_bloomSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, m_taaSetLayout, nullptr);
+    vkDestroySampler(m_device, m_historySampler, nullptr);
+
+    for (uint32_t i = 0; i < 2; ++i) {
+        if (m_historyImages[i] != VK_NULL_HANDLE) {
+            vkDestroyImageView(m_device, m_historyViews[i], nullptr);
+            vkDestroyImage(m_device, m_historyImages[i], nullptr);
+            vkFreeMemory(m_device, m_historyMemory[i], nullptr);
+        }
+    }
+
+    for (VkImageView view : m_bloomViews) {
+        vkDestroyImageView(m_device, view, nullptr);
+    }
+    vkDestroyImage(m_device, m_bloomImage, nullptr);
+    vkFreeMemory(m_device, m_bloomMemory, nullptr);
+
+    if (m_outputImage != VK_NULL_HANDLE) {
+        vkDestroyImageView(m_device, m_outputView, nullptr);
+        vkDestroyImage(m_device, m_outputImage, nullptr);
+        vkFreeMemory(m_device, m_outputMemory, nullptr);
+    }
+}
+
+VkPipelineStageFlags PostProcess::getSwapchainWriteStage() const {
+    return m_storageSwapchain ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_TRANSFER_BIT;
+}
+
+void PostProcess::createImages() {
+    if (m_temporalResolve) {
+        for (uint32_t i = 0; i < 2; ++i) {
+            m_historyImages[i] = createImage(m_extent, 1, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, m_historyMemory[i]);
+            m_historyViews[i] = createView(m_historyImages[i], HDR_FORMAT, 0);
+        }
+
+        // Bilinear taps of the Catmull-Rom history filter
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_LINEAR;
+        samplerInfo.minFilter = VK_FILTER_LINEAR;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.maxLod = 0.0f;
+        if (vkCreateSampler(m_device, &samplerInfo, nullptr, &m_historySampler) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create TAAU history sampler");
+        }
+    }
+
+    // Stop before the pyramid gets so small the tent filter only smears borders
+    VkExtent2D mipExtent = {std::max(1u, m_extent.width / 2), std::max(1u, m_extent.height / 2)};
+    while (m_bloomMipCount < MAX_BLOOM_MIPS &&
+           std::min(mipExtent.width, mipExtent.height) >= MIN_BLOOM_MIP_SIZE) {
+        m_bloomExtents.push_back(mipExtent);
+        ++m_bloomMipCount;
+        mipExtent = {std::max(1u, mipExtent.width / 2), std::max(1u, mipExtent.height / 2)};
+    }
+    if (m_bloomMipCount == 0) {
+        m_bloomExtents.push_back(mipExtent);
+        m_bloomMipCount = 1;
+    }
+
+    m_bloomImage = createImage(m_bloomExtents[0], m_bloomMipCount, VK_IMAGE_USAGE_STORAGE_BIT, m_bloomMemory);
+    for (uint32_t mip = 0; mip < m_bloomMipCount; ++mip) {
+        m_bloomViews.push_back(createView(m_bloomImage, HDR_FORMAT, mip));
+    }
+
+    if (!m_storageSwapchain) {
+        m_outputImage = createImage(m_extent, 1, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, m_outputMemory);
+        m_outputView = createView(m_outputImage, HDR_FORMAT, 0);
+    }
+}
+
+VkImage PostProcess::createImage(VkExtent2D extent, uint32_t mipLevels, VkImageUsageFlags usage, VkDeviceMemory& memory) {
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent = {extent.width, extent.height, 1};
+    imageInfo.mipLevels = mipLevels;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = HDR_FORMAT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = usage;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkImage image;
+    if (vkCreateImage(m_device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create post processing image");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(m_device, image, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    if (vkAllocateMemory(m_device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate post processing image memory");
+    }
+    vkBindImageMemory(m_device, image, memory, 0);
+    return image;
+}
+
+VkImageView PostProcess::createView(VkImage image, VkFormat format, uint32_t mipLevel) {
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = mipLevel;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    VkImageView view;
+    if (vkCreateImageView(m_device, &viewInfo, nullptr, &view) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create post processing image view");
+    }
+    return view;
+}
+
+uint32_t PostProcess::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &memProperties);
+
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+
+    throw std::runtime_error("failed to find suitable memory type!");
+}
+
+void PostProcess::createDescriptors(VkImageView hdrView, VkImageView motionView, const std::vector<VkImageView>& swapchainViews) {
+    auto storageBinding = [](uint32_t binding) {
+        VkDescriptorSetLayoutBinding layoutBinding{};
+        layoutBinding.binding = binding;
+        layoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        layoutBinding.descriptorCount = 1;
+        layoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        return layoutBinding;
+    };
+
+    // TAAU: 0 = HDR target, 1 = motion vectors, 2 = history (sampled), 3 = output
+    std::array<VkDescriptorSetLayoutBinding, 4> taaBindings = {storageBinding(0), storageBinding(1), storageBinding(2), storageBinding(3)};
+    taaBindings[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(taaBindings.size());
+    layoutInfo.pBindings = taaBindings.data();
+    if (vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &m_taaSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create TAAU descriptor set layout");
+    }
+
+    // Bloom passes: 0 = source mip, 1 = destination mip
+    std::array<VkDescriptorSetLayoutBinding, 2> bloomBindings = {storageBinding(0), storageBinding(1)};
+    layoutInfo.bindingCount = static_cast<uint32_t>(bloomBindings.size());
+    layoutInfo.pBindings = bloomBindings.data();
+    if (vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &m_bloomSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create bloom descriptor set layout");
+    }
+
+    // Composite: 0 = HDR target, 1 = bloom mip 0, 2 = output
+    std::array<VkDescriptorSetLayoutBinding, 3> compositeBindings = {storageBinding(0), storageBinding(1), storageBinding(2)};
+    layoutInfo.bindingCount = static_cast<uint32_t>(compositeBindings.size());
+    layoutInfo.pBindings = compositeBindings.data();
+    if (vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &m_compositeSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create composite descriptor set layout");
+    }
+
+    m_compositeSetCount = m_storageSwapchain ? static_cast<uint32_t>(swapchainViews.size()) : 1;
+    uint32_t taaSetCount = m_temporalResolve ? 2 : 0;
+    uint32_t bloomSetCount = m_bloomMipCount * m_variantCount + m_bloomMipCount - 1;
+    uint32_t compositeSetCount = m_compositeSetCount * m_variantCount;
+
+    std::array<VkDescriptorPoolSize, 2> poolSizes{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[0].descriptorCount = taaSetCount * 3 + bloomSetCount * 2 + compositeSetCount * 3;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[1].descriptorCount = std::max(taaSetCount, 1u);
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = taaSetCount + bloomSetCount + compositeSetCount;
+    if (vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create post processing descriptor pool");
+    }
+
+    auto allocateSets = [&](VkDescriptorSetLayout layout, uint32_t count) {
+        std::vector<VkDescriptorSet> sets(count);
+        if (count == 0) {
+            return sets;
+        }
+        std::vector<VkDescriptorSetLayout> layouts(count, layout);
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = m_descriptorPool;
+        allocInfo.descriptorSetCount = count;
+        allocInfo.pSetLayouts = layouts.data();
+        if (vkAllocateDescriptorSets(m_device, &allocInfo, sets.data()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate post processing descriptor sets");
+        }
+        return sets;
+    };
+    m_taaSets = allocateSets(m_taaSetLayout, taaSetCount);
+    m_downsampleSets = allocateSets(m_bloomSetLayout, m_bloomMipCount * m_variantCount);
+    m_upsampleSets = allocateSets(m_bloomSetLayout, m_bloomMipCount - 1);
+    m_compositeSets = allocateSets(m_compositeSetLayout, compositeSetCount);
+
+    // A null view marks the sampled binding, which uses the history sampler
+    auto writeImages = [&](VkDescriptorSet set, std::initializer_list<VkImageView> views, VkImageView sampledView = VK_NULL_HANDLE) {
+        std::vector<VkDescriptorImageInfo> imageInfos;
+        for (VkImageView view : views) {
+            if (view == VK_NULL_HANDLE) {
+                imageInfos.push_back({m_historySampler, sampledView, VK_IMAGE_LAYOUT_GENERAL});
+            } else {
+                imageInfos.push_back({VK_NULL_HANDLE, view, VK_IMAGE_LAYOUT_GENERAL});
+            }
+        }
+        std::vector<VkWriteDescriptorSet> writes(imageInfos.size());
+        for (size_t i = 0; i < writes.size(); ++i) {
+            writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[i].dstSet = set;
+            writes[i].dstBinding = static_cast<uint32_t>(i);
+            writes[i].descriptorType = imageInfos[i].sampler != VK_NULL_HANDLE ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+                                                                               : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            writes[i].descriptorCount = 1;
+            writes[i].pImageInfo = &imageInfos[i];
+        }
+        vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    };
+
+    // Set i writes history image i and reads the other one
+    for (uint32_t i = 0; i < taaSetCount; ++i) {
+        writeImages(m_taaSets[i], {hdrView, motionView, VK_NULL_HANDLE, m_historyViews[i]}, m_historyViews[1 - i]);
+    }
+
+    for (uint32_t variant = 0; variant < m_variantCount; ++variant) {
+        VkImageView sceneView = m_temporalResolve ? m_historyViews[variant] : hdrView;
+        for (uint32_t mip = 0; mip < m_bloomMipCount; ++mip) {
+            writeImages(m_downsampleSets[variant * m_bloomMipCount + mip],
+                        {mip == 0 ? sceneView : m_bloomViews[mip - 1], m_bloomViews[mip]});
+        }
+        for (uint32_t i = 0; i < m_compositeSetCount; ++i) {
+            writeImages(m_compositeSets[variant * m_compositeSetCount + i],
+                        {sceneView, m_bloomViews[0], m_storageSwapchain ? swapchainViews[i] : m_outputView});
+        }
+    }
+    for (uint32_t mip = 0; mip + 1 < m_bloomMipCount; ++mip) {
+        writeImages(m_upsampleSets[mip], {m_bloomViews[mip + 1], m_bloomViews[mip]});
+    }
+}
+
+void PostProcess::createPipelines() {
+    VkPushConstantRange taaRange{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(TaaPushConstants)};
+    VkPipelineLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &m_taaSetLayout;
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &taaRange;
+    if (vkCreatePipelineLayout(m_device, &layoutInfo, nullptr, &m_taaPipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create TAAU pipeline layout");
+    }
+
+    VkPushConstantRange bloomRange{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(BloomPushConstants)};
+    layoutInfo.pSetLayouts = &m_bloomSetLayout;
+    layoutInfo.pPushConstantRanges = &bloomRange;
+    if (vkCreatePipelineLayout(m_device, &layoutInfo, nullptr, &m_bloomPipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create bloom pipeline layout");
+    }
+
+    VkPushConstantRange compositeRange{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CompositePushConstants)};
+    layoutInfo.pSetLayouts = &m_compositeSetLayout;
+    layoutInfo.pPushConstantRanges = &compositeRange;
+    if (vkCreatePipelineLayout(m_device, &layoutInfo, nullptr, &m_compositePipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create composite pipeline layout");
+    }
+
+    auto createComputePipeline = [&](const char* file, VkPipelineLayout layout) {
+        VkShaderModule module = ShaderManager::createShaderModule(m_device, ShaderManager::readFile(file));
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = module;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.layout = layout;
+
+        VkPipeline pipeline;
+        VkResult result = vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
+        vkDestroyShaderModule(m_device, module, nullptr);
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error(std::string("failed to create post processing pipeline ") + file);
+        }
+        return pipeline;
+    };
+
+    if (m_temporalResolve) {
+        m_taaPipeline = createComputePipeline("shaders/taa_resolve.comp.spv", m_taaPipelineLayout);
+    }
+    m_downsamplePipeline = createComputePipeline("shaders/bloom_downsample.comp.spv", m_bloomPipelineLayout);
+    m_upsamplePipeline = createComputePipeline("shaders/bloom_upsample.comp.spv", m_bloomPipelineLayout);
+    m_compositePipeline = createComputePipeline("shaders/post_composite.comp.spv", m_compositePipelineLayout);
+}
+
+void PostProcess::record(VkCommandBuffer commandBuffer, uint32_t imageIndex, uint32_t frameIndex, glm::vec2 jitter,
+                         const PostProcessSettings& settings, GpuProfiler* profiler) {
+    VkImage swapchainImage = m_swapchainImages[imageIndex];
+    uint32_t variant = 0;
+
+    if (m_temporalResolve) {
+        profiler->beginScope(commandBuffer, "taa");
+
+        m_historyIndex = 1 - m_historyIndex;
+        variant = m_historyIndex;
+        if (!m_historyInitialized) {
+            for (VkImage image : m_historyImages) {
+                imageBarrier(commandBuffer, image, 1,
+                             VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+                             VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+            }
+            m_historyInitialized = true;
+            m_historyValid = false;
+        } else {
+            // Last frame's resolve wrote the history; its bloom and composite
+            // passes may still be reading the image written now
+            computeBarrier(commandBuffer);
+        }
+
+        TaaPushConstants taaConstants{};
+        taaConstants.jitter[0] = jitter.x;
+        taaConstants.jitter[1] = jitter.y;
+        taaConstants.inputSize[0] = static_cast<int32_t>(m_renderExtent.width);
+        taaConstants.inputSize[1] = static_cast<int32_t>(m_renderExtent.height);
+        taaConstants.outputSize[0] = static_cast<int32_t>(m_extent.width);
+        taaConstants.outputSize[1] = static_cast<int32_t>(m_extent.height);
+        taaConstants.blendFactor = settings.temporalBlend;
+        taaConstants.historyValid = m_historyValid ? 1u : 0u;
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_taaPipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_taaPipelineLayout, 0, 1, &m_taaSets[m_historyIndex], 0, nullptr);
+        vkCmdPushConstants(commandBuffer, m_taaPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(taaConstants), &taaConstants);
+        vkCmdDispatch(commandBuffer, groupCount(m_extent.width, POST_TILE_SIZE), groupCount(m_extent.height, POST_TILE_SIZE), 1);
+        computeBarrier(commandBuffer);
+        m_historyValid = true;
+
+        profiler->endScope(commandBuffer);
+    }
+
+    // Every mip is fully rewritten each frame, so the previous contents can be
+    // discarded. Done even with bloom off since the composite set references mip 0.
+    imageBarrier(commandBuffer, m_bloomImage, m_bloomMipCount,
+                 VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                 0, VK_ACCESS_SHADER_WRITE_BIT);
+
+    if (settings.bloomEnabled) {
+        profiler->beginScope(commandBuffer, "bloom");
+
+        BloomPushConstants bloomConstants{};
+        bloomConstants.threshold = settings.bloomThreshold;
+        bloomConstants.knee = settings.bloomKnee;
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_downsamplePipeline);
+        VkExtent2D srcExtent = m_extent;
+        for (uint32_t mip = 0; mip < m_bloomMipCount; ++mip) {
+            VkExtent2D dstExtent = m_bloomExtents[mip];
+            bloomConstants.srcSize[0] = static_cast<int32_t>(srcExtent.width);
+            bloomConstants.srcSize[1] = static_cast<int32_t>(srcExtent.height);
+            bloomConstants.dstSize[0] = static_cast<int32_t>(dstExtent.width);
+            bloomConstants.dstSize[1] = static_cast<int32_t>(dstExtent.height);
+            bloomConstants.prefilter = mip == 0 ? 1u : 0u;
+
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_bloomPipelineLayout, 0, 1,
+                                    &m_downsampleSets[variant * m_bloomMipCount + mip], 0, nullptr);
+            vkCmdPushConstants(commandBuffer, m_bloomPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(bloomConstants), &bloomConstants);
+            vkCmdDispatch(commandBuffer, groupCount(dstExtent.width, POST_TILE_SIZE), groupCount(dstExtent.height, POST_TILE_SIZE), 1);
+            computeBarrier(commandBuffer);
+            srcExtent = dstExtent;
+        }
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_upsamplePipeline);
+        for (uint32_t mip = m_bloomMipCount - 1; mip-- > 0;) {
+            VkExtent2D dstExtent = m_bloomExtents[mip];
+            bloomConstants.srcSize[0] = static_cast<int32_t>(m_bloomExtents[mip + 1].width);
+            bloomConstants.srcSize[1] = static_cast<int32_t>(m_bloomExtents[mip + 1].height);
+            bloomConstants.dstSize[0] = static_cast<int32_t>(dstExtent.width);
+            bloomConstants.dstSize[1] = static_cast<int32_t>(dstExtent.height);
+            bloomConstants.prefilter = 0u;
+
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_bloomPipelineLayout, 0, 1, &m_upsampleSets[mip], 0, nullptr);
+            vkCmdPushConstants(commandBuffer, m_bloomPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(bloomConstants), &bloomConstants);
+            vkCmdDispatch(commandBuffer, groupCount(dstExtent.width, POST_TILE_SIZE), groupCount(dstExtent.height, POST_TILE_SIZE), 1);
+            computeBarrier(commandBuffer);
+        }
+
+        profiler->endScope(commandBuffer);
+    }
+
+    profiler->beginScope(commandBuffer, "post");
+
+    // Source stage matches the acquire semaphore wait stage in endFrame()
+    VkImage outputImage = m_storageSwapchain ? swapchainImage : m_outputImage;
+    imageBarrier(commandBuffer, outputImage, 1,
+                 VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+                 getSwapchainWriteStage(), VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                 0, VK_ACCESS_SHADER_WRITE_BIT);
+
+    CompositePushConstants compositeConstants{};
+    compositeConstants.exposure = settings.exposure;
+    compositeConstants.bloomStrength = settings.bloomStrength;
+    compositeConstants.saturation = settings.saturation;
+    compositeConstants.contrast = settings.contrast;
+    compositeConstants.flags = (settings.bloomEnabled ? POST_FLAG_BLOOM : 0u) |
+                               (isSrgbFormat(m_swapchainFormat) ? 0u : POST_FLAG_ENCODE_SRGB);
+    compositeConstants.frameIndex = frameIndex;
+
+    VkDescriptorSet compositeSet = m_compositeSets[variant * m_compositeSetCount + (m_storageSwapchain ? imageIndex : 0)];
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_compositePipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_compositePipelineLayout, 0, 1, &compositeSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, m_compositePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(compositeConstants), &compositeConstants);
+    vkCmdDispatch(commandBuffer, groupCount(m_extent.width, POST_TILE_SIZE), groupCount(m_extent.height, POST_TILE_SIZE), 1);
+
+    if (m_storageSwapchain) {
+        imageBarrier(commandBuffer, swapchainImage, 1,
+                     VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                     VK_ACCESS_SHADER_WRITE_BIT, 0);
+    } else {
+        // Fallback for swapchains without storage usage; the blit also converts
+        // the float intermediate to the swapchain format (encoding sRGB if needed).
+        imageBarrier(commandBuffer, m_outputImage, 1,
+                     VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                     VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+        imageBarrier(commandBuffer, swapchainImage, 1,
+                     VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                     VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                     0, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+        VkImageBlit blit{};
+        blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.srcSubresource.layerCount = 1;
+        blit.srcOffsets[1] = {static_cast<int32_t>(m_extent.width), static_cast<int32_t>(m_extent.height), 1};
+        blit.dstSubresource = blit.srcSubresource;
+        blit.dstOffsets[1] = blit.srcOffsets[1];
+        vkCmdBlitImage(commandBuffer,
+                       m_outputImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       swapchainImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       1, &blit,
+                       VK_FILTER_NEAREST);
+
+        imageBarrier(commandBuffer, swapchainImage, 1,
+                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                     VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                     VK_ACCESS_TRANSFER_WRITE_BIT, 0);
+    }
+
+    profiler->endScope(commandBuffer);
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+class GpuProfiler;
+
+struct PostProcessSettings {
+    float exposure = 1.5f;
+    float bloomStrength = 0.2f;
+    float bloomThreshold = 1.0f; // Scene radiance above which pixels start to bloom
+    float bloomKnee = 0.5f;      // Width of the soft transition around the threshold
+    float saturation = 1.1f;
+    float contrast = 1.05f;
+    float temporalBlend = 0.1f;  // Weight of a new TAAU sample landing on the pixel center
+    bool bloomEnabled = true;
+};
+
+// Compute post chain run on the HDR radiance target every frame: an optional
+// temporal resolve (TAAU) from the jittered render resolution up to the
+// output resolution, a bloom mip pyramid (downsample with threshold, then
+// additive upsample) and one fused tone map + grade + dither pass. When the
+// swapchain supports storage usage the fused pass writes the swapchain image
+// directly; otherwise it writes an intermediate image that is blitted to it.
+class PostProcess {
+public:
+    // Without temporalResolve the HDR target must already be at the output
+    // extent and motionView is ignored.
+    PostProcess(VkDevice device,
+                VkPhysicalDevice physicalDevice,
+                VkImageView hdrView,
+                VkImageView motionView,
+                VkExtent2D renderExtent,
+                VkExtent2D extent,
+                bool temporalResolve,
+                const std::vector<VkImage>& swapchainImages,
+                const std::vector<VkImageView>& swapchainViews,
+                VkFormat swapchainFormat,
+                bool storageSwapchain);
+    ~PostProcess();
+
+    PostProcess(const PostProcess&) = delete;
+    PostProcess& operator=(const PostProcess&) = delete;
+
+    // Expects the HDR and motion targets in GENERAL layout with their writes
+    // made visible to compute; leaves the swapchain image in PRESENT_SRC
+    // layout. jitter is the sub-pixel offset the frame was rendered with.
+    void record(VkCommandBuffer commandBuffer, uint32_t imageIndex, uint32_t frameIndex, glm::vec2 jitter,
+                const PostProcessSettings& settings, GpuProfiler* profiler);
+
+    // Drops the accumulated history, e.g. after a backend switch
+    void resetHistory() { m_historyValid = false; }
+    bool hasTemporalResolve() const { return m_temporalResolve; }
+
+    // Stage at which the swapchain image is first written; the acquire
+    // semaphore must be waited on at this stage.
+    VkPipelineStageFlags getSwapchainWriteStage() const;
+    bool writesSwapchainDirectly() const { return m_storageSwapchain; }
+
+    static constexpr VkFormat HDR_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+private:
+    void createImages();
+    void createDescriptors(VkImageView hdrView, VkImageView motionView, const std::vector<VkImageView>& swapchainViews);
+    void createPipelines();
+    VkImage createImage(VkExtent2D extent, uint32_t mipLevels, VkImageUsageFlags usage, VkDeviceMemory& memory);
+    VkImageView createView(VkImage image, VkFormat format, uint32_t mipLevel);
+    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+    VkDevice m_device;
+    VkPhysicalDevice m_physicalDevice;
+    VkExtent2D m_renderExtent;
+    VkExtent2D m_extent;
+    bool m_temporalResolve;
+    std::vector<VkImage> m_swapchainImages;
+    VkFormat m_swapchainFormat;
+    bool m_storageSwapchain;
+
+    // TAAU output, ping-ponged: one is written this frame while the other is
+    // sampled as history. The written one feeds bloom and the composite.
+    VkImage m_historyImages[2];
+    VkDeviceMemory m_historyMemory[2];
+    VkImageView m_historyViews[2];
+    VkSampler m_historySampler;
+    uint32_t m_historyIndex;   // History image written this frame
+    bool m_historyInitialized; // Both images transitioned out of UNDEFINED
+    bool m_historyValid;
+
+    // Bloom pyramid, mip 0 is half the output resolution
+    VkImage m_bloomImage;
+    VkDeviceMemory m_bloomMemory;
+    std::vector<VkImageView> m_bloomViews;
+    std::vector<VkExtent2D> m_bloomExtents;
+    uint32_t m_bloomMipCount;
+
+    // Only used when the swapchain cannot be written from compute
+    VkImage m_outputImage;
+    VkDeviceMemory m_outputMemory;
+    VkImageView m_outputView;
+
+    // Sets reading the resolved image come in one variant per history image
+    // (a single variant without TAAU), indexed variant * count + i.
+    VkDescriptorSetLayout m_taaSetLayout;
+    VkDescriptorSetLayout m_bloomSetLayout;
+    VkDescriptorSetLayout m_compositeSetLayout;
+    VkDescriptorPool m_descriptorPool;
+    uint32_t m_variantCount;
+    std::vector<VkDescriptorSet> m_taaSets;        // One per history image
+    std::vector<VkDescriptorSet> m_downsampleSets; // One per bloom mip, per variant
+    std::vector<VkDescriptorSet> m_upsampleSets;   // One per bloom mip except the last
+    std::vector<VkDescriptorSet> m_compositeSets;  // One per swapchain image (or one for the intermediate), per variant
+    uint32_t m_compositeSetCount;
+
+    VkPipelineLayout m_taaPipelineLayout;
+    VkPipelineLayout m_bloomPipelineLayout;
+    VkPipelineLayout m_compositePipelineLayout;
+    VkPipeline m_taaPipeline;
+    VkPipeline m_downsamplePipeline;
+    VkPipeline m_upsamplePipeline;
+    VkPipeline m_compositePipeline;
+
+    static constexpr uint32_t POST_TILE_SIZE = 8;     // Matches local_size in the post shaders
+    static constexpr uint32_t MAX_BLOOM_MIPS = 6;
+    static constexpr uint32_t MIN_BLOOM_MIP_SIZE = 8; // Smallest mip edge worth blurring
+};
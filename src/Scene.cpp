@@ -1,10 +1,13 @@
 #include "Scene.h"
+#include "JobSystem.h"
 #include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <cstdlib>
 #include <iostream>
+#include <utility>
 
-Scene::Scene() : m_time(0.0f) {
+Scene::Scene(JobSystem* jobSystem) : m_jobSystem(jobSystem), m_time(0.0f) {
 }
 
 Scene::~Scene() {
@@ -16,84 +19,182 @@ void Scene::init() {
         std::cout << "Failed to load city model, creating basic city..." << std::endl;
         createBasicCity();
     }
+
+    optimizeMeshes();
     
-    // Combine all meshes into single vertex/index buffers
-    m_vertices.clear();
-    m_indices.clear();
+    // Combine all meshes into single vertex/index buffers. The ranges are a
+    // prefix sum over the mesh sizes, after which every mesh copies into its
+    // own slice independently and frees its own arrays, so the geometry is
+    // held twice at most per mesh in flight rather than for the whole scene.
+    m_meshRanges.clear();
+    m_meshRanges.reserve(m_meshes.size());
     
     uint32_t vertexOffset = 0;
+    uint32_t indexOffset = 0;
     for (const auto& mesh : m_meshes) {
-        for (const auto& vertex : mesh.vertices) {
-            m_vertices.push_back(vertex);
-        }
+        SceneMeshRange range{};
+        range.firstIndex = indexOffset;
+        range.indexCount = static_cast<uint32_t>(mesh.indices.size());
+        range.firstVertex = vertexOffset;
+        range.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+        m_meshRanges.push_back(range);
         
-        for (const auto& index : mesh.indices) {
-            m_indices.push_back(index + vertexOffset);
+        vertexOffset += range.vertexCount;
+        indexOffset += range.indexCount;
+    }
+    
+    m_vertices.assign(vertexOffset, GLTFVertex{});
+    m_indices.assign(indexOffset, 0);
+    parallelFor(m_jobSystem, static_cast<uint32_t>(m_meshes.size()), 1, [this](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            GLTFMesh& mesh = m_meshes[i];
+            const SceneMeshRange& range = m_meshRanges[i];
+            std::copy(mesh.vertices.begin(), mesh.vertices.end(), m_vertices.begin() + range.firstVertex);
+            std::transform(mesh.indices.begin(), mesh.indices.end(), m_indices.begin() + range.firstIndex,
+                           [&range](uint32_t index) { return index + range.firstVertex; });
+            std::vector<GLTFVertex>().swap(mesh.vertices);
+            std::vector<uint32_t>().swap(mesh.indices);
         }
-        
-        vertexOffset += static_cast<uint32_t>(mesh.vertices.size());
+    });
+
+    buildSceneGraph();
+}
+
+// Each mesh is optimized on its own job before the merge, since welding
+// changes the vertex counts the merge is sized by
+void Scene::optimizeMeshes() {
+    m_meshOptimizationStats = {};
+    if (m_meshOptimization == MeshOptimization::Off) {
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<MeshOptimizationStats> meshStats(m_meshes.size());
+    parallelFor(m_jobSystem, static_cast<uint32_t>(m_meshes.size()), 1, [this, &meshStats](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            meshStats[i] = optimizeMesh(m_meshes[i].vertices, m_meshes[i].indices, m_meshOptimization);
+        }
+    });
+    for (const MeshOptimizationStats& stats : meshStats) {
+        m_meshOptimizationStats.add(stats);
+    }
+
+    const MeshOptimizationStats& total = m_meshOptimizationStats;
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "[Scene] Mesh optimization (" << meshOptimizationToString(m_meshOptimization) << ") in " << ms << " ms: "
+              << total.verticesBefore << " -> " << total.verticesAfter << " vertices, "
+              << total.trianglesBefore << " -> " << total.trianglesAfter << " triangles, ACMR "
+              << total.getAcmrBefore() << " -> " << total.getAcmrAfter()
+              << " (" << MESH_OPT_CACHE_SIZE << "-entry FIFO)" << std::endl;
+}
+
+size_t Scene::releaseGeometry() {
+    size_t bytes = m_vertices.capacity() * sizeof(GLTFVertex) + m_indices.capacity() * sizeof(uint32_t);
+    std::vector<GLTFVertex>().swap(m_vertices);
+    std::vector<uint32_t>().swap(m_indices);
+    return bytes;
+}
+
+// The vertices above stay in mesh space; the graph places each mesh through
+// its TLAS instance
+void Scene::buildSceneGraph() {
+    m_graph.clear();
+    m_graph.reserve(static_cast<uint32_t>(m_meshes.size()) + 1);
+    m_graph.addNode(SceneGraph::NO_PARENT, glm::mat4(1.0f));
+    m_meshNodes.clear();
+    m_meshNodes.reserve(m_meshes.size());
+    for (const GLTFMesh& mesh : m_meshes) {
+        m_meshNodes.push_back(m_graph.addNode(ROOT_NODE, mesh.transform));
     }
+    m_graph.update();
+}
+
+void Scene::captureTransforms(SceneTransforms& transforms) const {
+    if (transforms.version == m_graph.getVersion() && transforms.meshWorlds.size() == m_meshNodes.size()) {
+        return;
+    }
+    transforms.meshWorlds.resize(m_meshNodes.size());
+    for (size_t i = 0; i < m_meshNodes.size(); ++i) {
+        transforms.meshWorlds[i] = m_graph.getWorldMatrix(m_meshNodes[i]);
+    }
+    transforms.version = m_graph.getVersion();
 }
 
 bool Scene::loadCityModel() {
     std::string modelPath = "assets/cyberpunk_city.glb";
-    if (GLTFLoader::loadModel(modelPath, m_cityModel)) {
+    if (GLTFLoader::loadModel(modelPath, m_cityModel, m_jobSystem)) {
         std::cout << "Successfully loaded city model: " << m_cityModel.name << std::endl;
         std::cout << "Loaded " << m_cityModel.meshes.size() << " meshes" << std::endl;
         
-        // Copy meshes from the loaded model
-        m_meshes = m_cityModel.meshes;
+        // The model keeps its name and bounds; the meshes move into the scene
+        m_meshes = std::move(m_cityModel.meshes);
+        m_cityModel.meshes.clear();
         return true;
     }
     return false;
 }
 
 void Scene::update(float deltaTime) {
+    // The neon glow is animated in the shaders from the interpolated scene
+    // time; materials are fixed once uploaded
     m_time += deltaTime;
-    
-    // Animate neon lights
-    for (auto& mesh : m_meshes) {
-        if (mesh.hasEmission) {
-            float intensity = 0.5f + 0.5f * sin(m_time * 2.0f);
-            mesh.emissionColor = glm::vec3(intensity, intensity * 0.8f, intensity * 1.2f);
-        }
-    }
+    m_graph.update();
 }
 
 void Scene::createBasicCity() {
-    // Create a simple city using the GLTFLoader helper
-    GLTFMesh cityMesh;
-    cityMesh.name = "BasicCity";
-    cityMesh.baseColor = glm::vec3(0.1f, 0.1f, 0.2f);
-    cityMesh.metallic = 0.2f;
-    cityMesh.roughness = 0.8f;
-    cityMesh.hasEmission = false;
-    cityMesh.transform = glm::mat4(1.0f);
+    // Create a simple city, one mesh per material
+    GLTFMesh groundMesh;
+    groundMesh.name = "BasicGround";
+    groundMesh.baseColor = glm::vec3(0.1f, 0.1f, 0.15f);
+    groundMesh.metallic = 0.8f;
+    groundMesh.roughness = 0.3f;
+    groundMesh.hasEmission = false;
+    groundMesh.transform = glm::mat4(1.0f);
     
     // Create ground
-    createGroundMesh(cityMesh);
+    createGroundMesh(groundMesh);
     
     // Create some buildings
+    GLTFMesh buildingMesh;
+    buildingMesh.name = "BasicBuildings";
+    buildingMesh.baseColor = glm::vec3(1.0f);
+    buildingMesh.metallic = 0.2f;
+    buildingMesh.roughness = 0.8f;
+    buildingMesh.hasEmission = false;
+    buildingMesh.transform = glm::mat4(1.0f);
+    
     for (int i = 0; i < 20; ++i) {
         float x = (i % 5 - 2) * 15.0f;
         float z = (i / 5 - 2) * 15.0f;
         float height = 5.0f + (i % 3) * 8.0f;
         
-        createBuildingMesh(cityMesh, glm::vec3(x, 0.0f, z), glm::vec3(4.0f, height, 4.0f), 
+        createBuildingMesh(buildingMesh, glm::vec3(x, 0.0f, z), glm::vec3(4.0f, height, 4.0f), 
                           glm::vec3(0.1f + (i % 3) * 0.1f, 0.1f, 0.2f + (i % 2) * 0.2f));
     }
     
     // Add some neon elements
+    GLTFMesh neonMesh;
+    neonMesh.name = "BasicNeon";
+    neonMesh.baseColor = glm::vec3(1.0f, 0.2f, 0.8f);
+    neonMesh.metallic = 0.0f;
+    neonMesh.roughness = 0.5f;
+    neonMesh.hasEmission = true;
+    neonMesh.emissionColor = glm::vec3(1.0f, 0.2f, 0.8f);
+    neonMesh.emissionStrength = 4.0f;
+    neonMesh.transform = glm::mat4(1.0f);
+    
     for (int i = 0; i < 10; ++i) {
         float x = (i % 5 - 2) * 15.0f;
         float z = (i / 5 - 2) * 15.0f;
         float height = 8.0f + (i % 3) * 5.0f;
         
-        createNeonMesh(cityMesh, glm::vec3(x, height, z), glm::vec3(6.0f, 0.2f, 0.2f),
+        createNeonMesh(neonMesh, glm::vec3(x, height, z), glm::vec3(6.0f, 0.2f, 0.2f),
                       glm::vec3(1.0f, 0.2f, 0.8f));
     }
     
-    m_meshes.push_back(cityMesh);
+    m_meshes.push_back(std::move(groundMesh));
+    m_meshes.push_back(std::move(buildingMesh));
+    m_meshes.push_back(std::move(neonMesh));
 }
 
 void Scene::createGroundMesh(GLTFMesh& mesh) {
@@ -7,6 +7,10 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include "GLTFLoader.h"
+#include "MeshOptimizer.h"
+#include "SceneGraph.h"
+
+class JobSystem;
 
 struct Vertex {
     glm::vec3 pos;
@@ -25,21 +29,60 @@ struct Mesh {
     glm::vec3 color;
 };
 
+// Where a mesh lives inside the combined vertex/index buffers
+struct SceneMeshRange {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t firstVertex;
+    uint32_t vertexCount;
+};
+
+// World matrix of every scene mesh at one simulation tick, parallel to
+// Scene::getMeshes(). Equal versions mean equal matrices.
+struct SceneTransforms {
+    std::vector<glm::mat4> meshWorlds;
+    uint64_t version = 0;
+};
+
 class Scene {
 public:
-    Scene();
+    // Loading, merging and per-frame updates are split across jobs when given
+    explicit Scene(JobSystem* jobSystem = nullptr);
     ~Scene();
     
+    // Applies to the next init()
+    void setMeshOptimization(MeshOptimization mode) { m_meshOptimization = mode; }
     void init();
     void update(float deltaTime);
     
+    // Per-mesh vertex and index arrays are empty after init(); the geometry
+    // lives only in the combined buffers below
     const std::vector<GLTFMesh>& getMeshes() const { return m_meshes; }
     const std::vector<GLTFVertex>& getVertices() const { return m_vertices; }
     const std::vector<uint32_t>& getIndices() const { return m_indices; }
+    // Frees the combined buffers once they are uploaded; ranges, materials
+    // and the scene graph stay. Returns the bytes released.
+    size_t releaseGeometry();
+    const std::vector<SceneMeshRange>& getMeshRanges() const { return m_meshRanges; }
+    float getTime() const { return m_time; }
+    const MeshOptimizationStats& getMeshOptimizationStats() const { return m_meshOptimizationStats; }
+
+    // Every mesh is a child of one root node, placed by GLTFMesh::transform.
+    // Once the simulation starts the graph belongs to its thread, which edits
+    // it between updates; other threads only see the matrices it publishes.
+    SceneGraph& getSceneGraph() { return m_graph; }
+    const std::vector<uint32_t>& getMeshNodes() const { return m_meshNodes; } // Parallel to m_meshes
+    uint32_t getRootNode() const { return ROOT_NODE; }
+
+    // Copies the mesh world matrices unless transforms already holds this
+    // graph version
+    void captureTransforms(SceneTransforms& transforms) const;
 
 private:
     bool loadCityModel();
     void createBasicCity();
+    void optimizeMeshes();
+    void buildSceneGraph();
     void createBuilding(const glm::vec3& position, const glm::vec3& size, const glm::vec3& color);
     void createGround();
     void createNeonLights();
@@ -52,7 +95,15 @@ private:
     std::vector<GLTFMesh> m_meshes;
     std::vector<GLTFVertex> m_vertices;
     std::vector<uint32_t> m_indices;
+    std::vector<SceneMeshRange> m_meshRanges; // Parallel to m_meshes
+    SceneGraph m_graph;
+    std::vector<uint32_t> m_meshNodes;
     
+    JobSystem* m_jobSystem;
     GLTFModel m_cityModel;
     float m_time;
+    MeshOptimization m_meshOptimization = MeshOptimization::VertexCache;
+    MeshOptimizationStats m_meshOptimizationStats;
+
+    static constexpr uint32_t ROOT_NODE = 0;
 };
@@ -0,0 +1,167 @@
+#include "SceneGraph.h"
+#include "CpuSimd.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+glm::mat4 composeLocal(const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale) {
+    glm::mat3 basis = glm::mat3_cast(rotation);
+    return glm::mat4(glm::vec4(basis[0] * scale.x, 0.0f),
+                     glm::vec4(basis[1] * scale.y, 0.0f),
+                     glm::vec4(basis[2] * scale.z, 0.0f),
+                     glm::vec4(translation, 1.0f));
+}
+
+void decomposeLocal(const glm::mat4& local, glm::vec3& translation, glm::quat& rotation, glm::vec3& scale) {
+    translation = glm::vec3(local[3]);
+    glm::mat3 basis(local);
+    scale = glm::vec3(glm::length(basis[0]), glm::length(basis[1]), glm::length(basis[2]));
+    // A mirroring matrix keeps a proper rotation by flipping one axis
+    if (glm::determinant(basis) < 0.0f) {
+        scale.x = -scale.x;
+    }
+    for (int axis = 0; axis < 3; ++axis) {
+        if (scale[axis] != 0.0f) {
+            basis[axis] /= scale[axis];
+        }
+    }
+    rotation = glm::normalize(glm::quat_cast(basis));
+}
+
+// out = a * b, one column of out per iteration as a weighted sum of a's
+// columns. out must not alias a or b.
+void multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& out) {
+    using simd::Float4;
+    const Float4 a0 = Float4::load(&a[0][0]);
+    const Float4 a1 = Float4::load(&a[1][0]);
+    const Float4 a2 = Float4::load(&a[2][0]);
+    const Float4 a3 = Float4::load(&a[3][0]);
+    for (int column = 0; column < 4; ++column) {
+        const glm::vec4& weights = b[column];
+        Float4 result = a0 * Float4::broadcast(weights.x) + a1 * Float4::broadcast(weights.y) +
+                        a2 * Float4::broadcast(weights.z) + a3 * Float4::broadcast(weights.w);
+        result.store(&out[column][0]);
+    }
+}
+
+} // namespace
+
+void SceneGraph::clear() {
+    m_parents.clear();
+    m_subtreeEnds.clear();
+    m_translations.clear();
+    m_rotations.clear();
+    m_scales.clear();
+    m_worlds.clear();
+    m_dirty.clear();
+    m_dirtyNodes.clear();
+    m_changedNodes.clear();
+    ++m_version;
+}
+
+void SceneGraph::reserve(uint32_t count) {
+    m_parents.reserve(count);
+    m_subtreeEnds.reserve(count);
+    m_translations.reserve(count);
+    m_rotations.reserve(count);
+    m_scales.reserve(count);
+    m_worlds.reserve(count);
+    m_dirty.reserve(count);
+}
+
+uint32_t SceneGraph::addNode(uint32_t parent, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale) {
+    uint32_t node = getNodeCount();
+    // Only the open path ends at the current node count
+    if (parent != NO_PARENT && (parent >= node || m_subtreeEnds[parent] != node)) {
+        throw std::runtime_error("failed to add scene graph node: parent must be the last node or one of its ancestors");
+    }
+
+    m_parents.push_back(parent);
+    m_subtreeEnds.push_back(node + 1);
+    m_translations.push_back(translation);
+    m_rotations.push_back(rotation);
+    m_scales.push_back(scale);
+    m_worlds.emplace_back(1.0f);
+    m_dirty.push_back(0);
+    for (uint32_t ancestor = parent; ancestor != NO_PARENT; ancestor = m_parents[ancestor]) {
+        m_subtreeEnds[ancestor] = node + 1;
+    }
+    markDirty(node);
+    return node;
+}
+
+uint32_t SceneGraph::addNode(uint32_t parent, const glm::mat4& local) {
+    glm::vec3 translation;
+    glm::quat rotation;
+    glm::vec3 scale;
+    decomposeLocal(local, translation, rotation, scale);
+    return addNode(parent, translation, rotation, scale);
+}
+
+void SceneGraph::setTranslation(uint32_t node, const glm::vec3& translation) {
+    m_translations[node] = translation;
+    markDirty(node);
+}
+
+void SceneGraph::setRotation(uint32_t node, const glm::quat& rotation) {
+    m_rotations[node] = rotation;
+    markDirty(node);
+}
+
+void SceneGraph::setScale(uint32_t node, const glm::vec3& scale) {
+    m_scales[node] = scale;
+    markDirty(node);
+}
+
+void SceneGraph::setLocalTransform(uint32_t node, const glm::mat4& local) {
+    decomposeLocal(local, m_translations[node], m_rotations[node], m_scales[node]);
+    markDirty(node);
+}
+
+void SceneGraph::markDirty(uint32_t node) {
+    if (!m_dirty[node]) {
+        m_dirty[node] = 1;
+        m_dirtyNodes.push_back(node);
+    }
+}
+
+bool SceneGraph::update() {
+    m_changedNodes.clear();
+    if (m_dirtyNodes.empty()) {
+        return false;
+    }
+
+    // In index order a dirty node inside an earlier dirty subtree is
+    // recomputed with it, so every world matrix is written once
+    std::sort(m_dirtyNodes.begin(), m_dirtyNodes.end());
+    uint32_t coveredEnd = 0;
+    for (uint32_t root : m_dirtyNodes) {
+        if (root < coveredEnd) {
+            continue;
+        }
+        coveredEnd = m_subtreeEnds[root];
+        for (uint32_t node = root; node < coveredEnd; ++node) {
+            glm::mat4 local = composeLocal(m_translations[node], m_rotations[node], m_scales[node]);
+            uint32_t parent = m_parents[node];
+            if (parent == NO_PARENT) {
+                m_worlds[node] = local;
+            } else {
+                multiply(m_worlds[parent], local, m_worlds[node]);
+            }
+            m_dirty[node] = 0;
+            m_changedNodes.push_back(node);
+        }
+    }
+    m_dirtyNodes.clear();
+    ++m_version;
+    return true;
+}
+
+void SceneGraph::writeTransform(const glm::mat4& world, VkTransformMatrixKHR& transform) {
+    for (int row = 0; row < 3; ++row) {
+        for (int column = 0; column < 4; ++column) {
+            transform.matrix[row][column] = world[column][row];
+        }
+    }
+}
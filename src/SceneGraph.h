@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Node hierarchy stored as parallel arrays in depth-first order: a parent
+// always precedes its children and every subtree is the contiguous range
+// [node, subtreeEnd). Local transforms are translation, rotation and scale;
+// setting one marks the node dirty, and update() recomputes the world
+// matrices of the dirty subtrees only, front to back, so each parent is final
+// before its children read it. Not thread-safe; Scene serializes access.
+class SceneGraph {
+public:
+    static constexpr uint32_t NO_PARENT = ~0u;
+
+    void clear();
+    void reserve(uint32_t count);
+
+    // Appends a node; parent is NO_PARENT for a root, otherwise the last node
+    // added or one of its ancestors, which keeps the order depth-first
+    uint32_t addNode(uint32_t parent, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale);
+    // The matrix is split into translation, rotation and scale, so shear is lost
+    uint32_t addNode(uint32_t parent, const glm::mat4& local);
+
+    void setTranslation(uint32_t node, const glm::vec3& translation);
+    void setRotation(uint32_t node, const glm::quat& rotation);
+    void setScale(uint32_t node, const glm::vec3& scale);
+    void setLocalTransform(uint32_t node, const glm::mat4& local);
+
+    // Returns false when nothing was dirty. The nodes whose world matrix
+    // changed are listed by getChangedNodes() until the next update.
+    bool update();
+
+    // Row-major 3x4 form of a world matrix, as TLAS instances take it
+    static void writeTransform(const glm::mat4& world, VkTransformMatrixKHR& transform);
+
+    uint32_t getNodeCount() const { return static_cast<uint32_t>(m_parents.size()); }
+    uint32_t getParent(uint32_t node) const { return m_parents[node]; }
+    uint32_t getSubtreeEnd(uint32_t node) const { return m_subtreeEnds[node]; }
+    const glm::vec3& getTranslation(uint32_t node) const { return m_translations[node]; }
+    const glm::quat& getRotation(uint32_t node) const { return m_rotations[node]; }
+    const glm::vec3& getScale(uint32_t node) const { return m_scales[node]; }
+    // Valid after update()
+    const glm::mat4& getWorldMatrix(uint32_t node) const { return m_worlds[node]; }
+    const std::vector<uint32_t>& getChangedNodes() const { return m_changedNodes; }
+    // Bumped by every update() that changed a world matrix
+    uint64_t getVersion() const { return m_version; }
+
+private:
+    void markDirty(uint32_t node);
+
+    std::vector<uint32_t> m_parents;
+    std::vector<uint32_t> m_subtreeEnds; // One past the node's last descendant
+    std::vector<glm::vec3> m_translations;
+    std::vector<glm::quat> m_rotations;
+    std::vector<glm::vec3> m_scales;
+    std::vector<glm::mat4> m_worlds;
+    std::vector<uint8_t> m_dirty;
+    std::vector<uint32_t> m_dirtyNodes; // Each dirty node once, in marking order
+    std::vector<uint32_t> m_changedNodes;
+    uint64_t m_version = 0;
+};
@@ -0,0 +1,511 @@
+#include "SceneRaycaster.h"
+#include "GLTFLoader.h"
+#include "JobSystem.h"
+#include "Scene.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <mutex>
+
+namespace {
+
+using simd::FloatPacket;
+
+constexpr float DIRECTION_EPSILON = 1.0e-12f;
+
+float safeInverse(float x) {
+    if (std::fabs(x) < DIRECTION_EPSILON) {
+        x = std::copysign(DIRECTION_EPSILON, x);
+    }
+    return 1.0f / x;
+}
+
+glm::vec3 safeInverse(const glm::vec3& direction) {
+    return glm::vec3(safeInverse(direction.x), safeInverse(direction.y), safeInverse(direction.z));
+}
+
+bool intersectBox(const glm::vec3& boxMin, const glm::vec3& boxMax, const glm::vec3& origin, const glm::vec3& inverse,
+                  float tMin, float tMax, float& tNear) {
+    glm::vec3 t0 = (boxMin - origin) * inverse;
+    glm::vec3 t1 = (boxMax - origin) * inverse;
+    glm::vec3 nearT = glm::min(t0, t1);
+    glm::vec3 farT = glm::max(t0, t1);
+    tNear = std::max(std::max(nearT.x, nearT.y), std::max(nearT.z, tMin));
+    float tFar = std::min(std::min(farT.x, farT.y), std::min(farT.z, tMax));
+    return tNear <= tFar;
+}
+
+// Rays of a packet in SoA form with their inverse directions for box tests
+struct PacketRays {
+    float originX[CpuRayPacket::WIDTH], originY[CpuRayPacket::WIDTH], originZ[CpuRayPacket::WIDTH];
+    float directionX[CpuRayPacket::WIDTH], directionY[CpuRayPacket::WIDTH], directionZ[CpuRayPacket::WIDTH];
+    FloatPacket inverse[3];
+    FloatPacket originScaled[3];
+
+    PacketRays(const CpuRay* rays, uint32_t count) {
+        float inverseValues[3][CpuRayPacket::WIDTH];
+        for (uint32_t lane = 0; lane < CpuRayPacket::WIDTH; ++lane) {
+            // Unused lanes repeat the first ray; they are never active
+            const CpuRay& ray = rays[lane < count ? lane : 0];
+            originX[lane] = ray.origin.x;
+            originY[lane] = ray.origin.y;
+            originZ[lane] = ray.origin.z;
+            directionX[lane] = ray.direction.x;
+            directionY[lane] = ray.direction.y;
+            directionZ[lane] = ray.direction.z;
+            glm::vec3 inverseDirection = safeInverse(ray.direction);
+            for (int axis = 0; axis < 3; ++axis) {
+                inverseValues[axis][lane] = inverseDirection[axis];
+            }
+        }
+        const float* origins[3] = {originX, originY, originZ};
+        for (int axis = 0; axis < 3; ++axis) {
+            inverse[axis] = FloatPacket::load(inverseValues[axis]);
+            originScaled[axis] = FloatPacket::load(origins[axis]) * inverse[axis];
+        }
+    }
+
+    // Lanes whose interval [tMin, tMax] overlaps the box
+    uint32_t testBox(const glm::vec3& boxMin, const glm::vec3& boxMax, FloatPacket tMin, FloatPacket tMax) const {
+        FloatPacket tNear = tMin;
+        FloatPacket tFar = tMax;
+        for (int axis = 0; axis < 3; ++axis) {
+            FloatPacket t0 = FloatPacket::broadcast(boxMin[axis]) * inverse[axis] - originScaled[axis];
+            FloatPacket t1 = FloatPacket::broadcast(boxMax[axis]) * inverse[axis] - originScaled[axis];
+            tNear = simd::max(tNear, simd::min(t0, t1));
+            tFar = simd::min(tFar, simd::max(t0, t1));
+        }
+        return (tNear <= tFar).bits();
+    }
+};
+
+// The lanes of packet in an instance's mesh space
+CpuRayPacket toMeshSpace(const PacketRays& packet, const glm::mat4& inverse, bool identity, uint32_t activeMask,
+                         const float* tMin, const float* tMax) {
+    CpuRayPacket local;
+    local.activeMask = activeMask;
+    for (uint32_t lane = 0; lane < CpuRayPacket::WIDTH; ++lane) {
+        glm::vec3 origin(packet.originX[lane], packet.originY[lane], packet.originZ[lane]);
+        glm::vec3 direction(packet.directionX[lane], packet.directionY[lane], packet.directionZ[lane]);
+        if (!identity) {
+            origin = glm::vec3(inverse * glm::vec4(origin, 1.0f));
+            direction = glm::mat3(inverse) * direction;
+        }
+        local.originX[lane] = origin.x;
+        local.originY[lane] = origin.y;
+        local.originZ[lane] = origin.z;
+        local.directionX[lane] = direction.x;
+        local.directionY[lane] = direction.y;
+        local.directionZ[lane] = direction.z;
+        local.tMin[lane] = tMin[lane];
+        local.tMax[lane] = tMax[lane];
+    }
+    return local;
+}
+
+} // namespace
+
+void SceneRaycaster::build(const std::vector<GLTFVertex>& vertices, const std::vector<uint32_t>& indices,
+                           const std::vector<SceneMeshRange>& ranges, JobSystem* jobs) {
+    auto start = std::chrono::steady_clock::now();
+
+    // Built without the lock: waiting on the jobs may run queries on this thread
+    std::vector<Instance> instances(ranges.size());
+    std::vector<glm::vec3> positions(vertices.size());
+    parallelFor(jobs, static_cast<uint32_t>(vertices.size()), 16 * 1024, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            positions[i] = vertices[i].position;
+        }
+    });
+
+    // One mesh per job; large meshes also split their own build across workers
+    parallelFor(jobs, static_cast<uint32_t>(ranges.size()), 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            const SceneMeshRange& range = ranges[i];
+            if (range.indexCount < 3) {
+                continue;
+            }
+            std::vector<uint32_t> triangles(range.indexCount / 3);
+            for (uint32_t triangle = 0; triangle < triangles.size(); ++triangle) {
+                triangles[triangle] = range.firstIndex / 3 + triangle;
+            }
+            Instance& instance = instances[i];
+            instance.bvh.build(vertices, indices, triangles, jobs);
+
+            glm::vec3 boundsMin(std::numeric_limits<float>::max());
+            glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+            for (uint32_t index = range.firstIndex; index < range.firstIndex + triangles.size() * 3; ++index) {
+                boundsMin = glm::min(boundsMin, positions[indices[index]]);
+                boundsMax = glm::max(boundsMax, positions[indices[index]]);
+            }
+            instance.localMin = instance.worldMin = boundsMin;
+            instance.localMax = instance.worldMax = boundsMax;
+        }
+    });
+
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    m_instances = std::move(instances);
+    m_positions = std::move(positions);
+    m_indices = indices;
+    m_order.clear();
+    uint32_t triangleCount = 0;
+    for (uint32_t i = 0; i < m_instances.size(); ++i) {
+        if (!m_instances[i].bvh.isEmpty()) {
+            m_order.push_back(i);
+            triangleCount += m_instances[i].bvh.getStats().triangleCount;
+        }
+    }
+    m_topNodes.clear();
+    if (!m_order.empty()) {
+        m_topNodes.reserve(2 * m_order.size());
+        m_topNodes.emplace_back();
+        buildTopLevel(0, 0, static_cast<uint32_t>(m_order.size()));
+        refitTopLevel();
+    }
+
+    m_transformVersion = 0;
+    m_stats = {};
+    m_stats.instanceCount = static_cast<uint32_t>(m_instances.size());
+    m_stats.triangleCount = triangleCount;
+    m_stats.buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Median split on the longest axis of the instance centers. The topology is
+// kept when instances move, so it is only as good as the layout at build time.
+void SceneRaycaster::buildTopLevel(uint32_t nodeIndex, uint32_t first, uint32_t count) {
+    if (count <= TOP_LEAF_SIZE) {
+        m_topNodes[nodeIndex].first = first;
+        m_topNodes[nodeIndex].count = count;
+        return;
+    }
+
+    auto center = [this](uint32_t instance) {
+        return 0.5f * (m_instances[instance].worldMin + m_instances[instance].worldMax);
+    };
+    glm::vec3 centerMin(std::numeric_limits<float>::max());
+    glm::vec3 centerMax(std::numeric_limits<float>::lowest());
+    for (uint32_t i = first; i < first + count; ++i) {
+        centerMin = glm::min(centerMin, center(m_order[i]));
+        centerMax = glm::max(centerMax, center(m_order[i]));
+    }
+    glm::vec3 extent = centerMax - centerMin;
+    int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+    uint32_t middle = first + count / 2;
+    std::nth_element(m_order.begin() + first, m_order.begin() + middle, m_order.begin() + first + count,
+                     [&](uint32_t a, uint32_t b) { return center(a)[axis] < center(b)[axis]; });
+
+    uint32_t left = static_cast<uint32_t>(m_topNodes.size());
+    m_topNodes.resize(left + 2);
+    m_topNodes[nodeIndex].left = left;
+    m_topNodes[nodeIndex].count = 0;
+    buildTopLevel(left, first, middle - first);
+    buildTopLevel(left + 1, middle, first + count - middle);
+}
+
+void SceneRaycaster::refitTopLevel() {
+    for (size_t i = m_topNodes.size(); i-- > 0;) {
+        TopNode& node = m_topNodes[i];
+        if (node.count > 0) {
+            node.min = glm::vec3(std::numeric_limits<float>::max());
+            node.max = glm::vec3(std::numeric_limits<float>::lowest());
+            for (uint32_t j = node.first; j < node.first + node.count; ++j) {
+                node.min = glm::min(node.min, m_instances[m_order[j]].worldMin);
+                node.max = glm::max(node.max, m_instances[m_order[j]].worldMax);
+            }
+        } else {
+            node.min = glm::min(m_topNodes[node.left].min, m_topNodes[node.left + 1].min);
+            node.max = glm::max(m_topNodes[node.left].max, m_topNodes[node.left + 1].max);
+        }
+    }
+}
+
+void SceneRaycaster::updateInstance(uint32_t instance, const glm::mat4& transform) {
+    Instance& target = m_instances.at(instance);
+    target.transform = transform;
+    target.inverse = glm::inverse(transform);
+    target.identity = transform == glm::mat4(1.0f);
+
+    // Transformed box from the center and the absolute linear part (Arvo)
+    glm::vec3 center = 0.5f * (target.localMin + target.localMax);
+    glm::vec3 halfExtent = 0.5f * (target.localMax - target.localMin);
+    glm::vec3 worldCenter = glm::vec3(transform * glm::vec4(center, 1.0f));
+    glm::vec3 worldHalfExtent(0.0f);
+    for (int column = 0; column < 3; ++column) {
+        worldHalfExtent += glm::abs(glm::vec3(transform[column])) * halfExtent[column];
+    }
+    target.worldMin = worldCenter - worldHalfExtent;
+    target.worldMax = worldCenter + worldHalfExtent;
+}
+
+void SceneRaycaster::setInstanceTransform(uint32_t instance, const glm::mat4& transform) {
+    setInstanceTransforms(&instance, &transform, 1);
+}
+
+void SceneRaycaster::setInstanceTransforms(const uint32_t* instances, const glm::mat4* transforms, uint32_t count) {
+    auto start = std::chrono::steady_clock::now();
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    for (uint32_t i = 0; i < count; ++i) {
+        updateInstance(instances[i], transforms[i]);
+    }
+    refitTopLevel();
+    m_stats.refitMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void SceneRaycaster::syncTransforms(const SceneTransforms& transforms) {
+    auto start = std::chrono::steady_clock::now();
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    if (transforms.version == m_transformVersion) {
+        return;
+    }
+    m_transformVersion = transforms.version;
+
+    uint32_t count = static_cast<uint32_t>(std::min(transforms.meshWorlds.size(), m_instances.size()));
+    bool moved = false;
+    for (uint32_t i = 0; i < count; ++i) {
+        if (m_instances[i].transform != transforms.meshWorlds[i]) {
+            updateInstance(i, transforms.meshWorlds[i]);
+            moved = true;
+        }
+    }
+    if (moved) {
+        refitTopLevel();
+        m_stats.refitMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+glm::mat4 SceneRaycaster::getInstanceTransform(uint32_t instance) const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    return m_instances.at(instance).transform;
+}
+
+RaycastStats SceneRaycaster::getStats() const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    return m_stats;
+}
+
+// Rays enter mesh space unnormalized, so hit distances need no conversion
+bool SceneRaycaster::castRay(const CpuRay& ray, RaycastHit& hit) const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    hit = {};
+    if (m_topNodes.empty()) {
+        return false;
+    }
+
+    glm::vec3 inverse = safeInverse(ray.direction);
+    float tMax = ray.tMax;
+    uint32_t stack[TOP_STACK_SIZE];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const TopNode& node = m_topNodes[stack[--stackSize]];
+        float tNear;
+        if (!intersectBox(node.min, node.max, ray.origin, inverse, ray.tMin, tMax, tNear)) {
+            continue;
+        }
+        if (node.count == 0) {
+            stack[stackSize++] = node.left + 1;
+            stack[stackSize++] = node.left;
+            continue;
+        }
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+            const Instance& instance = m_instances[m_order[i]];
+            CpuRay local = ray;
+            local.tMax = tMax;
+            if (!instance.identity) {
+                local.origin = glm::vec3(instance.inverse * glm::vec4(ray.origin, 1.0f));
+                local.direction = glm::mat3(instance.inverse) * ray.direction;
+            }
+            CpuHit localHit;
+            if (instance.bvh.intersect(local, localHit)) {
+                tMax = localHit.t;
+                hit.t = localHit.t;
+                hit.instance = m_order[i];
+                hit.triangle = localHit.triangle;
+                hit.barycentrics = glm::vec2(localHit.u, localHit.v);
+            }
+        }
+    }
+    if (hit.isHit()) {
+        completeHit(ray, hit);
+    }
+    return hit.isHit();
+}
+
+bool SceneRaycaster::isOccluded(const CpuRay& ray) const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    if (m_topNodes.empty()) {
+        return false;
+    }
+
+    glm::vec3 inverse = safeInverse(ray.direction);
+    uint32_t stack[TOP_STACK_SIZE];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const TopNode& node = m_topNodes[stack[--stackSize]];
+        float tNear;
+        if (!intersectBox(node.min, node.max, ray.origin, inverse, ray.tMin, ray.tMax, tNear)) {
+            continue;
+        }
+        if (node.count == 0) {
+            stack[stackSize++] = node.left + 1;
+            stack[stackSize++] = node.left;
+            continue;
+        }
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+            const Instance& instance = m_instances[m_order[i]];
+            CpuRay local = ray;
+            if (!instance.identity) {
+                local.origin = glm::vec3(instance.inverse * glm::vec4(ray.origin, 1.0f));
+                local.direction = glm::mat3(instance.inverse) * ray.direction;
+            }
+            if (instance.bvh.occluded(local)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void SceneRaycaster::castRays(const CpuRay* rays, RaycastHit* hits, uint32_t count, JobSystem* jobs) const {
+    parallelFor(jobs, count, BATCH_GRAIN, [&](uint32_t begin, uint32_t end) {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        for (uint32_t i = begin; i < end; i += CpuRayPacket::WIDTH) {
+            castPacket(rays + i, hits + i, std::min(CpuRayPacket::WIDTH, end - i));
+        }
+    });
+}
+
+void SceneRaycaster::testOcclusion(const CpuRay* rays, uint8_t* occluded, uint32_t count, JobSystem* jobs) const {
+    parallelFor(jobs, count, BATCH_GRAIN, [&](uint32_t begin, uint32_t end) {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        for (uint32_t i = begin; i < end; i += CpuRayPacket::WIDTH) {
+            uint32_t packetSize = std::min(CpuRayPacket::WIDTH, end - i);
+            uint32_t mask = testPacket(rays + i, packetSize);
+            for (uint32_t lane = 0; lane < packetSize; ++lane) {
+                occluded[i + lane] = (mask >> lane) & 1u;
+            }
+        }
+    });
+}
+
+// The packet walks the instance level together; each instance it reaches is
+// traced as one mesh-space packet of the lanes that overlap its box
+void SceneRaycaster::castPacket(const CpuRay* rays, RaycastHit* hits, uint32_t count) const {
+    constexpr uint32_t WIDTH = CpuRayPacket::WIDTH;
+    uint32_t activeMask = (count >= 32 ? 0u : (1u << count)) - 1u;
+    float laneMin[WIDTH];
+    float laneMax[WIDTH];
+    for (uint32_t lane = 0; lane < WIDTH; ++lane) {
+        if (lane < count) {
+            hits[lane] = {};
+        }
+        laneMin[lane] = lane < count ? rays[lane].tMin : 0.0f;
+        laneMax[lane] = lane < count ? rays[lane].tMax : -1.0f;
+    }
+    if (m_topNodes.empty()) {
+        return;
+    }
+
+    PacketRays packet(rays, count);
+    FloatPacket tMin = FloatPacket::load(laneMin);
+    uint32_t stack[TOP_STACK_SIZE];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const TopNode& node = m_topNodes[stack[--stackSize]];
+        uint32_t mask = packet.testBox(node.min, node.max, tMin, FloatPacket::load(laneMax)) & activeMask;
+        if (mask == 0) {
+            continue;
+        }
+        if (node.count == 0) {
+            stack[stackSize++] = node.left + 1;
+            stack[stackSize++] = node.left;
+            continue;
+        }
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+            const Instance& instance = m_instances[m_order[i]];
+            CpuRayPacket local = toMeshSpace(packet, instance.inverse, instance.identity, mask, laneMin, laneMax);
+            CpuPacketHit localHit;
+            instance.bvh.intersect(local, localHit);
+            for (uint32_t lane = 0; lane < count; ++lane) {
+                if (localHit.triangle[lane] != CpuHit::NONE) {
+                    laneMax[lane] = local.tMax[lane];
+                    hits[lane].t = local.tMax[lane];
+                    hits[lane].instance = m_order[i];
+                    hits[lane].triangle = localHit.triangle[lane];
+                    hits[lane].barycentrics = glm::vec2(localHit.u[lane], localHit.v[lane]);
+                }
+            }
+        }
+    }
+    for (uint32_t lane = 0; lane < count; ++lane) {
+        if (hits[lane].isHit()) {
+            completeHit(rays[lane], hits[lane]);
+        }
+    }
+}
+
+uint32_t SceneRaycaster::testPacket(const CpuRay* rays, uint32_t count) const {
+    constexpr uint32_t WIDTH = CpuRayPacket::WIDTH;
+    uint32_t activeMask = (count >= 32 ? 0u : (1u << count)) - 1u;
+    if (m_topNodes.empty()) {
+        return 0;
+    }
+
+    float laneMin[WIDTH];
+    float laneMax[WIDTH];
+    for (uint32_t lane = 0; lane < WIDTH; ++lane) {
+        laneMin[lane] = lane < count ? rays[lane].tMin : 0.0f;
+        laneMax[lane] = lane < count ? rays[lane].tMax : -1.0f;
+    }
+    PacketRays packet(rays, count);
+    FloatPacket tMin = FloatPacket::load(laneMin);
+    FloatPacket tMax = FloatPacket::load(laneMax);
+
+    uint32_t occludedMask = 0;
+    uint32_t stack[TOP_STACK_SIZE];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const TopNode& node = m_topNodes[stack[--stackSize]];
+        uint32_t mask = packet.testBox(node.min, node.max, tMin, tMax) & activeMask & ~occludedMask;
+        if (mask == 0) {
+            continue;
+        }
+        if (node.count == 0) {
+            stack[stackSize++] = node.left + 1;
+            stack[stackSize++] = node.left;
+            continue;
+        }
+        for (uint32_t i = node.first; i < node.first + node.count && mask != 0; ++i) {
+            const Instance& instance = m_instances[m_order[i]];
+            CpuRayPacket local = toMeshSpace(packet, instance.inverse, instance.identity, mask, laneMin, laneMax);
+            uint32_t blocked = instance.bvh.occluded(local);
+            occludedMask |= blocked;
+            mask &= ~blocked;
+        }
+        if (occludedMask == activeMask) {
+            break;
+        }
+    }
+    return occludedMask;
+}
+
+void SceneRaycaster::completeHit(const CpuRay& ray, RaycastHit& hit) const {
+    const Instance& instance = m_instances[hit.instance];
+    uint32_t base = hit.triangle * 3;
+    const glm::vec3& p0 = m_positions[m_indices[base + 0]];
+    const glm::vec3& p1 = m_positions[m_indices[base + 1]];
+    const glm::vec3& p2 = m_positions[m_indices[base + 2]];
+    glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+    if (!instance.identity) {
+        normal = glm::transpose(glm::mat3(instance.inverse)) * normal;
+    }
+    float length = glm::length(normal);
+    normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+    hit.normal = glm::dot(normal, ray.direction) > 0.0f ? -normal : normal;
+    hit.position = ray.origin + hit.t * ray.direction;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <shared_mutex>
+#include <vector>
+#include <glm/glm.hpp>
+#include "CpuBvh.h"
+
+class JobSystem;
+struct GLTFVertex;
+struct SceneMeshRange;
+struct SceneTransforms;
+
+// Closest hit of a scene query. The normal is the triangle's geometric
+// normal in world space, facing the ray origin.
+struct RaycastHit {
+    static constexpr uint32_t NONE = CpuHit::NONE;
+
+    float t = 0.0f;
+    uint32_t instance = NONE; // Scene mesh index, NONE on a miss
+    uint32_t triangle = NONE; // First index / 3 in the scene index buffer
+    glm::vec2 barycentrics{0.0f}; // Weights of the triangle's second and third vertex
+    glm::vec3 position{0.0f};
+    glm::vec3 normal{0.0f};
+
+    bool isHit() const { return instance != NONE; }
+};
+
+struct RaycastStats {
+    uint32_t instanceCount = 0;
+    uint32_t triangleCount = 0;
+    double buildMs = 0.0;
+    double refitMs = 0.0; // Last refit
+};
+
+// Ray queries against the scene on the CPU, for picking, ground clamping,
+// camera collision and line of sight. Every scene mesh is an instance with its
+// own CpuBvh in mesh space and a transform; the instances sit in a small
+// binary BVH that is refit when transforms change. Queries take a shared
+// lock and may run from any number of threads; build and transform updates
+// take it exclusively. Batches run on the job system with consecutive rays
+// traced as one SIMD packet, so coherent rays should be passed next to each
+// other. Each job of a batch locks on its own, so a transform update that
+// lands during a batch applies to the rays not traced yet.
+class SceneRaycaster {
+public:
+    // One instance per mesh range with an identity transform; ranges with
+    // fewer than three indices become empty instances that are never hit
+    void build(const std::vector<GLTFVertex>& vertices, const std::vector<uint32_t>& indices,
+               const std::vector<SceneMeshRange>& ranges, JobSystem* jobs);
+
+    // Places an instance's mesh-space geometry in the world and refits the
+    // instance level; the batch version refits once for all of them
+    void setInstanceTransform(uint32_t instance, const glm::mat4& transform);
+    void setInstanceTransforms(const uint32_t* instances, const glm::mat4* transforms, uint32_t count);
+    // Follows the scene graph: moves the instances whose matrix differs from
+    // Scene::captureTransforms() output, with one refit. Returns at once when
+    // this version was already applied.
+    void syncTransforms(const SceneTransforms& transforms);
+    glm::mat4 getInstanceTransform(uint32_t instance) const;
+
+    bool castRay(const CpuRay& ray, RaycastHit& hit) const;
+    // Any hit within the ray's interval
+    bool isOccluded(const CpuRay& ray) const;
+    // hits and occluded have count entries; occluded is 1 for blocked rays
+    void castRays(const CpuRay* rays, RaycastHit* hits, uint32_t count, JobSystem* jobs) const;
+    void testOcclusion(const CpuRay* rays, uint8_t* occluded, uint32_t count, JobSystem* jobs) const;
+
+    uint32_t getInstanceCount() const { return static_cast<uint32_t>(m_instances.size()); }
+    RaycastStats getStats() const;
+
+private:
+    struct Instance {
+        glm::mat4 transform{1.0f};
+        glm::mat4 inverse{1.0f};
+        glm::vec3 localMin{0.0f};
+        glm::vec3 localMax{0.0f};
+        glm::vec3 worldMin{0.0f};
+        glm::vec3 worldMax{0.0f};
+        bool identity = true; // Rays skip the transform
+        CpuBvh bvh;
+    };
+
+    // Binary node over instances. Children always follow their parent, so a
+    // reverse sweep refits bottom-up. Leaves own m_order[first, first + count).
+    struct TopNode {
+        glm::vec3 min;
+        glm::vec3 max;
+        uint32_t left = 0;  // Right child is stored at left + 1
+        uint32_t first = 0;
+        uint32_t count = 0; // Zero for inner nodes
+    };
+
+    void buildTopLevel(uint32_t nodeIndex, uint32_t first, uint32_t count);
+    void updateInstance(uint32_t instance, const glm::mat4& transform);
+    void refitTopLevel();
+
+    void castPacket(const CpuRay* rays, RaycastHit* hits, uint32_t count) const;
+    uint32_t testPacket(const CpuRay* rays, uint32_t count) const;
+    void completeHit(const CpuRay& ray, RaycastHit& hit) const;
+
+    mutable std::shared_mutex m_mutex;
+    std::vector<Instance> m_instances;
+    std::vector<TopNode> m_topNodes;
+    std::vector<uint32_t> m_order; // Non-empty instances in top-level leaf order
+    std::vector<glm::vec3> m_positions; // Mesh-space scene positions, for hit normals
+    std::vector<uint32_t> m_indices;
+    RaycastStats m_stats;
+    uint64_t m_transformVersion = 0; // Last SceneTransforms version synced
+
+    static constexpr uint32_t TOP_LEAF_SIZE = 2;
+    static constexpr uint32_t TOP_STACK_SIZE = 64;
+    static constexpr uint32_t BATCH_GRAIN = 64; // Rays per job, a multiple of every packet width
+};
@@ -1,10 +1,60 @@
 #include "ShaderManager.h"
+#include "JobSystem.h"
 #include <fstream>
 #include <iostream>
+#include <mutex>
 #include <stdexcept>
 #include <filesystem>
+#include <unordered_map>
+
+namespace {
+
+// SPIR-V read ahead by preloadShaders, keyed by canonical path
+std::mutex g_shaderCacheMutex;
+std::unordered_map<std::string, std::vector<char>> g_shaderCache;
+
+} // namespace
 
 std::vector<char> ShaderManager::readFile(const std::string& filename) {
+    {
+        std::lock_guard<std::mutex> lock(g_shaderCacheMutex);
+        auto cached = g_shaderCache.find(getCacheKey(filename));
+        if (cached != g_shaderCache.end()) {
+            return cached->second;
+        }
+    }
+    return readFileFromDisk(filename);
+}
+
+void ShaderManager::preloadShaders(JobSystem& jobs, const std::string& directory) {
+    std::vector<std::string> files;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+        if (entry.is_regular_file(ec) && entry.path().extension() == ".spv") {
+            files.push_back(entry.path().string());
+        }
+    }
+    if (files.empty()) {
+        return;
+    }
+
+    jobs.parallelFor(static_cast<uint32_t>(files.size()), 1, [&files](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            std::vector<char> code = readFileFromDisk(files[i]);
+            std::lock_guard<std::mutex> lock(g_shaderCacheMutex);
+            g_shaderCache[getCacheKey(files[i])] = std::move(code);
+        }
+    });
+    std::cout << "[ShaderManager] Preloaded " << files.size() << " shaders from " << directory << std::endl;
+}
+
+std::string ShaderManager::getCacheKey(const std::string& filename) {
+    std::error_code ec;
+    std::filesystem::path canonical = std::filesystem::weakly_canonical(filename, ec);
+    return ec ? filename : canonical.generic_string();
+}
+
+std::vector<char> ShaderManager::readFileFromDisk(const std::string& filename) {
     std::ifstream file(filename, std::ios::ate | std::ios::binary);
     if (!file.is_open()) {
         throw std::runtime_error("failed to open file: " + filename);
@@ -5,12 +5,21 @@
 #include <filesystem>
 #include <vulkan/vulkan.h>
 
+class JobSystem;
+
 class ShaderManager {
 public:
+    // Serves files preloaded by preloadShaders from memory, reads anything
+    // else (or still in flight) from disk
     static std::vector<char> readFile(const std::string& filename);
+    // Reads every SPIR-V file in directory on jobs, so startup can load
+    // shaders while the device is being created
+    static void preloadShaders(JobSystem& jobs, const std::string& directory = "shaders");
     static VkShaderModule createShaderModule(VkDevice device, const std::vector<char>& code);
     static VkShaderModule loadShader(VkDevice device, const std::string& filename);
     
 private:
     static std::filesystem::path getShaderPath(const std::string& filename);
+    static std::vector<char> readFileFromDisk(const std::string& filename);
+    static std::string getCacheKey(const std::string& filename);
 };
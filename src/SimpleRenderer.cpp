@@ -1,8 +1,12 @@
 #include "SimpleRenderer.h"
+#include "AccelerationStructureCache.h"
 #include "Camera.h"
+#include "CpuTracer.h"
 #include "Scene.h"
 #include "ShaderManager.h"
 #include "GLTFLoader.h"
+#include "GpuProfiler.h"
+#include "JobSystem.h"
 
 #include <vulkan/vulkan.h>
 #if defined(_WIN32)
@@ -12,14 +16,20 @@
 #include <windows.h>
 #include <vulkan/vulkan_win32.h>
 #endif
+#include <glm/gtc/packing.hpp>
 
 #include <array>
+#include <atomic>
 #include <chrono>
+#include <cmath>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <limits>
 #include <set>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 #include <algorithm>
 
@@ -42,7 +52,9 @@ const std::vector<const char*> kRequiredDeviceExtensions = {
     VK_KHR_SPIRV_1_4_EXTENSION_NAME,
     VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME,
     VK_KHR_SHADER_FLOAT_CONTROLS_EXTENSION_NAME,
-    VK_KHR_MAINTENANCE3_EXTENSION_NAME
+    VK_KHR_MAINTENANCE3_EXTENSION_NAME,
+    VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME,
+    VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME
 };
 
 VkTransformMatrixKHR makeIdentityTransformMatrix() {
@@ -53,6 +65,122 @@ VkTransformMatrixKHR makeIdentityTransformMatrix() {
     return matrix;
 }
 
+// VkAccelerationStructureInstanceKHR with named bitfields
+struct InstanceData {
+    VkTransformMatrixKHR transform;
+    uint32_t instanceCustomIndex : 24;
+    uint32_t mask : 8;
+    uint32_t instanceShaderBindingTableRecordOffset : 24;
+    uint32_t flags : 8;
+    uint64_t accelerationStructureReference;
+};
+
+// Places a mesh-space bounding sphere (center, radius) with a world matrix;
+// the radius grows with the largest axis scale
+glm::vec4 placeBoundingSphere(const glm::mat4& world, const glm::vec4& sphere) {
+    float scale = std::max({glm::length(glm::vec3(world[0])), glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))});
+    return glm::vec4(glm::vec3(world * glm::vec4(glm::vec3(sphere), 1.0f)), sphere.w * scale);
+}
+
+// Inverse of a rotation plus translation such as a lookAt view: the
+// transposed rotation and the translation rotated back and negated
+glm::mat4 inverseRigid(const glm::mat4& m) {
+    glm::mat3 rotation = glm::transpose(glm::mat3(m));
+    glm::mat4 inverse(rotation);
+    inverse[3] = glm::vec4(-(rotation * glm::vec3(m[3])), 1.0f);
+    return inverse;
+}
+
+// Inverse of a (possibly jittered, reverse-Z) perspective projection. Only
+// m[0][0], m[1][1], m[2][0..3] and m[3][2] are non-zero, which leaves a
+// closed form instead of a general 4x4 inverse.
+glm::mat4 inversePerspective(const glm::mat4& m) {
+    const float a = m[0][0];
+    const float b = m[1][1];
+    const float c = m[2][0];
+    const float d = m[2][1];
+    const float e = m[2][2];
+    const float s = m[2][3];
+    const float f = m[3][2];
+
+    glm::mat4 inverse(0.0f);
+    inverse[0][0] = 1.0f / a;
+    inverse[1][1] = 1.0f / b;
+    inverse[2][3] = 1.0f / f;
+    inverse[3][0] = -c / (a * s);
+    inverse[3][1] = -d / (b * s);
+    inverse[3][2] = 1.0f / s;
+    inverse[3][3] = -e / (f * s);
+    return inverse;
+}
+
+VkPresentModeKHR toVkPresentMode(PresentModePolicy policy) {
+    switch (policy) {
+    case PresentModePolicy::Immediate: return VK_PRESENT_MODE_IMMEDIATE_KHR;
+    case PresentModePolicy::Mailbox: return VK_PRESENT_MODE_MAILBOX_KHR;
+    case PresentModePolicy::Fifo:
+    default: return VK_PRESENT_MODE_FIFO_KHR;
+    }
+}
+
+const char* presentModeToString(VkPresentModeKHR mode) {
+    switch (mode) {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR: return "IMMEDIATE";
+    case VK_PRESENT_MODE_MAILBOX_KHR: return "MAILBOX";
+    case VK_PRESENT_MODE_FIFO_KHR: return "FIFO";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "FIFO_RELAXED";
+    default: return "UNKNOWN";
+    }
+}
+
+// FIFO is the only mode the spec guarantees, so every policy ends there.
+// IMMEDIATE prefers MAILBOX over FIFO since both avoid blocking on v-blank.
+VkPresentModeKHR selectPresentMode(PresentModePolicy policy, const std::vector<VkPresentModeKHR>& available) {
+    auto supported = [&](VkPresentModeKHR mode) {
+        return std::find(available.begin(), available.end(), mode) != available.end();
+    };
+
+    std::vector<VkPresentModeKHR> preference;
+    switch (policy) {
+    case PresentModePolicy::Immediate:
+        preference = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR};
+        break;
+    case PresentModePolicy::Mailbox:
+        preference = {VK_PRESENT_MODE_MAILBOX_KHR};
+        break;
+    case PresentModePolicy::Fifo:
+        break;
+    }
+
+    for (VkPresentModeKHR mode : preference) {
+        if (supported(mode)) {
+            return mode;
+        }
+    }
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+bool isDeviceExtensionSupported(VkPhysicalDevice device, const char* extensionName) {
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+    return std::any_of(availableExtensions.begin(), availableExtensions.end(), [&](const VkExtensionProperties& ext) {
+        return std::strcmp(ext.extensionName, extensionName) == 0;
+    });
+}
+
+// Per-frame diagnostics flood the console and dominate frame time once the
+// limiter is off, so they are opt-in like DEBUG_RT_COPY.
+bool isDebugRtLogEnabled() {
+    static const bool enabled = [] {
+        const char* env = std::getenv("DEBUG_RT_LOG");
+        return env && env[0] != '\0' && env[0] != '0';
+    }();
+    return enabled;
+}
+
 } // namespace
 
 namespace {
@@ -140,14 +268,36 @@ bool SimpleRenderer::isDeviceSuitable(VkPhysicalDevice device) {
     bufferAddressFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
     bufferAddressFeatures.pNext = &rtPipelineFeatures;
 
+    VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexing{};
+    descriptorIndexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+    descriptorIndexing.pNext = &bufferAddressFeatures;
+
     VkPhysicalDeviceFeatures2 deviceFeatures2{};
     deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
-    deviceFeatures2.pNext = &bufferAddressFeatures;
+    deviceFeatures2.pNext = &descriptorIndexing;
     vkGetPhysicalDeviceFeatures2(device, &deviceFeatures2);
 
+    // Everything createLogicalDevice() enables for the bindless scene set
+    bool descriptorIndexingSupported = descriptorIndexing.shaderSampledImageArrayNonUniformIndexing == VK_TRUE &&
+                                       descriptorIndexing.shaderStorageBufferArrayNonUniformIndexing == VK_TRUE &&
+                                       descriptorIndexing.descriptorBindingStorageBufferUpdateAfterBind == VK_TRUE &&
+                                       descriptorIndexing.descriptorBindingSampledImageUpdateAfterBind == VK_TRUE &&
+                                       descriptorIndexing.runtimeDescriptorArray == VK_TRUE &&
+                                       descriptorIndexing.descriptorBindingPartiallyBound == VK_TRUE &&
+                                       descriptorIndexing.descriptorBindingVariableDescriptorCount == VK_TRUE;
+
+    // The post chain writes BGRA swapchain images, which have no shader format
+    // qualifier; the rg16f motion target needs the extended storage formats,
+    // the culled raster path issues all its draws from one indirect call and
+    // the hit shaders read geometry through 64-bit buffer addresses
     return bufferAddressFeatures.bufferDeviceAddress == VK_TRUE &&
+           descriptorIndexingSupported &&
            accelFeatures.accelerationStructure == VK_TRUE &&
-           rtPipelineFeatures.rayTracingPipeline == VK_TRUE;
+           rtPipelineFeatures.rayTracingPipeline == VK_TRUE &&
+           deviceFeatures2.features.shaderStorageImageWriteWithoutFormat == VK_TRUE &&
+           deviceFeatures2.features.shaderStorageImageExtendedFormats == VK_TRUE &&
+           deviceFeatures2.features.multiDrawIndirect == VK_TRUE &&
+           deviceFeatures2.features.shaderInt64 == VK_TRUE;
 }
 
 VkDeviceAddress SimpleRenderer::getBufferDeviceAddress(VkBuffer buffer) const {
@@ -157,37 +307,137 @@ VkDeviceAddress SimpleRenderer::getBufferDeviceAddress(VkBuffer buffer) const {
     return vkGetBufferDeviceAddress(m_device, &addressInfo);
 }
 
-SimpleRenderer::SimpleRenderer(GLFWwindow* window)
+SimpleRenderer::SimpleRenderer(GLFWwindow* window, PresentModePolicy presentModePolicy, bool temporalUpscale, float renderScale, JobSystem* jobSystem)
     : m_window(window)
+    , m_jobSystem(jobSystem)
+    , m_presentModePolicy(presentModePolicy)
+    , m_presentMode(VK_PRESENT_MODE_FIFO_KHR)
     , m_graphicsQueueFamilyIndex(UINT32_MAX)
     , m_presentQueueFamilyIndex(UINT32_MAX)
+    , m_recordCpuMs(0.0)
     , m_currentFrame(0)
     , m_imageIndex(0)
+    , m_swapChainStorage(false)
+    , m_hdrImage(VK_NULL_HANDLE)
+    , m_hdrImageMemory(VK_NULL_HANDLE)
+    , m_hdrImageView(VK_NULL_HANDLE)
+    , m_motionImage(VK_NULL_HANDLE)
+    , m_motionImageMemory(VK_NULL_HANDLE)
+    , m_motionImageView(VK_NULL_HANDLE)
+    , m_renderExtent{0, 0}
+    , m_renderScale(temporalUpscale ? std::clamp(renderScale, MIN_RENDER_SCALE, 1.0f) : 1.0f)
+    , m_temporalUpscale(temporalUpscale)
+    , m_depthImage(VK_NULL_HANDLE)
+    , m_depthImageMemory(VK_NULL_HANDLE)
+    , m_depthImageView(VK_NULL_HANDLE)
+    , m_hizImage(VK_NULL_HANDLE)
+    , m_hizImageMemory(VK_NULL_HANDLE)
+    , m_hizImageView(VK_NULL_HANDLE)
+    , m_hizSampler(VK_NULL_HANDLE)
+    , m_hizSetLayout(VK_NULL_HANDLE)
+    , m_hizPipelineLayout(VK_NULL_HANDLE)
+    , m_hizPipeline(VK_NULL_HANDLE)
+    , m_hizDescriptorPool(VK_NULL_HANDLE)
+    , m_jitter(0.0f)
+    , m_jitterPhaseCount(BASE_JITTER_PHASES)
+    , m_prevViewProjection(1.0f)
+    , m_hasPrevViewProjection(false)
+    , m_renderPass(VK_NULL_HANDLE)
+    , m_loadRenderPass(VK_NULL_HANDLE)
+    , m_shadeRenderPass(VK_NULL_HANDLE)
+    , m_depthRenderPass(VK_NULL_HANDLE)
+    , m_depthLoadRenderPass(VK_NULL_HANDLE)
+    , m_hdrFramebuffer(VK_NULL_HANDLE)
+    , m_depthFramebuffer(VK_NULL_HANDLE)
+    , m_depthPrepass(false)
     , m_vertexBuffer(VK_NULL_HANDLE)
     , m_vertexBufferMemory(VK_NULL_HANDLE)
     , m_indexBuffer(VK_NULL_HANDLE)
     , m_indexBufferMemory(VK_NULL_HANDLE)
+    , m_graphicsPipeline(VK_NULL_HANDLE)
+    , m_depthPrepassPipeline(VK_NULL_HANDLE)
+    , m_depthEqualPipeline(VK_NULL_HANDLE)
+    , m_drawRecordBuffer(VK_NULL_HANDLE)
+    , m_drawRecordMemory(VK_NULL_HANDLE)
+    , m_indirectDrawBuffers{}
+    , m_indirectDrawMemory{}
+    , m_drawCountBuffers{}
+    , m_drawCountMemory{}
+    , m_drawVisibilityBuffer(VK_NULL_HANDLE)
+    , m_drawVisibilityMemory(VK_NULL_HANDLE)
+    , m_drawRecordCount(0)
+    , m_cullSetLayout(VK_NULL_HANDLE)
+    , m_cullPipelineLayout(VK_NULL_HANDLE)
+    , m_cullPipeline(VK_NULL_HANDLE)
+    , m_cullDescriptorPool(VK_NULL_HANDLE)
+    , m_meshletPath(MeshletPath::Off)
+    , m_meshShaderSupported(false)
+    , m_meshletCount(0)
+    , m_meshletIndexCount(0)
+    , m_meshletBuffer(VK_NULL_HANDLE)
+    , m_meshletMemory(VK_NULL_HANDLE)
+    , m_meshletVertexBuffer(VK_NULL_HANDLE)
+    , m_meshletVertexMemory(VK_NULL_HANDLE)
+    , m_meshletTriangleBuffer(VK_NULL_HANDLE)
+    , m_meshletTriangleMemory(VK_NULL_HANDLE)
+    , m_meshletVisibilityBuffer(VK_NULL_HANDLE)
+    , m_meshletVisibilityMemory(VK_NULL_HANDLE)
+    , m_meshletIndexBuffers{}
+    , m_meshletIndexMemory{}
+    , m_meshletDrawBuffers{}
+    , m_meshletDrawMemory{}
+    , m_meshletSetLayout(VK_NULL_HANDLE)
+    , m_meshletDescriptorPool(VK_NULL_HANDLE)
+    , m_meshletDescriptorSets{}
+    , m_meshletCullPipelineLayout(VK_NULL_HANDLE)
+    , m_meshletCullPipeline(VK_NULL_HANDLE)
+    , m_meshPipelineLayout(VK_NULL_HANDLE)
+    , m_meshPipeline(VK_NULL_HANDLE)
+    , m_clusterCountBuffer(VK_NULL_HANDLE)
+    , m_clusterCountMemory(VK_NULL_HANDLE)
+    , m_clusterLightBuffer(VK_NULL_HANDLE)
+    , m_clusterLightMemory(VK_NULL_HANDLE)
+    , m_clusterPipelineLayout(VK_NULL_HANDLE)
+    , m_clusterPipeline(VK_NULL_HANDLE)
+    , m_clusterParams{}
+    , m_meshInfoBuffer(VK_NULL_HANDLE)
+    , m_meshInfoBufferMemory(VK_NULL_HANDLE)
     , m_vertexCount(0)
     , m_indexCount(0)
     , m_instancesBuffer(VK_NULL_HANDLE)
     , m_instancesMemory(VK_NULL_HANDLE)
-    , m_rtStorageImage(VK_NULL_HANDLE)
-    , m_rtStorageMemory(VK_NULL_HANDLE)
-    , m_rtStorageImageView(VK_NULL_HANDLE)
-    , m_rtStorageFormat(VK_FORMAT_UNDEFINED)
     , m_rtDescriptorSetLayout(VK_NULL_HANDLE)
     , m_rtPipelineLayout(VK_NULL_HANDLE)
     , m_rtPipeline(VK_NULL_HANDLE)
     , m_rtDescriptorPool(VK_NULL_HANDLE)
     , m_rtShaderBindingTable(VK_NULL_HANDLE)
     , m_rtShaderBindingTableMemory(VK_NULL_HANDLE)
-    , m_rtReady(false) {
+    , m_rtReady(false)
+    , m_rayQuerySupported(false)
+    , m_rayQueryPipeline(VK_NULL_HANDLE)
+    , m_backend(RenderBackend::RayTracingPipeline)
+    , m_shadowsEnabled(true)
+    , m_frameCounter(0) {
     initVulkan();
 }
 
 SimpleRenderer::~SimpleRenderer() {
+    try {
+        joinRayTracingCompile();
+    } catch (const std::exception& e) {
+        std::cout << "[RT] Background pipeline compile failed: " << e.what() << std::endl;
+    }
+    try {
+        waitForCpuTracer();
+    } catch (const std::exception& e) {
+        std::cout << "[CPU] Background BVH build failed: " << e.what() << std::endl;
+    }
+    cleanupCpuUploadBuffers();
+    m_postProcess.reset();
+    cleanupDrawCullResources();
+    cleanupMeshletResources();
     cleanupRayTracingPipeline();
-    cleanupRayTracingStorageImage();
+    cleanupRayTracingLayouts();
     cleanupAccelerationStructures();
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         vkDestroySemaphore(m_device, m_renderFinishedSemaphores[i], nullptr);
@@ -199,32 +449,54 @@ SimpleRenderer::~SimpleRenderer() {
     vkFreeMemory(m_device, m_vertexBufferMemory, nullptr);
     vkDestroyBuffer(m_device, m_indexBuffer, nullptr);
     vkFreeMemory(m_device, m_indexBufferMemory, nullptr);
-    
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        vkDestroyBuffer(m_device, m_uniformBuffers[i], nullptr);
-        vkFreeMemory(m_device, m_uniformBuffersMemory[i], nullptr);
-        vkDestroyBuffer(m_device, m_lightingBuffers[i], nullptr);
-        vkFreeMemory(m_device, m_lightingBuffersMemory[i], nullptr);
+    vkDestroyBuffer(m_device, m_meshInfoBuffer, nullptr);
+    vkFreeMemory(m_device, m_meshInfoBufferMemory, nullptr);
+    vkDestroyBuffer(m_device, m_meshGeometryBuffer, nullptr);
+    vkFreeMemory(m_device, m_meshGeometryBufferMemory, nullptr);
+    vkDestroyBuffer(m_device, m_meshIndexBuffer, nullptr);
+    vkFreeMemory(m_device, m_meshIndexMemory, nullptr);
+    if (m_meshTransformsMapped) {
+        vkUnmapMemory(m_device, m_meshTransformMemory);
     }
+    vkDestroyBuffer(m_device, m_meshTransformBuffer, nullptr);
+    vkFreeMemory(m_device, m_meshTransformMemory, nullptr);
+
+    vkDestroyBuffer(m_device, m_frameConstantsBuffer, nullptr);
+    vkFreeMemory(m_device, m_frameConstantsMemory, nullptr);
+    vkDestroyBuffer(m_device, m_clusterCountBuffer, nullptr);
+    vkFreeMemory(m_device, m_clusterCountMemory, nullptr);
+    vkDestroyBuffer(m_device, m_clusterLightBuffer, nullptr);
+    vkFreeMemory(m_device, m_clusterLightMemory, nullptr);
+    vkDestroyPipeline(m_device, m_clusterPipeline, nullptr);
+    vkDestroyPipelineLayout(m_device, m_clusterPipelineLayout, nullptr);
     
     vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
     vkDestroyDescriptorSetLayout(m_device, m_descriptorSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, m_meshletSetLayout, nullptr);
+    vkDestroyPipeline(m_device, m_meshPipeline, nullptr);
+    vkDestroyPipelineLayout(m_device, m_meshPipelineLayout, nullptr);
     vkDestroyPipeline(m_device, m_graphicsPipeline, nullptr);
+    vkDestroyPipeline(m_device, m_depthPrepassPipeline, nullptr);
+    vkDestroyPipeline(m_device, m_depthEqualPipeline, nullptr);
     vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
     
+    cleanupFrameCommandPools();
     vkDestroyCommandPool(m_device, m_commandPool, nullptr);
     
-    for (auto framebuffer : m_swapChainFramebuffers) {
-        vkDestroyFramebuffer(m_device, framebuffer, nullptr);
+    vkDestroyFramebuffer(m_device, m_hdrFramebuffer, nullptr);
+    vkDestroyFramebuffer(m_device, m_depthFramebuffer, nullptr);
+    for (VkRenderPass renderPass : {m_renderPass, m_loadRenderPass, m_shadeRenderPass, m_depthRenderPass, m_depthLoadRenderPass}) {
+        vkDestroyRenderPass(m_device, renderPass, nullptr);
     }
-    
-    vkDestroyRenderPass(m_device, m_renderPass, nullptr);
+    cleanupDepthTarget();
+    cleanupHdrTarget();
     
     for (auto imageView : m_swapChainImageViews) {
         vkDestroyImageView(m_device, imageView, nullptr);
     }
     
     vkDestroySwapchainKHR(m_device, m_swapChain, nullptr);
+    m_profiler.reset();
     vkDestroyDevice(m_device, nullptr);
     vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
     vkDestroyInstance(m_instance, nullptr);
@@ -237,18 +509,34 @@ void SimpleRenderer::initVulkan() {
     createLogicalDevice();
     createSwapChain();
     createImageViews();
+    createCommandPool();
+    createFrameCommandPools();
+    createSyncObjects();
+    m_profiler = std::make_unique<GpuProfiler>(m_device, m_physicalDevice, m_graphicsQueueFamilyIndex, MAX_FRAMES_IN_FLIGHT);
+    createHdrTarget();
+    createDepthTarget();
     createRenderPass();
     createDescriptorSetLayout();
-    createGraphicsPipeline();
+
+    // Pipeline compilation dominates device setup: the raster pipelines and
+    // the post chain compile on workers while this thread creates the
+    // framebuffers, buffers and descriptors, which do not depend on them
+    JobCounter pipelinesCreated;
+    spawnJob([this]() { createGraphicsPipeline(); }, pipelinesCreated);
+    spawnJob([this]() {
+        m_postProcess = std::make_unique<PostProcess>(m_device, m_physicalDevice, m_hdrImageView, m_motionImageView,
+                                                      m_renderExtent, m_swapChainExtent, m_temporalUpscale,
+                                                      m_swapChainImages, m_swapChainImageViews,
+                                                      m_swapChainImageFormat, m_swapChainStorage);
+    }, pipelinesCreated);
     createFramebuffers();
-    createCommandPool();
-    createCommandBuffers();
-    createSyncObjects();
-    createUniformBuffers();
-    createLightingBuffers();
+    createFrameConstants();
+    createClusterResources();
     createDescriptorPool();
     createDescriptorSets();
     loadRayTracingFunctions();
+    createRayTracingLayouts();
+    waitJobs(pipelinesCreated);
     createAccelerationStructures();
 }
 
@@ -337,6 +625,10 @@ void SimpleRenderer::createLogicalDevice() {
     }
 
     VkPhysicalDeviceFeatures deviceFeatures{};
+    deviceFeatures.shaderStorageImageWriteWithoutFormat = VK_TRUE;
+    deviceFeatures.shaderStorageImageExtendedFormats = VK_TRUE;
+    deviceFeatures.multiDrawIndirect = VK_TRUE;
+    deviceFeatures.shaderInt64 = VK_TRUE; // Geometry addresses in the hit shaders
 
     VkPhysicalDeviceBufferDeviceAddressFeatures bufferAddressFeatures{};
     bufferAddressFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
@@ -345,6 +637,9 @@ void SimpleRenderer::createLogicalDevice() {
     VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexing{};
     descriptorIndexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
     descriptorIndexing.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    descriptorIndexing.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+    descriptorIndexing.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+    descriptorIndexing.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
     descriptorIndexing.runtimeDescriptorArray = VK_TRUE;
     descriptorIndexing.descriptorBindingPartiallyBound = VK_TRUE;
     descriptorIndexing.descriptorBindingVariableDescriptorCount = VK_TRUE;
@@ -360,14 +655,59 @@ void SimpleRenderer::createLogicalDevice() {
     rtPipelineFeatures.rayTracingPipeline = VK_TRUE;
     rtPipelineFeatures.pNext = &accelFeatures;
 
+    std::vector<const char*> deviceExtensions(kRequiredDeviceExtensions.begin(), kRequiredDeviceExtensions.end());
+    void* featureChain = &rtPipelineFeatures;
+
+    // Ray queries back the compute ray tracing path; optional so devices
+    // with only the pipeline extension keep working.
+    VkPhysicalDeviceRayQueryFeaturesKHR rayQueryFeatures{};
+    rayQueryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_QUERY_FEATURES_KHR;
+    m_rayQuerySupported = false;
+    if (isDeviceExtensionSupported(m_physicalDevice, VK_KHR_RAY_QUERY_EXTENSION_NAME)) {
+        VkPhysicalDeviceFeatures2 supportedFeatures{};
+        supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        supportedFeatures.pNext = &rayQueryFeatures;
+        vkGetPhysicalDeviceFeatures2(m_physicalDevice, &supportedFeatures);
+        m_rayQuerySupported = rayQueryFeatures.rayQuery == VK_TRUE;
+    }
+    if (m_rayQuerySupported) {
+        deviceExtensions.push_back(VK_KHR_RAY_QUERY_EXTENSION_NAME);
+        rayQueryFeatures.rayQuery = VK_TRUE;
+        rayQueryFeatures.pNext = featureChain;
+        featureChain = &rayQueryFeatures;
+    }
+    std::cout << "Ray query support: " << (m_rayQuerySupported ? "yes" : "no") << std::endl;
+
+    // Mesh shaders back the meshlet raster path; without them it culls in compute
+    VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures{};
+    meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+    m_meshShaderSupported = false;
+    if (isDeviceExtensionSupported(m_physicalDevice, VK_EXT_MESH_SHADER_EXTENSION_NAME)) {
+        VkPhysicalDeviceFeatures2 supportedFeatures{};
+        supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        supportedFeatures.pNext = &meshShaderFeatures;
+        vkGetPhysicalDeviceFeatures2(m_physicalDevice, &supportedFeatures);
+        m_meshShaderSupported = meshShaderFeatures.taskShader == VK_TRUE && meshShaderFeatures.meshShader == VK_TRUE;
+    }
+    if (m_meshShaderSupported) {
+        deviceExtensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+        meshShaderFeatures = VkPhysicalDeviceMeshShaderFeaturesEXT{};
+        meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+        meshShaderFeatures.taskShader = VK_TRUE;
+        meshShaderFeatures.meshShader = VK_TRUE;
+        meshShaderFeatures.pNext = featureChain;
+        featureChain = &meshShaderFeatures;
+    }
+    std::cout << "Mesh shader support: " << (m_meshShaderSupported ? "yes" : "no") << std::endl;
+
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-    createInfo.pNext = &rtPipelineFeatures;
+    createInfo.pNext = featureChain;
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     createInfo.pEnabledFeatures = &deviceFeatures;
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(kRequiredDeviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = kRequiredDeviceExtensions.data();
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
+    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
     createInfo.enabledLayerCount = 0;
 
     if (vkCreateDevice(m_physicalDevice, &createInfo, nullptr, &m_device) != VK_SUCCESS) {
@@ -376,6 +716,17 @@ void SimpleRenderer::createLogicalDevice() {
 
     vkGetDeviceQueue(m_device, graphicsFamily, 0, &m_graphicsQueue);
     vkGetDeviceQueue(m_device, presentFamily, 0, &m_presentQueue);
+
+    // Core in Vulkan 1.2, but the instance targets 1.0 so go through the extension
+    m_vkCmdDrawIndexedIndirectCountKHR = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+        vkGetDeviceProcAddr(m_device, "vkCmdDrawIndexedIndirectCountKHR"));
+    if (!m_vkCmdDrawIndexedIndirectCountKHR) {
+        throw std::runtime_error("vkCmdDrawIndexedIndirectCountKHR is not available on this device");
+    }
+    if (m_meshShaderSupported) {
+        m_vkCmdDrawMeshTasksEXT = reinterpret_cast<PFN_vkCmdDrawMeshTasksEXT>(vkGetDeviceProcAddr(m_device, "vkCmdDrawMeshTasksEXT"));
+        m_meshShaderSupported = m_vkCmdDrawMeshTasksEXT != nullptr;
+    }
 }
 
 void SimpleRenderer::createSwapChain() {
@@ -394,14 +745,33 @@ void SimpleRenderer::createSwapChain() {
         }
     }
 
+    // The post chain writes the swapchain from compute when it can. sRGB
+    // formats are rarely storage capable, so prefer a UNORM format and let
+    // the composite shader encode sRGB itself.
+    m_swapChainStorage = false;
+    if (capabilities.supportedUsageFlags & VK_IMAGE_USAGE_STORAGE_BIT) {
+        for (const auto& candidate : formats) {
+            if ((candidate.format != VK_FORMAT_B8G8R8A8_UNORM && candidate.format != VK_FORMAT_R8G8B8A8_UNORM) ||
+                candidate.colorSpace != VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
+                continue;
+            }
+            VkFormatProperties formatProperties;
+            vkGetPhysicalDeviceFormatProperties(m_physicalDevice, candidate.format, &formatProperties);
+            if (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) {
+                surfaceFormat = candidate;
+                m_swapChainStorage = true;
+                break;
+            }
+        }
+    }
+
     uint32_t presentModeCount;
     vkGetPhysicalDeviceSurfacePresentModesKHR(m_physicalDevice, m_surface, &presentModeCount, nullptr);
     std::vector<VkPresentModeKHR> presentModes(presentModeCount);
     vkGetPhysicalDeviceSurfacePresentModesKHR(m_physicalDevice, m_surface, &presentModeCount, presentModes.data());
-    VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
-    if (std::find(presentModes.begin(), presentModes.end(), VK_PRESENT_MODE_MAILBOX_KHR) != presentModes.end()) {
-        presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
-    }
+    VkPresentModeKHR presentMode = selectPresentMode(m_presentModePolicy, presentModes);
+    std::cout << "Present mode: " << presentModeToString(presentMode)
+              << " (requested " << presentModeToString(toVkPresentMode(m_presentModePolicy)) << ")" << std::endl;
 
     VkExtent2D extent = capabilities.currentExtent;
     if (extent.width == UINT32_MAX) {
@@ -422,7 +792,7 @@ void SimpleRenderer::createSwapChain() {
     createInfo.imageColorSpace = surfaceFormat.colorSpace;
     createInfo.imageExtent = extent;
     createInfo.imageArrayLayers = 1;
-    createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    createInfo.imageUsage = m_swapChainStorage ? VK_IMAGE_USAGE_STORAGE_BIT : VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 
     uint32_t queueFamilyIndices[] = {m_graphicsQueueFamilyIndex, m_presentQueueFamilyIndex};
     if (m_graphicsQueueFamilyIndex != m_presentQueueFamilyIndex) {
@@ -449,6 +819,7 @@ void SimpleRenderer::createSwapChain() {
 
     m_swapChainImageFormat = surfaceFormat.format;
     m_swapChainExtent = extent;
+    m_presentMode = presentMode;
 }
 
 void SimpleRenderer::createImageViews() {
@@ -476,68 +847,124 @@ void SimpleRenderer::createImageViews() {
     }
 }
 
+// The raster backend draws into the HDR and motion targets like the ray
+// traced backends, leaving them in GENERAL layout for the post chain.
 void SimpleRenderer::createRenderPass() {
-    VkAttachmentDescription colorAttachment{};
-    colorAttachment.format = m_swapChainImageFormat;
-    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-    
-    VkAttachmentReference colorAttachmentRef{};
-    colorAttachmentRef.attachment = 0;
-    colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    m_renderPass = createSceneRenderPass(true, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_LOAD_OP_CLEAR, false);
+    m_loadRenderPass = createSceneRenderPass(true, VK_ATTACHMENT_LOAD_OP_LOAD, VK_ATTACHMENT_LOAD_OP_LOAD, false);
+    m_shadeRenderPass = createSceneRenderPass(true, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_LOAD_OP_LOAD, true);
+    m_depthRenderPass = createSceneRenderPass(false, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_LOAD_OP_CLEAR, false);
+    m_depthLoadRenderPass = createSceneRenderPass(false, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_LOAD_OP_LOAD, false);
+}
+
+// HDR + motion + depth (or depth alone). Passes that load depth expect it in
+// DEPTH_STENCIL_READ_ONLY, which is also where every pass leaves it so the
+// Hi-Z build can sample it; color stays in GENERAL for the post chain.
+VkRenderPass SimpleRenderer::createSceneRenderPass(bool withColor, VkAttachmentLoadOp colorLoadOp, VkAttachmentLoadOp depthLoadOp, bool depthReadOnly) {
+    std::vector<VkAttachmentDescription> attachments;
+    std::vector<VkAttachmentReference> colorAttachmentRefs;
+    if (withColor) {
+        VkAttachmentDescription colorAttachment{};
+        colorAttachment.format = PostProcess::HDR_FORMAT;
+        colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        colorAttachment.loadOp = colorLoadOp;
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        colorAttachment.initialLayout = colorLoadOp == VK_ATTACHMENT_LOAD_OP_LOAD ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_UNDEFINED;
+        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_GENERAL;
+        attachments.push_back(colorAttachment);
+
+        colorAttachment.format = MOTION_FORMAT;
+        attachments.push_back(colorAttachment);
+
+        colorAttachmentRefs.push_back({0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+        colorAttachmentRefs.push_back({1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+    }
+
+    VkAttachmentDescription depthAttachment{};
+    depthAttachment.format = DEPTH_FORMAT;
+    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depthAttachment.loadOp = depthLoadOp;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.initialLayout = depthLoadOp == VK_ATTACHMENT_LOAD_OP_LOAD ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    attachments.push_back(depthAttachment);
+
+    VkAttachmentReference depthAttachmentRef{};
+    depthAttachmentRef.attachment = static_cast<uint32_t>(attachments.size() - 1);
+    depthAttachmentRef.layout = depthReadOnly ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
     
     VkSubpassDescription subpass{};
     subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpass.colorAttachmentCount = 1;
-    subpass.pColorAttachments = &colorAttachmentRef;
+    subpass.colorAttachmentCount = static_cast<uint32_t>(colorAttachmentRefs.size());
+    subpass.pColorAttachments = colorAttachmentRefs.data();
+    subpass.pDepthStencilAttachment = &depthAttachmentRef;
     
-    VkSubpassDependency dependency{};
-    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependency.dstSubpass = 0;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.srcAccessMask = 0;
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    // In: the previous frame's post chain may still be reading the color
+    // targets, the Hi-Z build reading depth, or an earlier pass writing it.
+    // Out: the post chain and the Hi-Z build read from compute, later passes
+    // load the attachments again.
+    constexpr VkPipelineStageFlags attachmentStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                                      VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                                                      VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    constexpr VkAccessFlags attachmentWrites = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    constexpr VkAccessFlags attachmentAccess = attachmentWrites | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                                               VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+
+    std::array<VkSubpassDependency, 2> dependencies{};
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = 0;
+    dependencies[0].srcStageMask = attachmentStages | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    dependencies[0].srcAccessMask = attachmentWrites;
+    dependencies[0].dstStageMask = attachmentStages;
+    dependencies[0].dstAccessMask = attachmentAccess;
+
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[1].srcStageMask = attachmentStages;
+    dependencies[1].srcAccessMask = attachmentWrites;
+    dependencies[1].dstStageMask = attachmentStages | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    dependencies[1].dstAccessMask = attachmentAccess | VK_ACCESS_SHADER_READ_BIT;
     
     VkRenderPassCreateInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassInfo.attachmentCount = 1;
-    renderPassInfo.pAttachments = &colorAttachment;
+    renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    renderPassInfo.pAttachments = attachments.data();
     renderPassInfo.subpassCount = 1;
     renderPassInfo.pSubpasses = &subpass;
-    renderPassInfo.dependencyCount = 1;
-    renderPassInfo.pDependencies = &dependency;
+    renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+    renderPassInfo.pDependencies = dependencies.data();
     
-    if (vkCreateRenderPass(m_device, &renderPassInfo, nullptr, &m_renderPass) != VK_SUCCESS) {
+    VkRenderPass renderPass;
+    if (vkCreateRenderPass(m_device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
         throw std::runtime_error("failed to create render pass!");
     }
+    return renderPass;
 }
 
 void SimpleRenderer::createFramebuffers() {
-    m_swapChainFramebuffers.resize(m_swapChainImageViews.size());
+    VkFramebufferCreateInfo framebufferInfo{};
+    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.renderPass = m_renderPass;
+    std::array<VkImageView, 3> attachments = {m_hdrImageView, m_motionImageView, m_depthImageView};
+    framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    framebufferInfo.pAttachments = attachments.data();
+    framebufferInfo.width = m_renderExtent.width;
+    framebufferInfo.height = m_renderExtent.height;
+    framebufferInfo.layers = 1;
     
-    for (size_t i = 0; i < m_swapChainImageViews.size(); i++) {
-        VkImageView attachments[] = {
-            m_swapChainImageViews[i]
-        };
-        
-        VkFramebufferCreateInfo framebufferInfo{};
-        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        framebufferInfo.renderPass = m_renderPass;
-        framebufferInfo.attachmentCount = 1;
-        framebufferInfo.pAttachments = attachments;
-        framebufferInfo.width = m_swapChainExtent.width;
-        framebufferInfo.height = m_swapChainExtent.height;
-        framebufferInfo.layers = 1;
-        
-        if (vkCreateFramebuffer(m_device, &framebufferInfo, nullptr, &m_swapChainFramebuffers[i]) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create framebuffer!");
-        }
+    if (vkCreateFramebuffer(m_device, &framebufferInfo, nullptr, &m_hdrFramebuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create framebuffer!");
+    }
+
+    framebufferInfo.renderPass = m_depthRenderPass;
+    framebufferInfo.attachmentCount = 1;
+    framebufferInfo.pAttachments = &m_depthImageView;
+    if (vkCreateFramebuffer(m_device, &framebufferInfo, nullptr, &m_depthFramebuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth framebuffer!");
     }
 }
 
@@ -552,17 +979,106 @@ void SimpleRenderer::createCommandPool() {
     }
 }
 
-void SimpleRenderer::createCommandBuffers() {
-    m_commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-    
-    VkCommandBufferAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.commandPool = m_commandPool;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandBufferCount = static_cast<uint32_t>(m_commandBuffers.size());
-    
-    if (vkAllocateCommandBuffers(m_device, &allocInfo, m_commandBuffers.data()) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate command buffers!");
+void SimpleRenderer::createFrameCommandPools() {
+    uint32_t workerCount = m_jobSystem ? m_jobSystem->getWorkerCount() : 1;
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT; // Reset as a whole every frame
+    poolInfo.queueFamilyIndex = m_graphicsQueueFamilyIndex;
+
+    m_recordContexts.assign(MAX_FRAMES_IN_FLIGHT, std::vector<CommandRecordContext>(workerCount));
+    m_submitCommandBuffers.assign(MAX_FRAMES_IN_FLIGHT, {});
+    for (auto& frameContexts : m_recordContexts) {
+        for (CommandRecordContext& context : frameContexts) {
+            if (vkCreateCommandPool(m_device, &poolInfo, nullptr, &context.pool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create frame command pool!");
+            }
+        }
+    }
+    std::cout << "[Renderer] Recording with " << workerCount << " command pools per frame" << std::endl;
+}
+
+void SimpleRenderer::cleanupFrameCommandPools() {
+    // Destroying a pool frees its command buffers
+    for (auto& frameContexts : m_recordContexts) {
+        for (CommandRecordContext& context : frameContexts) {
+            vkDestroyCommandPool(m_device, context.pool, nullptr);
+        }
+    }
+    m_recordContexts.clear();
+    m_submitCommandBuffers.clear();
+}
+
+void SimpleRenderer::resetFrameCommandPools(uint32_t frame) {
+    for (CommandRecordContext& context : m_recordContexts[frame]) {
+        vkResetCommandPool(m_device, context.pool, 0);
+        context.usedPrimaries = 0;
+        context.usedSecondaries = 0;
+    }
+    m_submitCommandBuffers[frame].clear();
+}
+
+// Hands out a buffer from the calling worker's pool for the current frame,
+// allocating one the first time a worker needs more than before
+VkCommandBuffer SimpleRenderer::acquireCommandBuffer(VkCommandBufferLevel level) {
+    int32_t workerIndex = m_jobSystem ? m_jobSystem->getCurrentWorkerIndex() : 0;
+    if (workerIndex < 0) {
+        throw std::runtime_error("command buffers can only be recorded on job system workers!");
+    }
+    CommandRecordContext& context = m_recordContexts[m_currentFrame][workerIndex];
+    bool primary = level == VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    std::vector<VkCommandBuffer>& buffers = primary ? context.primaries : context.secondaries;
+    uint32_t& used = primary ? context.usedPrimaries : context.usedSecondaries;
+
+    if (used == buffers.size()) {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = context.pool;
+        allocInfo.level = level;
+        allocInfo.commandBufferCount = 1;
+
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        if (vkAllocateCommandBuffers(m_device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate command buffers!");
+        }
+        buffers.push_back(commandBuffer);
+    }
+    return buffers[used++];
+}
+
+VkCommandBuffer SimpleRenderer::beginPrimaryCommandBuffer() {
+    VkCommandBuffer commandBuffer = acquireCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording command buffer!");
+    }
+    return commandBuffer;
+}
+
+// Jobs run inline when there is no job system
+void SimpleRenderer::spawnJob(std::function<void()> record, JobCounter& counter) {
+    if (m_jobSystem) {
+        m_jobSystem->spawn(std::move(record), &counter);
+    } else {
+        record();
+    }
+}
+
+// For work longer than a frame; waitJobs() in the frame never runs it inline
+void SimpleRenderer::spawnBackgroundJob(std::function<void()> job, JobCounter& counter) {
+    if (m_jobSystem) {
+        m_jobSystem->spawnBackground(std::move(job), &counter);
+    } else {
+        job();
+    }
+}
+
+void SimpleRenderer::waitJobs(JobCounter& counter) {
+    if (m_jobSystem) {
+        m_jobSystem->wait(counter);
     }
 }
 
@@ -597,39 +1113,62 @@ void SimpleRenderer::beginFrame() {
     }
     
     vkResetFences(m_device, 1, &m_inFlightFences[m_currentFrame]);
-}
+    resetFrameCommandPools(m_currentFrame);
 
-void SimpleRenderer::render(Camera* camera, Scene* scene) {
-    vkResetCommandBuffer(m_commandBuffers[m_currentFrame], 0);
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    if (vkBeginCommandBuffer(m_commandBuffers[m_currentFrame], &beginInfo) != VK_SUCCESS) {
-        throw std::runtime_error("failed to begin recording command buffer!");
+    // Switches to ray tracing between frames, never in the middle of one
+    if (m_rtCompilePending && m_rtCompileJobs->isDone()) {
+        waitForRayTracing();
+    }
+    if (m_cpuTracerPending && m_cpuTracerJobs->isDone()) {
+        waitForCpuTracer();
     }
+}
 
-    updateUniformBuffer(m_currentFrame, camera);
-    updateLightingBuffer(m_currentFrame);
+void SimpleRenderer::render(Camera* camera, float sceneTime, const SceneTransforms& transforms) {
+    auto recordStart = std::chrono::steady_clock::now();
+
+    m_jitter = m_temporalUpscale ? Camera::getJitterOffset(m_frameCounter, m_jitterPhaseCount) : glm::vec2(0.0f);
+    // The camera buffer is written by endFrame(); only the clip planes are
+    // needed now, recorded as push constants
+    m_clusterParams.zNear = camera ? camera->getNearPlane() : 0.1f;
+    m_clusterParams.zFar = camera ? camera->getFarPlane() : 100.0f;
+    m_clusterParams.time = sceneTime;
+    // Moves the emissive lights too, so before the lighting buffer is written
+    updateMeshTransforms(transforms);
+    updateLightingBuffer(m_currentFrame, m_clusterParams.time);
+
+    // The scene and the post chain are recorded in parallel into two
+    // primaries that are submitted together, scene first
+    VkCommandBuffer commandBuffer = beginPrimaryCommandBuffer();
+    m_profiler->beginFrame(commandBuffer, m_currentFrame);
+    updateTopLevelTransforms(commandBuffer, transforms);
+
+    JobCounter postRecorded;
+    VkCommandBuffer postCommandBuffer = VK_NULL_HANDLE;
+    uint32_t postFrameIndex = m_frameCounter++;
+    spawnJob([this, &postCommandBuffer, postFrameIndex]() {
+        postCommandBuffer = beginPrimaryCommandBuffer();
+        // TAAU, bloom, tone mapping and grading for every backend; writes and presents the swapchain image
+        m_postProcess->record(postCommandBuffer, m_imageIndex, postFrameIndex, m_jitter, m_postSettings, m_profiler.get());
+        if (vkEndCommandBuffer(postCommandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record post command buffer!");
+        }
+    }, postRecorded);
     static bool loggedNotReady = false;
     if (!m_rtReady && !loggedNotReady) {
         std::cout << "[RT] Resources not ready for ray tracing dispatch" << std::endl;
         loggedNotReady = true;
     }
 
-    // Start render pass for hybrid rendering
-    VkRenderPassBeginInfo renderPassInfo{};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = m_renderPass;
-    renderPassInfo.framebuffer = m_swapChainFramebuffers[m_imageIndex];
-    renderPassInfo.renderArea.offset = {0, 0};
-    renderPassInfo.renderArea.extent = m_swapChainExtent;
-    
-    VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
-    renderPassInfo.clearValueCount = 1;
-    renderPassInfo.pClearValues = &clearColor;
-    
-    vkCmdBeginRenderPass(m_commandBuffers[m_currentFrame], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    bool rtResourcesReady = m_rtReady && m_topLevelAS.handle != VK_NULL_HANDLE;
+    bool useRayTracingPipeline = rtResourcesReady && m_backend == RenderBackend::RayTracingPipeline && m_rtPipeline != VK_NULL_HANDLE;
+    bool useRayQuery = rtResourcesReady && m_backend == RenderBackend::RayQueryCompute && m_rayQueryPipeline != VK_NULL_HANDLE;
+    bool useCpuTracer = m_backend == RenderBackend::CpuReference && m_cpuTracer && !m_cpuTracerPending;
 
-    if (m_rtReady && m_rtPipeline != VK_NULL_HANDLE && m_topLevelAS.handle != VK_NULL_HANDLE && m_rtStorageImageView != VK_NULL_HANDLE) {
+    if (useCpuTracer) {
+        m_cpuTracer->syncTransforms(transforms, m_jobSystem);
+        recordCpuTrace(commandBuffer, camera);
+    } else if (useRayTracingPipeline || useRayQuery) {
         loggedNotReady = false;
         static int frameCount = 0;
         frameCount++;
@@ -641,199 +1180,379 @@ void SimpleRenderer::render(Camera* camera, Scene* scene) {
 
         if (debugCopyEnabled) {
             std::cout << "[RT][Debug] DEBUG_RT_COPY enabled - skipping ray dispatch" << std::endl;
-            vkCmdEndRenderPass(m_commandBuffers[m_currentFrame]);
-            VkImage swapchainImage = m_swapChainImages[m_imageIndex];
-            transitionImageLayout(swapchainImage,
-                                  m_swapChainImageFormat,
-                                  VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-                                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                  VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-                                  VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                  VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-                                  VK_ACCESS_TRANSFER_WRITE_BIT);
-            VkImageCopy copyRegion{};
-            copyRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            copyRegion.srcSubresource.baseArrayLayer = 0;
-            copyRegion.srcSubresource.layerCount = 1;
-            copyRegion.srcSubresource.mipLevel = 0;
-            copyRegion.dstSubresource = copyRegion.srcSubresource;
-            copyRegion.extent = {m_swapChainExtent.width, m_swapChainExtent.height, 1};
-            std::cout << "[RT][Debug] Copying storage image 0x" << std::hex << reinterpret_cast<uint64_t>(m_rtStorageImage)
-                      << " to swapchain image 0x" << reinterpret_cast<uint64_t>(swapchainImage) << std::dec << std::endl;
-            vkCmdCopyImage(m_commandBuffers[m_currentFrame],
-                           m_rtStorageImage, VK_IMAGE_LAYOUT_GENERAL,
-                           swapchainImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                           1, &copyRegion);
-            transitionImageLayout(swapchainImage,
-                                  m_swapChainImageFormat,
-                                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                  VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-                                  VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                  VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-                                  VK_ACCESS_TRANSFER_WRITE_BIT,
-                                  0);
-            std::cout << "[RT][Debug] Completed debug copy path" << std::endl;
-        }
-
-        if (!debugCopyEnabled && frameCount % 60 == 0) { // Log every 60 frames to avoid spam
-            std::cout << "[RT] Frame " << frameCount << " - Dispatching rays for main scene" << std::endl;
+        }
+
+        if (isDebugRtLogEnabled() && !debugCopyEnabled && frameCount % 60 == 0) { // Log every 60 frames to avoid spam
+            std::cout << "[RT] Frame " << frameCount << " - Dispatching rays for main scene (" << getBackendName(m_backend) << ")" << std::endl;
             std::cout << "[RT] Debug - Pipeline: " << (m_rtPipeline != VK_NULL_HANDLE ? "OK" : "NULL") << std::endl;
+            std::cout << "[RT] Debug - Ray Query Pipeline: " << (m_rayQueryPipeline != VK_NULL_HANDLE ? "OK" : "NULL") << std::endl;
             std::cout << "[RT] Debug - TLAS: " << (m_topLevelAS.handle != VK_NULL_HANDLE ? "OK" : "NULL") << std::endl;
-            std::cout << "[RT] Debug - Storage Image: " << (m_rtStorageImageView != VK_NULL_HANDLE ? "OK" : "NULL") << std::endl;
-            std::cout << "[RT] Debug - Descriptor Set: " << (m_rtDescriptorSets[m_currentFrame] != VK_NULL_HANDLE ? "OK" : "NULL") << std::endl;
+            std::cout << "[RT] Debug - Descriptor Set: " << (m_rtDescriptorSet != VK_NULL_HANDLE ? "OK" : "NULL") << std::endl;
             std::cout << "[RT] Debug - Raygen Region Address: " << m_rtRaygenRegion.deviceAddress << std::endl;
             std::cout << "[RT] Debug - Miss Region Address: " << m_rtMissRegion.deviceAddress << std::endl;
             std::cout << "[RT] Debug - Hit Region Address: " << m_rtHitRegion.deviceAddress << std::endl;
         }
         
         // Dispatch ray tracing to storage image
-        VkDescriptorSet rtSet = m_rtDescriptorSets[m_currentFrame];
+        VkDescriptorSet rtSet = m_rtDescriptorSet;
 
         static bool loggedBindings = false;
         if (!loggedBindings) {
             std::cout << "[RT][Debug] Binding pipeline for frame " << m_currentFrame << std::endl;
             std::cout << "[RT][Debug] Descriptor set handle: 0x" << std::hex << reinterpret_cast<uint64_t>(rtSet) << std::dec << std::endl;
-            std::cout << "[RT][Debug] Storage image view: 0x" << std::hex << reinterpret_cast<uint64_t>(m_rtStorageImageView) << std::dec << std::endl;
-            std::cout << "[RT][Debug] Storage image: 0x" << std::hex << reinterpret_cast<uint64_t>(m_rtStorageImage) << std::dec << std::endl;
+            std::cout << "[RT][Debug] HDR target view: 0x" << std::hex << reinterpret_cast<uint64_t>(m_hdrImageView) << std::dec << std::endl;
             std::cout << "[RT][Debug] TLAS address: 0x" << std::hex << m_topLevelAS.deviceAddress << std::dec << std::endl;
             loggedBindings = true;
         }
 
-        if (!debugCopyEnabled) {
-            vkCmdBindPipeline(m_commandBuffers[m_currentFrame], VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_rtPipeline);
-            vkCmdBindDescriptorSets(m_commandBuffers[m_currentFrame], VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_rtPipelineLayout, 0, 1, &rtSet, 0, nullptr);
-            m_vkCmdTraceRaysKHR(m_commandBuffers[m_currentFrame], &m_rtRaygenRegion, &m_rtMissRegion, &m_rtHitRegion, &m_rtCallableRegion, m_swapChainExtent.width, m_swapChainExtent.height, 1);
-            std::cout << "[RT][Debug] Dispatched rays: " << m_swapChainExtent.width << "x" << m_swapChainExtent.height << std::endl;
-        }
-
-        VkImageMemoryBarrier storageBarrier{};
-        storageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        storageBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-        storageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-        storageBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
-        storageBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
-        storageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        storageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        storageBarrier.image = m_rtStorageImage;
-        storageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        storageBarrier.subresourceRange.baseMipLevel = 0;
-        storageBarrier.subresourceRange.levelCount = 1;
-        storageBarrier.subresourceRange.baseArrayLayer = 0;
-        storageBarrier.subresourceRange.layerCount = 1;
-        if (!debugCopyEnabled) {
-            vkCmdPipelineBarrier(m_commandBuffers[m_currentFrame],
-                                 VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,
-                                 VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                 0,
-                                 0, nullptr,
-                                 0, nullptr,
-                                 1, &storageBarrier);
-            std::cout << "[RT][Debug] Barrier for storage image before blit" << std::endl;
-        }
-        
-        // End render pass before blitting
-        std::cout << "[RT][Debug] End ray tracing render pass" << std::endl;
-        vkCmdEndRenderPass(m_commandBuffers[m_currentFrame]);
-        
-        // Blit ray traced result to swapchain
-        VkImage swapchainImage = m_swapChainImages[m_imageIndex];
-        
-        if (frameCount % 60 == 0) {
-            std::cout << "[RT] Debug - Blitting from storage image to swapchain" << std::endl;
-            std::cout << "[RT] Debug - Swapchain Image: " << (swapchainImage != VK_NULL_HANDLE ? "OK" : "NULL") << std::endl;
-            std::cout << "[RT] Debug - Storage Image: " << (m_rtStorageImage != VK_NULL_HANDLE ? "OK" : "NULL") << std::endl;
-            std::cout << "[RT] Debug - Image Extent: " << m_swapChainExtent.width << "x" << m_swapChainExtent.height << std::endl;
+        // Ray dispatches are not allowed inside a render pass instance, so the
+        // ray traced paths write the HDR target as a storage image.
+        VkPipelineStageFlags traceStage = useRayQuery ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR;
+
+        // The previous frame's post chain may still be reading the targets
+        for (VkImage target : {m_hdrImage, m_motionImage}) {
+            cmdTransitionImageLayout(commandBuffer,
+                                     target,
+                                     VK_IMAGE_LAYOUT_GENERAL,
+                                     VK_IMAGE_LAYOUT_GENERAL,
+                                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                     traceStage,
+                                     0,
+                                     VK_ACCESS_SHADER_WRITE_BIT);
         }
-        
-        transitionImageLayout(swapchainImage,
-                              m_swapChainImageFormat,
-                              VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                              VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-                              VK_PIPELINE_STAGE_TRANSFER_BIT,
-                              VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-                              VK_ACCESS_TRANSFER_WRITE_BIT);
-
-        VkImageBlit blit{};
-        blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        blit.srcSubresource.mipLevel = 0;
-        blit.srcSubresource.baseArrayLayer = 0;
-        blit.srcSubresource.layerCount = 1;
-        blit.srcOffsets[1] = {static_cast<int32_t>(m_swapChainExtent.width), static_cast<int32_t>(m_swapChainExtent.height), 1};
-
-        blit.dstSubresource = blit.srcSubresource;
-        blit.dstOffsets[1] = blit.srcOffsets[1];
 
         if (!debugCopyEnabled) {
-            vkCmdBlitImage(m_commandBuffers[m_currentFrame],
-                           m_rtStorageImage, VK_IMAGE_LAYOUT_GENERAL,
-                           swapchainImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                           1, &blit,
-                           VK_FILTER_LINEAR);
-            std::cout << "[RT][Debug] Issued blit from storage image 0x" << std::hex << reinterpret_cast<uint64_t>(m_rtStorageImage)
-                      << " (layout " << layoutToString(VK_IMAGE_LAYOUT_GENERAL) << ") to swapchain image 0x"
-                      << reinterpret_cast<uint64_t>(swapchainImage) << " (layout " << layoutToString(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) << ")"
-                      << std::dec << std::endl;
-
-            transitionImageLayout(swapchainImage,
-                                  m_swapChainImageFormat,
-                                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                  VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-                                  VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                  VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-                                  VK_ACCESS_TRANSFER_WRITE_BIT,
-                                  0);
-            std::cout << "[RT][Debug] Restored swapchain image to " << layoutToString(VK_IMAGE_LAYOUT_PRESENT_SRC_KHR) << std::endl;
+            TracePushConstants pushConstants{};
+            pushConstants.flags = m_shadowsEnabled ? TRACE_FLAG_SHADOWS : 0u;
+            pushConstants.maxShadowLights = MAX_SHADOW_LIGHTS;
+            pushConstants.time = m_clusterParams.time;
+            vkCmdPushConstants(commandBuffer, m_rtPipelineLayout, VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT,
+                               0, sizeof(TracePushConstants), &pushConstants);
+
+            std::array<VkDescriptorSet, 2> traceSets = {rtSet, m_bindlessSet};
+            // Camera and lighting UBOs, both in the current frame's ring slice
+            uint32_t frameOffset = getFrameConstantsOffset();
+            std::array<uint32_t, 2> frameOffsets = {frameOffset, frameOffset};
+            m_profiler->beginScope(commandBuffer, "trace");
+            if (useRayQuery) {
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_rayQueryPipeline);
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_rtPipelineLayout, 0,
+                                        static_cast<uint32_t>(traceSets.size()), traceSets.data(),
+                                        static_cast<uint32_t>(frameOffsets.size()), frameOffsets.data());
+                vkCmdDispatch(commandBuffer,
+                              (m_renderExtent.width + RAY_QUERY_TILE_SIZE - 1) / RAY_QUERY_TILE_SIZE,
+                              (m_renderExtent.height + RAY_QUERY_TILE_SIZE - 1) / RAY_QUERY_TILE_SIZE,
+                              1);
+            } else {
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_rtPipeline);
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_rtPipelineLayout, 0,
+                                        static_cast<uint32_t>(traceSets.size()), traceSets.data(),
+                                        static_cast<uint32_t>(frameOffsets.size()), frameOffsets.data());
+                m_vkCmdTraceRaysKHR(commandBuffer, &m_rtRaygenRegion, &m_rtMissRegion, &m_rtHitRegion, &m_rtCallableRegion, m_renderExtent.width, m_renderExtent.height, 1);
+            }
+            m_profiler->endScope(commandBuffer);
+            if (isDebugRtLogEnabled()) {
+                std::cout << "[RT][Debug] Dispatched rays: " << m_renderExtent.width << "x" << m_renderExtent.height << std::endl;
+            }
+        }
+
+        for (VkImage target : {m_hdrImage, m_motionImage}) {
+            cmdTransitionImageLayout(commandBuffer,
+                                     target,
+                                     VK_IMAGE_LAYOUT_GENERAL,
+                                     VK_IMAGE_LAYOUT_GENERAL,
+                                     traceStage,
+                                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                     VK_ACCESS_SHADER_WRITE_BIT,
+                                     VK_ACCESS_SHADER_READ_BIT);
         }
     } else {
         // Fallback to raster rendering if ray tracing not ready
-        if (m_rtReady) {
+        if (m_rtReady && (m_backend == RenderBackend::RayTracingPipeline || m_backend == RenderBackend::RayQueryCompute)) {
             loggedNotReady = false;
             std::cout << "[RT] Skip ray tracing dispatch (resources not ready), using raster fallback" << std::endl;
         }
+
+        // Two-phase occlusion culling: draw what was visible last frame,
+        // build the Hi-Z pyramid from its depth, then cull everything else
+        // against it and draw what turned visible. With the prepass both
+        // phases only write depth and one EQUAL-tested pass shades them.
+        // The meshlet paths cull the same way per meshlet; mesh shading
+        // has no depth-only pipeline and skips the prepass.
+        MeshletPath meshletPath = activeMeshletPath();
+        bool depthPrepass = m_depthPrepass && meshletPath != MeshletPath::MeshShader;
+        VkPipeline colorPipeline = meshletPath == MeshletPath::MeshShader ? m_meshPipeline : m_graphicsPipeline;
+        std::vector<RasterPass> passes;
+        if (m_cullPipeline == VK_NULL_HANDLE) {
+            // No draw records (fallback geometry): one pass, everything drawn
+            passes.push_back({m_renderPass, m_hdrFramebuffer, m_graphicsPipeline, true, false, false, VK_NULL_HANDLE});
+        } else if (depthPrepass) {
+            passes.push_back({m_depthRenderPass, m_depthFramebuffer, m_depthPrepassPipeline, false, true, false, VK_NULL_HANDLE});
+            passes.push_back({m_depthLoadRenderPass, m_depthFramebuffer, m_depthPrepassPipeline, false, false, true, VK_NULL_HANDLE});
+            passes.push_back({m_shadeRenderPass, m_hdrFramebuffer, m_depthEqualPipeline, true, true, true, VK_NULL_HANDLE});
+        } else {
+            passes.push_back({m_renderPass, m_hdrFramebuffer, colorPipeline, true, true, false, VK_NULL_HANDLE});
+            passes.push_back({m_loadRenderPass, m_hdrFramebuffer, colorPipeline, true, false, true, VK_NULL_HANDLE});
+        }
+
+        // Pass contents go into secondaries recorded by the workers while
+        // this thread records the compute passes between them
+        JobCounter passesRecorded;
+        for (RasterPass& pass : passes) {
+            spawnJob([this, &pass]() { recordRasterPassContents(pass); }, passesRecorded);
+        }
+
+        m_profiler->beginScope(commandBuffer, "raster");
+        recordLightClustering(commandBuffer);
+        if (m_cullPipeline == VK_NULL_HANDLE) {
+            waitJobs(passesRecorded);
+            recordRasterPass(commandBuffer, passes[0]);
+        } else {
+            auto recordCull = [&](uint32_t phase) {
+                if (meshletPath == MeshletPath::Off) {
+                    recordDrawCull(commandBuffer, phase);
+                } else {
+                    recordMeshletCull(commandBuffer, phase);
+                }
+            };
+
+            recordCull(CULL_PHASE_EARLY);
+            waitJobs(passesRecorded);
+            recordRasterPass(commandBuffer, passes[0]);
+
+            recordHizBuild(commandBuffer);
+            recordCull(CULL_PHASE_LATE);
+            for (size_t i = 1; i < passes.size(); ++i) {
+                recordRasterPass(commandBuffer, passes[i]);
+            }
+        }
+        m_profiler->endScope(commandBuffer);
         
-        // Render using traditional rasterization
-        vkCmdBindPipeline(m_commandBuffers[m_currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline);
-        
-        VkBuffer vertexBuffers[] = {m_vertexBuffer};
-        VkDeviceSize offsets[] = {0};
-        vkCmdBindVertexBuffers(m_commandBuffers[m_currentFrame], 0, 1, vertexBuffers, offsets);
-        vkCmdBindIndexBuffer(m_commandBuffers[m_currentFrame], m_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-        
-        VkDescriptorSet descriptorSet = m_descriptorSets[m_currentFrame];
-        vkCmdBindDescriptorSets(m_commandBuffers[m_currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
-        
-        vkCmdDrawIndexed(m_commandBuffers[m_currentFrame], m_indexCount, 1, 0, 0, 0);
-        
-        std::cout << "[RT][Debug] End raster render pass" << std::endl;
-        vkCmdEndRenderPass(m_commandBuffers[m_currentFrame]);
+        if (isDebugRtLogEnabled()) {
+            std::cout << "[RT][Debug] End raster render pass" << std::endl;
+        }
     }
 
-    if (vkEndCommandBuffer(m_commandBuffers[m_currentFrame]) != VK_SUCCESS) {
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
         throw std::runtime_error("failed to record command buffer!");
     }
+    waitJobs(postRecorded);
+    m_submitCommandBuffers[m_currentFrame] = {commandBuffer, postCommandBuffer};
+
+    double recordMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - recordStart).count();
+    m_recordCpuMs = m_recordCpuMs > 0.0 ? m_recordCpuMs + (recordMs - m_recordCpuMs) * RECORD_TIME_SMOOTHING : recordMs;
+}
+
+// Records the draws of one scene render pass into a secondary command buffer
+// of the calling worker; safe to run for several passes in parallel.
+void SimpleRenderer::recordRasterPassContents(RasterPass& pass) {
+    VkCommandBuffer commandBuffer = acquireCommandBuffer(VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+
+    VkCommandBufferInheritanceInfo inheritanceInfo{};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass = pass.renderPass;
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = pass.framebuffer;
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording secondary command buffer!");
+    }
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pass.pipeline);
+    
+    // Vertices and, per vertex, the scene mesh whose transform places it
+    VkBuffer vertexBuffers[] = {m_vertexBuffer, m_meshIndexBuffer};
+    VkDeviceSize offsets[] = {0, 0};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+    
+    // Camera UBO and point lights sit in the current frame's ring slice, the
+    // mesh transforms in their own
+    uint32_t frameOffset = getFrameConstantsOffset();
+    std::array<uint32_t, 3> frameOffsets = {frameOffset, frameOffset, getMeshTransformOffset()};
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &m_descriptorSet,
+                            static_cast<uint32_t>(frameOffsets.size()), frameOffsets.data());
+    vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ClusterPushConstants), &m_clusterParams);
+    
+    if (!pass.drawEarly && !pass.drawLate) {
+        vkCmdDrawIndexed(commandBuffer, m_indexCount, 1, 0, 0, 0);
+    }
+    MeshletPath meshletPath = activeMeshletPath();
+    for (uint32_t phase = 0; phase < CULL_PHASE_COUNT; ++phase) {
+        if (!((phase == CULL_PHASE_EARLY && pass.drawEarly) || (phase == CULL_PHASE_LATE && pass.drawLate))) {
+            continue;
+        }
+        if (meshletPath == MeshletPath::MeshShader) {
+            // One task workgroup per MESHLET_TASK_GROUP_SIZE meshlets, culled in the task stage
+            std::array<VkDescriptorSet, 2> meshSets = {m_descriptorSet, m_meshletDescriptorSets[phase]};
+            MeshletPushConstants pushConstants{m_meshletCount, phase};
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_meshPipelineLayout, 0,
+                                    static_cast<uint32_t>(meshSets.size()), meshSets.data(),
+                                    static_cast<uint32_t>(frameOffsets.size()), frameOffsets.data());
+            vkCmdPushConstants(commandBuffer, m_meshPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ClusterPushConstants), &m_clusterParams);
+            vkCmdPushConstants(commandBuffer, m_meshPipelineLayout, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT,
+                               sizeof(ClusterPushConstants), sizeof(MeshletPushConstants), &pushConstants);
+            uint32_t taskGroups = (m_meshletCount + MESHLET_TASK_GROUP_SIZE - 1) / MESHLET_TASK_GROUP_SIZE;
+            uint32_t groupsX = std::min(taskGroups, MAX_DISPATCH_GROUPS);
+            m_vkCmdDrawMeshTasksEXT(commandBuffer, groupsX, (taskGroups + groupsX - 1) / groupsX, 1);
+        } else if (meshletPath == MeshletPath::Compute) {
+            vkCmdBindIndexBuffer(commandBuffer, m_meshletIndexBuffers[phase], 0, VK_INDEX_TYPE_UINT32);
+            vkCmdDrawIndexedIndirect(commandBuffer, m_meshletDrawBuffers[phase], 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+        } else {
+            m_vkCmdDrawIndexedIndirectCountKHR(commandBuffer, m_indirectDrawBuffers[phase], 0, m_drawCountBuffers[phase], 0,
+                                               m_drawRecordCount, sizeof(VkDrawIndexedIndirectCommand));
+        }
+    }
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record secondary command buffer!");
+    }
+    pass.contents = commandBuffer;
+}
+
+void SimpleRenderer::recordRasterPass(VkCommandBuffer commandBuffer, const RasterPass& pass) {
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = pass.renderPass;
+    renderPassInfo.framebuffer = pass.framebuffer;
+    renderPassInfo.renderArea.offset = {0, 0};
+    renderPassInfo.renderArea.extent = m_renderExtent;
+    
+    // Attachments that are loaded ignore their clear value; depth clears to far (0 with reverse-Z)
+    std::array<VkClearValue, 3> clearValues{};
+    clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+    clearValues[1].color = {{0.0f, 0.0f, 0.0f, 0.0f}};
+    clearValues[2].depthStencil = {0.0f, 0};
+    renderPassInfo.clearValueCount = pass.withColor ? 3u : 1u;
+    renderPassInfo.pClearValues = pass.withColor ? clearValues.data() : &clearValues[2];
+    
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    vkCmdExecuteCommands(commandBuffer, 1, &pass.contents);
+    vkCmdEndRenderPass(commandBuffer);
+}
+
+void SimpleRenderer::setBackend(RenderBackend backend) {
+    if (!isBackendAvailable(backend)) {
+        std::cout << "[Renderer] Backend " << getBackendName(backend) << " is not available, keeping "
+                  << getBackendName(m_backend) << std::endl;
+        return;
+    }
+    if (backend == RenderBackend::CpuReference && !m_cpuTracer) {
+        buildCpuTracer();
+    }
+    if (m_rtCompilePending && (backend == RenderBackend::RayTracingPipeline || backend == RenderBackend::RayQueryCompute)) {
+        std::cout << "[Renderer] " << getBackendName(backend) << " starts once its pipeline is compiled, drawing raster until then" << std::endl;
+    }
+    if (m_cpuTracerPending && backend == RenderBackend::CpuReference) {
+        std::cout << "[Renderer] " << getBackendName(backend) << " starts once its BVH is built, drawing raster until then" << std::endl;
+    }
+    if (backend != m_backend) {
+        std::cout << "[Renderer] Switching backend: " << getBackendName(m_backend) << " -> " << getBackendName(backend) << std::endl;
+        // The backends shade differently, so the old history would smear in
+        m_postProcess->resetHistory();
+    }
+    m_backend = backend;
+}
+
+void SimpleRenderer::setLatencyMode(bool enabled) {
+    if (enabled != m_latencyMode) {
+        std::cout << "[Renderer] Latency mode " << (enabled ? "enabled" : "disabled") << std::endl;
+    }
+    m_latencyMode = enabled;
+    m_inputToPresentMs = 0.0;
+}
+
+bool SimpleRenderer::isBackendAvailable(RenderBackend backend) const {
+    switch (backend) {
+    // The compile job owns the pipeline handles while it runs
+    case RenderBackend::RayTracingPipeline: return m_rtCompilePending || m_rtPipeline != VK_NULL_HANDLE;
+    case RenderBackend::RayQueryCompute: return m_rtCompilePending ? m_rayQuerySupported : m_rayQueryPipeline != VK_NULL_HANDLE;
+    case RenderBackend::Raster: return m_graphicsPipeline != VK_NULL_HANDLE;
+    // Built on first selection from the uploaded geometry
+    case RenderBackend::CpuReference: return m_indexCount > 0 && !m_rtMeshes.empty();
+    }
+    return false;
+}
+
+void SimpleRenderer::setBloomEnabled(bool enabled) {
+    if (enabled != m_postSettings.bloomEnabled) {
+        std::cout << "[Renderer] Bloom " << (enabled ? "enabled" : "disabled") << std::endl;
+    }
+    m_postSettings.bloomEnabled = enabled;
+}
+
+void SimpleRenderer::setDepthPrepassEnabled(bool enabled) {
+    if (enabled != m_depthPrepass) {
+        std::cout << "[Renderer] Depth prepass " << (enabled ? "enabled" : "disabled") << std::endl;
+    }
+    m_depthPrepass = enabled;
+}
+
+void SimpleRenderer::setShadowsEnabled(bool enabled) {
+    if (enabled != m_shadowsEnabled) {
+        std::cout << "[Renderer] Ray traced shadows " << (enabled ? "enabled" : "disabled") << std::endl;
+    }
+    m_shadowsEnabled = enabled;
+}
+
+const char* SimpleRenderer::getBackendName(RenderBackend backend) {
+    switch (backend) {
+    case RenderBackend::RayTracingPipeline: return "rt-pipeline";
+    case RenderBackend::RayQueryCompute: return "ray-query";
+    case RenderBackend::Raster: return "raster";
+    case RenderBackend::CpuReference: return "cpu";
+    }
+    return "unknown";
 }
 
-void SimpleRenderer::endFrame() {
+void SimpleRenderer::setMeshletPath(MeshletPath path) {
+    if (path == MeshletPath::MeshShader && !m_meshShaderSupported) {
+        path = MeshletPath::Compute;
+    }
+    if (path != m_meshletPath) {
+        std::cout << "[Renderer] Meshlet path: " << getMeshletPathName(path) << std::endl;
+    }
+    m_meshletPath = path;
+}
+
+const char* SimpleRenderer::getMeshletPathName(MeshletPath path) {
+    switch (path) {
+    case MeshletPath::Off: return "off";
+    case MeshletPath::MeshShader: return "mesh-shader";
+    case MeshletPath::Compute: return "compute";
+    }
+    return "unknown";
+}
+
+void SimpleRenderer::endFrame(Camera* camera) {
+    // Persistently mapped and coherent, so the write is visible to the submit
+    auto latchTime = std::chrono::steady_clock::now();
+    updateUniformBuffer(m_currentFrame, camera);
+
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     
     VkSemaphore waitSemaphores[] = {m_imageAvailableSemaphores[m_currentFrame]};
-    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+    // The swapchain image is only touched by the post chain
+    VkPipelineStageFlags waitStages[] = {m_postProcess->getSwapchainWriteStage()};
     submitInfo.waitSemaphoreCount = 1;
     submitInfo.pWaitSemaphores = waitSemaphores;
     submitInfo.pWaitDstStageMask = waitStages;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &m_commandBuffers[m_currentFrame];
+    submitInfo.commandBufferCount = static_cast<uint32_t>(m_submitCommandBuffers[m_currentFrame].size());
+    submitInfo.pCommandBuffers = m_submitCommandBuffers[m_currentFrame].data();
     
     VkSemaphore signalSemaphores[] = {m_renderFinishedSemaphores[m_currentFrame]};
     submitInfo.signalSemaphoreCount = 1;
     submitInfo.pSignalSemaphores = signalSemaphores;
     
-submit_frame:
-    std::cout << "[RT][Debug] Submitting command buffer for frame " << m_currentFrame << std::endl;
     VkResult submitResult = vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, m_inFlightFences[m_currentFrame]);
-    std::cout << "[RT][Debug] vkQueueSubmit result: " << submitResult << std::endl;
+    if (isDebugRtLogEnabled()) {
+        std::cout << "[RT][Debug] vkQueueSubmit frame " << m_currentFrame << " result: " << submitResult << std::endl;
+    }
     if (submitResult != VK_SUCCESS) {
         throw std::runtime_error("failed to submit draw command buffer!");
     }
@@ -849,11 +1568,19 @@ submit_frame:
     presentInfo.pImageIndices = &m_imageIndex;
     
     VkResult result = vkQueuePresentKHR(m_presentQueue, &presentInfo);
-    std::cout << "[RT][Debug] Presented image index " << m_imageIndex << " result: " << result << std::endl;
+    if (isDebugRtLogEnabled()) {
+        std::cout << "[RT][Debug] Presented image index " << m_imageIndex << " result: " << result << std::endl;
+    }
     
     if (result != VK_SUCCESS) {
         throw std::runtime_error("failed to present swap chain image!");
     }
+
+    if (m_latencyMode) {
+        vkWaitForFences(m_device, 1, &m_inFlightFences[m_currentFrame], VK_TRUE, UINT64_MAX);
+        double latencyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - latchTime).count();
+        m_inputToPresentMs = m_inputToPresentMs > 0.0 ? m_inputToPresentMs + (latencyMs - m_inputToPresentMs) * RECORD_TIME_SMOOTHING : latencyMs;
+    }
     
     m_currentFrame = (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 }
@@ -886,7 +1613,8 @@ void SimpleRenderer::createVertexBufferFromData(const std::vector<GLTFVertex>& v
     vkUnmapMemory(m_device, stagingBufferMemory);
     
     createBuffer(bufferSize,
-                 VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                 VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                  m_vertexBuffer,
                  m_vertexBufferMemory,
@@ -898,6 +1626,30 @@ void SimpleRenderer::createVertexBufferFromData(const std::vector<GLTFVertex>& v
     vkFreeMemory(m_device, stagingBufferMemory, nullptr);
 }
 
+void SimpleRenderer::createMeshIndexBuffer(const std::vector<uint32_t>& vertexMeshes) {
+    VkDeviceSize bufferSize = sizeof(uint32_t) * vertexMeshes.size();
+    
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+    
+    void* data;
+    vkMapMemory(m_device, stagingBufferMemory, 0, bufferSize, 0, &data);
+    memcpy(data, vertexMeshes.data(), (size_t)bufferSize);
+    vkUnmapMemory(m_device, stagingBufferMemory);
+    
+    createBuffer(bufferSize,
+                 VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                 m_meshIndexBuffer,
+                 m_meshIndexMemory);
+    
+    copyBuffer(stagingBuffer, m_meshIndexBuffer, bufferSize);
+    
+    vkDestroyBuffer(m_device, stagingBuffer, nullptr);
+    vkFreeMemory(m_device, stagingBufferMemory, nullptr);
+}
+
 void SimpleRenderer::createIndexBuffer(const std::vector<uint32_t>& indices) {
     if (indices.empty()) {
         // Fallback to a simple triangle if no indices provided
@@ -909,6 +1661,26 @@ void SimpleRenderer::createIndexBuffer(const std::vector<uint32_t>& indices) {
     createIndexBufferFromData(indices);
 }
 
+void SimpleRenderer::setAccelerationStructureCacheDirectory(const std::string& directory) {
+    if (directory.empty()) {
+        m_asCache.reset();
+        return;
+    }
+
+    // Serialized BLASes are only portable between identical drivers, so each
+    // driver gets its own directory; the per-entry compatibility check still
+    // catches driver updates that keep the UUID
+    VkPhysicalDeviceIDProperties idProperties{};
+    idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+    VkPhysicalDeviceProperties2 deviceProperties{};
+    deviceProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    deviceProperties.pNext = &idProperties;
+    vkGetPhysicalDeviceProperties2(m_physicalDevice, &deviceProperties);
+
+    m_asCache = std::make_unique<AccelerationStructureCache>(directory, idProperties.driverUUID);
+    std::cout << "[RT] Acceleration structure cache at " << m_asCache->getDirectory().string() << std::endl;
+}
+
 void SimpleRenderer::initGeometry(Scene* scene) {
     if (scene) {
         const auto& vertices = scene->getVertices();
@@ -926,7 +1698,101 @@ void SimpleRenderer::initGeometry(Scene* scene) {
     createIndexBuffer(indices);
     m_vertexCount = static_cast<uint32_t>(vertices.size());
     m_indexCount = static_cast<uint32_t>(indices.size());
+    const VkDeviceAddress vertexAddress = getBufferDeviceAddress(m_vertexBuffer);
+    const VkDeviceAddress indexAddress = getBufferDeviceAddress(m_indexBuffer);
+
+    m_rtMeshes.clear();
+    m_sceneLights.clear();
+    m_sceneLightMeshes.clear();
+    m_sceneLightBounds.clear();
+    std::vector<DrawRecord> drawRecords;
+    MeshletData meshletData;
+    const auto& meshes = scene->getMeshes();
+    const auto& ranges = scene->getMeshRanges();
+    const uint32_t meshCount = static_cast<uint32_t>(std::min(meshes.size(), ranges.size()));
+
+    // Bounds and meshlets of every mesh are independent, so they are built
+    // on the job system and merged below in mesh order
+    std::vector<glm::vec3> meshBoundsMin(meshCount, glm::vec3(std::numeric_limits<float>::max()));
+    std::vector<glm::vec3> meshBoundsMax(meshCount, glm::vec3(std::numeric_limits<float>::lowest()));
+    std::vector<MeshletData> meshMeshlets(meshCount);
+    std::vector<uint64_t> meshHashes(meshCount, 0);
+    parallelFor(m_jobSystem, meshCount, 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            if (ranges[i].indexCount < 3) {
+                continue;
+            }
+            // Mesh space, like the vertices; the culling shaders place the
+            // bounds with the mesh's transform
+            for (uint32_t v = ranges[i].firstVertex; v < ranges[i].firstVertex + ranges[i].vertexCount; ++v) {
+                meshBoundsMin[i] = glm::min(meshBoundsMin[i], vertices[v].position);
+                meshBoundsMax[i] = glm::max(meshBoundsMax[i], vertices[v].position);
+            }
+            buildMeshlets(vertices, indices.data() + ranges[i].firstIndex, ranges[i].indexCount, meshMeshlets[i]);
+            for (Meshlet& meshlet : meshMeshlets[i].meshlets) {
+                meshlet.meshIndex = i;
+            }
+            if (m_asCache) {
+                meshHashes[i] = AccelerationStructureCache::hashTriangles(vertices.data(), indices.data() + ranges[i].firstIndex,
+                                                                          ranges[i].indexCount, BLAS_BUILD_FLAGS);
+            }
+        }
+    });
+
+    // The simulation has not started yet, so the graph can be read directly
+    SceneTransforms transforms;
+    scene->captureTransforms(transforms);
+
+    std::vector<uint32_t> vertexMeshes(vertices.size(), 0);
+    for (uint32_t i = 0; i < meshCount; ++i) {
+        std::fill_n(vertexMeshes.begin() + ranges[i].firstVertex, ranges[i].vertexCount, i);
+        if (ranges[i].indexCount < 3) {
+            continue;
+        }
+        RayTracedMesh mesh;
+        mesh.indexCount = ranges[i].indexCount;
+        mesh.material = makeMaterialRecord(meshes[i], ranges[i].firstIndex);
+        mesh.geometry = {vertexAddress, indexAddress + ranges[i].firstIndex * sizeof(uint32_t), sizeof(GLTFVertex), 0};
+        mesh.geometryHash = meshHashes[i];
+        mesh.sceneMesh = i;
+        m_rtMeshes.push_back(mesh);
+
+        DrawRecord draw{};
+        const glm::vec3& boundsMin = meshBoundsMin[i];
+        const glm::vec3& boundsMax = meshBoundsMax[i];
+        draw.boundsMin = glm::vec4(boundsMin, 0.0f);
+        draw.boundsMax = glm::vec4(boundsMax, 0.0f);
+        draw.firstIndex = ranges[i].firstIndex;
+        draw.indexCount = ranges[i].indexCount;
+        draw.meshIndex = i;
+        drawRecords.push_back(draw);
+        appendMeshlets(meshletData, meshMeshlets[i]);
+
+        // Emissive meshes light their surroundings in the raster path and
+        // follow them when the graph moves them (updateMeshTransforms)
+        if (classifyMaterial(meshes[i]) == MaterialType::Emissive && m_sceneLights.size() < MAX_POINT_LIGHTS - KEY_LIGHT_COUNT) {
+            glm::vec4 bounds((boundsMin + boundsMax) * 0.5f, glm::length(boundsMax - boundsMin) * 0.5f);
+            PointLight light{};
+            light.positionRadius = placeBoundingSphere(transforms.meshWorlds[i], bounds) + glm::vec4(0.0f, 0.0f, 0.0f, EMISSIVE_LIGHT_REACH);
+            light.colorIntensity = glm::vec4(meshes[i].emissionColor, meshes[i].emissionStrength);
+            m_sceneLights.push_back(light);
+            m_sceneLightMeshes.push_back(i);
+            m_sceneLightBounds.push_back(bounds);
+        }
+
+        std::cout << "Mesh " << meshes[i].name << ": " << ranges[i].indexCount / 3 << " triangles, "
+                  << materialTypeToString(classifyMaterial(meshes[i])) << " material" << std::endl;
+    }
+    for (RayTracedMesh& mesh : m_rtMeshes) {
+        SceneGraph::writeTransform(transforms.meshWorlds[mesh.sceneMesh], mesh.transform);
+    }
+    createMeshIndexBuffer(vertexMeshes);
+    createMeshTransforms(transforms);
+    createMeshInfoBuffer();
+    createDrawCullResources(drawRecords);
+    createMeshletResources(meshletData);
     createAccelerationStructures();
+    m_instanceTransformVersion = transforms.version;
         
     } else {
         // Fallback to triangle
@@ -934,24 +1800,621 @@ void SimpleRenderer::initGeometry(Scene* scene) {
     createIndexBuffer(std::vector<uint32_t>());
     m_vertexCount = 3;
     m_indexCount = 3;
+    createMeshIndexBuffer(std::vector<uint32_t>(3, 0));
+    SceneTransforms transforms;
+    transforms.meshWorlds.assign(1, glm::mat4(1.0f));
+    createMeshTransforms(transforms);
+
+    RayTracedMesh mesh;
+    mesh.indexCount = 3;
+    mesh.geometry = {getBufferDeviceAddress(m_vertexBuffer), getBufferDeviceAddress(m_indexBuffer), sizeof(GLTFVertex), 0};
+    mesh.material.baseColor = glm::vec4(1.0f);
+    mesh.material.materialType = static_cast<uint32_t>(MaterialType::Rough);
+    mesh.transform = makeIdentityTransformMatrix();
+    m_rtMeshes.assign(1, mesh);
+    createMeshInfoBuffer();
     createAccelerationStructures();
     }
 }
 
-void SimpleRenderer::createIndexBufferFromData(const std::vector<uint32_t>& indices) {
-    VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
-    
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-    
-    void* data;
-    vkMapMemory(m_device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, indices.data(), (size_t)bufferSize);
-    vkUnmapMemory(m_device, stagingBufferMemory);
-    
+// Per-instance tables in the bindless set, both indexed by the TLAS instance
+// custom index: geometry for the hit shaders and ray queries, materials for
+// ray queries (the RT pipeline reads those from the SBT)
+void SimpleRenderer::createMeshInfoBuffer() {
+    std::vector<MaterialRecord> records;
+    std::vector<MeshGeometryRecord> geometry;
+    for (const RayTracedMesh& mesh : m_rtMeshes) {
+        records.push_back(mesh.material);
+        geometry.push_back(mesh.geometry);
+    }
+    if (records.empty()) {
+        return;
+    }
+
+    auto upload = [this](const void* source, VkDeviceSize bufferSize, VkBuffer& buffer, VkDeviceMemory& memory) {
+        VkBuffer stagingBuffer;
+        VkDeviceMemory stagingBufferMemory;
+        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+        void* data;
+        vkMapMemory(m_device, stagingBufferMemory, 0, bufferSize, 0, &data);
+        memcpy(data, source, (size_t)bufferSize);
+        vkUnmapMemory(m_device, stagingBufferMemory);
+
+        createBuffer(bufferSize,
+                     VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                     buffer,
+                     memory);
+
+        copyBuffer(stagingBuffer, buffer, bufferSize);
+
+        vkDestroyBuffer(m_device, stagingBuffer, nullptr);
+        vkFreeMemory(m_device, stagingBufferMemory, nullptr);
+    };
+    upload(records.data(), sizeof(MaterialRecord) * records.size(), m_meshInfoBuffer, m_meshInfoBufferMemory);
+    upload(geometry.data(), sizeof(MeshGeometryRecord) * geometry.size(), m_meshGeometryBuffer, m_meshGeometryBufferMemory);
+
+    std::array<VkDescriptorBufferInfo, 2> bufferInfos = {{
+        {m_meshGeometryBuffer, 0, VK_WHOLE_SIZE},
+        {m_meshInfoBuffer, 0, VK_WHOLE_SIZE}
+    }};
+    std::array<VkWriteDescriptorSet, 2> writes{};
+    for (uint32_t b = 0; b < writes.size(); ++b) {
+        writes[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[b].dstSet = m_bindlessSet;
+        writes[b].dstBinding = b;
+        writes[b].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[b].descriptorCount = 1;
+        writes[b].pBufferInfo = &bufferInfos[b];
+    }
+    vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+void SimpleRenderer::createDrawCullResources(const std::vector<DrawRecord>& drawRecords) {
+    cleanupDrawCullResources();
+    if (drawRecords.empty()) {
+        return;
+    }
+    m_drawRecordCount = static_cast<uint32_t>(drawRecords.size());
+
+    VkDeviceSize recordsSize = sizeof(DrawRecord) * drawRecords.size();
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    createBuffer(recordsSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+    void* data;
+    vkMapMemory(m_device, stagingBufferMemory, 0, recordsSize, 0, &data);
+    memcpy(data, drawRecords.data(), (size_t)recordsSize);
+    vkUnmapMemory(m_device, stagingBufferMemory);
+
+    createBuffer(recordsSize,
+                 VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                 m_drawRecordBuffer,
+                 m_drawRecordMemory);
+    copyBuffer(stagingBuffer, m_drawRecordBuffer, recordsSize);
+
+    vkDestroyBuffer(m_device, stagingBuffer, nullptr);
+    vkFreeMemory(m_device, stagingBufferMemory, nullptr);
+
+    for (uint32_t phase = 0; phase < CULL_PHASE_COUNT; ++phase) {
+        createBuffer(sizeof(VkDrawIndexedIndirectCommand) * drawRecords.size(),
+                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                     m_indirectDrawBuffers[phase],
+                     m_indirectDrawMemory[phase]);
+        createBuffer(sizeof(uint32_t),
+                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                     m_drawCountBuffers[phase],
+                     m_drawCountMemory[phase]);
+    }
+
+    // Nothing counts as visible before the first frame, so it is all drawn late
+    VkDeviceSize visibilitySize = sizeof(uint32_t) * drawRecords.size();
+    createBuffer(visibilitySize,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                 m_drawVisibilityBuffer,
+                 m_drawVisibilityMemory);
+    VkCommandBuffer fillCommandBuffer = beginSingleTimeCommands();
+    vkCmdFillBuffer(fillCommandBuffer, m_drawVisibilityBuffer, 0, visibilitySize, 0);
+    endSingleTimeCommands(fillCommandBuffer);
+
+    // 0 = camera UBO, 1 = draw records, 2 = indirect commands, 3 = draw count,
+    // 4 = visibility, 5 = Hi-Z pyramid, 6 = mesh transforms
+    std::array<VkDescriptorSetLayoutBinding, 7> bindings{};
+    for (uint32_t i = 0; i < bindings.size(); ++i) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    bindings[5].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[6].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+    if (vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &m_cullSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create draw cull descriptor set layout");
+    }
+
+    VkPushConstantRange pushConstantRange{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DrawCullPushConstants)};
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_cullSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &m_cullPipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create draw cull pipeline layout");
+    }
+
+    VkShaderModule computeModule = ShaderManager::createShaderModule(m_device, ShaderManager::readFile("shaders/draw_cull.comp.spv"));
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = computeModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = m_cullPipelineLayout;
+    VkResult result = vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_cullPipeline);
+    vkDestroyShaderModule(m_device, computeModule, nullptr);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create draw cull pipeline");
+    }
+
+    const uint32_t setCount = CULL_PHASE_COUNT;
+    std::array<VkDescriptorPoolSize, 4> poolSizes = {{
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, setCount},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, setCount * 4},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, setCount},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, setCount}
+    }};
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = setCount;
+    if (vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_cullDescriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create draw cull descriptor pool");
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(setCount, m_cullSetLayout);
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_cullDescriptorPool;
+    allocInfo.descriptorSetCount = static_cast<uint32_t>(layouts.size());
+    allocInfo.pSetLayouts = layouts.data();
+    m_cullDescriptorSets.resize(setCount);
+    if (vkAllocateDescriptorSets(m_device, &allocInfo, m_cullDescriptorSets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate draw cull descriptor sets");
+    }
+
+    VkDescriptorImageInfo hizInfo{m_hizSampler, m_hizImageView, VK_IMAGE_LAYOUT_GENERAL};
+    // createMeshTransforms() has sized the ring for these meshes
+    VkDescriptorBufferInfo transformsInfo{m_meshTransformBuffer, 0, sizeof(MeshTransform) * m_previousMeshWorlds.size()};
+    for (uint32_t phase = 0; phase < CULL_PHASE_COUNT; ++phase) {
+        std::array<VkDescriptorBufferInfo, 5> bufferInfos = {{
+            frameConstantsInfo(m_cameraConstantsOffset, sizeof(UniformBufferObject)),
+            {m_drawRecordBuffer, 0, VK_WHOLE_SIZE},
+            {m_indirectDrawBuffers[phase], 0, VK_WHOLE_SIZE},
+            {m_drawCountBuffers[phase], 0, VK_WHOLE_SIZE},
+            {m_drawVisibilityBuffer, 0, VK_WHOLE_SIZE}
+        }};
+        std::array<VkWriteDescriptorSet, 7> writes{};
+        for (uint32_t b = 0; b < writes.size(); ++b) {
+            writes[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[b].dstSet = m_cullDescriptorSets[phase];
+            writes[b].dstBinding = b;
+            writes[b].descriptorType = bindings[b].descriptorType;
+            writes[b].descriptorCount = 1;
+            if (b < bufferInfos.size()) {
+                writes[b].pBufferInfo = &bufferInfos[b];
+            } else if (b == 5) {
+                writes[b].pImageInfo = &hizInfo;
+            } else {
+                writes[b].pBufferInfo = &transformsInfo;
+            }
+        }
+        vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+
+    std::cout << "[Renderer] GPU culling ready for " << m_drawRecordCount << " raster draws" << std::endl;
+}
+
+void SimpleRenderer::cleanupDrawCullResources() {
+    if (m_cullPipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(m_device, m_cullPipeline, nullptr);
+        m_cullPipeline = VK_NULL_HANDLE;
+    }
+    if (m_cullPipelineLayout != VK_NULL_HANDLE) {
+        vkDestroyPipelineLayout(m_device, m_cullPipelineLayout, nullptr);
+        m_cullPipelineLayout = VK_NULL_HANDLE;
+    }
+    if (m_cullDescriptorPool != VK_NULL_HANDLE) {
+        vkDestroyDescriptorPool(m_device, m_cullDescriptorPool, nullptr);
+        m_cullDescriptorPool = VK_NULL_HANDLE;
+        m_cullDescriptorSets.clear();
+    }
+    if (m_cullSetLayout != VK_NULL_HANDLE) {
+        vkDestroyDescriptorSetLayout(m_device, m_cullSetLayout, nullptr);
+        m_cullSetLayout = VK_NULL_HANDLE;
+    }
+    for (auto [buffer, memory] : {std::pair<VkBuffer*, VkDeviceMemory*>{&m_drawRecordBuffer, &m_drawRecordMemory},
+                                  std::pair<VkBuffer*, VkDeviceMemory*>{&m_indirectDrawBuffers[CULL_PHASE_EARLY], &m_indirectDrawMemory[CULL_PHASE_EARLY]},
+                                  std::pair<VkBuffer*, VkDeviceMemory*>{&m_indirectDrawBuffers[CULL_PHASE_LATE], &m_indirectDrawMemory[CULL_PHASE_LATE]},
+                                  std::pair<VkBuffer*, VkDeviceMemory*>{&m_drawCountBuffers[CULL_PHASE_EARLY], &m_drawCountMemory[CULL_PHASE_EARLY]},
+                                  std::pair<VkBuffer*, VkDeviceMemory*>{&m_drawCountBuffers[CULL_PHASE_LATE], &m_drawCountMemory[CULL_PHASE_LATE]},
+                                  std::pair<VkBuffer*, VkDeviceMemory*>{&m_drawVisibilityBuffer, &m_drawVisibilityMemory}}) {
+        if (*buffer != VK_NULL_HANDLE) {
+            vkDestroyBuffer(m_device, *buffer, nullptr);
+            *buffer = VK_NULL_HANDLE;
+        }
+        if (*memory != VK_NULL_HANDLE) {
+            vkFreeMemory(m_device, *memory, nullptr);
+            *memory = VK_NULL_HANDLE;
+        }
+    }
+    m_drawRecordCount = 0;
+}
+
+// Resets the phase's draw count, culls the draw records against the camera
+// frustum (and in the late phase the Hi-Z pyramid) and makes the compacted
+// commands visible to the indirect draw.
+void SimpleRenderer::recordDrawCull(VkCommandBuffer commandBuffer, uint32_t phase) {
+    m_profiler->beginScope(commandBuffer, phase == CULL_PHASE_EARLY ? "cull" : "cull-late");
+
+    // The previous frame's indirect draws may still be reading the buffers and
+    // its late phase wrote the visibility flags
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+    vkCmdFillBuffer(commandBuffer, m_drawCountBuffers[phase], 0, sizeof(uint32_t), 0);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    DrawCullPushConstants pushConstants{m_drawRecordCount, phase};
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullPipeline);
+    std::array<uint32_t, 2> dynamicOffsets = {getFrameConstantsOffset(), getMeshTransformOffset()};
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullPipelineLayout, 0, 1,
+                            &m_cullDescriptorSets[phase], static_cast<uint32_t>(dynamicOffsets.size()), dynamicOffsets.data());
+    vkCmdPushConstants(commandBuffer, m_cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DrawCullPushConstants), &pushConstants);
+    vkCmdDispatch(commandBuffer, (m_drawRecordCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    m_profiler->endScope(commandBuffer);
+}
+
+// Uploads the meshlets, allocates the per-phase compacted index buffers of
+// the compute path and creates its cull pipeline. Meshlet visibility starts
+// cleared like the per-mesh flags, so the first frame draws everything late.
+void SimpleRenderer::createMeshletResources(const MeshletData& meshletData) {
+    cleanupMeshletResources();
+    if (meshletData.meshlets.empty()) {
+        return;
+    }
+    m_meshletCount = static_cast<uint32_t>(meshletData.meshlets.size());
+    m_meshletIndexCount = static_cast<uint32_t>(meshletData.triangles.size() * 3);
+
+    auto uploadStorageBuffer = [&](const void* source, VkDeviceSize size, VkBuffer& buffer, VkDeviceMemory& memory) {
+        VkBuffer stagingBuffer;
+        VkDeviceMemory stagingBufferMemory;
+        createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+        void* data;
+        vkMapMemory(m_device, stagingBufferMemory, 0, size, 0, &data);
+        memcpy(data, source, (size_t)size);
+        vkUnmapMemory(m_device, stagingBufferMemory);
+
+        createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, memory);
+        copyBuffer(stagingBuffer, buffer, size);
+
+        vkDestroyBuffer(m_device, stagingBuffer, nullptr);
+        vkFreeMemory(m_device, stagingBufferMemory, nullptr);
+    };
+    uploadStorageBuffer(meshletData.meshlets.data(), sizeof(Meshlet) * meshletData.meshlets.size(), m_meshletBuffer, m_meshletMemory);
+    uploadStorageBuffer(meshletData.vertices.data(), sizeof(uint32_t) * meshletData.vertices.size(), m_meshletVertexBuffer, m_meshletVertexMemory);
+    uploadStorageBuffer(meshletData.triangles.data(), sizeof(uint32_t) * meshletData.triangles.size(), m_meshletTriangleBuffer, m_meshletTriangleMemory);
+
+    VkDeviceSize visibilitySize = sizeof(uint32_t) * m_meshletCount;
+    createBuffer(visibilitySize,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                 m_meshletVisibilityBuffer,
+                 m_meshletVisibilityMemory);
+    VkCommandBuffer fillCommandBuffer = beginSingleTimeCommands();
+    vkCmdFillBuffer(fillCommandBuffer, m_meshletVisibilityBuffer, 0, visibilitySize, 0);
+    endSingleTimeCommands(fillCommandBuffer);
+
+    for (uint32_t phase = 0; phase < CULL_PHASE_COUNT; ++phase) {
+        createBuffer(sizeof(uint32_t) * m_meshletIndexCount,
+                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                     m_meshletIndexBuffers[phase],
+                     m_meshletIndexMemory[phase]);
+        createBuffer(sizeof(VkDrawIndexedIndirectCommand),
+                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                     m_meshletDrawBuffers[phase],
+                     m_meshletDrawMemory[phase]);
+    }
+
+    std::array<VkDescriptorPoolSize, 2> poolSizes = {{
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, CULL_PHASE_COUNT * 7},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, CULL_PHASE_COUNT}
+    }};
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = CULL_PHASE_COUNT;
+    if (vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_meshletDescriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create meshlet descriptor pool");
+    }
+
+    std::array<VkDescriptorSetLayout, CULL_PHASE_COUNT> layouts;
+    layouts.fill(m_meshletSetLayout);
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_meshletDescriptorPool;
+    allocInfo.descriptorSetCount = CULL_PHASE_COUNT;
+    allocInfo.pSetLayouts = layouts.data();
+    if (vkAllocateDescriptorSets(m_device, &allocInfo, m_meshletDescriptorSets) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate meshlet descriptor sets");
+    }
+
+    VkDescriptorImageInfo hizInfo{m_hizSampler, m_hizImageView, VK_IMAGE_LAYOUT_GENERAL};
+    for (uint32_t phase = 0; phase < CULL_PHASE_COUNT; ++phase) {
+        std::array<VkDescriptorBufferInfo, 8> bufferInfos = {{
+            {m_meshletBuffer, 0, VK_WHOLE_SIZE},
+            {m_meshletVertexBuffer, 0, VK_WHOLE_SIZE},
+            {m_meshletTriangleBuffer, 0, VK_WHOLE_SIZE},
+            {m_meshletVisibilityBuffer, 0, VK_WHOLE_SIZE},
+            {},
+            {m_vertexBuffer, 0, VK_WHOLE_SIZE},
+            {m_meshletIndexBuffers[phase], 0, VK_WHOLE_SIZE},
+            {m_meshletDrawBuffers[phase], 0, VK_WHOLE_SIZE}
+        }};
+        std::array<VkWriteDescriptorSet, 8> writes{};
+        for (uint32_t b = 0; b < writes.size(); ++b) {
+            writes[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[b].dstSet = m_meshletDescriptorSets[phase];
+            writes[b].dstBinding = b;
+            writes[b].descriptorCount = 1;
+            if (b == 4) {
+                writes[b].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                writes[b].pImageInfo = &hizInfo;
+            } else {
+                writes[b].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                writes[b].pBufferInfo = &bufferInfos[b];
+            }
+        }
+        vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+
+    std::array<VkDescriptorSetLayout, 2> setLayouts = {m_descriptorSetLayout, m_meshletSetLayout};
+    VkPushConstantRange pushConstantRange{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(MeshletPushConstants)};
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &m_meshletCullPipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create meshlet cull pipeline layout");
+    }
+
+    VkShaderModule computeModule = ShaderManager::createShaderModule(m_device, ShaderManager::readFile("shaders/meshlet_cull.comp.spv"));
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = computeModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = m_meshletCullPipelineLayout;
+    VkResult result = vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_meshletCullPipeline);
+    vkDestroyShaderModule(m_device, computeModule, nullptr);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create meshlet cull pipeline");
+    }
+
+    std::cout << "[Renderer] " << m_meshletCount << " meshlets, "
+              << static_cast<float>(meshletData.vertices.size()) / m_meshletCount << " vertices and "
+              << static_cast<float>(meshletData.triangles.size()) / m_meshletCount << " triangles on average" << std::endl;
+}
+
+void SimpleRenderer::cleanupMeshletResources() {
+    if (m_meshletCullPipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(m_device, m_meshletCullPipeline, nullptr);
+        m_meshletCullPipeline = VK_NULL_HANDLE;
+    }
+    if (m_meshletCullPipelineLayout != VK_NULL_HANDLE) {
+        vkDestroyPipelineLayout(m_device, m_meshletCullPipelineLayout, nullptr);
+        m_meshletCullPipelineLayout = VK_NULL_HANDLE;
+    }
+    if (m_meshletDescriptorPool != VK_NULL_HANDLE) {
+        vkDestroyDescriptorPool(m_device, m_meshletDescriptorPool, nullptr);
+        m_meshletDescriptorPool = VK_NULL_HANDLE;
+    }
+    for (auto [buffer, memory] : {std::pair<VkBuffer*, VkDeviceMemory*>{&m_meshletBuffer, &m_meshletMemory},
+                                  std::pair<VkBuffer*, VkDeviceMemory*>{&m_meshletVertexBuffer, &m_meshletVertexMemory},
+                                  std::pair<VkBuffer*, VkDeviceMemory*>{&m_meshletTriangleBuffer, &m_meshletTriangleMemory},
+                                  std::pair<VkBuffer*, VkDeviceMemory*>{&m_meshletVisibilityBuffer, &m_meshletVisibilityMemory},
+                                  std::pair<VkBuffer*, VkDeviceMemory*>{&m_meshletIndexBuffers[CULL_PHASE_EARLY], &m_meshletIndexMemory[CULL_PHASE_EARLY]},
+                                  std::pair<VkBuffer*, VkDeviceMemory*>{&m_meshletIndexBuffers[CULL_PHASE_LATE], &m_meshletIndexMemory[CULL_PHASE_LATE]},
+                                  std::pair<VkBuffer*, VkDeviceMemory*>{&m_meshletDrawBuffers[CULL_PHASE_EARLY], &m_meshletDrawMemory[CULL_PHASE_EARLY]},
+                                  std::pair<VkBuffer*, VkDeviceMemory*>{&m_meshletDrawBuffers[CULL_PHASE_LATE], &m_meshletDrawMemory[CULL_PHASE_LATE]}}) {
+        if (*buffer != VK_NULL_HANDLE) {
+            vkDestroyBuffer(m_device, *buffer, nullptr);
+            *buffer = VK_NULL_HANDLE;
+        }
+        if (*memory != VK_NULL_HANDLE) {
+            vkFreeMemory(m_device, *memory, nullptr);
+            *memory = VK_NULL_HANDLE;
+        }
+    }
+    m_meshletCount = 0;
+    m_meshletIndexCount = 0;
+}
+
+// Compute path: resets the phase's draw command and expands the surviving
+// meshlets into its index buffer. The mesh shader path culls in the task
+// stage during the draw, so it only orders the visibility flags and Hi-Z.
+void SimpleRenderer::recordMeshletCull(VkCommandBuffer commandBuffer, uint32_t phase) {
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    if (m_meshletPath == MeshletPath::MeshShader) {
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TASK_SHADER_BIT_EXT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_TASK_SHADER_BIT_EXT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        return;
+    }
+
+    m_profiler->beginScope(commandBuffer, phase == CULL_PHASE_EARLY ? "cull" : "cull-late");
+
+    // The previous frame's draws may still be reading the outputs and its
+    // late phase wrote the visibility flags
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+    VkDrawIndexedIndirectCommand emptyDraw{0, 1, 0, 0, 0};
+    vkCmdUpdateBuffer(commandBuffer, m_meshletDrawBuffers[phase], 0, sizeof(emptyDraw), &emptyDraw);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    std::array<VkDescriptorSet, 2> descriptorSets = {m_descriptorSet, m_meshletDescriptorSets[phase]};
+    uint32_t frameOffset = getFrameConstantsOffset();
+    std::array<uint32_t, 3> frameOffsets = {frameOffset, frameOffset, getMeshTransformOffset()};
+    MeshletPushConstants pushConstants{m_meshletCount, phase};
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_meshletCullPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_meshletCullPipelineLayout, 0,
+                            static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data(),
+                            static_cast<uint32_t>(frameOffsets.size()), frameOffsets.data());
+    vkCmdPushConstants(commandBuffer, m_meshletCullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(MeshletPushConstants), &pushConstants);
+    uint32_t groupsX = std::min(m_meshletCount, MAX_DISPATCH_GROUPS);
+    vkCmdDispatch(commandBuffer, groupsX, (m_meshletCount + groupsX - 1) / groupsX, 1);
+
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    m_profiler->endScope(commandBuffer);
+}
+
+// The cluster grid covers the render extent with CLUSTER_TILE_SIZE tiles and
+// CLUSTER_DEPTH_SLICES exponential depth slices. Light lists live in one
+// fixed-size slot per cluster, so the buffers only depend on the grid.
+void SimpleRenderer::createClusterResources() {
+    m_clusterParams.gridX = (m_renderExtent.width + CLUSTER_TILE_SIZE - 1) / CLUSTER_TILE_SIZE;
+    m_clusterParams.gridY = (m_renderExtent.height + CLUSTER_TILE_SIZE - 1) / CLUSTER_TILE_SIZE;
+    m_clusterParams.gridZ = CLUSTER_DEPTH_SLICES;
+    m_clusterParams.screenWidth = static_cast<float>(m_renderExtent.width);
+    m_clusterParams.screenHeight = static_cast<float>(m_renderExtent.height);
+    const uint32_t clusterCount = m_clusterParams.gridX * m_clusterParams.gridY * m_clusterParams.gridZ;
+
+    createBuffer(sizeof(uint32_t) * clusterCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_clusterCountBuffer, m_clusterCountMemory);
+    createBuffer(sizeof(uint32_t) * clusterCount * MAX_LIGHTS_PER_CLUSTER, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_clusterLightBuffer, m_clusterLightMemory);
+
+    VkPushConstantRange pushConstantRange{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ClusterPushConstants)};
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &m_clusterPipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create light cluster pipeline layout");
+    }
+
+    VkShaderModule computeModule = ShaderManager::createShaderModule(m_device, ShaderManager::readFile("shaders/cluster_lights.comp.spv"));
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = computeModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = m_clusterPipelineLayout;
+    VkResult result = vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_clusterPipeline);
+    vkDestroyShaderModule(m_device, computeModule, nullptr);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create light cluster pipeline");
+    }
+
+    std::cout << "[Renderer] Light cluster grid " << m_clusterParams.gridX << "x" << m_clusterParams.gridY << "x"
+              << m_clusterParams.gridZ << " (" << clusterCount << " clusters)" << std::endl;
+}
+
+// Rebuilds every cluster's light list for this frame's camera before the
+// raster passes shade with it.
+void SimpleRenderer::recordLightClustering(VkCommandBuffer commandBuffer) {
+    m_profiler->beginScope(commandBuffer, "lights");
+
+    // The previous frame's fragment shaders may still be reading the lists
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    const uint32_t clusterCount = m_clusterParams.gridX * m_clusterParams.gridY * m_clusterParams.gridZ;
+    uint32_t frameOffset = getFrameConstantsOffset();
+    std::array<uint32_t, 3> frameOffsets = {frameOffset, frameOffset, getMeshTransformOffset()};
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_clusterPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_clusterPipelineLayout, 0, 1, &m_descriptorSet,
+                            static_cast<uint32_t>(frameOffsets.size()), frameOffsets.data());
+    vkCmdPushConstants(commandBuffer, m_clusterPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ClusterPushConstants), &m_clusterParams);
+    vkCmdDispatch(commandBuffer, (clusterCount + CLUSTER_GROUP_SIZE - 1) / CLUSTER_GROUP_SIZE, 1, 1);
+
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    m_profiler->endScope(commandBuffer);
+}
+
+void SimpleRenderer::createIndexBufferFromData(const std::vector<uint32_t>& indices) {
+    VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
+    
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+    
+    void* data;
+    vkMapMemory(m_device, stagingBufferMemory, 0, bufferSize, 0, &data);
+    memcpy(data, indices.data(), (size_t)bufferSize);
+    vkUnmapMemory(m_device, stagingBufferMemory);
+    
     createBuffer(bufferSize,
-                 VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                 VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                     VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                  m_indexBuffer,
                  m_indexBufferMemory,
@@ -982,14 +2445,19 @@ void SimpleRenderer::createGraphicsPipeline() {
     
     VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
     
-    // Vertex input state
-    auto bindingDescription = GLTFVertex::getBindingDescription();
+    // Vertex input state: the vertices, then the per-vertex mesh index that
+    // selects the vertex's transform even when draws merge meshes
+    std::array<VkVertexInputBindingDescription, 2> bindingDescriptions = {{
+        GLTFVertex::getBindingDescription(),
+        {1, sizeof(uint32_t), VK_VERTEX_INPUT_RATE_VERTEX}
+    }};
     auto attributeDescriptions = GLTFVertex::getAttributeDescriptions();
+    attributeDescriptions.push_back({4, 1, VK_FORMAT_R32_UINT, 0});
     
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+    vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
+    vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
     vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
     vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
     
@@ -1003,14 +2471,14 @@ void SimpleRenderer::createGraphicsPipeline() {
     VkViewport viewport{};
     viewport.x = 0.0f;
     viewport.y = 0.0f;
-    viewport.width = (float)m_swapChainExtent.width;
-    viewport.height = (float)m_swapChainExtent.height;
+    viewport.width = (float)m_renderExtent.width;
+    viewport.height = (float)m_renderExtent.height;
     viewport.minDepth = 0.0f;
     viewport.maxDepth = 1.0f;
     
     VkRect2D scissor{};
     scissor.offset = {0, 0};
-    scissor.extent = m_swapChainExtent;
+    scissor.extent = m_renderExtent;
     
     VkPipelineViewportStateCreateInfo viewportState{};
     viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
@@ -1035,28 +2503,42 @@ void SimpleRenderer::createGraphicsPipeline() {
     multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
     multisampling.sampleShadingEnable = VK_FALSE;
     multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    // Reverse-Z: cleared to 0 (far), nearer fragments have larger depth
+    VkPipelineDepthStencilStateCreateInfo depthStencil{};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = VK_TRUE;
+    depthStencil.depthWriteEnable = VK_TRUE;
+    depthStencil.depthCompareOp = VK_COMPARE_OP_GREATER_OR_EQUAL;
+    depthStencil.depthBoundsTestEnable = VK_FALSE;
+    depthStencil.stencilTestEnable = VK_FALSE;
     
     // Color blending state
     VkPipelineColorBlendAttachmentState colorBlendAttachment{};
     colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
     colorBlendAttachment.blendEnable = VK_FALSE;
+    // HDR radiance and motion vectors
+    std::array<VkPipelineColorBlendAttachmentState, 2> colorBlendAttachments = {colorBlendAttachment, colorBlendAttachment};
     
     VkPipelineColorBlendStateCreateInfo colorBlending{};
     colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
     colorBlending.logicOpEnable = VK_FALSE;
     colorBlending.logicOp = VK_LOGIC_OP_COPY;
-    colorBlending.attachmentCount = 1;
-    colorBlending.pAttachments = &colorBlendAttachment;
+    colorBlending.attachmentCount = static_cast<uint32_t>(colorBlendAttachments.size());
+    colorBlending.pAttachments = colorBlendAttachments.data();
     colorBlending.blendConstants[0] = 0.0f;
     colorBlending.blendConstants[1] = 0.0f;
     colorBlending.blendConstants[2] = 0.0f;
     colorBlending.blendConstants[3] = 0.0f;
     
-    // Create pipeline layout
+    // Create pipeline layout; the fragment shader gets the cluster grid as push constants
+    VkPushConstantRange pushConstantRange{VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ClusterPushConstants)};
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     pipelineLayoutInfo.setLayoutCount = 1;
     pipelineLayoutInfo.pSetLayouts = &m_descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
     
     if (vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
         throw std::runtime_error("failed to create pipeline layout!");
@@ -1072,6 +2554,7 @@ void SimpleRenderer::createGraphicsPipeline() {
     pipelineInfo.pViewportState = &viewportState;
     pipelineInfo.pRasterizationState = &rasterizer;
     pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pDepthStencilState = &depthStencil;
     pipelineInfo.pColorBlendState = &colorBlending;
     pipelineInfo.layout = m_pipelineLayout;
     pipelineInfo.renderPass = m_renderPass;
@@ -1081,121 +2564,313 @@ void SimpleRenderer::createGraphicsPipeline() {
     if (vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_graphicsPipeline) != VK_SUCCESS) {
         throw std::runtime_error("failed to create graphics pipeline!");
     }
+
+    // Meshlet path: task and mesh stages replace the vertex input and vertex
+    // shader; set 1 holds the meshlets and the task stage's push constants
+    // follow the fragment stage's cluster constants
+    if (m_meshShaderSupported) {
+        std::array<VkDescriptorSetLayout, 2> meshSetLayouts = {m_descriptorSetLayout, m_meshletSetLayout};
+        std::array<VkPushConstantRange, 2> meshPushConstantRanges = {{
+            pushConstantRange,
+            {VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT, sizeof(ClusterPushConstants), sizeof(MeshletPushConstants)}
+        }};
+        VkPipelineLayoutCreateInfo meshLayoutInfo = pipelineLayoutInfo;
+        meshLayoutInfo.setLayoutCount = static_cast<uint32_t>(meshSetLayouts.size());
+        meshLayoutInfo.pSetLayouts = meshSetLayouts.data();
+        meshLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(meshPushConstantRanges.size());
+        meshLayoutInfo.pPushConstantRanges = meshPushConstantRanges.data();
+        if (vkCreatePipelineLayout(m_device, &meshLayoutInfo, nullptr, &m_meshPipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create mesh shader pipeline layout!");
+        }
+
+        VkShaderModule taskShaderModule = ShaderManager::createShaderModule(m_device, ShaderManager::readFile("shaders/meshlet.task.spv"));
+        VkShaderModule meshShaderModule = ShaderManager::createShaderModule(m_device, ShaderManager::readFile("shaders/meshlet.mesh.spv"));
+        std::array<VkPipelineShaderStageCreateInfo, 3> meshShaderStages = {vertShaderStageInfo, vertShaderStageInfo, fragShaderStageInfo};
+        meshShaderStages[0].stage = VK_SHADER_STAGE_TASK_BIT_EXT;
+        meshShaderStages[0].module = taskShaderModule;
+        meshShaderStages[1].stage = VK_SHADER_STAGE_MESH_BIT_EXT;
+        meshShaderStages[1].module = meshShaderModule;
+
+        VkGraphicsPipelineCreateInfo meshPipelineInfo = pipelineInfo;
+        meshPipelineInfo.stageCount = static_cast<uint32_t>(meshShaderStages.size());
+        meshPipelineInfo.pStages = meshShaderStages.data();
+        meshPipelineInfo.pVertexInputState = nullptr;
+        meshPipelineInfo.pInputAssemblyState = nullptr;
+        meshPipelineInfo.layout = m_meshPipelineLayout;
+        VkResult result = vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &meshPipelineInfo, nullptr, &m_meshPipeline);
+        vkDestroyShaderModule(m_device, meshShaderModule, nullptr);
+        vkDestroyShaderModule(m_device, taskShaderModule, nullptr);
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("failed to create mesh shader pipeline!");
+        }
+    }
+
+    // Shading after a depth prepass: only the fragments that won the prepass pass
+    depthStencil.depthWriteEnable = VK_FALSE;
+    depthStencil.depthCompareOp = VK_COMPARE_OP_EQUAL;
+    pipelineInfo.renderPass = m_shadeRenderPass;
+    if (vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_depthEqualPipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth equal graphics pipeline!");
+    }
+
+    // Depth prepass: vertex stage only, no color attachments
+    depthStencil.depthWriteEnable = VK_TRUE;
+    depthStencil.depthCompareOp = VK_COMPARE_OP_GREATER_OR_EQUAL;
+    VkPipelineColorBlendStateCreateInfo noColorBlending{};
+    noColorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    pipelineInfo.stageCount = 1;
+    pipelineInfo.pColorBlendState = &noColorBlending;
+    pipelineInfo.renderPass = m_depthRenderPass;
+    if (vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_depthPrepassPipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth prepass pipeline!");
+    }
     
     // Clean up shader modules
     vkDestroyShaderModule(m_device, fragShaderModule, nullptr);
     vkDestroyShaderModule(m_device, vertShaderModule, nullptr);
 }
 
+// Shared by the raster pipelines and the light clustering compute pass:
+// camera UBO, point lights, per-cluster light counts, light indices and the
+// mesh transforms. The first two live in the frame constant ring and the last
+// in its own per-frame ring; all three are offset per frame at bind.
 void SimpleRenderer::createDescriptorSetLayout() {
     VkDescriptorSetLayoutBinding uboLayoutBinding{};
     uboLayoutBinding.binding = 0;
     uboLayoutBinding.descriptorCount = 1;
-    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     uboLayoutBinding.pImmutableSamplers = nullptr;
-    uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
+    std::array<VkDescriptorSetLayoutBinding, 5> bindings{};
+    bindings[0] = uboLayoutBinding;
+    for (uint32_t b = 1; b < 4; ++b) {
+        bindings[b].binding = b;
+        bindings[b].descriptorCount = 1;
+        bindings[b].descriptorType = b == 1 ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[b].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    // Mesh transforms: placed vertices, and meshlet bounds in the cull passes
+    bindings[4].binding = 4;
+    bindings[4].descriptorCount = 1;
+    bindings[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    bindings[4].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+    if (m_meshShaderSupported) {
+        bindings[4].stageFlags |= VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
+    }
     
     VkDescriptorSetLayoutCreateInfo layoutInfo{};
     layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    layoutInfo.bindingCount = 1;
-    layoutInfo.pBindings = &uboLayoutBinding;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
     
     if (vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS) {
         throw std::runtime_error("failed to create descriptor set layout!");
     }
+
+    // Meshlet set: 0 = meshlets, 1 = meshlet vertices, 2 = meshlet triangles,
+    // 3 = visibility, 4 = Hi-Z pyramid, 5 = vertices (mesh shader), 6 = compacted
+    // indices and 7 = their draw command (compute path)
+    VkShaderStageFlags meshletStages = VK_SHADER_STAGE_COMPUTE_BIT;
+    if (m_meshShaderSupported) {
+        meshletStages |= VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
+    }
+    std::array<VkDescriptorSetLayoutBinding, 8> meshletBindings{};
+    for (uint32_t b = 0; b < meshletBindings.size(); ++b) {
+        meshletBindings[b].binding = b;
+        meshletBindings[b].descriptorCount = 1;
+        meshletBindings[b].descriptorType = b == 4 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        meshletBindings[b].stageFlags = meshletStages;
+    }
+    layoutInfo.bindingCount = static_cast<uint32_t>(meshletBindings.size());
+    layoutInfo.pBindings = meshletBindings.data();
+    if (vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &m_meshletSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create meshlet descriptor set layout!");
+    }
 }
 
-void SimpleRenderer::createUniformBuffers() {
-    VkDeviceSize bufferSize = sizeof(UniformBufferObject);
-    
-    m_uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-    m_uniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
-    m_uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
-    
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_uniformBuffers[i], m_uniformBuffersMemory[i]);
-        
-        vkMapMemory(m_device, m_uniformBuffersMemory[i], 0, bufferSize, 0, &m_uniformBuffersMapped[i]);
+// One allocation for everything the CPU rewrites per frame. Each frame in
+// flight owns a slice, so a write never races the GPU reading another frame.
+void SimpleRenderer::createFrameConstants() {
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(m_physicalDevice, &properties);
+    const VkDeviceSize alignment = std::max(properties.limits.minUniformBufferOffsetAlignment,
+                                            properties.limits.minStorageBufferOffsetAlignment);
+    auto alignUp = [alignment](VkDeviceSize value) { return (value + alignment - 1) / alignment * alignment; };
+
+    m_cameraConstantsOffset = 0;
+    m_lightingConstantsOffset = alignUp(m_cameraConstantsOffset + sizeof(UniformBufferObject));
+    m_pointLightsOffset = alignUp(m_lightingConstantsOffset + sizeof(LightingUBO));
+    m_frameConstantsStride = alignUp(m_pointLightsOffset + sizeof(PointLight) * MAX_POINT_LIGHTS);
+    const VkDeviceSize bufferSize = m_frameConstantsStride * MAX_FRAMES_IN_FLIGHT;
+
+    createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 m_frameConstantsBuffer, m_frameConstantsMemory);
+    void* mapped = nullptr;
+    vkMapMemory(m_device, m_frameConstantsMemory, 0, bufferSize, 0, &mapped);
+    m_frameConstantsMapped = static_cast<uint8_t*>(mapped);
+
+    // The shadow copy starts out equal to the mapped memory
+    std::memset(m_frameConstantsMapped, 0, bufferSize);
+    m_frameConstantsShadow.assign(bufferSize, 0);
+}
+
+void SimpleRenderer::writeFrameConstants(uint32_t frame, VkDeviceSize offset, const void* data, size_t size) {
+    const VkDeviceSize position = frame * m_frameConstantsStride + offset;
+    uint8_t* shadow = m_frameConstantsShadow.data() + position;
+    if (std::memcmp(shadow, data, size) == 0) {
+        return;
     }
+    std::memcpy(shadow, data, size);
+    std::memcpy(m_frameConstantsMapped + position, data, size);
 }
 
-void SimpleRenderer::createLightingBuffers() {
-    VkDeviceSize bufferSize = sizeof(LightingUBO);
-    
-    m_lightingBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-    m_lightingBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
-    m_lightingBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
-    
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_lightingBuffers[i], m_lightingBuffersMemory[i]);
-        
-        vkMapMemory(m_device, m_lightingBuffersMemory[i], 0, bufferSize, 0, &m_lightingBuffersMapped[i]);
+// Describes a block in frame 0's slice; binds add getFrameConstantsOffset()
+// as the dynamic offset to reach the current frame's copy
+VkDescriptorBufferInfo SimpleRenderer::frameConstantsInfo(VkDeviceSize offset, VkDeviceSize range) const {
+    return {m_frameConstantsBuffer, offset, range};
+}
+
+uint32_t SimpleRenderer::getFrameConstantsOffset() const {
+    return static_cast<uint32_t>(m_currentFrame * m_frameConstantsStride);
+}
+
+// Sized once the scene's meshes are known, so binding 4 of the raster set is
+// written here rather than in createDescriptorSets. Every slice starts out
+// with the load-time matrices and no motion.
+void SimpleRenderer::createMeshTransforms(const SceneTransforms& transforms) {
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(m_physicalDevice, &properties);
+    const VkDeviceSize alignment = properties.limits.minStorageBufferOffsetAlignment;
+    const VkDeviceSize sliceSize = sizeof(MeshTransform) * transforms.meshWorlds.size();
+    m_meshTransformStride = (sliceSize + alignment - 1) / alignment * alignment;
+    const VkDeviceSize bufferSize = m_meshTransformStride * MAX_FRAMES_IN_FLIGHT;
+
+    createBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 m_meshTransformBuffer, m_meshTransformMemory);
+    void* mapped = nullptr;
+    vkMapMemory(m_device, m_meshTransformMemory, 0, bufferSize, 0, &mapped);
+    m_meshTransformsMapped = static_cast<uint8_t*>(mapped);
+
+    for (uint32_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; ++frame) {
+        auto* slice = reinterpret_cast<MeshTransform*>(m_meshTransformsMapped + frame * m_meshTransformStride);
+        for (size_t i = 0; i < transforms.meshWorlds.size(); ++i) {
+            slice[i] = {transforms.meshWorlds[i], transforms.meshWorlds[i]};
+        }
+    }
+    m_previousMeshWorlds = transforms.meshWorlds;
+    m_previousMeshTransformVersion = transforms.version;
+    m_settledMeshTransformVersions.assign(MAX_FRAMES_IN_FLIGHT, transforms.version);
+
+    VkDescriptorBufferInfo bufferInfo{m_meshTransformBuffer, 0, sliceSize};
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = m_descriptorSet;
+    write.dstBinding = 4;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    write.descriptorCount = 1;
+    write.pBufferInfo = &bufferInfo;
+    vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+}
+
+// Writes this frame's slice. While the graph moves, previousModel holds the
+// matrices the last frame drew with so motion vectors see the mesh move; once
+// it stops, each slice is rewritten one last time with both equal.
+void SimpleRenderer::updateMeshTransforms(const SceneTransforms& transforms) {
+    if (!m_meshTransformsMapped || transforms.meshWorlds.size() != m_previousMeshWorlds.size()) {
+        return;
+    }
+
+    auto* slice = reinterpret_cast<MeshTransform*>(m_meshTransformsMapped + m_currentFrame * m_meshTransformStride);
+    uint64_t& settled = m_settledMeshTransformVersions[m_currentFrame];
+    if (transforms.version != m_previousMeshTransformVersion) {
+        for (size_t i = 0; i < transforms.meshWorlds.size(); ++i) {
+            slice[i] = {transforms.meshWorlds[i], m_previousMeshWorlds[i]};
+        }
+        settled = 0;
+
+        for (size_t l = 0; l < m_sceneLights.size(); ++l) {
+            m_sceneLights[l].positionRadius = placeBoundingSphere(transforms.meshWorlds[m_sceneLightMeshes[l]], m_sceneLightBounds[l]) +
+                                              glm::vec4(0.0f, 0.0f, 0.0f, EMISSIVE_LIGHT_REACH);
+        }
+        m_previousMeshWorlds = transforms.meshWorlds;
+        m_previousMeshTransformVersion = transforms.version;
+    } else if (settled != transforms.version) {
+        for (size_t i = 0; i < transforms.meshWorlds.size(); ++i) {
+            slice[i] = {transforms.meshWorlds[i], transforms.meshWorlds[i]};
+        }
+        settled = transforms.version;
     }
 }
 
+uint32_t SimpleRenderer::getMeshTransformOffset() const {
+    return static_cast<uint32_t>(m_currentFrame * m_meshTransformStride);
+}
+
 void SimpleRenderer::createDescriptorPool() {
-    VkDescriptorPoolSize poolSize{};
-    poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSize.descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    std::array<VkDescriptorPoolSize, 3> poolSizes = {{
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 2},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2}
+    }};
     
     VkDescriptorPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolInfo.poolSizeCount = 1;
-    poolInfo.pPoolSizes = &poolSize;
-    poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = 1;
     
     if (vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
         throw std::runtime_error("failed to create descriptor pool!");
     }
 }
 
+// One set for every frame in flight: the ring bindings are dynamic
 void SimpleRenderer::createDescriptorSets() {
-    std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, m_descriptorSetLayout);
     VkDescriptorSetAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
     allocInfo.descriptorPool = m_descriptorPool;
-    allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-    allocInfo.pSetLayouts = layouts.data();
-    
-    m_descriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
-    if (vkAllocateDescriptorSets(m_device, &allocInfo, m_descriptorSets.data()) != VK_SUCCESS) {
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &m_descriptorSetLayout;
+    if (vkAllocateDescriptorSets(m_device, &allocInfo, &m_descriptorSet) != VK_SUCCESS) {
         throw std::runtime_error("failed to allocate descriptor sets!");
     }
     
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        VkDescriptorBufferInfo bufferInfo{};
-        bufferInfo.buffer = m_uniformBuffers[i];
-        bufferInfo.offset = 0;
-        bufferInfo.range = sizeof(UniformBufferObject);
-        
-        VkWriteDescriptorSet descriptorWrite{};
-        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrite.dstSet = m_descriptorSets[i];
-        descriptorWrite.dstBinding = 0;
-        descriptorWrite.dstArrayElement = 0;
-        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        descriptorWrite.descriptorCount = 1;
-        descriptorWrite.pBufferInfo = &bufferInfo;
-        
-        vkUpdateDescriptorSets(m_device, 1, &descriptorWrite, 0, nullptr);
+    std::array<VkDescriptorBufferInfo, 4> bufferInfos = {{
+        frameConstantsInfo(m_cameraConstantsOffset, sizeof(UniformBufferObject)),
+        frameConstantsInfo(m_pointLightsOffset, sizeof(PointLight) * MAX_POINT_LIGHTS),
+        {m_clusterCountBuffer, 0, VK_WHOLE_SIZE},
+        {m_clusterLightBuffer, 0, VK_WHOLE_SIZE}
+    }};
+    const std::array<VkDescriptorType, 4> types = {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+                                                   VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER};
+    
+    std::array<VkWriteDescriptorSet, 4> descriptorWrites{};
+    for (uint32_t b = 0; b < descriptorWrites.size(); ++b) {
+        descriptorWrites[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[b].dstSet = m_descriptorSet;
+        descriptorWrites[b].dstBinding = b;
+        descriptorWrites[b].dstArrayElement = 0;
+        descriptorWrites[b].descriptorType = types[b];
+        descriptorWrites[b].descriptorCount = 1;
+        descriptorWrites[b].pBufferInfo = &bufferInfos[b];
     }
+    
+    vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
 }
 
-void SimpleRenderer::updateUniformBuffer(uint32_t currentImage, Camera* camera) {
-    static auto startTime = std::chrono::high_resolution_clock::now();
+UniformBufferObject SimpleRenderer::makeCameraConstants(Camera* camera) const {
     static bool debugPrinted = false;
     
-    auto currentTime = std::chrono::high_resolution_clock::now();
-    float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
-    
     UniformBufferObject ubo{};
     ubo.model = glm::mat4(1.0f);
     
     if (camera) {
         ubo.view = camera->getViewMatrix();
-        ubo.proj = camera->getProjectionMatrix();
-        ubo.viewInverse = glm::inverse(ubo.view);
-        ubo.projInverse = glm::inverse(ubo.proj);
+        ubo.proj = camera->getJitteredProjectionMatrix(m_jitter, m_renderExtent.width, m_renderExtent.height);
+        ubo.viewProjection = camera->getProjectionMatrix() * ubo.view;
         ubo.cameraPos = camera->getPosition();
         
         // Debug output for first frame
@@ -1205,49 +2880,71 @@ void SimpleRenderer::updateUniformBuffer(uint32_t currentImage, Camera* camera)
         }
     } else {
         ubo.view = glm::lookAt(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        ubo.proj = glm::perspective(glm::radians(45.0f), (float)m_swapChainExtent.width / (float)m_swapChainExtent.height, 0.1f, 100.0f);
+        ubo.proj = glm::perspective(glm::radians(45.0f), (float)m_swapChainExtent.width / (float)m_swapChainExtent.height, 100.0f, 0.1f); // Reverse-Z
         ubo.proj[1][1] *= -1; // Flip Y for Vulkan
         ubo.cameraPos = glm::vec3(0.0f, 0.0f, 3.0f);
+        ubo.viewProjection = ubo.proj * ubo.view;
     }
+    ubo.viewInverse = inverseRigid(ubo.view);
+    ubo.projInverse = inversePerspective(ubo.proj);
     
-    ubo.time = time;
-    
-    memcpy(m_uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
+    // First frame has no history, so it reports zero motion
+    ubo.prevViewProjection = m_hasPrevViewProjection ? m_prevViewProjection : ubo.viewProjection;
+    return ubo;
 }
 
-void SimpleRenderer::updateLightingBuffer(uint32_t currentImage) {
-    static auto startTime = std::chrono::high_resolution_clock::now();
-    auto currentTime = std::chrono::high_resolution_clock::now();
-    float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+void SimpleRenderer::updateUniformBuffer(uint32_t currentImage, Camera* camera) {
+    UniformBufferObject ubo = makeCameraConstants(camera);
+    m_prevViewProjection = ubo.viewProjection;
+    m_hasPrevViewProjection = true;
     
+    writeFrameConstants(currentImage, m_cameraConstantsOffset, &ubo, sizeof(ubo));
+}
+
+LightingUBO SimpleRenderer::makeLightingConstants(float time) const {
     LightingUBO lighting{};
     
     // Set up cyberpunk lighting
     lighting.lightCount = 4;
     lighting.ambientLight = glm::vec3(0.02f, 0.02f, 0.05f);
-    lighting.exposure = 1.5f;
+    lighting.exposure = m_postSettings.exposure; // Applied by the post chain
     
     // Main city light - bright magenta
-    lighting.lightPositions[0] = glm::vec3(0.0f, 50.0f, -30.0f);
-    lighting.lightColors[0] = glm::vec3(1.0f, 0.3f, 0.8f);
-    lighting.lightIntensities[0] = 2.0f;
+    lighting.lightPositions[0] = glm::vec4(0.0f, 50.0f, -30.0f, 1.0f);
+    lighting.lightColors[0] = glm::vec4(1.0f, 0.3f, 0.8f, 2.0f);
     
     // Secondary light - cyan
-    lighting.lightPositions[1] = glm::vec3(-20.0f, 30.0f, -20.0f);
-    lighting.lightColors[1] = glm::vec3(0.2f, 0.8f, 1.0f);
-    lighting.lightIntensities[1] = 1.5f;
+    lighting.lightPositions[1] = glm::vec4(-20.0f, 30.0f, -20.0f, 1.0f);
+    lighting.lightColors[1] = glm::vec4(0.2f, 0.8f, 1.0f, 1.5f);
     
     // Ground light - warm orange
-    lighting.lightPositions[2] = glm::vec3(10.0f, 5.0f, -25.0f);
-    lighting.lightColors[2] = glm::vec3(1.0f, 0.6f, 0.2f);
-    lighting.lightIntensities[2] = 1.0f;
+    lighting.lightPositions[2] = glm::vec4(10.0f, 5.0f, -25.0f, 1.0f);
+    lighting.lightColors[2] = glm::vec4(1.0f, 0.6f, 0.2f, 1.0f);
     
     // Animated light - pulsing purple
-    lighting.lightPositions[3] = glm::vec3(15.0f, 40.0f, -35.0f + sin(time * 0.5f) * 10.0f);
-    lighting.lightColors[3] = glm::vec3(0.8f, 0.2f, 1.0f);
-    lighting.lightIntensities[3] = 1.2f + sin(time * 2.0f) * 0.3f;
-    
-    memcpy(m_lightingBuffersMapped[currentImage], &lighting, sizeof(lighting));
+    lighting.lightPositions[3] = glm::vec4(15.0f, 40.0f, -35.0f + sin(time * 0.5f) * 10.0f, 1.0f);
+    lighting.lightColors[3] = glm::vec4(0.8f, 0.2f, 1.0f, 1.2f + sin(time * 2.0f) * 0.3f);
+    return lighting;
+}
+
+void SimpleRenderer::updateLightingBuffer(uint32_t currentImage, float time) {
+    LightingUBO lighting = makeLightingConstants(time);
+    writeFrameConstants(currentImage, m_lightingConstantsOffset, &lighting, sizeof(lighting));
+
+    // The raster path sees the key lights followed by the emissive mesh
+    // lights. The mesh lights are static, so after the first frames in flight
+    // only the key lights reach the mapped memory.
+    std::array<PointLight, KEY_LIGHT_COUNT> keyLights;
+    for (uint32_t i = 0; i < KEY_LIGHT_COUNT; ++i) {
+        keyLights[i].positionRadius = glm::vec4(glm::vec3(lighting.lightPositions[i]), KEY_LIGHT_RANGE);
+        keyLights[i].colorIntensity = lighting.lightColors[i];
+    }
+    writeFrameConstants(currentImage, m_pointLightsOffset, keyLights.data(), sizeof(keyLights));
+    if (!m_sceneLights.empty()) {
+        writeFrameConstants(currentImage, m_pointLightsOffset + sizeof(keyLights), m_sceneLights.data(),
+                            sizeof(PointLight) * m_sceneLights.size());
+    }
+    m_clusterParams.lightCount = KEY_LIGHT_COUNT + static_cast<uint32_t>(m_sceneLights.size());
 }
 
 void SimpleRenderer::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory, VkMemoryAllocateFlags allocateFlags) {
@@ -1281,6 +2978,26 @@ void SimpleRenderer::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, V
     vkBindBufferMemory(m_device, buffer, bufferMemory, 0);
 }
 
+// Blocking copy of a device-local buffer into host memory, for one-off reads
+void SimpleRenderer::readBackBuffer(VkBuffer source, void* destination, VkDeviceSize size) {
+    if (size == 0) {
+        return;
+    }
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 stagingBuffer, stagingBufferMemory);
+    copyBuffer(source, stagingBuffer, size);
+
+    void* data;
+    vkMapMemory(m_device, stagingBufferMemory, 0, size, 0, &data);
+    memcpy(destination, data, (size_t)size);
+    vkUnmapMemory(m_device, stagingBufferMemory);
+
+    vkDestroyBuffer(m_device, stagingBuffer, nullptr);
+    vkFreeMemory(m_device, stagingBufferMemory, nullptr);
+}
+
 void SimpleRenderer::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
     VkCommandBuffer commandBuffer = beginSingleTimeCommands();
     
@@ -1343,135 +3060,280 @@ void SimpleRenderer::loadRayTracingFunctions() {
     m_vkGetAccelerationStructureDeviceAddressKHR = reinterpret_cast<PFN_vkGetAccelerationStructureDeviceAddressKHR>(vkGetDeviceProcAddr(m_device, "vkGetAccelerationStructureDeviceAddressKHR"));
     m_vkCmdBuildAccelerationStructuresKHR = reinterpret_cast<PFN_vkCmdBuildAccelerationStructuresKHR>(vkGetDeviceProcAddr(m_device, "vkCmdBuildAccelerationStructuresKHR"));
     m_vkGetAccelerationStructureBuildSizesKHR = reinterpret_cast<PFN_vkGetAccelerationStructureBuildSizesKHR>(vkGetDeviceProcAddr(m_device, "vkGetAccelerationStructureBuildSizesKHR"));
+    m_vkCmdCopyAccelerationStructureToMemoryKHR = reinterpret_cast<PFN_vkCmdCopyAccelerationStructureToMemoryKHR>(vkGetDeviceProcAddr(m_device, "vkCmdCopyAccelerationStructureToMemoryKHR"));
+    m_vkCmdCopyMemoryToAccelerationStructureKHR = reinterpret_cast<PFN_vkCmdCopyMemoryToAccelerationStructureKHR>(vkGetDeviceProcAddr(m_device, "vkCmdCopyMemoryToAccelerationStructureKHR"));
+    m_vkCmdWriteAccelerationStructuresPropertiesKHR = reinterpret_cast<PFN_vkCmdWriteAccelerationStructuresPropertiesKHR>(vkGetDeviceProcAddr(m_device, "vkCmdWriteAccelerationStructuresPropertiesKHR"));
+    m_vkGetDeviceAccelerationStructureCompatibilityKHR = reinterpret_cast<PFN_vkGetDeviceAccelerationStructureCompatibilityKHR>(vkGetDeviceProcAddr(m_device, "vkGetDeviceAccelerationStructureCompatibilityKHR"));
     m_vkCreateRayTracingPipelinesKHR = reinterpret_cast<PFN_vkCreateRayTracingPipelinesKHR>(vkGetDeviceProcAddr(m_device, "vkCreateRayTracingPipelinesKHR"));
     m_vkGetRayTracingShaderGroupHandlesKHR = reinterpret_cast<PFN_vkGetRayTracingShaderGroupHandlesKHR>(vkGetDeviceProcAddr(m_device, "vkGetRayTracingShaderGroupHandlesKHR"));
     m_vkCmdTraceRaysKHR = reinterpret_cast<PFN_vkCmdTraceRaysKHR>(vkGetDeviceProcAddr(m_device, "vkCmdTraceRaysKHR"));
+    m_vkCreateDeferredOperationKHR = reinterpret_cast<PFN_vkCreateDeferredOperationKHR>(vkGetDeviceProcAddr(m_device, "vkCreateDeferredOperationKHR"));
+    m_vkDestroyDeferredOperationKHR = reinterpret_cast<PFN_vkDestroyDeferredOperationKHR>(vkGetDeviceProcAddr(m_device, "vkDestroyDeferredOperationKHR"));
+    m_vkGetDeferredOperationMaxConcurrencyKHR = reinterpret_cast<PFN_vkGetDeferredOperationMaxConcurrencyKHR>(vkGetDeviceProcAddr(m_device, "vkGetDeferredOperationMaxConcurrencyKHR"));
+    m_vkGetDeferredOperationResultKHR = reinterpret_cast<PFN_vkGetDeferredOperationResultKHR>(vkGetDeviceProcAddr(m_device, "vkGetDeferredOperationResultKHR"));
+    m_vkDeferredOperationJoinKHR = reinterpret_cast<PFN_vkDeferredOperationJoinKHR>(vkGetDeviceProcAddr(m_device, "vkDeferredOperationJoinKHR"));
 
     if (!m_vkCreateAccelerationStructureKHR ||
         !m_vkDestroyAccelerationStructureKHR ||
         !m_vkGetAccelerationStructureDeviceAddressKHR ||
         !m_vkCmdBuildAccelerationStructuresKHR ||
         !m_vkGetAccelerationStructureBuildSizesKHR ||
+        !m_vkCmdCopyAccelerationStructureToMemoryKHR ||
+        !m_vkCmdCopyMemoryToAccelerationStructureKHR ||
+        !m_vkCmdWriteAccelerationStructuresPropertiesKHR ||
+        !m_vkGetDeviceAccelerationStructureCompatibilityKHR ||
         !m_vkCreateRayTracingPipelinesKHR ||
         !m_vkGetRayTracingShaderGroupHandlesKHR ||
-        !m_vkCmdTraceRaysKHR) {
+        !m_vkCmdTraceRaysKHR ||
+        !m_vkCreateDeferredOperationKHR ||
+        !m_vkDestroyDeferredOperationKHR ||
+        !m_vkGetDeferredOperationMaxConcurrencyKHR ||
+        !m_vkGetDeferredOperationResultKHR ||
+        !m_vkDeferredOperationJoinKHR) {
         throw std::runtime_error("Required ray tracing functions are not available on this device");
     }
 }
 
 void SimpleRenderer::createAccelerationStructures() {
+    joinRayTracingCompile();
     cleanupAccelerationStructures();
     m_rtReady = false;
+    m_asStats = {};
 
-    if (m_vertexCount == 0 || m_indexCount == 0) {
+    if (m_vertexCount == 0 || m_indexCount == 0 || m_rtMeshes.empty()) {
         std::cout << "[RT] No geometry available for acceleration structures" << std::endl;
         cleanupRayTracingPipeline();
-        cleanupRayTracingStorageImage();
         return;
     }
 
-    std::cout << "[RT] Building acceleration structures with " << m_vertexCount << " vertices and " << m_indexCount << " indices" << std::endl;
+    auto setupStart = std::chrono::steady_clock::now();
+    std::cout << "[RT] Building acceleration structures with " << m_vertexCount << " vertices, " << m_indexCount
+              << " indices and " << m_rtMeshes.size() << " meshes" << std::endl;
 
     VkDeviceAddress vertexAddress = getBufferDeviceAddress(m_vertexBuffer);
     VkDeviceAddress indexAddress = getBufferDeviceAddress(m_indexBuffer);
 
-    VkAccelerationStructureGeometryTrianglesDataKHR triangles{};
-    triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
-    triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
-    triangles.vertexData.deviceAddress = vertexAddress;
-    triangles.vertexStride = sizeof(GLTFVertex);
-    triangles.maxVertex = m_vertexCount;
-    triangles.indexType = VK_INDEX_TYPE_UINT32;
-    triangles.indexData.deviceAddress = indexAddress;
-
-    VkAccelerationStructureGeometryKHR geometry{};
-    geometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
-    geometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
-    geometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
-    geometry.geometry.triangles = triangles;
-
-    VkAccelerationStructureBuildGeometryInfoKHR buildInfo{};
-    buildInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
-    buildInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-    buildInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
-    buildInfo.geometryCount = 1;
-    buildInfo.pGeometries = &geometry;
-
-    uint32_t primitiveCount = m_indexCount / 3;
-    VkAccelerationStructureBuildSizesInfoKHR sizeInfo{};
-    sizeInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
-    m_vkGetAccelerationStructureBuildSizesKHR(m_device,
-                                              VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
-                                              &buildInfo,
-                                              &primitiveCount,
-                                              &sizeInfo);
+    VkPhysicalDeviceAccelerationStructurePropertiesKHR asProperties{};
+    asProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_PROPERTIES_KHR;
+    VkPhysicalDeviceProperties2 deviceProperties{};
+    deviceProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    deviceProperties.pNext = &asProperties;
+    vkGetPhysicalDeviceProperties2(m_physicalDevice, &deviceProperties);
+    VkDeviceSize scratchAlignment = asProperties.minAccelerationStructureScratchOffsetAlignment;
+    auto alignUp = [](VkDeviceSize value, VkDeviceSize alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    };
 
-    createBuffer(sizeInfo.accelerationStructureSize,
-                 VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                 m_bottomLevelAS.buffer,
-                 m_bottomLevelAS.memory,
-                 VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT);
+    // Cached BLASes are deserialized instead of built. The driver decides
+    // whether a blob is still usable; rejected ones are rebuilt and rewritten.
+    size_t meshCount = m_rtMeshes.size();
+    std::vector<std::vector<uint8_t>> cachedData(meshCount);
+    if (m_asCache) {
+        parallelFor(m_jobSystem, static_cast<uint32_t>(meshCount), 1, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; ++i) {
+                if (m_rtMeshes[i].geometryHash != 0) {
+                    m_asCache->load(m_rtMeshes[i].geometryHash, cachedData[i]);
+                }
+            }
+        });
+        for (std::vector<uint8_t>& data : cachedData) {
+            if (data.empty()) {
+                continue;
+            }
+            VkAccelerationStructureVersionInfoKHR versionInfo{};
+            versionInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_VERSION_INFO_KHR;
+            versionInfo.pVersionData = data.data();
+            VkAccelerationStructureCompatibilityKHR compatibility = VK_ACCELERATION_STRUCTURE_COMPATIBILITY_INCOMPATIBLE_KHR;
+            m_vkGetDeviceAccelerationStructureCompatibilityKHR(m_device, &versionInfo, &compatibility);
+            if (compatibility != VK_ACCELERATION_STRUCTURE_COMPATIBILITY_COMPATIBLE_KHR) {
+                data.clear();
+                m_asStats.blasIncompatible++;
+            }
+        }
+    }
 
-    VkAccelerationStructureCreateInfoKHR accelCreateInfo{};
-    accelCreateInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
-    accelCreateInfo.buffer = m_bottomLevelAS.buffer;
-    accelCreateInfo.size = sizeInfo.accelerationStructureSize;
-    accelCreateInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+    // One BLAS per mesh. Cached ones are copied from a single staging buffer,
+    // the rest are built in a single command with a shared scratch buffer.
+    std::vector<VkAccelerationStructureGeometryKHR> geometries(meshCount);
+    std::vector<VkAccelerationStructureBuildGeometryInfoKHR> buildInfos(meshCount);
+    std::vector<VkAccelerationStructureBuildRangeInfoKHR> rangeInfos(meshCount);
+    std::vector<VkDeviceSize> scratchOffsets(meshCount);
+    std::vector<VkDeviceSize> stagingOffsets(meshCount);
+    std::vector<uint32_t> builtMeshes;
+    std::vector<uint32_t> cachedMeshes;
+    VkDeviceSize scratchSize = 0;
+    VkDeviceSize stagingSize = 0;
+
+    for (size_t i = 0; i < meshCount; ++i) {
+        RayTracedMesh& mesh = m_rtMeshes[i];
+        VkDeviceSize accelerationStructureSize = 0;
+
+        if (!cachedData[i].empty()) {
+            accelerationStructureSize = AccelerationStructureCache::readDeserializedSize(cachedData[i]);
+            stagingOffsets[i] = stagingSize;
+            stagingSize += alignUp(cachedData[i].size(), AS_SERIALIZATION_ALIGNMENT);
+            cachedMeshes.push_back(static_cast<uint32_t>(i));
+        } else {
+            // Indices are rebased to the shared vertex buffer, so every geometry
+            // sees all vertices and only the index range differs.
+            VkAccelerationStructureGeometryTrianglesDataKHR triangles{};
+            triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
+            triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
+            triangles.vertexData.deviceAddress = vertexAddress;
+            triangles.vertexStride = sizeof(GLTFVertex);
+            triangles.maxVertex = m_vertexCount - 1;
+            triangles.indexType = VK_INDEX_TYPE_UINT32;
+            triangles.indexData.deviceAddress = indexAddress + mesh.material.firstIndex * sizeof(uint32_t);
+
+            geometries[i].sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
+            geometries[i].geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
+            geometries[i].flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+            geometries[i].geometry.triangles = triangles;
+
+            VkAccelerationStructureBuildGeometryInfoKHR& buildInfo = buildInfos[i];
+            buildInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+            buildInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+            buildInfo.flags = BLAS_BUILD_FLAGS;
+            buildInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+            buildInfo.geometryCount = 1;
+            buildInfo.pGeometries = &geometries[i];
+
+            uint32_t primitiveCount = mesh.indexCount / 3;
+            VkAccelerationStructureBuildSizesInfoKHR sizeInfo{};
+            sizeInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
+            m_vkGetAccelerationStructureBuildSizesKHR(m_device,
+                                                      VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
+                                                      &buildInfo,
+                                                      &primitiveCount,
+                                                      &sizeInfo);
+
+            accelerationStructureSize = sizeInfo.accelerationStructureSize;
+            rangeInfos[i].primitiveCount = primitiveCount;
+            scratchOffsets[i] = scratchSize;
+            scratchSize += alignUp(sizeInfo.buildScratchSize, scratchAlignment);
+            builtMeshes.push_back(static_cast<uint32_t>(i));
+        }
 
-    if (m_vkCreateAccelerationStructureKHR(m_device, &accelCreateInfo, nullptr, &m_bottomLevelAS.handle) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to create bottom-level acceleration structure");
+        createBuffer(accelerationStructureSize,
+                     VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                     mesh.blas.buffer,
+                     mesh.blas.memory,
+                     VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT);
+
+        VkAccelerationStructureCreateInfoKHR accelCreateInfo{};
+        accelCreateInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
+        accelCreateInfo.buffer = mesh.blas.buffer;
+        accelCreateInfo.size = accelerationStructureSize;
+        accelCreateInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+
+        if (m_vkCreateAccelerationStructureKHR(m_device, &accelCreateInfo, nullptr, &mesh.blas.handle) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create bottom-level acceleration structure");
+        }
+        buildInfos[i].dstAccelerationStructure = mesh.blas.handle;
     }
 
-    VkBuffer scratchBuffer;
-    VkDeviceMemory scratchMemory;
-    createBuffer(sizeInfo.buildScratchSize,
-                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                 scratchBuffer,
-                 scratchMemory,
-                 VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT);
-
-    VkAccelerationStructureBuildGeometryInfoKHR buildGeomInfo = buildInfo;
-    buildGeomInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
-    buildGeomInfo.dstAccelerationStructure = m_bottomLevelAS.handle;
-    buildGeomInfo.scratchData.deviceAddress = getBufferDeviceAddress(scratchBuffer);
+    // Over-allocate so the base addresses can be rounded up to the scratch
+    // and serialization alignments
+    VkBuffer scratchBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory scratchMemory = VK_NULL_HANDLE;
+    std::vector<VkAccelerationStructureBuildGeometryInfoKHR> pendingBuilds;
+    std::vector<const VkAccelerationStructureBuildRangeInfoKHR*> pRangeInfos;
+    if (!builtMeshes.empty()) {
+        createBuffer(scratchSize + scratchAlignment,
+                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                     scratchBuffer,
+                     scratchMemory,
+                     VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT);
+
+        VkDeviceAddress scratchAddress = alignUp(getBufferDeviceAddress(scratchBuffer), scratchAlignment);
+        for (uint32_t i : builtMeshes) {
+            buildInfos[i].scratchData.deviceAddress = scratchAddress + scratchOffsets[i];
+            pendingBuilds.push_back(buildInfos[i]);
+            pRangeInfos.push_back(&rangeInfos[i]);
+        }
+    }
 
-    VkAccelerationStructureBuildRangeInfoKHR rangeInfo{};
-    rangeInfo.primitiveCount = primitiveCount;
-    const VkAccelerationStructureBuildRangeInfoKHR* pRangeInfo = &rangeInfo;
+    VkBuffer stagingBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory stagingMemory = VK_NULL_HANDLE;
+    VkDeviceAddress stagingAddress = 0;
+    if (!cachedMeshes.empty()) {
+        createBuffer(stagingSize + AS_SERIALIZATION_ALIGNMENT,
+                     VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     stagingBuffer,
+                     stagingMemory,
+                     VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT);
+
+        VkDeviceAddress rawAddress = getBufferDeviceAddress(stagingBuffer);
+        stagingAddress = alignUp(rawAddress, AS_SERIALIZATION_ALIGNMENT);
+        void* mapped = nullptr;
+        vkMapMemory(m_device, stagingMemory, 0, VK_WHOLE_SIZE, 0, &mapped);
+        uint8_t* base = static_cast<uint8_t*>(mapped) + (stagingAddress - rawAddress);
+        for (uint32_t i : cachedMeshes) {
+            std::memcpy(base + stagingOffsets[i], cachedData[i].data(), cachedData[i].size());
+            std::vector<uint8_t>().swap(cachedData[i]);
+        }
+        vkUnmapMemory(m_device, stagingMemory);
+    }
 
     VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-    m_vkCmdBuildAccelerationStructuresKHR(commandBuffer, 1, &buildGeomInfo, &pRangeInfo);
+    for (uint32_t i : cachedMeshes) {
+        VkCopyMemoryToAccelerationStructureInfoKHR copyInfo{};
+        copyInfo.sType = VK_STRUCTURE_TYPE_COPY_MEMORY_TO_ACCELERATION_STRUCTURE_INFO_KHR;
+        copyInfo.src.deviceAddress = stagingAddress + stagingOffsets[i];
+        copyInfo.dst = m_rtMeshes[i].blas.handle;
+        copyInfo.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_DESERIALIZE_KHR;
+        m_vkCmdCopyMemoryToAccelerationStructureKHR(commandBuffer, &copyInfo);
+    }
+    if (!pendingBuilds.empty()) {
+        m_vkCmdBuildAccelerationStructuresKHR(commandBuffer, static_cast<uint32_t>(pendingBuilds.size()), pendingBuilds.data(), pRangeInfos.data());
+    }
     endSingleTimeCommands(commandBuffer);
 
-    vkDestroyBuffer(m_device, scratchBuffer, nullptr);
-    vkFreeMemory(m_device, scratchMemory, nullptr);
-
-    VkAccelerationStructureDeviceAddressInfoKHR addressInfo{};
-    addressInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
-    addressInfo.accelerationStructure = m_bottomLevelAS.handle;
-    m_bottomLevelAS.deviceAddress = m_vkGetAccelerationStructureDeviceAddressKHR(m_device, &addressInfo);
-
-    struct InstanceData {
-        VkTransformMatrixKHR transform;
-        uint32_t instanceCustomIndex : 24;
-        uint32_t mask : 8;
-        uint32_t instanceShaderBindingTableRecordOffset : 24;
-        uint32_t flags : 8;
-        uint64_t accelerationStructureReference;
-    };
+    if (scratchBuffer != VK_NULL_HANDLE) {
+        vkDestroyBuffer(m_device, scratchBuffer, nullptr);
+        vkFreeMemory(m_device, scratchMemory, nullptr);
+    }
+    if (stagingBuffer != VK_NULL_HANDLE) {
+        vkDestroyBuffer(m_device, stagingBuffer, nullptr);
+        vkFreeMemory(m_device, stagingMemory, nullptr);
+    }
 
-    InstanceData instance{};
-    instance.transform = makeIdentityTransformMatrix();
-    instance.instanceCustomIndex = 0;
-    instance.mask = 0xFF;
-    instance.instanceShaderBindingTableRecordOffset = 0;
-    instance.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
-    instance.accelerationStructureReference = m_bottomLevelAS.deviceAddress;
+    for (RayTracedMesh& mesh : m_rtMeshes) {
+        VkAccelerationStructureDeviceAddressInfoKHR addressInfo{};
+        addressInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
+        addressInfo.accelerationStructure = mesh.blas.handle;
+        mesh.blas.deviceAddress = m_vkGetAccelerationStructureDeviceAddressKHR(m_device, &addressInfo);
+    }
+
+    if (m_asCache && !builtMeshes.empty()) {
+        serializeAccelerationStructures(builtMeshes);
+    }
+
+    // The custom index lets ray queries find the mesh info entry; the record
+    // offset selects the mesh's hit record (one record per mesh, see the SBT).
+    // The transform places the mesh-space BLAS through its scene graph node.
+    std::vector<InstanceData> instances(meshCount);
+    m_instanceMeshes.resize(meshCount);
+    for (size_t i = 0; i < meshCount; ++i) {
+        InstanceData& instance = instances[i];
+        instance.transform = m_rtMeshes[i].transform;
+        instance.instanceCustomIndex = static_cast<uint32_t>(i);
+        instance.mask = 0xFF;
+        instance.instanceShaderBindingTableRecordOffset = static_cast<uint32_t>(i);
+        instance.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
+        instance.accelerationStructureReference = m_rtMeshes[i].blas.deviceAddress;
+        m_instanceMeshes[i] = m_rtMeshes[i].sceneMesh;
+    }
+    // Unknown until initGeometry() says which graph version the transforms
+    // came from, so the first frame refreshes them
+    m_instanceTransformVersion = 0;
 
-    VkDeviceSize instanceBufferSize = sizeof(InstanceData);
-    createBuffer(instanceBufferSize,
+    // Every slice starts out complete; updates only rewrite the transforms
+    VkDeviceSize instanceSliceSize = sizeof(InstanceData) * instances.size();
+    createBuffer(instanceSliceSize * MAX_FRAMES_IN_FLIGHT,
                  VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
                  m_instancesBuffer,
@@ -1479,9 +3341,11 @@ void SimpleRenderer::createAccelerationStructures() {
                  VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT);
 
     void* mapped = nullptr;
-    vkMapMemory(m_device, m_instancesMemory, 0, instanceBufferSize, 0, &mapped);
-    std::memcpy(mapped, &instance, sizeof(InstanceData));
-    vkUnmapMemory(m_device, m_instancesMemory);
+    vkMapMemory(m_device, m_instancesMemory, 0, VK_WHOLE_SIZE, 0, &mapped);
+    m_instancesMapped = static_cast<uint8_t*>(mapped);
+    for (int frame = 0; frame < MAX_FRAMES_IN_FLIGHT; ++frame) {
+        std::memcpy(m_instancesMapped + frame * instanceSliceSize, instances.data(), static_cast<size_t>(instanceSliceSize));
+    }
 
     VkAccelerationStructureGeometryInstancesDataKHR instancesData{};
     instancesData.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
@@ -1496,11 +3360,11 @@ void SimpleRenderer::createAccelerationStructures() {
     VkAccelerationStructureBuildGeometryInfoKHR topBuildInfo{};
     topBuildInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
     topBuildInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
-    topBuildInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+    topBuildInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
     topBuildInfo.geometryCount = 1;
     topBuildInfo.pGeometries = &topGeometry;
 
-    uint32_t instanceCount = 1;
+    uint32_t instanceCount = static_cast<uint32_t>(meshCount);
     VkAccelerationStructureBuildSizesInfoKHR topSizeInfo{};
     topSizeInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
     m_vkGetAccelerationStructureBuildSizesKHR(m_device,
@@ -1526,19 +3390,20 @@ void SimpleRenderer::createAccelerationStructures() {
         throw std::runtime_error("Failed to create top-level acceleration structure");
     }
 
-    VkBuffer topScratchBuffer;
-    VkDeviceMemory topScratchMemory;
-    createBuffer(topSizeInfo.buildScratchSize,
+    // Sized for both the build and later updates, which reuse it
+    VkDeviceSize topScratchSize = std::max(topSizeInfo.buildScratchSize, topSizeInfo.updateScratchSize);
+    createBuffer(topScratchSize + scratchAlignment,
                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                 topScratchBuffer,
-                 topScratchMemory,
+                 m_topLevelScratchBuffer,
+                 m_topLevelScratchMemory,
                  VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT);
+    m_topLevelScratchAddress = alignUp(getBufferDeviceAddress(m_topLevelScratchBuffer), scratchAlignment);
 
     VkAccelerationStructureBuildGeometryInfoKHR topBuildGeomInfo = topBuildInfo;
     topBuildGeomInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
     topBuildGeomInfo.dstAccelerationStructure = m_topLevelAS.handle;
-    topBuildGeomInfo.scratchData.deviceAddress = getBufferDeviceAddress(topScratchBuffer);
+    topBuildGeomInfo.scratchData.deviceAddress = m_topLevelScratchAddress;
 
     VkAccelerationStructureBuildRangeInfoKHR topRangeInfo{};
     topRangeInfo.primitiveCount = instanceCount;
@@ -1548,113 +3413,596 @@ void SimpleRenderer::createAccelerationStructures() {
     m_vkCmdBuildAccelerationStructuresKHR(topCommandBuffer, 1, &topBuildGeomInfo, &pTopRangeInfo);
     endSingleTimeCommands(topCommandBuffer);
 
-    vkDestroyBuffer(m_device, topScratchBuffer, nullptr);
-    vkFreeMemory(m_device, topScratchMemory, nullptr);
-
     VkAccelerationStructureDeviceAddressInfoKHR topAddressInfo{};
     topAddressInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
     topAddressInfo.accelerationStructure = m_topLevelAS.handle;
     m_topLevelAS.deviceAddress = m_vkGetAccelerationStructureDeviceAddressKHR(m_device, &topAddressInfo);
 
-    std::cout << "[RT] Acceleration structures built, creating pipeline" << std::endl;
-
+    m_asStats.blasCount = static_cast<uint32_t>(meshCount);
+    m_asStats.blasFromCache = static_cast<uint32_t>(cachedMeshes.size());
+    m_asStats.setupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - setupStart).count();
+    std::cout << "[RT] Acceleration structures ready in " << m_asStats.setupMs << " ms ("
+              << (cachedMeshes.empty() ? "cold" : builtMeshes.empty() ? "warm" : "partially warm") << "): "
+              << m_asStats.blasFromCache << " of " << m_asStats.blasCount << " BLASes from cache";
+    if (m_asStats.blasIncompatible > 0) {
+        std::cout << ", " << m_asStats.blasIncompatible << " rejected as incompatible";
+    }
+    if (m_asStats.blasWritten > 0) {
+        std::cout << ", " << m_asStats.blasWritten << " written to cache";
+    }
+    std::cout << std::endl;
+
     createRayTracingPipeline();
 }
 
-void SimpleRenderer::createRayTracingStorageImage() {
-    cleanupRayTracingStorageImage();
+// Refits the TLAS when the sampled transforms changed since the last build
+// or update. World matrices go straight into this frame's instance slice;
+// the other slice may still be read by the previous frame's update. All
+// transforms are rewritten because the slice skipped the changes made while
+// the other one was current.
+void SimpleRenderer::updateTopLevelTransforms(VkCommandBuffer commandBuffer, const SceneTransforms& transforms) {
+    if (!m_instancesMapped || m_topLevelAS.handle == VK_NULL_HANDLE || transforms.meshWorlds.empty() ||
+        transforms.version == m_instanceTransformVersion) {
+        return;
+    }
+
+    uint32_t instanceCount = static_cast<uint32_t>(m_instanceMeshes.size());
+    VkDeviceSize sliceOffset = static_cast<VkDeviceSize>(m_currentFrame) * instanceCount * sizeof(InstanceData);
+    auto* slice = reinterpret_cast<InstanceData*>(m_instancesMapped + sliceOffset);
+    for (uint32_t i = 0; i < instanceCount; ++i) {
+        SceneGraph::writeTransform(transforms.meshWorlds[m_instanceMeshes[i]], slice[i].transform);
+    }
+    m_instanceTransformVersion = transforms.version;
+
+    VkAccelerationStructureGeometryKHR topGeometry{};
+    topGeometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
+    topGeometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
+    topGeometry.geometry.instances.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
+    topGeometry.geometry.instances.arrayOfPointers = VK_FALSE;
+    topGeometry.geometry.instances.data.deviceAddress = getBufferDeviceAddress(m_instancesBuffer) + sliceOffset;
+
+    VkAccelerationStructureBuildGeometryInfoKHR updateInfo{};
+    updateInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+    updateInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
+    updateInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
+    updateInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR;
+    updateInfo.srcAccelerationStructure = m_topLevelAS.handle;
+    updateInfo.dstAccelerationStructure = m_topLevelAS.handle;
+    updateInfo.geometryCount = 1;
+    updateInfo.pGeometries = &topGeometry;
+    updateInfo.scratchData.deviceAddress = m_topLevelScratchAddress;
+
+    VkAccelerationStructureBuildRangeInfoKHR rangeInfo{};
+    rangeInfo.primitiveCount = instanceCount;
+    const VkAccelerationStructureBuildRangeInfoKHR* pRangeInfo = &rangeInfo;
 
-    m_rtStorageFormat = VK_FORMAT_B8G8R8A8_UNORM;
-    VkImageCreateInfo imageInfo{};
-    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    imageInfo.imageType = VK_IMAGE_TYPE_2D;
-    imageInfo.extent = {m_swapChainExtent.width, m_swapChainExtent.height, 1};
-    imageInfo.mipLevels = 1;
-    imageInfo.arrayLayers = 1;
-    imageInfo.format = m_rtStorageFormat;
-    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
-    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    const VkPipelineStageFlags traceStages = VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    m_profiler->beginScope(commandBuffer, "tlas-update");
+    // The previous frame's traces read the TLAS in place, and its update
+    // used the same scratch memory
+    VkMemoryBarrier readBarrier{};
+    readBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    readBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+    readBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+    vkCmdPipelineBarrier(commandBuffer,
+                         traceStages | VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                         VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                         0, 1, &readBarrier, 0, nullptr, 0, nullptr);
+    m_vkCmdBuildAccelerationStructuresKHR(commandBuffer, 1, &updateInfo, &pRangeInfo);
+
+    VkMemoryBarrier buildBarrier{};
+    buildBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    buildBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+    buildBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                         traceStages,
+                         0, 1, &buildBarrier, 0, nullptr, 0, nullptr);
+    m_profiler->endScope(commandBuffer);
+}
 
-    if (vkCreateImage(m_device, &imageInfo, nullptr, &m_rtStorageImage) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create ray tracing storage image");
+// Writes freshly built BLASes to the cache. Their serialized sizes are only
+// known after the build, so they are queried first; then every BLAS is copied
+// into one readback buffer and the files are written on workers.
+void SimpleRenderer::serializeAccelerationStructures(const std::vector<uint32_t>& meshIndices) {
+    std::vector<uint32_t> cacheable;
+    std::vector<VkAccelerationStructureKHR> handles;
+    for (uint32_t i : meshIndices) {
+        if (m_rtMeshes[i].geometryHash != 0) {
+            cacheable.push_back(i);
+            handles.push_back(m_rtMeshes[i].blas.handle);
+        }
+    }
+    if (cacheable.empty()) {
+        return;
+    }
+    const uint32_t count = static_cast<uint32_t>(cacheable.size());
+
+    VkQueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_SERIALIZATION_SIZE_KHR;
+    queryPoolInfo.queryCount = count;
+    VkQueryPool queryPool;
+    if (vkCreateQueryPool(m_device, &queryPoolInfo, nullptr, &queryPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create acceleration structure serialization query pool");
     }
 
-    std::cout << "[RT][Debug] Storage image created: "
-              << imageInfo.extent.width << "x" << imageInfo.extent.height
-              << " format " << imageInfo.format << std::endl;
+    // The builds were in an earlier submit; make their writes visible to the
+    // query and the copies
+    VkMemoryBarrier buildBarrier{};
+    buildBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    buildBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+    buildBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
 
-    VkMemoryRequirements memRequirements;
-    vkGetImageMemoryRequirements(m_device, m_rtStorageImage, &memRequirements);
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                         VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                         0, 1, &buildBarrier, 0, nullptr, 0, nullptr);
+    vkCmdResetQueryPool(commandBuffer, queryPool, 0, count);
+    m_vkCmdWriteAccelerationStructuresPropertiesKHR(commandBuffer, count, handles.data(),
+                                                    VK_QUERY_TYPE_ACCELERATION_STRUCTURE_SERIALIZATION_SIZE_KHR, queryPool, 0);
+    endSingleTimeCommands(commandBuffer);
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    std::vector<uint64_t> serializedSizes(count);
+    VkResult queryResult = vkGetQueryPoolResults(m_device, queryPool, 0, count, sizeof(uint64_t) * count, serializedSizes.data(),
+                                                 sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+    vkDestroyQueryPool(m_device, queryPool, nullptr);
+    if (queryResult != VK_SUCCESS) {
+        std::cout << "[RT] Could not query BLAS serialization sizes, cache not written" << std::endl;
+        return;
+    }
+
+    auto alignUp = [](VkDeviceSize value, VkDeviceSize alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    };
+    std::vector<VkDeviceSize> offsets(count);
+    VkDeviceSize readbackSize = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        offsets[i] = readbackSize;
+        readbackSize += alignUp(serializedSizes[i], AS_SERIALIZATION_ALIGNMENT);
+    }
+
+    VkBuffer readbackBuffer;
+    VkDeviceMemory readbackMemory;
+    createBuffer(readbackSize + AS_SERIALIZATION_ALIGNMENT,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 readbackBuffer,
+                 readbackMemory,
+                 VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT);
+    VkDeviceAddress rawAddress = getBufferDeviceAddress(readbackBuffer);
+    VkDeviceAddress readbackAddress = alignUp(rawAddress, AS_SERIALIZATION_ALIGNMENT);
+
+    VkMemoryBarrier hostBarrier{};
+    hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+    commandBuffer = beginSingleTimeCommands();
+    for (uint32_t i = 0; i < count; ++i) {
+        VkCopyAccelerationStructureToMemoryInfoKHR copyInfo{};
+        copyInfo.sType = VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_TO_MEMORY_INFO_KHR;
+        copyInfo.src = handles[i];
+        copyInfo.dst.deviceAddress = readbackAddress + offsets[i];
+        copyInfo.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_SERIALIZE_KHR;
+        m_vkCmdCopyAccelerationStructureToMemoryKHR(commandBuffer, &copyInfo);
+    }
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                         VK_PIPELINE_STAGE_HOST_BIT,
+                         0, 1, &hostBarrier, 0, nullptr, 0, nullptr);
+    endSingleTimeCommands(commandBuffer);
 
-    if (vkAllocateMemory(m_device, &allocInfo, nullptr, &m_rtStorageMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate ray tracing storage memory");
+    void* mapped = nullptr;
+    vkMapMemory(m_device, readbackMemory, 0, VK_WHOLE_SIZE, 0, &mapped);
+    const uint8_t* base = static_cast<const uint8_t*>(mapped) + (readbackAddress - rawAddress);
+    std::atomic<uint32_t> written{0};
+    parallelFor(m_jobSystem, count, 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            if (m_asCache->store(m_rtMeshes[cacheable[i]].geometryHash, base + offsets[i], static_cast<size_t>(serializedSizes[i]))) {
+                written.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    });
+    vkUnmapMemory(m_device, readbackMemory);
+
+    vkDestroyBuffer(m_device, readbackBuffer, nullptr);
+    vkFreeMemory(m_device, readbackMemory, nullptr);
+    m_asStats.blasWritten = written.load();
+}
+
+void SimpleRenderer::createHdrTarget() {
+    cleanupHdrTarget();
+
+    m_renderExtent = {
+        std::max(1u, static_cast<uint32_t>(std::lround(m_swapChainExtent.width * m_renderScale))),
+        std::max(1u, static_cast<uint32_t>(std::lround(m_swapChainExtent.height * m_renderScale)))
+    };
+    float upscaleArea = static_cast<float>(m_swapChainExtent.width * m_swapChainExtent.height) /
+                        static_cast<float>(m_renderExtent.width * m_renderExtent.height);
+    m_jitterPhaseCount = std::min(MAX_JITTER_PHASES,
+                                  static_cast<uint32_t>(std::lround(BASE_JITTER_PHASES * upscaleArea)));
+
+    auto createTarget = [&](VkFormat format, VkImage& image, VkDeviceMemory& memory, VkImageView& view) {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent = {m_renderExtent.width, m_renderExtent.height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = format;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateImage(m_device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create HDR render target");
+        }
+
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(m_device, image, &memRequirements);
+
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        if (vkAllocateMemory(m_device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate HDR render target memory");
+        }
+
+        vkBindImageMemory(m_device, image, memory, 0);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = format;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+
+        if (vkCreateImageView(m_device, &viewInfo, nullptr, &view) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create HDR render target view");
+        }
+
+        // The targets live in GENERAL from here on; the raster render pass
+        // returns them to GENERAL as well.
+        transitionImageLayout(image,
+                              format,
+                              VK_IMAGE_LAYOUT_UNDEFINED,
+                              VK_IMAGE_LAYOUT_GENERAL,
+                              VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                              VK_PIPELINE_STAGE_TRANSFER_BIT,
+                              0,
+                              VK_ACCESS_TRANSFER_WRITE_BIT);
+
+        VkCommandBuffer cmd = beginSingleTimeCommands();
+        VkClearColorValue clearColor{0.0f, 0.0f, 0.0f, 1.0f};
+        VkImageSubresourceRange range{};
+        range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        range.baseMipLevel = 0;
+        range.levelCount = 1;
+        range.baseArrayLayer = 0;
+        range.layerCount = 1;
+        vkCmdClearColorImage(cmd, image, VK_IMAGE_LAYOUT_GENERAL, &clearColor, 1, &range);
+        endSingleTimeCommands(cmd);
+    };
+
+    createTarget(PostProcess::HDR_FORMAT, m_hdrImage, m_hdrImageMemory, m_hdrImageView);
+    createTarget(MOTION_FORMAT, m_motionImage, m_motionImageMemory, m_motionImageView);
+
+    std::cout << "[Renderer] HDR target created: " << m_renderExtent.width << "x" << m_renderExtent.height
+              << " format " << PostProcess::HDR_FORMAT;
+    if (m_temporalUpscale) {
+        std::cout << ", TAAU to " << m_swapChainExtent.width << "x" << m_swapChainExtent.height
+                  << " over " << m_jitterPhaseCount << " jitter phases";
     }
+    std::cout << std::endl;
+}
 
-    vkBindImageMemory(m_device, m_rtStorageImage, m_rtStorageMemory, 0);
+void SimpleRenderer::cleanupHdrTarget() {
+    auto destroyTarget = [&](VkImage& image, VkDeviceMemory& memory, VkImageView& view) {
+        if (view != VK_NULL_HANDLE) {
+            vkDestroyImageView(m_device, view, nullptr);
+            view = VK_NULL_HANDLE;
+        }
+        if (image != VK_NULL_HANDLE) {
+            vkDestroyImage(m_device, image, nullptr);
+            image = VK_NULL_HANDLE;
+        }
+        if (memory != VK_NULL_HANDLE) {
+            vkFreeMemory(m_device, memory, nullptr);
+            memory = VK_NULL_HANDLE;
+        }
+    };
+    destroyTarget(m_hdrImage, m_hdrImageMemory, m_hdrImageView);
+    destroyTarget(m_motionImage, m_motionImageMemory, m_motionImageView);
+}
 
-    VkImageViewCreateInfo viewInfo{};
-    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    viewInfo.image = m_rtStorageImage;
-    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    viewInfo.format = m_rtStorageFormat;
-    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    viewInfo.subresourceRange.baseMipLevel = 0;
-    viewInfo.subresourceRange.levelCount = 1;
-    viewInfo.subresourceRange.baseArrayLayer = 0;
-    viewInfo.subresourceRange.layerCount = 1;
+void SimpleRenderer::createDepthTarget() {
+    cleanupDepthTarget();
 
-    if (vkCreateImageView(m_device, &viewInfo, nullptr, &m_rtStorageImageView) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create ray tracing storage image view");
+    m_hizMipExtents.clear();
+    VkExtent2D mipExtent = m_renderExtent;
+    while (true) {
+        m_hizMipExtents.push_back(mipExtent);
+        if (mipExtent.width == 1 && mipExtent.height == 1) {
+            break;
+        }
+        mipExtent = {std::max(1u, mipExtent.width / 2), std::max(1u, mipExtent.height / 2)};
     }
+    uint32_t mipCount = static_cast<uint32_t>(m_hizMipExtents.size());
+
+    auto createImage = [&](VkFormat format, uint32_t mipLevels, VkImageUsageFlags usage, VkImage& image, VkDeviceMemory& memory) {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent = {m_renderExtent.width, m_renderExtent.height, 1};
+        imageInfo.mipLevels = mipLevels;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = format;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = usage;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        if (vkCreateImage(m_device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create depth target");
+        }
 
-    VkCommandBuffer cmd = beginSingleTimeCommands();
-    std::cout << "[RT][Debug] Transition storage image to GENERAL layout" << std::endl;
-    transitionImageLayout(m_rtStorageImage,
-                          m_rtStorageFormat,
-                          VK_IMAGE_LAYOUT_UNDEFINED,
-                          VK_IMAGE_LAYOUT_GENERAL,
-                          VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-                          VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,
-                          0,
-                          VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT);
-
-    VkClearColorValue clearColor{0.0f, 0.0f, 1.0f, 1.0f};
-    VkImageSubresourceRange range{};
-    range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    range.baseMipLevel = 0;
-    range.levelCount = 1;
-    range.baseArrayLayer = 0;
-    range.layerCount = 1;
-    vkCmdClearColorImage(cmd, m_rtStorageImage, VK_IMAGE_LAYOUT_GENERAL, &clearColor, 1, &range);
-    std::cout << "[RT][Debug] Cleared storage image to blue" << std::endl;
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(m_device, image, &memRequirements);
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        if (vkAllocateMemory(m_device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate depth target memory");
+        }
+        vkBindImageMemory(m_device, image, memory, 0);
+    };
+
+    auto createView = [&](VkImage image, VkFormat format, VkImageAspectFlags aspect, uint32_t baseMip, uint32_t mipLevels) {
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = format;
+        viewInfo.subresourceRange.aspectMask = aspect;
+        viewInfo.subresourceRange.baseMipLevel = baseMip;
+        viewInfo.subresourceRange.levelCount = mipLevels;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+        VkImageView view;
+        if (vkCreateImageView(m_device, &viewInfo, nullptr, &view) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create depth target view");
+        }
+        return view;
+    };
 
+    // The depth image starts every frame UNDEFINED in the clearing pass, so it needs no initial transition
+    createImage(DEPTH_FORMAT, 1, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, m_depthImage, m_depthImageMemory);
+    m_depthImageView = createView(m_depthImage, DEPTH_FORMAT, VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1);
+
+    createImage(HIZ_FORMAT, mipCount, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, m_hizImage, m_hizImageMemory);
+    m_hizImageView = createView(m_hizImage, HIZ_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT, 0, mipCount);
+    for (uint32_t mip = 0; mip < mipCount; ++mip) {
+        m_hizMipViews.push_back(createView(m_hizImage, HIZ_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT, mip, 1));
+    }
+
+    // The pyramid lives in GENERAL: written as storage, read through texelFetch
+    VkCommandBuffer cmd = beginSingleTimeCommands();
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = m_hizImage;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, mipCount, 0, 1};
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &barrier);
     endSingleTimeCommands(cmd);
+
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+    if (vkCreateSampler(m_device, &samplerInfo, nullptr, &m_hizSampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create Hi-Z sampler");
+    }
+
+    // 0 = source (depth or the previous mip), 1 = destination mip
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[1].descriptorCount = 1;
+    bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+    if (vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &m_hizSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create Hi-Z descriptor set layout");
+    }
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_hizSetLayout;
+    if (vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &m_hizPipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create Hi-Z pipeline layout");
+    }
+
+    VkShaderModule computeModule = ShaderManager::createShaderModule(m_device, ShaderManager::readFile("shaders/hiz_build.comp.spv"));
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = computeModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = m_hizPipelineLayout;
+    VkResult result = vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_hizPipeline);
+    vkDestroyShaderModule(m_device, computeModule, nullptr);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create Hi-Z pipeline");
+    }
+
+    std::array<VkDescriptorPoolSize, 2> poolSizes = {{
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, mipCount},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, mipCount}
+    }};
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = mipCount;
+    if (vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_hizDescriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create Hi-Z descriptor pool");
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(mipCount, m_hizSetLayout);
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_hizDescriptorPool;
+    allocInfo.descriptorSetCount = mipCount;
+    allocInfo.pSetLayouts = layouts.data();
+    m_hizDescriptorSets.resize(mipCount);
+    if (vkAllocateDescriptorSets(m_device, &allocInfo, m_hizDescriptorSets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate Hi-Z descriptor sets");
+    }
+
+    for (uint32_t mip = 0; mip < mipCount; ++mip) {
+        VkDescriptorImageInfo sourceInfo{};
+        sourceInfo.sampler = m_hizSampler;
+        sourceInfo.imageView = mip == 0 ? m_depthImageView : m_hizMipViews[mip - 1];
+        sourceInfo.imageLayout = mip == 0 ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+        VkDescriptorImageInfo destInfo{VK_NULL_HANDLE, m_hizMipViews[mip], VK_IMAGE_LAYOUT_GENERAL};
+
+        std::array<VkWriteDescriptorSet, 2> writes{};
+        for (uint32_t b = 0; b < writes.size(); ++b) {
+            writes[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[b].dstSet = m_hizDescriptorSets[mip];
+            writes[b].dstBinding = b;
+            writes[b].descriptorType = bindings[b].descriptorType;
+            writes[b].descriptorCount = 1;
+            writes[b].pImageInfo = b == 0 ? &sourceInfo : &destInfo;
+        }
+        vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+
+    std::cout << "[Renderer] Depth target created (reverse-Z), Hi-Z pyramid with " << mipCount << " mips" << std::endl;
 }
 
-void SimpleRenderer::cleanupRayTracingStorageImage() {
-    if (m_rtStorageImageView != VK_NULL_HANDLE) {
-        vkDestroyImageView(m_device, m_rtStorageImageView, nullptr);
-        m_rtStorageImageView = VK_NULL_HANDLE;
+void SimpleRenderer::cleanupDepthTarget() {
+    if (m_hizPipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(m_device, m_hizPipeline, nullptr);
+        m_hizPipeline = VK_NULL_HANDLE;
+    }
+    if (m_hizPipelineLayout != VK_NULL_HANDLE) {
+        vkDestroyPipelineLayout(m_device, m_hizPipelineLayout, nullptr);
+        m_hizPipelineLayout = VK_NULL_HANDLE;
+    }
+    if (m_hizDescriptorPool != VK_NULL_HANDLE) {
+        vkDestroyDescriptorPool(m_device, m_hizDescriptorPool, nullptr);
+        m_hizDescriptorPool = VK_NULL_HANDLE;
+        m_hizDescriptorSets.clear();
+    }
+    if (m_hizSetLayout != VK_NULL_HANDLE) {
+        vkDestroyDescriptorSetLayout(m_device, m_hizSetLayout, nullptr);
+        m_hizSetLayout = VK_NULL_HANDLE;
+    }
+    if (m_hizSampler != VK_NULL_HANDLE) {
+        vkDestroySampler(m_device, m_hizSampler, nullptr);
+        m_hizSampler = VK_NULL_HANDLE;
+    }
+    for (VkImageView view : m_hizMipViews) {
+        vkDestroyImageView(m_device, view, nullptr);
     }
-    if (m_rtStorageImage != VK_NULL_HANDLE) {
-        vkDestroyImage(m_device, m_rtStorageImage, nullptr);
-        m_rtStorageImage = VK_NULL_HANDLE;
+    m_hizMipViews.clear();
+
+    auto destroyImage = [&](VkImage& image, VkDeviceMemory& memory, VkImageView& view) {
+        if (view != VK_NULL_HANDLE) {
+            vkDestroyImageView(m_device, view, nullptr);
+            view = VK_NULL_HANDLE;
+        }
+        if (image != VK_NULL_HANDLE) {
+            vkDestroyImage(m_device, image, nullptr);
+            image = VK_NULL_HANDLE;
+        }
+        if (memory != VK_NULL_HANDLE) {
+            vkFreeMemory(m_device, memory, nullptr);
+            memory = VK_NULL_HANDLE;
+        }
+    };
+    destroyImage(m_hizImage, m_hizImageMemory, m_hizImageView);
+    destroyImage(m_depthImage, m_depthImageMemory, m_depthImageView);
+}
+
+// Reduces the depth just rendered into the Hi-Z pyramid, one dispatch per mip
+void SimpleRenderer::recordHizBuild(VkCommandBuffer commandBuffer) {
+    m_profiler->beginScope(commandBuffer, "hiz");
+
+    // The previous frame's late cull (compute or task shader) may still be reading the pyramid
+    VkPipelineStageFlags cullStages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    if (m_meshShaderSupported) {
+        cullStages |= VK_PIPELINE_STAGE_TASK_SHADER_BIT_EXT;
     }
-    if (m_rtStorageMemory != VK_NULL_HANDLE) {
-        vkFreeMemory(m_device, m_rtStorageMemory, nullptr);
-        m_rtStorageMemory = VK_NULL_HANDLE;
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, cullStages, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_hizPipeline);
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    for (size_t mip = 0; mip < m_hizMipExtents.size(); ++mip) {
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_hizPipelineLayout, 0, 1, &m_hizDescriptorSets[mip], 0, nullptr);
+        vkCmdDispatch(commandBuffer,
+                      (m_hizMipExtents[mip].width + HIZ_TILE_SIZE - 1) / HIZ_TILE_SIZE,
+                      (m_hizMipExtents[mip].height + HIZ_TILE_SIZE - 1) / HIZ_TILE_SIZE,
+                      1);
+        // The next mip and, after the last one, the late cull read what was just written
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0, 1, &barrier, 0, nullptr, 0, nullptr);
     }
+
+    m_profiler->endScope(commandBuffer);
 }
 
 void SimpleRenderer::cleanupAccelerationStructures() {
+    if (m_instancesMapped) {
+        vkUnmapMemory(m_device, m_instancesMemory);
+        m_instancesMapped = nullptr;
+    }
+    m_instanceMeshes.clear();
+    if (m_topLevelScratchBuffer != VK_NULL_HANDLE) {
+        vkDestroyBuffer(m_device, m_topLevelScratchBuffer, nullptr);
+        vkFreeMemory(m_device, m_topLevelScratchMemory, nullptr);
+        m_topLevelScratchBuffer = VK_NULL_HANDLE;
+        m_topLevelScratchMemory = VK_NULL_HANDLE;
+        m_topLevelScratchAddress = 0;
+    }
     if (m_instancesBuffer != VK_NULL_HANDLE) {
         vkDestroyBuffer(m_device, m_instancesBuffer, nullptr);
         m_instancesBuffer = VK_NULL_HANDLE;
@@ -1680,23 +4028,58 @@ void SimpleRenderer::cleanupAccelerationStructures() {
         as.deviceAddress = 0;
     };
 
-    destroyAS(m_bottomLevelAS);
+    for (RayTracedMesh& mesh : m_rtMeshes) {
+        destroyAS(mesh.blas);
+    }
     destroyAS(m_topLevelAS);
 }
 
+// Pipeline compilation takes far longer than everything else in device
+// setup, so it runs as a job and frames are drawn by the raster path until
+// beginFrame() finds it done and finishRayTracingPipeline() switches over
 void SimpleRenderer::createRayTracingPipeline() {
+    joinRayTracingCompile();
     cleanupRayTracingPipeline();
-    createRayTracingStorageImage();
 
-    std::cout << "[RT] Creating ray tracing pipeline" << std::endl;
+    // The compile job reads the materials, not m_rtMeshes
+    std::vector<MaterialRecord> materials;
+    materials.reserve(m_rtMeshes.size());
+    for (const RayTracedMesh& mesh : m_rtMeshes) {
+        materials.push_back(mesh.material);
+    }
+
+    std::cout << "[RT] Compiling ray tracing pipelines in the background, drawing raster until they are ready" << std::endl;
+    m_rtCompileStart = std::chrono::steady_clock::now();
+    m_rtCompileJobs = std::make_unique<JobCounter>();
+    m_rtCompilePending = true;
+    spawnBackgroundJob([this, materials = std::move(materials)]() { compileRayTracingPipeline(materials); }, *m_rtCompileJobs);
+}
+
+// Runs on a background thread. Fills the pipelines and the host copy of the shader
+// binding table; nothing the frame loop reads before
+// finishRayTracingPipeline().
+void SimpleRenderer::compileRayTracingPipeline(const std::vector<MaterialRecord>& materials) {
+    auto compileStart = std::chrono::steady_clock::now();
+
+    // Closest hit shader per MaterialType, in enum order
+    const std::array<const char*, MATERIAL_TYPE_COUNT> hitShaderFiles = {
+        "shaders/closest_hit.rchit.spv",
+        "shaders/closest_hit_metallic.rchit.spv",
+        "shaders/closest_hit_emissive.rchit.spv",
+        "shaders/closest_hit_glass.rchit.spv"
+    };
 
     std::vector<char> rayGenCode = ShaderManager::readFile("shaders/ray_gen.rgen.spv");
     std::vector<char> missCode = ShaderManager::readFile("shaders/miss.rmiss.spv");
-    std::vector<char> chitCode = ShaderManager::readFile("shaders/closest_hit.rchit.spv");
+    std::vector<char> shadowMissCode = ShaderManager::readFile("shaders/shadow.rmiss.spv");
 
     VkShaderModule rayGenModule = ShaderManager::createShaderModule(m_device, rayGenCode);
     VkShaderModule missModule = ShaderManager::createShaderModule(m_device, missCode);
-    VkShaderModule chitModule = ShaderManager::createShaderModule(m_device, chitCode);
+    VkShaderModule shadowMissModule = ShaderManager::createShaderModule(m_device, shadowMissCode);
+    std::vector<VkShaderModule> hitModules;
+    for (const char* file : hitShaderFiles) {
+        hitModules.push_back(ShaderManager::createShaderModule(m_device, ShaderManager::readFile(file)));
+    }
 
     VkPipelineShaderStageCreateInfo raygenStage{};
     raygenStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -1710,13 +4093,19 @@ void SimpleRenderer::createRayTracingPipeline() {
     missStage.module = missModule;
     missStage.pName = "main";
 
-    VkPipelineShaderStageCreateInfo chitStage{};
-    chitStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    chitStage.stage = VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR;
-    chitStage.module = chitModule;
-    chitStage.pName = "main";
-
-    std::array<VkPipelineShaderStageCreateInfo, 3> stages = {raygenStage, missStage, chitStage};
+    VkPipelineShaderStageCreateInfo shadowMissStage = missStage;
+    shadowMissStage.module = shadowMissModule;
+
+    std::vector<VkPipelineShaderStageCreateInfo> stages = {raygenStage, missStage, shadowMissStage};
+    const uint32_t firstHitStage = static_cast<uint32_t>(stages.size());
+    for (VkShaderModule module : hitModules) {
+        VkPipelineShaderStageCreateInfo chitStage{};
+        chitStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        chitStage.stage = VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR;
+        chitStage.module = module;
+        chitStage.pName = "main";
+        stages.push_back(chitStage);
+    }
 
     VkRayTracingShaderGroupCreateInfoKHR raygenGroup{};
     raygenGroup.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR;
@@ -1734,63 +4123,27 @@ void SimpleRenderer::createRayTracingPipeline() {
     missGroup.anyHitShader = VK_SHADER_UNUSED_KHR;
     missGroup.intersectionShader = VK_SHADER_UNUSED_KHR;
 
-    VkRayTracingShaderGroupCreateInfoKHR hitGroup{};
-    hitGroup.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR;
-    hitGroup.type = VK_RAY_TRACING_SHADER_GROUP_TYPE_TRIANGLES_HIT_GROUP_KHR;
-    hitGroup.generalShader = VK_SHADER_UNUSED_KHR;
-    hitGroup.closestHitShader = 2;
-    hitGroup.anyHitShader = VK_SHADER_UNUSED_KHR;
-    hitGroup.intersectionShader = VK_SHADER_UNUSED_KHR;
-
-    std::array<VkRayTracingShaderGroupCreateInfoKHR, 3> groups = {raygenGroup, missGroup, hitGroup};
-
-    std::array<VkDescriptorSetLayoutBinding, 6> bindings{};
-    bindings[0].binding = 0;
-    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-    bindings[0].descriptorCount = 1;
-    bindings[0].stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
-
-    bindings[1].binding = 1;
-    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
-    bindings[1].descriptorCount = 1;
-    bindings[1].stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
-
-    bindings[2].binding = 2;
-    bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    bindings[2].descriptorCount = 1;
-    bindings[2].stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR;
-
-    bindings[3].binding = 3;
-    bindings[3].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    bindings[3].descriptorCount = 1;
-    bindings[3].stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
-
-    bindings[4].binding = 4;
-    bindings[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    bindings[4].descriptorCount = 1;
-    bindings[4].stageFlags = VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR;
-
-    bindings[5].binding = 5;
-    bindings[5].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    bindings[5].descriptorCount = 1;
-    bindings[5].stageFlags = VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR;
-
-    VkDescriptorSetLayoutCreateInfo rtLayoutInfo{};
-    rtLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    rtLayoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
-    rtLayoutInfo.pBindings = bindings.data();
-
-    if (vkCreateDescriptorSetLayout(m_device, &rtLayoutInfo, nullptr, &m_rtDescriptorSetLayout) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create ray tracing descriptor set layout");
+    // Miss index 1, used by shadow rays in ray_gen.rgen
+    VkRayTracingShaderGroupCreateInfoKHR shadowMissGroup = missGroup;
+    shadowMissGroup.generalShader = 2;
+
+    std::vector<VkRayTracingShaderGroupCreateInfoKHR> groups = {raygenGroup, missGroup, shadowMissGroup};
+    const uint32_t missGroupCount = 2;
+    const uint32_t firstHitGroup = static_cast<uint32_t>(groups.size());
+    for (uint32_t i = 0; i < MATERIAL_TYPE_COUNT; ++i) {
+        VkRayTracingShaderGroupCreateInfoKHR hitGroup{};
+        hitGroup.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR;
+        hitGroup.type = VK_RAY_TRACING_SHADER_GROUP_TYPE_TRIANGLES_HIT_GROUP_KHR;
+        hitGroup.generalShader = VK_SHADER_UNUSED_KHR;
+        hitGroup.closestHitShader = firstHitStage + i;
+        hitGroup.anyHitShader = VK_SHADER_UNUSED_KHR;
+        hitGroup.intersectionShader = VK_SHADER_UNUSED_KHR;
+        groups.push_back(hitGroup);
     }
 
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 1;
-    pipelineLayoutInfo.pSetLayouts = &m_rtDescriptorSetLayout;
-
-    if (vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &m_rtPipelineLayout) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create ray tracing pipeline layout");
+    // Only needs the layout, so it compiles alongside the RT pipeline
+    if (m_rayQuerySupported) {
+        spawnBackgroundJob([this]() { createRayQueryPipeline(); }, *m_rtCompileJobs);
     }
 
     VkRayTracingPipelineCreateInfoKHR pipelineInfo{};
@@ -1802,11 +4155,28 @@ void SimpleRenderer::createRayTracingPipeline() {
     pipelineInfo.maxPipelineRayRecursionDepth = 1;
     pipelineInfo.layout = m_rtPipelineLayout;
 
-    if (m_vkCreateRayTracingPipelinesKHR(m_device, VK_NULL_HANDLE, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_rtPipeline) != VK_SUCCESS) {
+    // Deferred so the driver can spread the compile over several threads;
+    // the create info has to stay alive until the operation completes
+    VkDeferredOperationKHR deferredOperation = VK_NULL_HANDLE;
+    if (m_vkCreateDeferredOperationKHR(m_device, nullptr, &deferredOperation) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create deferred operation for the ray tracing pipeline");
+    }
+    uint32_t compileThreads = 1;
+    VkResult result = m_vkCreateRayTracingPipelinesKHR(m_device, deferredOperation, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_rtPipeline);
+    if (result == VK_OPERATION_DEFERRED_KHR) {
+        compileThreads = joinDeferredOperation(deferredOperation);
+        result = m_vkGetDeferredOperationResultKHR(m_device, deferredOperation);
+    } else if (result == VK_OPERATION_NOT_DEFERRED_KHR) {
+        result = VK_SUCCESS;
+    }
+    m_vkDestroyDeferredOperationKHR(m_device, deferredOperation, nullptr);
+    if (result != VK_SUCCESS) {
         throw std::runtime_error("failed to create ray tracing pipeline");
     }
 
-    std::cout << "[RT] Ray tracing pipeline created" << std::endl;
+    std::cout << "[RT] Ray tracing pipeline compiled in "
+              << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - compileStart).count()
+              << " ms on " << compileThreads << " threads" << std::endl;
 
     VkPhysicalDeviceProperties2 properties{};
     m_rtProperties = {};
@@ -1815,16 +4185,271 @@ void SimpleRenderer::createRayTracingPipeline() {
     properties.pNext = &m_rtProperties;
     vkGetPhysicalDeviceProperties2(m_physicalDevice, &properties);
 
+    // Regions must start on shaderGroupBaseAlignment; records within a region
+    // are spaced by the aligned handle size. Handles come back tightly packed.
+    auto alignUp = [](VkDeviceSize value, VkDeviceSize alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    };
     VkDeviceSize handleSize = m_rtProperties.shaderGroupHandleSize;
-    VkDeviceSize handleSizeAligned = (handleSize + m_rtProperties.shaderGroupHandleAlignment - 1) & ~(m_rtProperties.shaderGroupHandleAlignment - 1);
-    VkDeviceSize groupCount = static_cast<VkDeviceSize>(groups.size());
-    VkDeviceSize sbtSize = groupCount * handleSizeAligned;
+    VkDeviceSize handleSizeAligned = alignUp(handleSize, m_rtProperties.shaderGroupHandleAlignment);
+    VkDeviceSize baseAlignment = m_rtProperties.shaderGroupBaseAlignment;
+    uint32_t groupCount = static_cast<uint32_t>(groups.size());
 
-    std::vector<uint8_t> handles(sbtSize);
-    if (m_vkGetRayTracingShaderGroupHandlesKHR(m_device, m_rtPipeline, 0, static_cast<uint32_t>(groupCount), sbtSize, handles.data()) != VK_SUCCESS) {
+    std::vector<uint8_t> handles(groupCount * handleSize);
+    if (m_vkGetRayTracingShaderGroupHandlesKHR(m_device, m_rtPipeline, 0, groupCount, handles.size(), handles.data()) != VK_SUCCESS) {
         throw std::runtime_error("failed to get ray tracing shader group handles");
     }
 
+    // Hit records are a group handle followed by the mesh's MaterialRecord,
+    // one per mesh in TLAS instance order (instanceShaderBindingTableRecordOffset).
+    VkDeviceSize hitRecordStride = alignUp(handleSize + sizeof(MaterialRecord), m_rtProperties.shaderGroupHandleAlignment);
+    if (hitRecordStride > m_rtProperties.maxShaderGroupStride) {
+        throw std::runtime_error("hit record stride exceeds maxShaderGroupStride");
+    }
+    VkDeviceSize hitRecordCount = materials.size();
+
+    VkDeviceSize raygenOffset = 0;
+    VkDeviceSize missOffset = alignUp(raygenOffset + handleSizeAligned, baseAlignment);
+    VkDeviceSize hitOffset = alignUp(missOffset + missGroupCount * handleSizeAligned, baseAlignment);
+    VkDeviceSize sbtSize = hitOffset + hitRecordCount * hitRecordStride;
+
+    std::vector<uint8_t>& sbtData = m_rtShaderBindingTableData;
+    sbtData.assign(sbtSize, 0);
+    auto copyHandle = [&](uint32_t groupIndex, VkDeviceSize offset) {
+        std::memcpy(sbtData.data() + offset, handles.data() + groupIndex * handleSize, static_cast<size_t>(handleSize));
+    };
+    copyHandle(0, raygenOffset);
+    for (uint32_t i = 0; i < missGroupCount; ++i) {
+        copyHandle(1 + i, missOffset + i * handleSizeAligned);
+    }
+    for (size_t i = 0; i < materials.size(); ++i) {
+        VkDeviceSize recordOffset = hitOffset + i * hitRecordStride;
+        copyHandle(firstHitGroup + materials[i].materialType, recordOffset);
+        std::memcpy(sbtData.data() + recordOffset + handleSize, &materials[i], sizeof(MaterialRecord));
+    }
+
+    // Offsets into the table until finishRayTracingPipeline() uploads it
+    m_rtRaygenRegion = {raygenOffset, handleSizeAligned, handleSizeAligned};
+    m_rtMissRegion = {missOffset, handleSizeAligned, handleSizeAligned * missGroupCount};
+    m_rtHitRegion = {hitOffset, hitRecordStride, hitRecordCount * hitRecordStride};
+    m_rtCallableRegion = {0, 0, 0};
+
+    for (VkShaderModule module : hitModules) {
+        vkDestroyShaderModule(m_device, module, nullptr);
+    }
+    vkDestroyShaderModule(m_device, shadowMissModule, nullptr);
+    vkDestroyShaderModule(m_device, missModule, nullptr);
+    vkDestroyShaderModule(m_device, rayGenModule, nullptr);
+}
+
+// Spreads a deferred operation over up to its maximum concurrency of
+// background threads, this one included, and returns how many joined. The
+// helpers stay off the workers so a frame never joins the compile.
+uint32_t SimpleRenderer::joinDeferredOperation(VkDeferredOperationKHR operation) {
+    uint32_t threadCount = 1;
+    if (m_jobSystem) {
+        threadCount = std::clamp(m_vkGetDeferredOperationMaxConcurrencyKHR(m_device, operation), 1u,
+                                 m_jobSystem->getBackgroundThreadCount());
+    }
+
+    // THREAD_DONE: nothing left for this thread while others finish the
+    // operation; SUCCESS: the operation is complete
+    auto join = [this, operation]() {
+        VkResult result = m_vkDeferredOperationJoinKHR(m_device, operation);
+        while (result == VK_THREAD_IDLE_KHR) {
+            std::this_thread::yield();
+            result = m_vkDeferredOperationJoinKHR(m_device, operation);
+        }
+    };
+
+    JobCounter helpers;
+    for (uint32_t i = 1; i < threadCount; ++i) {
+        spawnBackgroundJob(join, helpers);
+    }
+    join();
+    waitJobs(helpers);
+    return threadCount;
+}
+
+// Waits for a pending compile; rethrows its failure
+void SimpleRenderer::joinRayTracingCompile() {
+    if (!m_rtCompilePending) {
+        return;
+    }
+    m_rtCompilePending = false;
+    waitJobs(*m_rtCompileJobs);
+}
+
+void SimpleRenderer::waitForRayTracing() {
+    if (m_rtCompilePending) {
+        joinRayTracingCompile();
+        finishRayTracingPipeline();
+    }
+}
+
+// Built when its backend is first selected, so the geometry is only resident
+// on the CPU for runs that trace there. The scene's copy is released after
+// the upload, so the tracer's own copy is read back from the GPU buffers;
+// the BVH build then runs on a background thread while the other backends
+// keep drawing. Its parallel binning still spreads over the workers.
+void SimpleRenderer::buildCpuTracer() {
+    waitForCpuTracer(); // A previous build still writes the old tracer
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<GLTFVertex> vertices(m_vertexCount);
+    std::vector<uint32_t> indices(m_indexCount);
+    readBackBuffer(m_vertexBuffer, vertices.data(), sizeof(GLTFVertex) * vertices.size());
+    readBackBuffer(m_indexBuffer, indices.data(), sizeof(uint32_t) * indices.size());
+    std::cout << "[CPU] Read back " << (vertices.size() * sizeof(GLTFVertex) + indices.size() * sizeof(uint32_t)) / (1024.0 * 1024.0)
+              << " MB of geometry in "
+              << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << std::endl;
+
+    // Placed like the raster paths' last frame; syncTransforms catches up
+    // with anything that moves while the BVH builds
+    std::vector<CpuTracerMesh> meshes;
+    meshes.reserve(m_rtMeshes.size());
+    for (const RayTracedMesh& mesh : m_rtMeshes) {
+        glm::mat4 world = mesh.sceneMesh < m_previousMeshWorlds.size() ? m_previousMeshWorlds[mesh.sceneMesh] : glm::mat4(1.0f);
+        meshes.push_back({mesh.indexCount, mesh.material, mesh.sceneMesh, world});
+    }
+
+    m_cpuTracer = std::make_unique<CpuTracer>();
+    m_cpuTracerJobs = std::make_unique<JobCounter>();
+    m_cpuTracerPending = true;
+    CpuTracer* tracer = m_cpuTracer.get();
+    JobSystem* jobs = m_jobSystem;
+    spawnBackgroundJob([tracer, jobs, vertices = std::move(vertices), indices = std::move(indices),
+                        meshes = std::move(meshes)]() mutable {
+        tracer->build(std::move(vertices), std::move(indices), std::move(meshes), jobs);
+    }, *m_cpuTracerJobs);
+}
+
+void SimpleRenderer::waitForCpuTracer() {
+    if (!m_cpuTracerPending) {
+        return;
+    }
+    m_cpuTracerPending = false;
+    waitJobs(*m_cpuTracerJobs);
+
+    const CpuBvhStats& stats = m_cpuTracer->getBvh().getStats();
+    std::cout << "[CPU] BVH ready: " << stats.triangleCount << " triangles, " << stats.nodeCount << " nodes, depth "
+              << stats.depth << ", SAH cost " << stats.sahCost << ", built in " << stats.buildMs << " ms";
+    if (m_backend == RenderBackend::CpuReference) {
+        std::cout << ", switching from raster to " << getBackendName(m_backend);
+        m_postProcess->resetHistory();
+    }
+    std::cout << std::endl;
+}
+
+// Traces the frame on the job system with the camera as of now rather than
+// the late-latched one: the image is finished before endFrame runs. The
+// result is packed to half floats and copied into the HDR and motion images,
+// which the post chain then reads as if a GPU backend had written them.
+void SimpleRenderer::recordCpuTrace(VkCommandBuffer commandBuffer, Camera* camera) {
+    UniformBufferObject cameraConstants = makeCameraConstants(camera);
+    LightingUBO lighting = makeLightingConstants(m_clusterParams.time);
+
+    CpuTraceFrame frame;
+    frame.viewInverse = cameraConstants.viewInverse;
+    frame.projInverse = cameraConstants.projInverse;
+    frame.viewProjection = cameraConstants.viewProjection;
+    frame.prevViewProjection = cameraConstants.prevViewProjection;
+    frame.cameraPos = cameraConstants.cameraPos;
+    for (uint32_t i = 0; i < KEY_LIGHT_COUNT; ++i) {
+        frame.lightPositions[i] = lighting.lightPositions[i];
+        frame.lightColors[i] = lighting.lightColors[i];
+    }
+    frame.lightCount = lighting.lightCount;
+    frame.ambientLight = lighting.ambientLight;
+    frame.shadows = m_shadowsEnabled;
+    frame.maxShadowLights = MAX_SHADOW_LIGHTS;
+    frame.time = m_clusterParams.time;
+
+    const uint32_t width = m_renderExtent.width;
+    const uint32_t height = m_renderExtent.height;
+    m_cpuTracer->render(frame, width, height, m_jobSystem);
+
+    const VkDeviceSize pixelCount = static_cast<VkDeviceSize>(width) * height;
+    const VkDeviceSize colorSize = pixelCount * 4 * sizeof(uint16_t);
+    const VkDeviceSize motionSize = pixelCount * 2 * sizeof(uint16_t);
+    if (m_cpuUploadSize != colorSize + motionSize) {
+        createCpuUploadBuffers(colorSize + motionSize);
+    }
+
+    uint8_t* mapped = m_cpuUploadMapped[m_currentFrame];
+    const std::vector<glm::vec4>& color = m_cpuTracer->getColor();
+    const std::vector<glm::vec2>& motion = m_cpuTracer->getMotion();
+    parallelFor(m_jobSystem, height, CpuTracer::TILE_SIZE, [&](uint32_t begin, uint32_t end) {
+        for (size_t pixel = static_cast<size_t>(begin) * width; pixel < static_cast<size_t>(end) * width; ++pixel) {
+            uint32_t packedColor[2] = {glm::packHalf2x16(glm::vec2(color[pixel].r, color[pixel].g)),
+                                       glm::packHalf2x16(glm::vec2(color[pixel].b, color[pixel].a))};
+            uint32_t packedMotion = glm::packHalf2x16(motion[pixel]);
+            std::memcpy(mapped + pixel * sizeof(packedColor), packedColor, sizeof(packedColor));
+            std::memcpy(mapped + colorSize + pixel * sizeof(packedMotion), &packedMotion, sizeof(packedMotion));
+        }
+    });
+
+    // The previous frame's post chain may still be reading the targets
+    for (VkImage target : {m_hdrImage, m_motionImage}) {
+        cmdTransitionImageLayout(commandBuffer, target, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 0, VK_ACCESS_TRANSFER_WRITE_BIT);
+    }
+
+    m_profiler->beginScope(commandBuffer, "cpu-upload");
+    VkBufferImageCopy region{};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = {width, height, 1};
+    vkCmdCopyBufferToImage(commandBuffer, m_cpuUploadBuffers[m_currentFrame], m_hdrImage, VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+    region.bufferOffset = colorSize;
+    vkCmdCopyBufferToImage(commandBuffer, m_cpuUploadBuffers[m_currentFrame], m_motionImage, VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+    m_profiler->endScope(commandBuffer);
+
+    for (VkImage target : {m_hdrImage, m_motionImage}) {
+        cmdTransitionImageLayout(commandBuffer, target, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+    }
+}
+
+// Sized for the render extent; a resize waits for the GPU before replacing them
+void SimpleRenderer::createCpuUploadBuffers(VkDeviceSize size) {
+    if (!m_cpuUploadBuffers.empty()) {
+        vkDeviceWaitIdle(m_device);
+        cleanupCpuUploadBuffers();
+    }
+
+    m_cpuUploadBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    m_cpuUploadMemory.resize(MAX_FRAMES_IN_FLIGHT);
+    m_cpuUploadMapped.resize(MAX_FRAMES_IN_FLIGHT);
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     m_cpuUploadBuffers[i], m_cpuUploadMemory[i]);
+        void* mapped = nullptr;
+        vkMapMemory(m_device, m_cpuUploadMemory[i], 0, size, 0, &mapped);
+        m_cpuUploadMapped[i] = static_cast<uint8_t*>(mapped);
+    }
+    m_cpuUploadSize = size;
+}
+
+void SimpleRenderer::cleanupCpuUploadBuffers() {
+    for (size_t i = 0; i < m_cpuUploadBuffers.size(); ++i) {
+        vkUnmapMemory(m_device, m_cpuUploadMemory[i]);
+        vkDestroyBuffer(m_device, m_cpuUploadBuffers[i], nullptr);
+        vkFreeMemory(m_device, m_cpuUploadMemory[i], nullptr);
+    }
+    m_cpuUploadBuffers.clear();
+    m_cpuUploadMemory.clear();
+    m_cpuUploadMapped.clear();
+    m_cpuUploadSize = 0;
+}
+
+// Main thread, between frames: uploads the shader binding table, which
+// needs the graphics queue, and publishes the pipelines to render()
+void SimpleRenderer::finishRayTracingPipeline() {
+    VkDeviceSize sbtSize = m_rtShaderBindingTableData.size();
     createBuffer(sbtSize,
                  VK_BUFFER_USAGE_SHADER_BINDING_TABLE_BIT_KHR | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
@@ -1842,148 +4467,224 @@ void SimpleRenderer::createRayTracingPipeline() {
 
     void* data;
     vkMapMemory(m_device, stagingMemory, 0, sbtSize, 0, &data);
-    std::memcpy(data, handles.data(), static_cast<size_t>(sbtSize));
+    std::memcpy(data, m_rtShaderBindingTableData.data(), static_cast<size_t>(sbtSize));
     vkUnmapMemory(m_device, stagingMemory);
 
     copyBuffer(stagingBuffer, m_rtShaderBindingTable, sbtSize);
     vkDestroyBuffer(m_device, stagingBuffer, nullptr);
     vkFreeMemory(m_device, stagingMemory, nullptr);
+    m_rtShaderBindingTableData.clear();
 
     VkDeviceAddress sbtAddress = getBufferDeviceAddress(m_rtShaderBindingTable);
-    m_rtRaygenRegion = {sbtAddress, handleSizeAligned, handleSizeAligned};
-    m_rtMissRegion = {sbtAddress + handleSizeAligned, handleSizeAligned, handleSizeAligned};
-    m_rtHitRegion = {sbtAddress + handleSizeAligned * 2, handleSizeAligned, handleSizeAligned};
-    m_rtCallableRegion = {0, 0, 0};
+    m_rtRaygenRegion.deviceAddress += sbtAddress;
+    m_rtMissRegion.deviceAddress += sbtAddress;
+    m_rtHitRegion.deviceAddress += sbtAddress;
 
     std::cout << "[RT] Shader binding table setup completed" << std::endl;
 
-    vkDestroyShaderModule(m_device, chitModule, nullptr);
-    vkDestroyShaderModule(m_device, missModule, nullptr);
-    vkDestroyShaderModule(m_device, rayGenModule, nullptr);
-
-    createRayTracingDescriptorSets();
+    updateRayTracingDescriptorSets();
     m_rtReady = true;
+
+    std::cout << "[RT] Ray tracing ready "
+              << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_rtCompileStart).count()
+              << " ms after its compile started";
+    if (m_backend == RenderBackend::RayTracingPipeline || m_backend == RenderBackend::RayQueryCompute) {
+        std::cout << ", switching from raster to " << getBackendName(m_backend);
+        // The raster frames shaded differently, their history would smear in
+        m_postProcess->resetHistory();
+    }
+    std::cout << std::endl;
 }
 
-void SimpleRenderer::createRayTracingDescriptorSets() {
-    std::cout << "[RT] Creating descriptor sets" << std::endl;
+void SimpleRenderer::createRayQueryPipeline() {
+    std::cout << "[RT] Creating ray query compute pipeline" << std::endl;
+
+    std::vector<char> computeCode = ShaderManager::readFile("shaders/ray_query.comp.spv");
+    VkShaderModule computeModule = ShaderManager::createShaderModule(m_device, computeCode);
+
+    VkPipelineShaderStageCreateInfo computeStage{};
+    computeStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    computeStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    computeStage.module = computeModule;
+    computeStage.pName = "main";
+
+    // Shares the descriptor set layout (and thus the descriptor sets) with the
+    // ray tracing pipeline; pipeline layouts are not tied to a bind point.
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage = computeStage;
+    pipelineInfo.layout = m_rtPipelineLayout;
+
+    if (vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_rayQueryPipeline) != VK_SUCCESS) {
+        vkDestroyShaderModule(m_device, computeModule, nullptr);
+        throw std::runtime_error("failed to create ray query compute pipeline");
+    }
+
+    vkDestroyShaderModule(m_device, computeModule, nullptr);
+    std::cout << "[RT] Ray query compute pipeline created" << std::endl;
+}
 
-    if (m_rtDescriptorPool != VK_NULL_HANDLE) {
-        vkDestroyDescriptorPool(m_device, m_rtDescriptorPool, nullptr);
-        m_rtDescriptorPool = VK_NULL_HANDLE;
+// Created once: the pipeline layout never changes, so recompiling the
+// pipelines or rebuilding the acceleration structures only rewrites
+// descriptors. Set 0 holds the targets and the frame constants (offset per
+// frame at bind), set 1 is the global bindless scene set.
+void SimpleRenderer::createRayTracingLayouts() {
+    const VkShaderStageFlags traceStages = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT;
+    std::array<VkDescriptorSetLayoutBinding, 5> frameBindings = {{
+        {0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, traceStages, nullptr},              // HDR radiance
+        {1, VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 1, traceStages, nullptr}, // TLAS
+        {2, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, traceStages | VK_SHADER_STAGE_MISS_BIT_KHR, nullptr}, // Camera
+        {3, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, traceStages, nullptr},     // Lighting
+        {4, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, traceStages, nullptr}               // Motion, for the TAAU resolve
+    }};
+
+    VkDescriptorSetLayoutCreateInfo frameLayoutInfo{};
+    frameLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    frameLayoutInfo.bindingCount = static_cast<uint32_t>(frameBindings.size());
+    frameLayoutInfo.pBindings = frameBindings.data();
+    if (vkCreateDescriptorSetLayout(m_device, &frameLayoutInfo, nullptr, &m_rtDescriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create ray tracing descriptor set layout");
     }
 
-    VkDescriptorPoolSize poolSizes[4] = {
-        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, MAX_FRAMES_IN_FLIGHT},
-        {VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, MAX_FRAMES_IN_FLIGHT},
-        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, MAX_FRAMES_IN_FLIGHT * 2}, // Camera + Lighting
-        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_FRAMES_IN_FLIGHT * 2}  // Vertex + Index
+    // Geometry is fetched through the buffer addresses in the geometry
+    // table, so the set only holds the per-instance tables and the texture
+    // array. Every binding may be partially bound and written while in use.
+    const VkShaderStageFlags fetchStages = VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT;
+    std::array<VkDescriptorSetLayoutBinding, 3> sceneBindings = {{
+        {0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, fetchStages, nullptr},                    // Geometry table
+        {1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},    // Materials for ray queries
+        {2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_BINDLESS_TEXTURES, fetchStages, nullptr} // Material textures
+    }};
+    const VkDescriptorBindingFlags bindlessFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;
+    std::array<VkDescriptorBindingFlags, 3> sceneBindingFlags = {
+        bindlessFlags, bindlessFlags,
+        bindlessFlags | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT
     };
 
-    VkDescriptorPoolCreateInfo poolInfo{};
-    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolInfo.poolSizeCount = 4;
-    poolInfo.pPoolSizes = poolSizes;
-    poolInfo.maxSets = MAX_FRAMES_IN_FLIGHT;
+    VkDescriptorSetLayoutBindingFlagsCreateInfo sceneFlagsInfo{};
+    sceneFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    sceneFlagsInfo.bindingCount = static_cast<uint32_t>(sceneBindingFlags.size());
+    sceneFlagsInfo.pBindingFlags = sceneBindingFlags.data();
+
+    VkDescriptorSetLayoutCreateInfo sceneLayoutInfo{};
+    sceneLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    sceneLayoutInfo.pNext = &sceneFlagsInfo;
+    sceneLayoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    sceneLayoutInfo.bindingCount = static_cast<uint32_t>(sceneBindings.size());
+    sceneLayoutInfo.pBindings = sceneBindings.data();
+    if (vkCreateDescriptorSetLayout(m_device, &sceneLayoutInfo, nullptr, &m_bindlessSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create bindless scene descriptor set layout");
+    }
 
-    if (vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_rtDescriptorPool) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create ray tracing descriptor pool");
+    std::array<VkDescriptorSetLayout, 2> setLayouts = {m_rtDescriptorSetLayout, m_bindlessSetLayout};
+    VkPushConstantRange pushConstantRange{traceStages, 0, sizeof(TracePushConstants)};
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &m_rtPipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create ray tracing pipeline layout");
     }
 
-    std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, m_rtDescriptorSetLayout);
-    VkDescriptorSetAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = m_rtDescriptorPool;
-    allocInfo.descriptorSetCount = static_cast<uint32_t>(layouts.size());
-    allocInfo.pSetLayouts = layouts.data();
+    std::array<VkDescriptorPoolSize, 3> framePoolSizes = {{
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2}, // HDR + motion
+        {VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 1},
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 2} // Camera + Lighting
+    }};
+    VkDescriptorPoolCreateInfo framePoolInfo{};
+    framePoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    framePoolInfo.poolSizeCount = static_cast<uint32_t>(framePoolSizes.size());
+    framePoolInfo.pPoolSizes = framePoolSizes.data();
+    framePoolInfo.maxSets = 1;
+    if (vkCreateDescriptorPool(m_device, &framePoolInfo, nullptr, &m_rtDescriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create ray tracing descriptor pool");
+    }
 
-    m_rtDescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
-    if (vkAllocateDescriptorSets(m_device, &allocInfo, m_rtDescriptorSets.data()) != VK_SUCCESS) {
+    VkDescriptorSetAllocateInfo frameAllocInfo{};
+    frameAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    frameAllocInfo.descriptorPool = m_rtDescriptorPool;
+    frameAllocInfo.descriptorSetCount = 1;
+    frameAllocInfo.pSetLayouts = &m_rtDescriptorSetLayout;
+    if (vkAllocateDescriptorSets(m_device, &frameAllocInfo, &m_rtDescriptorSet) != VK_SUCCESS) {
         throw std::runtime_error("failed to allocate ray tracing descriptor sets");
     }
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-        VkDescriptorImageInfo imageInfo{};
-        imageInfo.imageView = m_rtStorageImageView;
-        imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-
-        VkWriteDescriptorSet imageWrite{};
-        imageWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        imageWrite.dstSet = m_rtDescriptorSets[i];
-        imageWrite.dstBinding = 0;
-        imageWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-        imageWrite.descriptorCount = 1;
-        imageWrite.pImageInfo = &imageInfo;
-
-        VkWriteDescriptorSetAccelerationStructureKHR asInfo{};
-        asInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR;
-        asInfo.accelerationStructureCount = 1;
-        asInfo.pAccelerationStructures = &m_topLevelAS.handle;
-
-        VkWriteDescriptorSet asWrite{};
-        asWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        asWrite.dstSet = m_rtDescriptorSets[i];
-        asWrite.dstBinding = 1;
-        asWrite.descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
-        asWrite.descriptorCount = 1;
-        asWrite.pNext = &asInfo;
-
-        VkDescriptorBufferInfo uboInfo{};
-        uboInfo.buffer = m_uniformBuffers[i];
-        uboInfo.range = sizeof(UniformBufferObject);
-
-    VkDescriptorBufferInfo uboInfoPerFrame{};
-    uboInfoPerFrame.buffer = m_uniformBuffers[i];
-    uboInfoPerFrame.range = sizeof(UniformBufferObject);
-
-    VkWriteDescriptorSet uboWrite{};
-    uboWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    uboWrite.dstSet = m_rtDescriptorSets[i];
-    uboWrite.dstBinding = 2;
-    uboWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    uboWrite.descriptorCount = 1;
-    uboWrite.pBufferInfo = &uboInfoPerFrame;
-
-    VkDescriptorBufferInfo lightingInfo{};
-    lightingInfo.buffer = m_lightingBuffers[i];
-    lightingInfo.range = sizeof(LightingUBO);
-
-    VkWriteDescriptorSet lightingWrite{};
-    lightingWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    lightingWrite.dstSet = m_rtDescriptorSets[i];
-    lightingWrite.dstBinding = 3;
-    lightingWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    lightingWrite.descriptorCount = 1;
-    lightingWrite.pBufferInfo = &lightingInfo;
-
-        VkDescriptorBufferInfo vertexInfo{};
-        vertexInfo.buffer = m_vertexBuffer;
-        vertexInfo.range = VK_WHOLE_SIZE;
-
-        VkWriteDescriptorSet vertexWrite{};
-        vertexWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        vertexWrite.dstSet = m_rtDescriptorSets[i];
-        vertexWrite.dstBinding = 4;
-        vertexWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        vertexWrite.descriptorCount = 1;
-        vertexWrite.pBufferInfo = &vertexInfo;
-
-        VkDescriptorBufferInfo indexInfo{};
-        indexInfo.buffer = m_indexBuffer;
-        indexInfo.range = VK_WHOLE_SIZE;
-
-        VkWriteDescriptorSet indexWrite{};
-        indexWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        indexWrite.dstSet = m_rtDescriptorSets[i];
-        indexWrite.dstBinding = 5;
-        indexWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        indexWrite.descriptorCount = 1;
-        indexWrite.pBufferInfo = &indexInfo;
-
-    std::array<VkWriteDescriptorSet, 6> writes = {imageWrite, asWrite, uboWrite, lightingWrite, vertexWrite, indexWrite};
-    vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    std::array<VkDescriptorPoolSize, 2> scenePoolSizes = {{
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_BINDLESS_TEXTURES}
+    }};
+    VkDescriptorPoolCreateInfo scenePoolInfo{};
+    scenePoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    scenePoolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    scenePoolInfo.poolSizeCount = static_cast<uint32_t>(scenePoolSizes.size());
+    scenePoolInfo.pPoolSizes = scenePoolSizes.data();
+    scenePoolInfo.maxSets = 1;
+    if (vkCreateDescriptorPool(m_device, &scenePoolInfo, nullptr, &m_bindlessPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create bindless scene descriptor pool");
     }
 
+    uint32_t textureCount = MAX_BINDLESS_TEXTURES;
+    VkDescriptorSetVariableDescriptorCountAllocateInfo variableCountInfo{};
+    variableCountInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
+    variableCountInfo.descriptorSetCount = 1;
+    variableCountInfo.pDescriptorCounts = &textureCount;
+
+    VkDescriptorSetAllocateInfo sceneAllocInfo{};
+    sceneAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    sceneAllocInfo.pNext = &variableCountInfo;
+    sceneAllocInfo.descriptorPool = m_bindlessPool;
+    sceneAllocInfo.descriptorSetCount = 1;
+    sceneAllocInfo.pSetLayouts = &m_bindlessSetLayout;
+    if (vkAllocateDescriptorSets(m_device, &sceneAllocInfo, &m_bindlessSet) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate bindless scene descriptor set");
+    }
+
+    std::cout << "[RT] Bindless scene set with " << MAX_BINDLESS_TEXTURES << " texture slots" << std::endl;
+}
+
+void SimpleRenderer::cleanupRayTracingLayouts() {
+    vkDestroyDescriptorPool(m_device, m_bindlessPool, nullptr);
+    vkDestroyDescriptorPool(m_device, m_rtDescriptorPool, nullptr);
+    vkDestroyPipelineLayout(m_device, m_rtPipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, m_bindlessSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, m_rtDescriptorSetLayout, nullptr);
+}
+
+// The frame set only changes when the TLAS is rebuilt; scene geometry lives
+// in the bindless set and is never rewritten here
+void SimpleRenderer::updateRayTracingDescriptorSets() {
+    VkDescriptorImageInfo imageInfo{VK_NULL_HANDLE, m_hdrImageView, VK_IMAGE_LAYOUT_GENERAL};
+    VkDescriptorImageInfo motionInfo{VK_NULL_HANDLE, m_motionImageView, VK_IMAGE_LAYOUT_GENERAL};
+    VkDescriptorBufferInfo cameraInfo = frameConstantsInfo(m_cameraConstantsOffset, sizeof(UniformBufferObject));
+    VkDescriptorBufferInfo lightingInfo = frameConstantsInfo(m_lightingConstantsOffset, sizeof(LightingUBO));
+
+    VkWriteDescriptorSetAccelerationStructureKHR asInfo{};
+    asInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR;
+    asInfo.accelerationStructureCount = 1;
+    asInfo.pAccelerationStructures = &m_topLevelAS.handle;
+
+    std::array<VkWriteDescriptorSet, 5> writes{};
+    for (uint32_t b = 0; b < writes.size(); ++b) {
+        writes[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[b].dstSet = m_rtDescriptorSet;
+        writes[b].dstBinding = b;
+        writes[b].descriptorCount = 1;
+    }
+    writes[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    writes[0].pImageInfo = &imageInfo;
+    writes[1].descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+    writes[1].pNext = &asInfo;
+    writes[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    writes[2].pBufferInfo = &cameraInfo;
+    writes[3].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    writes[3].pBufferInfo = &lightingInfo;
+    writes[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    writes[4].pImageInfo = &motionInfo;
+    vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
     std::cout << "[RT] Descriptor sets ready" << std::endl;
 }
 
@@ -2002,21 +4703,13 @@ void SimpleRenderer::cleanupRayTracingPipeline() {
     m_rtHitRegion = {};
     m_rtCallableRegion = {};
 
-    if (m_rtDescriptorPool != VK_NULL_HANDLE) {
-        vkDestroyDescriptorPool(m_device, m_rtDescriptorPool, nullptr);
-        m_rtDescriptorPool = VK_NULL_HANDLE;
-    }
     if (m_rtPipeline != VK_NULL_HANDLE) {
         vkDestroyPipeline(m_device, m_rtPipeline, nullptr);
         m_rtPipeline = VK_NULL_HANDLE;
     }
-    if (m_rtPipelineLayout != VK_NULL_HANDLE) {
-        vkDestroyPipelineLayout(m_device, m_rtPipelineLayout, nullptr);
-        m_rtPipelineLayout = VK_NULL_HANDLE;
-    }
-    if (m_rtDescriptorSetLayout != VK_NULL_HANDLE) {
-        vkDestroyDescriptorSetLayout(m_device, m_rtDescriptorSetLayout, nullptr);
-        m_rtDescriptorSetLayout = VK_NULL_HANDLE;
+    if (m_rayQueryPipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(m_device, m_rayQueryPipeline, nullptr);
+        m_rayQueryPipeline = VK_NULL_HANDLE;
     }
 }
 
@@ -2030,9 +4723,11 @@ void SimpleRenderer::transitionImageLayout(VkImage image,
                                            VkAccessFlags dstAccess) {
     VkCommandBuffer cmd = beginSingleTimeCommands();
 
-    std::cout << "[RT][Debug] transitionImageLayout image=0x" << std::hex << reinterpret_cast<uint64_t>(image)
-              << std::dec << " " << layoutToString(oldLayout) << " -> " << layoutToString(newLayout)
-              << " srcStage=" << srcStage << " dstStage=" << dstStage << std::endl;
+    if (isDebugRtLogEnabled()) {
+        std::cout << "[RT][Debug] transitionImageLayout image=0x" << std::hex << reinterpret_cast<uint64_t>(image)
+                  << std::dec << " " << layoutToString(oldLayout) << " -> " << layoutToString(newLayout)
+                  << " srcStage=" << srcStage << " dstStage=" << dstStage << std::endl;
+    }
 
     VkImageMemoryBarrier barrier{};
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -2059,3 +4754,35 @@ void SimpleRenderer::transitionImageLayout(VkImage image,
 
     endSingleTimeCommands(cmd);
 }
+
+void SimpleRenderer::cmdTransitionImageLayout(VkCommandBuffer commandBuffer,
+                                              VkImage image,
+                                              VkImageLayout oldLayout,
+                                              VkImageLayout newLayout,
+                                              VkPipelineStageFlags srcStage,
+                                              VkPipelineStageFlags dstStage,
+                                              VkAccessFlags srcAccess,
+                                              VkAccessFlags dstAccess) {
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+
+    vkCmdPipelineBarrier(commandBuffer,
+                         srcStage,
+                         dstStage,
+                         0,
+                         0, nullptr,
+                         0, nullptr,
+                         1, &barrier);
+}
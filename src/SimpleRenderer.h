@@ -1,34 +1,111 @@
 #pragma once
 
+#include <chrono>
+#include <cstddef>
 #include <memory>
+#include <string>
 #include <vector>
 #include <cstdint>
+#include <functional>
 #include <vulkan/vulkan.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_inverse.hpp>
 #include "GLTFLoader.h"
+#include "Material.h"
+#include "Meshlet.h"
+#include "PostProcess.h"
 
 class Camera;
 class Scene;
+struct SceneTransforms;
+class GpuProfiler;
+class AccelerationStructureCache;
+class CpuTracer;
+class JobSystem;
+class JobCounter;
 
+// Mirrors the CameraUBO blocks in the shaders (std140). Written once per frame
+// right before submit; animation time travels in push constants instead.
 struct UniformBufferObject {
     glm::mat4 model;
     glm::mat4 view;
     glm::mat4 proj;
     glm::mat4 viewInverse;
     glm::mat4 projInverse;
+    glm::mat4 viewProjection;     // Unjittered, for motion vectors
+    glm::mat4 prevViewProjection; // Unjittered, previous frame
     glm::vec3 cameraPos;
-    float time;
 };
 
+static_assert(offsetof(UniformBufferObject, cameraPos) == 448, "UniformBufferObject must match the std140 CameraUBO");
+static_assert(sizeof(UniformBufferObject) == 464, "UniformBufferObject must match the std140 CameraUBO");
+
+// Mirrors LightingUBO in shaders/shading.glsl (std140). Arrays are vec4 so the
+// C++ and std140 strides agree.
 struct LightingUBO {
-    glm::vec3 lightPositions[4];
-    glm::vec3 lightColors[4];
-    float lightIntensities[4];
+    glm::vec4 lightPositions[4]; // xyz used
+    glm::vec4 lightColors[4];    // rgb color, a intensity
     int lightCount;
-    glm::vec3 ambientLight;
     float exposure;
+    glm::vec3 ambientLight;
+};
+
+static_assert(offsetof(LightingUBO, lightCount) == 128, "LightingUBO must match the std140 layout in shading.glsl");
+static_assert(offsetof(LightingUBO, exposure) == 132, "LightingUBO must match the std140 layout in shading.glsl");
+static_assert(offsetof(LightingUBO, ambientLight) == 144, "LightingUBO must match the std140 layout in shading.glsl");
+
+// Point light shaded by the raster path through the cluster grid. Mirrors
+// PointLight in shaders/cluster_lights.comp and frag.glsl (std430).
+struct PointLight {
+    glm::vec4 positionRadius; // World position, range where the falloff reaches zero
+    glm::vec4 colorIntensity;
+};
+
+static_assert(sizeof(PointLight) == 32, "PointLight must match the std430 layout in the cluster shaders");
+
+// Mirrors ClusterPushConstants in shaders/cluster_lights.comp and frag.glsl
+struct ClusterPushConstants {
+    uint32_t gridX;
+    uint32_t gridY;
+    uint32_t gridZ;
+    uint32_t lightCount;
+    float screenWidth;  // Render resolution
+    float screenHeight;
+    float zNear;        // Depth slices are spaced exponentially between these
+    float zFar;
+    float time;         // Seconds, drives emissive glow
+};
+
+static_assert(sizeof(ClusterPushConstants) == 36, "meshlet.task places its push constants at offset 36");
+
+// Mirrors TracePushConstants in shaders/shading.glsl
+struct TracePushConstants {
+    uint32_t flags;
+    uint32_t maxShadowLights;
+    float time; // Seconds, drives the sky
+};
+
+enum class PresentModePolicy {
+    Fifo,      // V-synced, never tears, highest latency
+    Mailbox,   // V-synced, newest frame wins, falls back to FIFO
+    Immediate  // No v-sync, tears; used for uncapped benchmarking
+};
+
+enum class RenderBackend {
+    RayTracingPipeline, // VK_KHR_ray_tracing_pipeline with an SBT
+    RayQueryCompute,    // Inline GL_EXT_ray_query in a compute shader
+    Raster,             // Forward rasterization fallback
+    CpuReference        // CpuTracer on the job system, uploaded into the HDR target
+};
+
+// How the raster backend feeds geometry. The meshlet paths cull per meshlet
+// instead of per mesh, either in a task shader or, without VK_EXT_mesh_shader,
+// in compute writing a compacted index buffer.
+enum class MeshletPath {
+    Off,        // Per-mesh culling and indexed indirect draws
+    MeshShader, // meshlet.task / meshlet.mesh
+    Compute     // meshlet_cull.comp and vkCmdDrawIndexedIndirect
 };
 
 struct AccelerationStructure {
@@ -38,17 +115,151 @@ struct AccelerationStructure {
     VkDeviceAddress deviceAddress = 0;
 };
 
+// Per-mesh raster draw with mesh-space bounds, placed by its mesh transform
+// and culled on the GPU. Mirrors DrawRecord in shaders/draw_cull.comp (std430).
+struct DrawRecord {
+    glm::vec4 boundsMin; // xyz used
+    glm::vec4 boundsMax; // xyz used
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t meshIndex;  // Scene mesh, selects its MeshTransform
+    uint32_t padding;
+};
+
+static_assert(sizeof(DrawRecord) == 48, "DrawRecord must match the std430 layout in draw_cull.comp");
+
+// Scene graph placement of a mesh in the raster paths: this frame's world
+// matrix and the previous frame's, for motion vectors. Mirrors MeshTransform
+// in shaders/mesh_transform.glsl (std430).
+struct MeshTransform {
+    glm::mat4 model;
+    glm::mat4 previousModel;
+};
+
+// Mirrors CullPushConstants in shaders/draw_cull.comp
+struct DrawCullPushConstants {
+    uint32_t recordCount;
+    uint32_t phase; // CULL_PHASE_EARLY or CULL_PHASE_LATE
+};
+
+// Mirrors MeshletPushConstants in shaders/meshlet.task and meshlet_cull.comp
+struct MeshletPushConstants {
+    uint32_t meshletCount;
+    uint32_t phase; // CULL_PHASE_EARLY or CULL_PHASE_LATE
+};
+
+// Where a mesh's triangles live, as buffer device addresses. Mirrors
+// MeshGeometry in shaders/vertex_fetch.glsl (std430); one per TLAS instance,
+// looked up with gl_InstanceCustomIndexEXT.
+struct MeshGeometryRecord {
+    VkDeviceAddress vertices; // GLTFVertex records
+    VkDeviceAddress indices;  // The mesh's first uint32 index
+    uint32_t vertexStride;    // Bytes
+    uint32_t padding;
+};
+
+static_assert(sizeof(MeshGeometryRecord) == 24, "MeshGeometryRecord must match the std430 layout in vertex_fetch.glsl");
+
+// A scene mesh as seen by the ray tracer: its own BLAS, one TLAS instance
+// (custom index and SBT record offset = mesh index) and one SBT hit record.
+struct RayTracedMesh {
+    uint32_t indexCount = 0;
+    MaterialRecord material{}; // material.firstIndex locates the mesh in the index buffer
+    MeshGeometryRecord geometry{};
+    uint64_t geometryHash = 0; // AccelerationStructureCache key, 0 when not cached
+    uint32_t sceneMesh = 0; // Index into Scene::getMeshes(), whose graph node places the instance
+    VkTransformMatrixKHR transform{}; // TLAS instance transform at build time
+    AccelerationStructure blas;
+};
+
+// How the last acceleration structure setup went: cold builds every BLAS,
+// warm deserializes all of them from the cache
+struct AccelerationStructureStats {
+    double setupMs = 0.0; // BLASes and TLAS, including cache reads and writes
+    uint32_t blasCount = 0;
+    uint32_t blasFromCache = 0;
+    uint32_t blasIncompatible = 0; // Cached but rejected by the driver, rebuilt
+    uint32_t blasWritten = 0;
+};
+
 class SimpleRenderer {
 public:
-    SimpleRenderer(GLFWwindow* window);
+    // With temporalUpscale the scene is traced at renderScale of the window
+    // with a jittered camera and the post chain's TAAU pass reconstructs the
+    // full resolution; without it renderScale is ignored.
+    SimpleRenderer(GLFWwindow* window,
+                   PresentModePolicy presentModePolicy = PresentModePolicy::Mailbox,
+                   bool temporalUpscale = true,
+                   float renderScale = DEFAULT_RENDER_SCALE,
+                   JobSystem* jobSystem = nullptr);
     ~SimpleRenderer();
 
     void beginFrame();
-    void render(Camera* camera, Scene* scene);
-    void endFrame();
+    // Must be called from the thread that created the job system (worker 0).
+    // sceneTime drives the lighting and emissive animation; transforms place
+    // the TLAS instances. Both come from the same simulation sample.
+    void render(Camera* camera, float sceneTime, const SceneTransforms& transforms);
+    // Writes the camera matrices from camera right before the submit (late
+    // latch): the GPU reads them at execution, not at record time, so input
+    // sampled after render() still reaches this frame
+    void endFrame(Camera* camera);
+    // Serialized BLASes are read from and written to directory; empty
+    // disables the cache. Takes effect for the next initGeometry.
+    void setAccelerationStructureCacheDirectory(const std::string& directory);
     void initGeometry(Scene* scene);
+    const AccelerationStructureStats& getAccelerationStructureStats() const { return m_asStats; }
     
     VkDevice getDevice() const { return m_device; }
+    VkPresentModeKHR getPresentMode() const { return m_presentMode; }
+
+    void setBackend(RenderBackend backend);
+    RenderBackend getBackend() const { return m_backend; }
+    // The RT backends count as available while their pipelines compile in
+    // the background; frames are drawn by the raster path until then
+    bool isBackendAvailable(RenderBackend backend) const;
+    // Blocks until a background RT pipeline compile is done and switches to it
+    void waitForRayTracing();
+    // Blocks until the background CPU BVH build is done
+    void waitForCpuTracer();
+    // Null before initGeometry; its stats describe the last CPU frame
+    const CpuTracer* getCpuTracer() const { return m_cpuTracer.get(); }
+    static const char* getBackendName(RenderBackend backend);
+
+    // Ray traced shadows for the RT pipeline and ray query backends
+    void setShadowsEnabled(bool enabled);
+    bool areShadowsEnabled() const { return m_shadowsEnabled; }
+
+    // Bloom in the HDR post chain; tone mapping and grading always run
+    void setBloomEnabled(bool enabled);
+    bool isBloomEnabled() const { return m_postSettings.bloomEnabled; }
+
+    // Raster backend: lay down depth for all visible meshes first, then shade
+    // with an EQUAL depth test so every pixel is shaded once
+    void setDepthPrepassEnabled(bool enabled);
+    bool isDepthPrepassEnabled() const { return m_depthPrepass; }
+
+    // Raster backend: cull and draw meshlets instead of whole meshes.
+    // MeshShader falls back to Compute on devices without mesh shaders.
+    void setMeshletPath(MeshletPath path);
+    MeshletPath getMeshletPath() const { return m_meshletPath; }
+    bool isMeshShaderSupported() const { return m_meshShaderSupported; }
+    static const char* getMeshletPathName(MeshletPath path);
+
+    GpuProfiler* getProfiler() const { return m_profiler.get(); }
+    // Smoothed CPU time render() spends recording command buffers
+    double getRecordCpuMs() const { return m_recordCpuMs; }
+
+    // Waits for each frame after presenting it, so no frames queue up behind
+    // the one being shown, and measures the latched input's latency
+    void setLatencyMode(bool enabled);
+    bool isLatencyMode() const { return m_latencyMode; }
+    // Smoothed time from the camera latch until the frame's GPU work is done
+    // and its present is queued, latency mode only
+    double getInputToPresentMs() const { return m_inputToPresentMs; }
+    VkExtent2D getRenderExtent() const { return m_renderExtent; }
+
+    static constexpr float DEFAULT_RENDER_SCALE = 2.0f / 3.0f; // 720p trace for a 1080p window
+    static constexpr float MIN_RENDER_SCALE = 0.25f;
 
 private:
     void initVulkan();
@@ -59,42 +270,101 @@ private:
     void createSwapChain();
     void createImageViews();
     void createRenderPass();
+    VkRenderPass createSceneRenderPass(bool withColor, VkAttachmentLoadOp colorLoadOp, VkAttachmentLoadOp depthLoadOp, bool depthReadOnly);
     void createFramebuffers();
+    void createHdrTarget();
+    void cleanupHdrTarget();
+    void createDepthTarget();
+    void cleanupDepthTarget();
+    void recordHizBuild(VkCommandBuffer commandBuffer);
+    // One scene render pass instance. drawEarly / drawLate select which
+    // culling phase's indirect draws are issued; with neither, the whole
+    // index buffer is drawn. The contents are a secondary command buffer.
+    struct RasterPass {
+        VkRenderPass renderPass;
+        VkFramebuffer framebuffer;
+        VkPipeline pipeline;
+        bool withColor;
+        bool drawEarly;
+        bool drawLate;
+        VkCommandBuffer contents;
+    };
+    void recordRasterPassContents(RasterPass& pass);
+    void recordRasterPass(VkCommandBuffer commandBuffer, const RasterPass& pass);
     void createCommandPool();
-    void createCommandBuffers();
+    void createFrameCommandPools();
+    void cleanupFrameCommandPools();
+    void resetFrameCommandPools(uint32_t frame);
+    VkCommandBuffer acquireCommandBuffer(VkCommandBufferLevel level);
+    VkCommandBuffer beginPrimaryCommandBuffer();
+    void spawnJob(std::function<void()> record, JobCounter& counter);
+    void spawnBackgroundJob(std::function<void()> job, JobCounter& counter);
+    void waitJobs(JobCounter& counter);
     void createSyncObjects();
     void createVertexBuffer(const std::vector<GLTFVertex>& vertices);
     void createIndexBuffer(const std::vector<uint32_t>& indices);
     void createVertexBufferFromData(const std::vector<GLTFVertex>& vertices);
     void createIndexBufferFromData(const std::vector<uint32_t>& indices);
+    void createMeshInfoBuffer();
+    void createMeshIndexBuffer(const std::vector<uint32_t>& vertexMeshes);
+    void createMeshTransforms(const SceneTransforms& transforms);
+    void updateMeshTransforms(const SceneTransforms& transforms);
+    uint32_t getMeshTransformOffset() const;
+    void createDrawCullResources(const std::vector<DrawRecord>& drawRecords);
+    void cleanupDrawCullResources();
+    void recordDrawCull(VkCommandBuffer commandBuffer, uint32_t phase);
+    void createMeshletResources(const MeshletData& meshletData);
+    void cleanupMeshletResources();
+    void recordMeshletCull(VkCommandBuffer commandBuffer, uint32_t phase);
+    // The selected meshlet path, or Off while there are no meshlets to draw
+    MeshletPath activeMeshletPath() const { return m_meshletCount > 0 ? m_meshletPath : MeshletPath::Off; }
+    void createClusterResources();
+    void recordLightClustering(VkCommandBuffer commandBuffer);
     void createGraphicsPipeline();
     void createDescriptorSetLayout();
-    void createUniformBuffers();
-    void createLightingBuffers();
+    void createFrameConstants();
+    void writeFrameConstants(uint32_t frame, VkDeviceSize offset, const void* data, size_t size);
+    VkDescriptorBufferInfo frameConstantsInfo(VkDeviceSize offset, VkDeviceSize range) const;
+    uint32_t getFrameConstantsOffset() const;
     void createDescriptorPool();
     void createDescriptorSets();
+    UniformBufferObject makeCameraConstants(Camera* camera) const;
+    LightingUBO makeLightingConstants(float time) const;
     void updateUniformBuffer(uint32_t currentImage, Camera* camera);
-    void updateLightingBuffer(uint32_t currentImage);
+    void updateLightingBuffer(uint32_t currentImage, float time);
     
     bool isDeviceSuitable(VkPhysicalDevice device);
     bool checkDeviceExtensionSupport(VkPhysicalDevice device);
     bool findQueueFamilies(VkPhysicalDevice device, uint32_t& graphicsFamily, uint32_t& presentFamily);
     void loadRayTracingFunctions();
     void createAccelerationStructures();
+    void serializeAccelerationStructures(const std::vector<uint32_t>& meshIndices);
     void cleanupAccelerationStructures();
+    void updateTopLevelTransforms(VkCommandBuffer commandBuffer, const SceneTransforms& transforms);
     void createRayTracingPipeline();
-    void createRayTracingDescriptorSets();
-    void createRayTracingStorageImage();
+    void compileRayTracingPipeline(const std::vector<MaterialRecord>& materials);
+    uint32_t joinDeferredOperation(VkDeferredOperationKHR operation);
+    void joinRayTracingCompile();
+    void finishRayTracingPipeline();
+    void createRayQueryPipeline();
+    void createRayTracingLayouts();
+    void cleanupRayTracingLayouts();
+    void updateRayTracingDescriptorSets();
     void cleanupRayTracingPipeline();
-    void cleanupRayTracingStorageImage();
+    void buildCpuTracer();
+    void recordCpuTrace(VkCommandBuffer commandBuffer, Camera* camera);
+    void createCpuUploadBuffers(VkDeviceSize size);
+    void cleanupCpuUploadBuffers();
     
     void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory, VkMemoryAllocateFlags allocateFlags = 0);
     void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+    void readBackBuffer(VkBuffer source, void* destination, VkDeviceSize size);
     VkCommandBuffer beginSingleTimeCommands();
     void endSingleTimeCommands(VkCommandBuffer commandBuffer);
     uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
     VkDeviceAddress getBufferDeviceAddress(VkBuffer buffer) const;
     void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage, VkAccessFlags srcAccess, VkAccessFlags dstAccess);
+    void cmdTransitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage, VkAccessFlags srcAccess, VkAccessFlags dstAccess);
     
     VkInstance m_instance;
     VkSurfaceKHR m_surface;
@@ -107,13 +377,74 @@ private:
     std::vector<VkImage> m_swapChainImages;
     VkFormat m_swapChainImageFormat;
     VkExtent2D m_swapChainExtent;
+    PresentModePolicy m_presentModePolicy;
+    VkPresentModeKHR m_presentMode;
     std::vector<VkImageView> m_swapChainImageViews;
+    bool m_swapChainStorage; // Swapchain images can be written by the post chain directly
     
-    VkRenderPass m_renderPass;
-    std::vector<VkFramebuffer> m_swapChainFramebuffers;
+    // Linear radiance and screen-space motion written by every backend (ray
+    // traced or raster) at the render resolution and consumed by the post chain
+    VkImage m_hdrImage;
+    VkDeviceMemory m_hdrImageMemory;
+    VkImageView m_hdrImageView;
+    VkImage m_motionImage;
+    VkDeviceMemory m_motionImageMemory;
+    VkImageView m_motionImageView;
+    VkExtent2D m_renderExtent;
+    float m_renderScale;
+    bool m_temporalUpscale;
+
+    // Reverse-Z raster depth and its hierarchical-Z pyramid (mip 0 matches the
+    // render extent, each further mip halves it down to 1x1)
+    VkImage m_depthImage;
+    VkDeviceMemory m_depthImageMemory;
+    VkImageView m_depthImageView;
+    VkImage m_hizImage;
+    VkDeviceMemory m_hizImageMemory;
+    VkImageView m_hizImageView;               // All mips, sampled by the cull pass
+    std::vector<VkImageView> m_hizMipViews;   // One per mip, written by the build pass
+    std::vector<VkExtent2D> m_hizMipExtents;
+    VkSampler m_hizSampler;
+    VkDescriptorSetLayout m_hizSetLayout;
+    VkPipelineLayout m_hizPipelineLayout;
+    VkPipeline m_hizPipeline;
+    VkDescriptorPool m_hizDescriptorPool;
+    std::vector<VkDescriptorSet> m_hizDescriptorSets; // One per mip
+
+    // TAAU camera jitter and the previous frame's unjittered view-projection
+    glm::vec2 m_jitter;
+    uint32_t m_jitterPhaseCount;
+    glm::mat4 m_prevViewProjection;
+    bool m_hasPrevViewProjection;
     
-    VkCommandPool m_commandPool;
-    std::vector<VkCommandBuffer> m_commandBuffers;
+    // All scene render passes share one framebuffer layout (HDR, motion,
+    // depth) or the depth-only one and differ in load ops and depth layouts
+    VkRenderPass m_renderPass;        // Clears everything; the early phase without a prepass
+    VkRenderPass m_loadRenderPass;    // Loads everything; the late phase without a prepass
+    VkRenderPass m_shadeRenderPass;   // Clears color, tests against the prepass depth read-only
+    VkRenderPass m_depthRenderPass;   // Depth only, clears; early prepass
+    VkRenderPass m_depthLoadRenderPass; // Depth only, loads; late prepass
+    VkFramebuffer m_hdrFramebuffer;
+    VkFramebuffer m_depthFramebuffer;
+    bool m_depthPrepass;
+    
+    VkCommandPool m_commandPool; // One-time setup commands
+
+    // Per-frame command pools, one per job system worker so every thread
+    // records into buffers from its own pool. A frame's pools are reset in
+    // bulk once its fence has signalled and their buffers reused.
+    struct CommandRecordContext {
+        VkCommandPool pool = VK_NULL_HANDLE;
+        std::vector<VkCommandBuffer> primaries;
+        std::vector<VkCommandBuffer> secondaries;
+        uint32_t usedPrimaries = 0;
+        uint32_t usedSecondaries = 0;
+    };
+    std::vector<std::vector<CommandRecordContext>> m_recordContexts; // [frame][worker]
+    std::vector<std::vector<VkCommandBuffer>> m_submitCommandBuffers; // [frame], scene then post chain
+    double m_recordCpuMs;
+    bool m_latencyMode = false;
+    double m_inputToPresentMs = 0.0;
     
     VkBuffer m_vertexBuffer;
     VkDeviceMemory m_vertexBufferMemory;
@@ -121,21 +452,104 @@ private:
     VkDeviceMemory m_indexBufferMemory;
     uint32_t m_vertexCount;
     uint32_t m_indexCount;
+    // The raster paths draw the merged mesh-space vertices; the scene mesh of
+    // every vertex (vertex input binding 1) selects its MeshTransform
+    VkBuffer m_meshIndexBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory m_meshIndexMemory = VK_NULL_HANDLE;
+    // One slice of MeshTransforms per frame in flight, persistently mapped
+    // like the TLAS instances and bound with a dynamic offset
+    VkBuffer m_meshTransformBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory m_meshTransformMemory = VK_NULL_HANDLE;
+    uint8_t* m_meshTransformsMapped = nullptr;
+    VkDeviceSize m_meshTransformStride = 0; // Slice size
+    std::vector<glm::mat4> m_previousMeshWorlds; // Written last frame, the next previousModel
+    uint64_t m_previousMeshTransformVersion = 0;
+    std::vector<uint64_t> m_settledMeshTransformVersions; // Per slice, version written with no motion (0 when moving)
     
     VkPipelineLayout m_pipelineLayout;
-    VkPipeline m_graphicsPipeline;
+    VkPipeline m_graphicsPipeline;      // Depth test and write
+    VkPipeline m_depthPrepassPipeline;  // Vertex only, into the depth-only passes
+    VkPipeline m_depthEqualPipeline;    // Shades exactly the prepass depth, no writes
+
+    // GPU-driven raster: draw records are frustum and occlusion culled in
+    // compute and the survivors compacted into indirect buffers drawn with an
+    // indirect count, one buffer per culling phase
+    static constexpr uint32_t CULL_PHASE_EARLY = 0; // Meshes visible last frame, before the Hi-Z build
+    static constexpr uint32_t CULL_PHASE_LATE = 1;  // Everything else, against this frame's Hi-Z
+    static constexpr uint32_t CULL_PHASE_COUNT = 2;
+    VkBuffer m_drawRecordBuffer;
+    VkDeviceMemory m_drawRecordMemory;
+    VkBuffer m_indirectDrawBuffers[CULL_PHASE_COUNT];
+    VkDeviceMemory m_indirectDrawMemory[CULL_PHASE_COUNT];
+    VkBuffer m_drawCountBuffers[CULL_PHASE_COUNT];
+    VkDeviceMemory m_drawCountMemory[CULL_PHASE_COUNT];
+    VkBuffer m_drawVisibilityBuffer; // Per record, visible at the end of the last frame
+    VkDeviceMemory m_drawVisibilityMemory;
+    uint32_t m_drawRecordCount;
+    VkDescriptorSetLayout m_cullSetLayout;
+    VkPipelineLayout m_cullPipelineLayout;
+    VkPipeline m_cullPipeline;
+    VkDescriptorPool m_cullDescriptorPool;
+    std::vector<VkDescriptorSet> m_cullDescriptorSets; // Per phase; the camera UBO is offset per frame
+
+    // Meshlet raster path: the same two culling phases per meshlet, with
+    // set 0 the raster set and set 1 the meshlet set of the phase
+    MeshletPath m_meshletPath;
+    bool m_meshShaderSupported;
+    uint32_t m_meshletCount;
+    uint32_t m_meshletIndexCount; // Capacity of each compacted index buffer
+    VkBuffer m_meshletBuffer;
+    VkDeviceMemory m_meshletMemory;
+    VkBuffer m_meshletVertexBuffer;
+    VkDeviceMemory m_meshletVertexMemory;
+    VkBuffer m_meshletTriangleBuffer;
+    VkDeviceMemory m_meshletTriangleMemory;
+    VkBuffer m_meshletVisibilityBuffer; // Per meshlet, visible at the end of the last frame
+    VkDeviceMemory m_meshletVisibilityMemory;
+    VkBuffer m_meshletIndexBuffers[CULL_PHASE_COUNT]; // Compute path output
+    VkDeviceMemory m_meshletIndexMemory[CULL_PHASE_COUNT];
+    VkBuffer m_meshletDrawBuffers[CULL_PHASE_COUNT];  // One VkDrawIndexedIndirectCommand each
+    VkDeviceMemory m_meshletDrawMemory[CULL_PHASE_COUNT];
+    VkDescriptorSetLayout m_meshletSetLayout;
+    VkDescriptorPool m_meshletDescriptorPool;
+    VkDescriptorSet m_meshletDescriptorSets[CULL_PHASE_COUNT];
+    VkPipelineLayout m_meshletCullPipelineLayout;
+    VkPipeline m_meshletCullPipeline;
+    VkPipelineLayout m_meshPipelineLayout;
+    VkPipeline m_meshPipeline; // Task + mesh + frag.glsl, only with mesh shader support
     
     VkDescriptorSetLayout m_descriptorSetLayout;
     VkDescriptorPool m_descriptorPool;
-    std::vector<VkDescriptorSet> m_descriptorSets;
-    
-    std::vector<VkBuffer> m_uniformBuffers;
-    std::vector<VkDeviceMemory> m_uniformBuffersMemory;
-    std::vector<void*> m_uniformBuffersMapped;
+    VkDescriptorSet m_descriptorSet = VK_NULL_HANDLE;
     
-    std::vector<VkBuffer> m_lightingBuffers;
-    std::vector<VkDeviceMemory> m_lightingBuffersMemory;
-    std::vector<void*> m_lightingBuffersMapped;
+    // Per-frame constants share one persistently mapped, host-coherent ring
+    // with a slice per frame in flight: camera UBO, lighting UBO and the
+    // point light list, each at an offset aligned for both buffer types.
+    // A CPU shadow copy of the ring lets writes skip bytes that are unchanged.
+    VkBuffer m_frameConstantsBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory m_frameConstantsMemory = VK_NULL_HANDLE;
+    uint8_t* m_frameConstantsMapped = nullptr;
+    std::vector<uint8_t> m_frameConstantsShadow;
+    VkDeviceSize m_cameraConstantsOffset = 0;   // Within a slice
+    VkDeviceSize m_lightingConstantsOffset = 0;
+    VkDeviceSize m_pointLightsOffset = 0;
+    VkDeviceSize m_frameConstantsStride = 0;    // Slice size
+
+    // Clustered raster lighting: the key lights plus one point light per
+    // emissive mesh, binned into a screen tile x depth slice grid each frame.
+    // The raster descriptor set (UBO, lights, cluster counts, cluster light
+    // indices, mesh transforms) is shared by the binning pass and the raster
+    // shaders.
+    std::vector<PointLight> m_sceneLights; // From emissive meshes, moved with them
+    std::vector<uint32_t> m_sceneLightMeshes; // Scene mesh of every scene light
+    std::vector<glm::vec4> m_sceneLightBounds; // Mesh-space center and radius of every scene light
+    VkBuffer m_clusterCountBuffer;
+    VkDeviceMemory m_clusterCountMemory;
+    VkBuffer m_clusterLightBuffer;
+    VkDeviceMemory m_clusterLightMemory;
+    VkPipelineLayout m_clusterPipelineLayout;
+    VkPipeline m_clusterPipeline;
+    ClusterPushConstants m_clusterParams;
     
     std::vector<VkSemaphore> m_imageAvailableSemaphores;
     std::vector<VkSemaphore> m_renderFinishedSemaphores;
@@ -145,24 +559,42 @@ private:
     uint32_t m_imageIndex;
     
     GLFWwindow* m_window;
+    JobSystem* m_jobSystem; // Optional, splits geometry preprocessing across workers
     
     uint32_t m_graphicsQueueFamilyIndex;
     uint32_t m_presentQueueFamilyIndex;
     
-    AccelerationStructure m_bottomLevelAS;
+    std::vector<RayTracedMesh> m_rtMeshes;
+    VkBuffer m_meshInfoBuffer;
+    VkDeviceMemory m_meshInfoBufferMemory;
+    VkBuffer m_meshGeometryBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory m_meshGeometryBufferMemory = VK_NULL_HANDLE;
     AccelerationStructure m_topLevelAS;
     VkBuffer m_instancesBuffer;
     VkDeviceMemory m_instancesMemory;
+    // One slice of instances per frame in flight, persistently mapped, so
+    // moved instances are written while the GPU reads the other slice
+    uint8_t* m_instancesMapped = nullptr;
+    std::vector<uint32_t> m_instanceMeshes; // Scene mesh of every TLAS instance
+    uint64_t m_instanceTransformVersion = 0; // SceneTransforms version the TLAS was last built or updated from
+    VkBuffer m_topLevelScratchBuffer = VK_NULL_HANDLE; // Kept for TLAS updates
+    VkDeviceMemory m_topLevelScratchMemory = VK_NULL_HANDLE;
+    VkDeviceAddress m_topLevelScratchAddress = 0;
+    std::unique_ptr<AccelerationStructureCache> m_asCache; // Null when disabled
+    AccelerationStructureStats m_asStats;
     
-    VkImage m_rtStorageImage;
-    VkDeviceMemory m_rtStorageMemory;
-    VkImageView m_rtStorageImageView;
-    VkFormat m_rtStorageFormat;
     VkDescriptorSetLayout m_rtDescriptorSetLayout;
     VkPipelineLayout m_rtPipelineLayout;
     VkPipeline m_rtPipeline;
     VkDescriptorPool m_rtDescriptorPool;
-    std::vector<VkDescriptorSet> m_rtDescriptorSets;
+    VkDescriptorSet m_rtDescriptorSet = VK_NULL_HANDLE;
+    // Global bindless scene set (set 1 of the RT pipeline layout), created
+    // once. The per-mesh tables are rewritten in place and geometry is
+    // reached through their buffer addresses, so neither the pool nor the
+    // layout is rebuilt when meshes are added.
+    VkDescriptorSetLayout m_bindlessSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool m_bindlessPool = VK_NULL_HANDLE;
+    VkDescriptorSet m_bindlessSet = VK_NULL_HANDLE;
     VkBuffer m_rtShaderBindingTable;
     VkDeviceMemory m_rtShaderBindingTableMemory;
     VkStridedDeviceAddressRegionKHR m_rtRaygenRegion{};
@@ -170,17 +602,81 @@ private:
     VkStridedDeviceAddressRegionKHR m_rtHitRegion{};
     VkStridedDeviceAddressRegionKHR m_rtCallableRegion{};
     VkPhysicalDeviceRayTracingPipelinePropertiesKHR m_rtProperties{};
+    std::vector<uint8_t> m_rtShaderBindingTableData; // Host copy written by the compile job
 
     bool m_rtReady;
+    // Background RT pipeline compile; the flag is only touched by the main thread
+    std::unique_ptr<JobCounter> m_rtCompileJobs;
+    bool m_rtCompilePending = false;
+    std::chrono::steady_clock::time_point m_rtCompileStart;
+
+    bool m_rayQuerySupported;
+    VkPipeline m_rayQueryPipeline;
+
+    // CPU reference backend: the BVH is built on the job system after
+    // initGeometry, and each frame's radiance and motion reach the HDR and
+    // motion images through a persistently mapped upload buffer per frame
+    // in flight (RGBA16F rows, then RG16F rows)
+    std::unique_ptr<CpuTracer> m_cpuTracer;
+    std::unique_ptr<JobCounter> m_cpuTracerJobs;
+    bool m_cpuTracerPending = false; // Only touched by the main thread
+    std::vector<VkBuffer> m_cpuUploadBuffers;
+    std::vector<VkDeviceMemory> m_cpuUploadMemory;
+    std::vector<uint8_t*> m_cpuUploadMapped;
+    VkDeviceSize m_cpuUploadSize = 0;
+    RenderBackend m_backend;
+    bool m_shadowsEnabled;
+
+    std::unique_ptr<GpuProfiler> m_profiler;
+    std::unique_ptr<PostProcess> m_postProcess;
+    PostProcessSettings m_postSettings;
+    uint32_t m_frameCounter; // Seeds the post chain dither and the jitter sequence
 
     PFN_vkCreateAccelerationStructureKHR m_vkCreateAccelerationStructureKHR = nullptr;
     PFN_vkDestroyAccelerationStructureKHR m_vkDestroyAccelerationStructureKHR = nullptr;
     PFN_vkGetAccelerationStructureDeviceAddressKHR m_vkGetAccelerationStructureDeviceAddressKHR = nullptr;
     PFN_vkCmdBuildAccelerationStructuresKHR m_vkCmdBuildAccelerationStructuresKHR = nullptr;
     PFN_vkGetAccelerationStructureBuildSizesKHR m_vkGetAccelerationStructureBuildSizesKHR = nullptr;
+    PFN_vkCmdCopyAccelerationStructureToMemoryKHR m_vkCmdCopyAccelerationStructureToMemoryKHR = nullptr;
+    PFN_vkCmdCopyMemoryToAccelerationStructureKHR m_vkCmdCopyMemoryToAccelerationStructureKHR = nullptr;
+    PFN_vkCmdWriteAccelerationStructuresPropertiesKHR m_vkCmdWriteAccelerationStructuresPropertiesKHR = nullptr;
+    PFN_vkGetDeviceAccelerationStructureCompatibilityKHR m_vkGetDeviceAccelerationStructureCompatibilityKHR = nullptr;
     PFN_vkCreateRayTracingPipelinesKHR m_vkCreateRayTracingPipelinesKHR = nullptr;
     PFN_vkGetRayTracingShaderGroupHandlesKHR m_vkGetRayTracingShaderGroupHandlesKHR = nullptr;
     PFN_vkCmdTraceRaysKHR m_vkCmdTraceRaysKHR = nullptr;
+    PFN_vkCreateDeferredOperationKHR m_vkCreateDeferredOperationKHR = nullptr;
+    PFN_vkDestroyDeferredOperationKHR m_vkDestroyDeferredOperationKHR = nullptr;
+    PFN_vkGetDeferredOperationMaxConcurrencyKHR m_vkGetDeferredOperationMaxConcurrencyKHR = nullptr;
+    PFN_vkGetDeferredOperationResultKHR m_vkGetDeferredOperationResultKHR = nullptr;
+    PFN_vkDeferredOperationJoinKHR m_vkDeferredOperationJoinKHR = nullptr;
+    PFN_vkCmdDrawIndexedIndirectCountKHR m_vkCmdDrawIndexedIndirectCountKHR = nullptr;
+    PFN_vkCmdDrawMeshTasksEXT m_vkCmdDrawMeshTasksEXT = nullptr;
     
     static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+    static constexpr double RECORD_TIME_SMOOTHING = 0.05; // Weight of the newest frame in m_recordCpuMs and m_inputToPresentMs
+    static constexpr uint32_t RAY_QUERY_TILE_SIZE = 8; // Matches local_size in ray_query.comp
+    static constexpr uint32_t CULL_GROUP_SIZE = 64;    // Matches local_size in draw_cull.comp
+    static constexpr uint32_t HIZ_TILE_SIZE = 8;       // Matches local_size in hiz_build.comp
+    static constexpr uint32_t CLUSTER_GROUP_SIZE = 64; // Matches local_size in cluster_lights.comp
+    static constexpr uint32_t MESHLET_TASK_GROUP_SIZE = 32; // Matches local_size in meshlet.task
+    static constexpr uint32_t MAX_DISPATCH_GROUPS = 65535;  // Guaranteed maxComputeWorkGroupCount per dimension
+    static constexpr uint32_t CLUSTER_TILE_SIZE = 64;  // Pixels per cluster tile edge
+    static constexpr uint32_t CLUSTER_DEPTH_SLICES = 24;
+    static constexpr uint32_t MAX_LIGHTS_PER_CLUSTER = 128;
+    static constexpr uint32_t MAX_POINT_LIGHTS = 4096;
+    static constexpr uint32_t KEY_LIGHT_COUNT = 4;      // LightingUBO lights, always first in the point light list
+    static constexpr float KEY_LIGHT_RANGE = 150.0f;
+    static constexpr float EMISSIVE_LIGHT_REACH = 8.0f; // How far past its bounds an emissive mesh lights
+    static constexpr uint32_t MAX_SHADOW_LIGHTS = 2;   // Shadow rays per hit, strongest lights first
+    static constexpr uint32_t TRACE_FLAG_SHADOWS = 1u << 0;
+    static constexpr uint32_t MAX_BINDLESS_TEXTURES = 1024; // Reserved for material textures; the loader has none yet
+    static constexpr VkBuildAccelerationStructureFlagsKHR BLAS_BUILD_FLAGS = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+    static constexpr VkDeviceSize AS_SERIALIZATION_ALIGNMENT = 256; // Required for serialized AS addresses
+    static constexpr VkFormat MOTION_FORMAT = VK_FORMAT_R16G16_SFLOAT;
+    static constexpr VkFormat DEPTH_FORMAT = VK_FORMAT_D32_SFLOAT;
+    static constexpr VkFormat HIZ_FORMAT = VK_FORMAT_R32_SFLOAT;
+    // Jitter phases at native resolution; scaled by the upscale area ratio so
+    // every output pixel still sees a spread of sample positions
+    static constexpr uint32_t BASE_JITTER_PHASES = 8;
+    static constexpr uint32_t MAX_JITTER_PHASES = 64;
 };
@@ -0,0 +1,171 @@
+#include "Simulation.h"
+#include "Camera.h"
+#include "Scene.h"
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+// Skips the copy when both already hold the same matrices
+void copyTransforms(const SceneTransforms& from, SceneTransforms& to) {
+    if (to.version != from.version || to.meshWorlds.size() != from.meshWorlds.size()) {
+        to = from;
+    }
+}
+
+} // namespace
+
+Simulation::Simulation(Camera& camera, Scene& scene, double tickRate)
+    : m_camera(camera)
+    , m_scene(scene)
+    , m_tickRate(tickRate)
+    , m_tickInterval(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / tickRate))) {
+    // Until the first tick both snapshot states are the initial one
+    m_lastState = captureState();
+    m_scene.captureTransforms(m_lastTransforms);
+    SimulationSnapshot initial;
+    initial.previous = m_lastState;
+    initial.current = m_lastState;
+    initial.previousTransforms = m_lastTransforms;
+    initial.currentTransforms = m_lastTransforms;
+    initial.currentTime = std::chrono::steady_clock::now();
+    m_snapshots.back() = initial;
+    m_snapshots.publish();
+}
+
+Simulation::~Simulation() {
+    stop();
+}
+
+void Simulation::start() {
+    if (m_running.exchange(true)) {
+        return;
+    }
+    std::cout << "[Sim] Fixed timestep at " << m_tickRate << " Hz" << std::endl;
+    m_thread = std::thread([this]() { threadLoop(); });
+}
+
+void Simulation::stop() {
+    m_running.store(false);
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void Simulation::setInput(const SimulationInput& input, bool enabled) {
+    m_input.back() = {input, enabled};
+    m_input.publish();
+}
+
+SimulationState Simulation::sample(std::chrono::steady_clock::time_point now) {
+    m_snapshots.update();
+    const SimulationSnapshot& snapshot = m_snapshots.front();
+
+    float alpha = getBlendFactor(snapshot, now);
+
+    SimulationState state;
+    state.cameraPosition = glm::mix(snapshot.previous.cameraPosition, snapshot.current.cameraPosition, alpha);
+    state.sceneTime = glm::mix(snapshot.previous.sceneTime, snapshot.current.sceneTime, alpha);
+    return state;
+}
+
+const SceneTransforms& Simulation::sampleTransforms(std::chrono::steady_clock::time_point now) {
+    m_snapshots.update();
+    const SimulationSnapshot& snapshot = m_snapshots.front();
+    const SceneTransforms& previous = snapshot.previousTransforms;
+    const SceneTransforms& current = snapshot.currentTransforms;
+    if (previous.version == current.version || previous.meshWorlds.size() != current.meshWorlds.size()) {
+        copyTransforms(current, m_sampledTransforms);
+        return m_sampledTransforms;
+    }
+
+    // Matrices are blended per element, close enough to a rotation for the
+    // motion of one tick
+    float alpha = getBlendFactor(snapshot, now);
+    m_sampledTransforms.meshWorlds.resize(current.meshWorlds.size());
+    for (size_t i = 0; i < current.meshWorlds.size(); ++i) {
+        const glm::mat4& from = previous.meshWorlds[i];
+        const glm::mat4& to = current.meshWorlds[i];
+        m_sampledTransforms.meshWorlds[i] = from == to ? to : from + (to - from) * alpha;
+    }
+    m_sampledTransforms.version = BLENDED_VERSION | ++m_blendCount;
+    return m_sampledTransforms;
+}
+
+// Shown one tick late so there is always a state to blend towards
+float Simulation::getBlendFactor(const SimulationSnapshot& snapshot, std::chrono::steady_clock::time_point now) const {
+    float alpha = static_cast<float>(std::chrono::duration<double>(now - snapshot.currentTime).count() * m_tickRate);
+    return std::clamp(alpha, 0.0f, 1.0f);
+}
+
+void Simulation::threadLoop() {
+    const float deltaTime = static_cast<float>(1.0 / m_tickRate);
+    auto nextTick = std::chrono::steady_clock::now();
+
+    while (m_running.load(std::memory_order_relaxed)) {
+        auto tickStart = std::chrono::steady_clock::now();
+        step(deltaTime);
+        auto tickEnd = std::chrono::steady_clock::now();
+
+        SimulationSnapshot& snapshot = m_snapshots.back();
+        snapshot.previous = m_lastState;
+        snapshot.current = captureState();
+        copyTransforms(m_lastTransforms, snapshot.previousTransforms);
+        m_scene.captureTransforms(snapshot.currentTransforms);
+        snapshot.currentTime = tickEnd;
+        snapshot.tick = m_tickCount.load(std::memory_order_relaxed) + 1;
+        m_lastState = snapshot.current;
+        copyTransforms(snapshot.currentTransforms, m_lastTransforms);
+        m_snapshots.publish();
+
+        double tickMs = std::chrono::duration<double, std::milli>(tickEnd - tickStart).count();
+        double smoothed = m_tickCpuMs.load(std::memory_order_relaxed);
+        m_tickCpuMs.store(smoothed + (tickMs - smoothed) * TICK_TIME_SMOOTHING, std::memory_order_relaxed);
+        m_tickCount.fetch_add(1, std::memory_order_relaxed);
+
+        // Catch up after short stalls, but a long one (debugger, slow tick)
+        // resets the schedule instead of fast-forwarding the world
+        nextTick += m_tickInterval;
+        if (tickEnd - nextTick > m_tickInterval * MAX_CATCH_UP_TICKS) {
+            nextTick = tickEnd;
+        }
+        std::this_thread::sleep_until(nextTick);
+    }
+}
+
+void Simulation::step(float deltaTime) {
+    m_input.update();
+    const InputSample& sample = m_input.front();
+    if (sample.enabled) {
+        const SimulationInput& input = sample.input;
+        m_camera.setOrientation(input.yaw, input.pitch);
+        if (input.forward) {
+            m_camera.moveForward(deltaTime);
+        }
+        if (input.backward) {
+            m_camera.moveBackward(deltaTime);
+        }
+        if (input.left) {
+            m_camera.moveLeft(deltaTime);
+        }
+        if (input.right) {
+            m_camera.moveRight(deltaTime);
+        }
+        if (input.up) {
+            m_camera.moveUp(deltaTime);
+        }
+        if (input.down) {
+            m_camera.moveDown(deltaTime);
+        }
+    }
+
+    m_camera.update(deltaTime);
+    m_scene.update(deltaTime);
+}
+
+SimulationState Simulation::captureState() const {
+    SimulationState state;
+    state.cameraPosition = m_camera.getPosition();
+    state.sceneTime = m_scene.getTime();
+    return state;
+}
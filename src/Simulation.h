@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <glm/glm.hpp>
+#include "Scene.h"
+#include "TripleBuffer.h"
+
+class Camera;
+
+// Input sampled by the main thread, which owns the window; the simulation
+// applies the newest sample on each tick. Mouse look stays on the main thread
+// so the camera can be latched right before submit; the simulation only
+// takes the resulting look direction to move along.
+struct SimulationInput {
+    bool forward = false;
+    bool backward = false;
+    bool left = false;
+    bool right = false;
+    bool up = false;
+    bool down = false;
+    float yaw = 0.0f;
+    float pitch = 0.0f;
+};
+
+// Everything the render thread needs from one tick
+struct SimulationState {
+    glm::vec3 cameraPosition{0.0f};
+    float sceneTime = 0.0f;
+};
+
+// Immutable once published. Carries the two latest ticks so the reader can
+// interpolate even when it skipped snapshots.
+struct SimulationSnapshot {
+    SimulationState previous;
+    SimulationState current;
+    SceneTransforms previousTransforms;
+    SceneTransforms currentTransforms;
+    std::chrono::steady_clock::time_point currentTime; // When current was produced
+    uint64_t tick = 0;
+};
+
+// Fixed-timestep simulation on its own thread: camera movement and scene
+// animation advance by exactly one tick interval per step, independent of
+// the frame rate. The render thread reads interpolated state and never waits
+// for a tick.
+class Simulation {
+public:
+    Simulation(Camera& camera, Scene& scene, double tickRate);
+    ~Simulation();
+
+    Simulation(const Simulation&) = delete;
+    Simulation& operator=(const Simulation&) = delete;
+
+    void start();
+    void stop();
+
+    // Main thread. Without input enabled the camera holds still (benchmarks).
+    void setInput(const SimulationInput& input, bool enabled);
+    // Main thread. State one tick behind the newest, blended by how far the
+    // current time is into the next tick.
+    SimulationState sample(std::chrono::steady_clock::time_point now);
+    // Main thread. Mesh world matrices blended the same way, valid until the
+    // next call. While meshes move every result has a new version.
+    const SceneTransforms& sampleTransforms(std::chrono::steady_clock::time_point now);
+
+    double getTickRate() const { return m_tickRate; }
+    double getTickCpuMs() const { return m_tickCpuMs.load(std::memory_order_relaxed); }
+    uint64_t getTickCount() const { return m_tickCount.load(std::memory_order_relaxed); }
+
+private:
+    void threadLoop();
+    void step(float deltaTime);
+    SimulationState captureState() const;
+    float getBlendFactor(const SimulationSnapshot& snapshot, std::chrono::steady_clock::time_point now) const;
+
+    Camera& m_camera; // Simulation thread's; the renderer gets a separate copy
+    Scene& m_scene;
+    double m_tickRate;
+    std::chrono::steady_clock::duration m_tickInterval;
+
+    struct InputSample {
+        SimulationInput input;
+        bool enabled = false;
+    };
+    TripleBuffer<InputSample> m_input;             // Main thread -> simulation
+    TripleBuffer<SimulationSnapshot> m_snapshots;  // Simulation -> main thread
+
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+    std::atomic<double> m_tickCpuMs{0.0};
+    std::atomic<uint64_t> m_tickCount{0};
+    SimulationState m_lastState; // Simulation thread only
+    SceneTransforms m_lastTransforms; // Simulation thread only
+    SceneTransforms m_sampledTransforms; // Main thread only
+    uint64_t m_blendCount = 0;
+
+    static constexpr double TICK_TIME_SMOOTHING = 0.05; // Weight of the newest tick in m_tickCpuMs
+    static constexpr uint32_t MAX_CATCH_UP_TICKS = 5;   // Further behind than this, drop time instead
+    static constexpr uint64_t BLENDED_VERSION = 1ull << 63; // Marks blended transforms, above any graph version
+};
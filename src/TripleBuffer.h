@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single-producer/single-consumer handoff of the latest value. The
+// writer fills back() and publishes it; the reader picks up the newest
+// published value with update() and reads front() until its next update.
+// Neither side ever waits for the other, and values the reader was too slow
+// to see are overwritten.
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() = default;
+    explicit TripleBuffer(const T& initial) {
+        m_buffers.fill(initial);
+    }
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // Writer only
+    T& back() { return m_buffers[m_back]; }
+    void publish() {
+        m_back = m_middle.exchange(m_back | FRESH_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // Reader only, returns whether front() changed
+    bool update() {
+        if ((m_middle.load(std::memory_order_relaxed) & FRESH_BIT) == 0) {
+            return false;
+        }
+        m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+    const T& front() const { return m_buffers[m_front]; }
+
+private:
+    static constexpr uint8_t INDEX_MASK = 0x3;
+    static constexpr uint8_t FRESH_BIT = 0x4; // Middle holds a value the reader has not taken
+
+    std::array<T, 3> m_buffers{};
+    uint8_t m_front = 0;                // Reader's
+    std::atomic<uint8_t> m_middle{1};   // Last published, swapped by both sides
+    uint8_t m_back = 2;                 // Writer's
+};